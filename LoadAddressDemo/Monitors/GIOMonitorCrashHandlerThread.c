@@ -0,0 +1,189 @@
+//
+//  GIOMonitorCrashHandlerThread.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashHandlerThread.h"
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashMonitorContext.h"
+#include "GIOMonitorCrashMachineContext.h"
+#include "GIOMonitorCrashThread.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#include <mach/mach.h>
+#include <pthread.h>
+#include <string.h>
+
+
+/** Stack size of the handler thread. Large enough for the report writer's
+ * buffers with plenty of room to spare. */
+#define kHandlerThreadStackSize (512 * 1024)
+
+/** How long the crashed thread waits for the report, in seconds. */
+#define kHandleTimeoutSeconds 5
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static bool g_isStarted = false;
+
+static thread_t g_handlerThread;
+
+/** Signalled by the crashed thread when a request is ready. */
+static semaphore_t g_requestSemaphore;
+
+/** Signalled by the handler thread when a request has been handled. */
+static semaphore_t g_doneSemaphore;
+
+/** The pending request. Only written while g_isBusy is held. */
+static void (*volatile g_onEvent)(struct GIOMonitorCrash_MonitorContext* monitorContext);
+static struct GIOMonitorCrash_MonitorContext* volatile g_monitorContext;
+
+/** The crashed thread, and whether it handed its crash arena over with the
+ * request. The crashed context's buffers were allocated there, so the
+ * arena has to move with it rather than be acquired afresh.
+ */
+static volatile GIOMonitorCrashThread g_requestingThread;
+static volatile bool g_hasArena;
+
+/** Held by the crashed thread while it waits for its request. If it stops
+ * waiting, it marks the request abandoned, and the handler thread frees
+ * itself once it's done.
+ */
+#define kBusyIdle 0
+#define kBusyWaiting 1
+#define kBusyAbandoned 2
+static volatile int g_isBusy = kBusyIdle;
+
+
+// ============================================================================
+#pragma mark - Handler Thread -
+// ============================================================================
+
+static void* handlerThread(void* const userData)
+{
+    pthread_setname_np((const char*)userData);
+
+    for(;;)
+    {
+        if(semaphore_wait(g_requestSemaphore) != KERN_SUCCESS)
+        {
+            continue;
+        }
+        GIOMonitorCrashLOG_DEBUG("Handling crash on the handler thread.");
+        g_onEvent(g_monitorContext);
+        // An abandoned request's arena stays here. Handing it back to a
+        // thread that no longer waits for it would leave it held forever.
+        if(g_hasArena && __atomic_load_n(&g_isBusy, __ATOMIC_ACQUIRE) == kBusyWaiting)
+        {
+            gioMonitorCrashArena_transfer(g_requestingThread);
+        }
+        semaphore_signal(g_doneSemaphore);
+        // Nobody is waiting for an abandoned request, so the signal above is
+        // stale. The next request drops it.
+        __atomic_compare_exchange_n(&g_isBusy, &(int){kBusyAbandoned}, kBusyIdle, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+bool gioMonitorCrashHandlerThread_start(void)
+{
+    if(g_isStarted)
+    {
+        return true;
+    }
+
+    const task_t thisTask = mach_task_self();
+    if(semaphore_create(thisTask, &g_requestSemaphore, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not create crash handler request semaphore");
+        return false;
+    }
+    if(semaphore_create(thisTask, &g_doneSemaphore, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not create crash handler done semaphore");
+        semaphore_destroy(thisTask, g_requestSemaphore);
+        return false;
+    }
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, kHandlerThreadStackSize);
+    int error = pthread_create(&thread, &attr, handlerThread, "GIOMonitorCrash Crash Handler");
+    pthread_attr_destroy(&attr);
+    if(error != 0)
+    {
+        GIOMonitorCrashLOG_ERROR("pthread_create: %s", strerror(error));
+        semaphore_destroy(thisTask, g_requestSemaphore);
+        semaphore_destroy(thisTask, g_doneSemaphore);
+        return false;
+    }
+    g_handlerThread = pthread_mach_thread_np(thread);
+    gioMonitorCrashMachineContext_addReservedThread((GIOMonitorCrashThread)g_handlerThread);
+    g_isStarted = true;
+    GIOMonitorCrashLOG_DEBUG("Crash handler thread started.");
+    return true;
+}
+
+bool gioMonitorCrashHandlerThread_handleException(void (*onEvent)(struct GIOMonitorCrash_MonitorContext* monitorContext),
+                                                  struct GIOMonitorCrash_MonitorContext* monitorContext)
+{
+    if(!g_isStarted || (thread_t)gioMonitorCrashThread_self() == g_handlerThread)
+    {
+        return false;
+    }
+    if(!__atomic_compare_exchange_n(&g_isBusy, &(int){kBusyIdle}, kBusyWaiting, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return false;
+    }
+    const mach_timespec_t noWait = {0, 0};
+    while(semaphore_timedwait(g_doneSemaphore, noWait) == KERN_SUCCESS)
+    {
+        // Left by an abandoned request.
+    }
+
+    g_onEvent = onEvent;
+    g_monitorContext = monitorContext;
+    g_requestingThread = gioMonitorCrashThread_self();
+    g_hasArena = gioMonitorCrashArena_transfer((GIOMonitorCrashThread)g_handlerThread);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    semaphore_signal(g_requestSemaphore);
+
+    mach_timespec_t timeout = {kHandleTimeoutSeconds, 0};
+    kern_return_t kr;
+    do
+    {
+        kr = semaphore_timedwait(g_doneSemaphore, timeout);
+    } while(kr == KERN_ABORTED);
+    if(kr != KERN_SUCCESS)
+    {
+        // Writing inline now would race the handler thread for the same
+        // file, so settle for whatever it has written so far.
+        GIOMonitorCrashLOG_ERROR("Crash handler thread did not finish within %d seconds", kHandleTimeoutSeconds);
+        __atomic_store_n(&g_isBusy, kBusyAbandoned, __ATOMIC_RELEASE);
+        if(semaphore_timedwait(g_doneSemaphore, noWait) == KERN_SUCCESS)
+        {
+            // It finished after the timeout but before the request was
+            // marked abandoned, so it didn't free itself.
+            __atomic_compare_exchange_n(&g_isBusy, &(int){kBusyAbandoned}, kBusyIdle, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        }
+        return true;
+    }
+    __atomic_store_n(&g_isBusy, kBusyIdle, __ATOMIC_RELEASE);
+    return true;
+}
@@ -0,0 +1,67 @@
+//
+//  GIOMonitorCrashHandlerThread.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Hands fatal crashes off to a dedicated thread.
+ *
+ * The thread is started at install time with its own large stack, and is
+ * reserved so that suspending the environment leaves it running. When a
+ * crash occurs, the crashed thread only fills in the crash context, signals
+ * the handler thread and waits for it. The report is then written on a
+ * known good stack rather than on the crashed thread's, which may have
+ * overflowed or been corrupted.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashHandlerThread_h
+#define HDR_GIOMonitorCrashHandlerThread_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+
+struct GIOMonitorCrash_MonitorContext;
+
+
+/** Start the handler thread. Does nothing if it is already running.
+ * This allocates memory, so never call it from a crash handler.
+ *
+ * @return true if the handler thread is running.
+ */
+bool gioMonitorCrashHandlerThread_start(void);
+
+/** Have the handler thread call onEvent with a crash context, and wait for it
+ * to return. This is async-safe.
+ *
+ * It fails if the handler thread isn't running, is busy with another crash,
+ * or is the calling thread (it has crashed itself). The caller should call
+ * onEvent directly in that case. If the wait times out, the handler thread
+ * carries on, and takes new requests once it has finished.
+ *
+ * If the calling thread owns the crash arena, the handler thread gets it for
+ * the duration of the request, and hands it back before this returns. After
+ * a timeout the handler thread keeps it.
+ *
+ * @param onEvent The function to call.
+ *
+ * @param monitorContext The crash context to pass to onEvent.
+ *
+ * @return true if the handler thread handled the crash, or timed out trying.
+ */
+bool gioMonitorCrashHandlerThread_handleException(void (*onEvent)(struct GIOMonitorCrash_MonitorContext* monitorContext),
+                                                  struct GIOMonitorCrash_MonitorContext* monitorContext);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashHandlerThread_h
@@ -31,13 +31,16 @@
 
 #include "GIOMonitorCrashReportStore.h"
 #include "GIOMonitorCrashReport.h"
+#include "GIOMonitorCrashArena.h"
 #include "GIOMonitorCrashFileUtils.h"
+#include "GIOMonitorCrashSnapshotLimiter.h"
 
-//#include "GIOMonitorCrashMonitor_Deadlock.h"
+#include "GIOMonitorCrashHandlerThread.h"
+#include "GIOMonitorCrashMonitor_Deadlock.h"
 //#include "GIOMonitorCrashMonitor_MachException.h"
 ////#include "GIOMonitorCrashMonitor_CPPException.h"
 //#include "GIOMonitorCrashMonitor_NSException.h"
-//#include "GIOMonitorCrashMonitor_Signal.h"
+#include "GIOMonitorCrashMonitor_Signal.h"
 //#include "GIOMonitorCrashMonitor_System.h"
 //#include "GIOMonitorCrashMonitor_User.h"
 //#include "GIOMonitorCrashMonitor_AppState.h"
@@ -70,22 +73,24 @@ static Monitor g_monitors[] =
 //        .getAPI = gioMonitorCrashCM_machexception_getAPI,
 //    },
 //#endif
-//#if GIOMonitorCrashCRASH_HAS_SIGNAL
-//    {
-//        .monitorType = GIOMonitorCrashMonitorTypeSignal,
-//        .getAPI = gioMonitorCrashCM_signal_getAPI,
-//    },
-//#endif
+#if GIOMonitorCrashCRASH_HAS_SIGNAL
+    {
+        .monitorType = GIOMonitorCrashMonitorTypeSignal,
+        .getAPI = gioMonitorCrashCM_signal_getAPI,
+    },
+#endif
+#if GIOMonitorCrashCRASH_HAS_OBJC
+    {
+        .monitorType = GIOMonitorCrashMonitorTypeMainThreadDeadlock,
+        .getAPI = gioMonitorCrashCM_deadlock_getAPI,
+    },
+#endif
 //#if GIOMonitorCrashCRASH_HAS_OBJC
 //    {
 //        .monitorType = GIOMonitorCrashMonitorTypeNSException,
 //        .getAPI = gioMonitorCrashCM_nsexception_getAPI,
 //    },
 //    {
-//        .monitorType = GIOMonitorCrashMonitorTypeMainThreadDeadlock,
-//        .getAPI = gioMonitorCrashCM_deadlock_getAPI,
-//    },
-//    {
 //        .monitorType = GIOMonitorCrashMonitorTypeZombie,
 //        .getAPI = gioMonitorCrashCM_zombie_getAPI,
 //    },
@@ -115,6 +120,7 @@ static GIOMonitorCrashMonitorType g_activeMonitors = GIOMonitorCrashMonitorTypeN
 static bool g_handlingFatalException = false;
 static bool g_crashedDuringExceptionHandling = false;
 static bool g_requiresAsyncSafety = false;
+static bool g_shouldDeferReportFormatting = false;
 
 static void (*g_onExceptionEvent)(struct GIOMonitorCrash_MonitorContext* monitorContext);
 
@@ -133,6 +139,15 @@ static inline GIOMonitorCrashMonitorAPI* getAPI(Monitor* monitor)
     return NULL;
 }
 
+static inline void setMonitorEnabled(Monitor* monitor, bool isEnabled)
+{
+    GIOMonitorCrashMonitorAPI* api = getAPI(monitor);
+    if(api != NULL && api->setEnabled != NULL)
+    {
+        api->setEnabled(isEnabled);
+    }
+}
+
 static inline bool isMonitorEnabled(Monitor* monitor)
 {
     GIOMonitorCrashMonitorAPI* api = getAPI(monitor);
@@ -157,6 +172,11 @@ void gioMonitorCrashCM_setEventCallback(void (*onEvent)(struct GIOMonitorCrash_M
     g_onExceptionEvent = onEvent;
 }
 
+void gioMonitorCrashCM_setDeferReportFormatting(bool shouldDeferReportFormatting)
+{
+    g_shouldDeferReportFormatting = shouldDeferReportFormatting;
+}
+
 void gioMonitorCrashCM_setActiveMonitors(GIOMonitorCrashMonitorType monitorTypes)
 {
     //  GIO DELETE
@@ -173,32 +193,32 @@ void gioMonitorCrashCM_setActiveMonitors(GIOMonitorCrashMonitorType monitorTypes
 //        }
 //        monitorTypes &= GIOMonitorCrashMonitorTypeDebuggerSafe;
 //    }
-//    if(g_requiresAsyncSafety && (monitorTypes & GIOMonitorCrashMonitorTypeAsyncUnsafe))
-//    {
-//        GIOMonitorCrashLOG_DEBUG("Async-safe environment detected. Masking out unsafe monitors.");
-//        monitorTypes &= GIOMonitorCrashMonitorTypeAsyncSafe;
-//    }
-//
-//    GIOMonitorCrashLOG_DEBUG("Changing active monitors from 0x%x tp 0x%x.", g_activeMonitors, monitorTypes);
-//
-//    GIOMonitorCrashMonitorType activeMonitors = GIOMonitorCrashMonitorTypeNone;
-//    for(int i = 0; i < g_monitorsCount; i++)
-//    {
-//        Monitor* monitor = &g_monitors[i];
-//        bool isEnabled = monitor->monitorType & monitorTypes;
-//        setMonitorEnabled(monitor, isEnabled);
-//        if(isMonitorEnabled(monitor))
-//        {
-//            activeMonitors |= monitor->monitorType;
-//        }
-//        else
-//        {
-//            activeMonitors &= ~monitor->monitorType;
-//        }
-//    }
-//
-//    GIOMonitorCrashLOG_DEBUG("Active monitors are now 0x%x.", activeMonitors);
-//    g_activeMonitors = activeMonitors;
+    if(g_requiresAsyncSafety && (monitorTypes & GIOMonitorCrashMonitorTypeAsyncUnsafe))
+    {
+        GIOMonitorCrashLOG_DEBUG("Async-safe environment detected. Masking out unsafe monitors.");
+        monitorTypes &= GIOMonitorCrashMonitorTypeAsyncSafe;
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Changing active monitors from 0x%x tp 0x%x.", g_activeMonitors, monitorTypes);
+
+    GIOMonitorCrashMonitorType activeMonitors = GIOMonitorCrashMonitorTypeNone;
+    for(int i = 0; i < g_monitorsCount; i++)
+    {
+        Monitor* monitor = &g_monitors[i];
+        bool isEnabled = monitor->monitorType & monitorTypes;
+        setMonitorEnabled(monitor, isEnabled);
+        if(isMonitorEnabled(monitor))
+        {
+            activeMonitors |= monitor->monitorType;
+        }
+        else
+        {
+            activeMonitors &= ~monitor->monitorType;
+        }
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Active monitors are now 0x%x.", activeMonitors);
+    g_activeMonitors = activeMonitors;
 }
 
 GIOMonitorCrashMonitorType gioMonitorCrashCM_getActiveMonitors()
@@ -237,10 +257,37 @@ bool gioMonitorCrashCM_notifyFatalExceptionCaptured(bool isAsyncSafeEnvironment)
  */
 static void onCrash(struct GIOMonitorCrash_MonitorContext* monitorContext)
 {
+    // Buffers come from the crash arena while this thread holds it.
+    const bool hasArena = gioMonitorCrashArena_acquire();
     char crashReportFilePath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
-    gioMonitorCRS_getNextCrashReportPath(crashReportFilePath);
-    strncpy(g_lastCrashReportFilePath, crashReportFilePath, sizeof(g_lastCrashReportFilePath));
-    gioMonitorCrashReport_writeStandardReport(monitorContext, crashReportFilePath);
+    if(g_shouldDeferReportFormatting && !monitorContext->currentSnapshotUserReported)
+    {
+        // Formatted into a report on the next launch, which also coalesces it.
+        gioMonitorCRS_getNextRawCapturePath(crashReportFilePath);
+        if(gioMonitorCrashReport_writeRawCapture(monitorContext, crashReportFilePath))
+        {
+            // The capture carries the suppressed snapshot counts now.
+            gioMonitorCrashSnapshotLimiter_commitSuppressedCounts();
+        }
+    }
+    else
+    {
+        int64_t reportID = gioMonitorCRS_getNextCrashReportPath(crashReportFilePath);
+        strncpy(g_lastCrashReportFilePath, crashReportFilePath, sizeof(g_lastCrashReportFilePath));
+        gioMonitorCrashReport_writeStandardReport(monitorContext, crashReportFilePath);
+        // Snapshots were asked for, so each one is kept.
+        const bool isCoalesced = !monitorContext->currentSnapshotUserReported &&
+            gioMonitorCRS_coalesceReport(reportID, gioMonitorCrashReport_getLastFingerprint(), true);
+        // A coalesced report is gone, so its suppressed snapshot counts go in the next one.
+        if(!isCoalesced)
+        {
+            gioMonitorCrashSnapshotLimiter_commitSuppressedCounts();
+        }
+    }
+    if(hasArena)
+    {
+        gioMonitorCrashArena_release();
+    }
 }
 
 void gioMonitorCrashCM_handleException(struct GIOMonitorCrash_MonitorContext* context)
@@ -260,8 +307,13 @@ void gioMonitorCrashCM_handleException(struct GIOMonitorCrash_MonitorContext* co
     }
 
     g_onExceptionEvent = onCrash;
-    
-    g_onExceptionEvent(context);
+
+    // Fatal crashes are written on the handler thread's stack when it's running.
+    if(context->currentSnapshotUserReported ||
+       !gioMonitorCrashHandlerThread_handleException(g_onExceptionEvent, context))
+    {
+        g_onExceptionEvent(context);
+    }
 
     if (context->currentSnapshotUserReported) {
         g_handlingFatalException = false;
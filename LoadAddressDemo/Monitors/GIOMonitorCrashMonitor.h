@@ -65,6 +65,15 @@ GIOMonitorCrashMonitorType gioMonitorCrashCM_getActiveMonitors(void);
  */
 void gioMonitorCrashCM_setEventCallback(void (*onEvent)(struct GIOMonitorCrash_MonitorContext* monitorContext));
 
+/** Configure whether fatal crashes are dumped as raw captures, to be
+ *  formatted into reports on the next launch, instead of being formatted
+ *  inside the crash handler. User reported snapshots are always formatted
+ *  right away.
+ *
+ * @param shouldDeferReportFormatting If true, defer report formatting.
+ */
+void gioMonitorCrashCM_setDeferReportFormatting(bool shouldDeferReportFormatting);
+
 
 // ============================================================================
 #pragma mark - Internal API -
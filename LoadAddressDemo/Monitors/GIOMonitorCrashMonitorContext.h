@@ -33,6 +33,7 @@ extern "C" {
 #endif
 
 #include "GIOMonitorCrashMonitorType.h"
+#include "GIOMonitorCrashReportProfile.h"
 #include "GIOMonitorCrashMachineContext.h"
 
 #include <stdbool.h>
@@ -47,6 +48,11 @@ typedef struct GIOMonitorCrash_MonitorContext
      */
     bool currentSnapshotUserReported;
 
+    /** What the report captures about each thread. If Default, the profile
+     *  configured for the crash type is used.
+     */
+    GIOMonitorCrashReportProfile reportProfile;
+
     /** If true, the environment has crashed hard, and only async-safe
      *  functions should be used.
      */
@@ -60,6 +66,11 @@ typedef struct GIOMonitorCrash_MonitorContext
     /** If true, a second crash occurred while handling a crash. */
     bool crashedDuringCrashHandling;
 
+    /** If true, the other threads could not be suspended and kept running
+     * while the report was written, so their state may be inconsistent.
+     */
+    bool threadsNotSuspended;
+
     /** If true, the registers contain valid information about the crash. */
     bool registersAreValid;
 
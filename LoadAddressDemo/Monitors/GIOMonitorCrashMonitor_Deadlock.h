@@ -0,0 +1,70 @@
+//
+//  GIOMonitorCrashMonitor_Deadlock.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Catches deadlocks in threads and queues.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashMonitor_Deadlock_h
+#define HDR_GIOMonitorCrashMonitor_Deadlock_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "GIOMonitorCrashMonitor.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/** Set the interval between watchdog checks on the main thread.
+ * Default is 0 (disabled).
+ *
+ * @param value The number of seconds between checks (0 = disabled).
+ */
+void gioMonitorCrashCM_setDeadlockHandlerWatchdogInterval(double value);
+
+/** Set the interval between samples of the main thread's stack while it is
+ * hung (busy for a quarter of a second or more). The samples are aggregated
+ * into a hang profile that is added to the debug section of reports.
+ * Has no effect unless the watchdog interval is set.
+ * Default is 0 (disabled).
+ *
+ * @param value The number of seconds between samples (0 = disabled).
+ */
+void gioMonitorCrashCM_setHangSampleInterval(double value);
+
+/** If true, the app is shut down with abort() once a deadlock is reported.
+ * Otherwise the report is a snapshot, written once per hang, and the app
+ * keeps running.
+ * Default is false.
+ *
+ * @param shouldTerminate If true, terminate on deadlock.
+ */
+void gioMonitorCrashCM_setTerminateOnDeadlock(bool shouldTerminate);
+
+/** Get the CPU time used by the watchdog so far, including hang sampling.
+ * This is the monitor's overhead while the app is running.
+ *
+ * @return The CPU time in microseconds.
+ */
+uint64_t gioMonitorCrashCM_getDeadlockWatchdogCPUTime(void);
+
+/** Access the Monitor API.
+ */
+GIOMonitorCrashMonitorAPI* gioMonitorCrashCM_deadlock_getAPI(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashMonitor_Deadlock_h
@@ -0,0 +1,368 @@
+//
+//  GIOMonitorCrashMonitor_Deadlock.m
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#import "GIOMonitorCrashMonitor_Deadlock.h"
+#import "GIOMonitorCrashMonitorContext.h"
+#import "GIOMonitorCrashArena.h"
+#import "GIOMonitorCrashHangProfile.h"
+#import "GIOMonitorCrashMachineContext.h"
+#import "GIOMonitorCrashReportFields.h"
+#import "GIOMonitorCrashSnapshotLimiter.h"
+#import "GIOMonitorCrashStackCursor_MachineContext.h"
+#import "GIOMonitorCrashThread.h"
+#import <Foundation/Foundation.h>
+
+#include <mach/mach.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <uuid/uuid.h>
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#import "GIOMonitorCrashLogger.h"
+
+
+#define kIdleInterval 5.0f
+
+/** How long the main thread must be busy before hang sampling starts. */
+#define kHangThreshold 0.25
+
+/** Frames kept per hang sample. */
+#define kMaxHangSampleFrames 64
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+/* The main run loop bumps g_heartbeat on every activity: the low bit is 1
+ * while the main thread is busy and 0 while it is waiting for events. The
+ * watchdog thread only reads it, so the main thread never takes a lock or
+ * sends a message to prove it's alive. If the heartbeat hasn't moved for a
+ * whole interval and the main thread wasn't waiting, it's deadlocked.
+ */
+
+static volatile bool g_isEnabled = false;
+
+static GIOMonitorCrash_MonitorContext g_monitorContext;
+
+/** Interval between watchdog sentinel checks on the main queue. */
+static double g_watchdogInterval = 0;
+
+/** Interval between main thread samples during a hang (0 = don't sample). */
+static double g_hangSampleInterval = 0;
+
+/** If true, the app is shut down once a deadlock is reported. */
+static bool g_shouldTerminateOnDeadlock = false;
+
+/** Thread which our watchdog is watching. */
+static GIOMonitorCrashThread g_mainQueueThread;
+
+/** Main run loop activity counter. */
+static uint32_t g_heartbeat = 0;
+
+/** Incremented whenever the watchdog should stop, so an old thread never
+ * keeps running alongside a new one.
+ */
+static uint32_t g_watchdogGeneration = 0;
+
+static CFRunLoopObserverRef g_runLoopObserver = NULL;
+
+/** CPU time used by all watchdog threads so far, in microseconds. */
+static uint64_t g_watchdogCPUTimeUSec = 0;
+
+
+// ============================================================================
+#pragma mark - Callbacks -
+// ============================================================================
+
+static void onMainRunLoopActivity(__unused CFRunLoopObserverRef observer, CFRunLoopActivity activity, __unused void* info)
+{
+    // Only the main thread writes the heartbeat, so a plain store will do.
+    const uint32_t isBusy = activity == kCFRunLoopBeforeWaiting ? 0 : 1;
+    const uint32_t heartbeat = __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_heartbeat, ((heartbeat + 2) & ~1u) | isBusy, __ATOMIC_RELAXED);
+}
+
+/** Write a report with the main thread as the crashed context.
+ *
+ * Unless terminating on deadlock, this is a snapshot and the app keeps
+ * running: the heartbeat only comes from the run loop modes the observer is
+ * in, so a main thread running a nested run loop in some other mode looks
+ * hung while it is still working.
+ */
+static void handleDeadlock(void)
+{
+    const bool isFatal = g_shouldTerminateOnDeadlock;
+    if(!isFatal && !gioMonitorCrashSnapshotLimiter_shouldCapture(GIOMonitorCrashExcType_Deadlock))
+    {
+        return;
+    }
+    const bool isSuspended = gioMonitorCrashMachineContext_suspendEnvironment(GIOMonitorCrashMC_SUSPEND_WAIT_MILLISECONDS);
+    if(isFatal)
+    {
+        gioMonitorCrashCM_notifyFatalExceptionCaptured(false);
+    }
+    // Held from here so that the crashed context can keep data in it.
+    const bool hasArena = gioMonitorCrashArena_acquire();
+
+    // The main thread is the one that failed, so it's the crashed context.
+    // That also gives the report the list of all threads.
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+    gioMonitorCrashMachineContext_getContextForThread(g_mainQueueThread, machineContext, true);
+    GIOMonitorCrashStackCursor stackCursor;
+    gioMonitorCrashStackCursor_initWithMachineContext(&stackCursor, GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD, machineContext);
+    char eventID[37];
+    uuid_t uuid;
+    uuid_generate(uuid);
+    uuid_unparse_upper(uuid, eventID);
+
+    GIOMonitorCrashLOG_DEBUG(@"Filling out context.");
+    GIOMonitorCrash_MonitorContext* crashContext = &g_monitorContext;
+    memset(crashContext, 0, sizeof(*crashContext));
+    crashContext->crashType = GIOMonitorCrashMonitorTypeMainThreadDeadlock;
+    crashContext->eventID = eventID;
+    crashContext->registersAreValid = false;
+    crashContext->offendingMachineContext = machineContext;
+    crashContext->stackCursor = &stackCursor;
+    crashContext->currentSnapshotUserReported = !isFatal;
+    crashContext->threadsNotSuspended = !isSuspended;
+
+    gioMonitorCrashCM_handleException(crashContext);
+    if(hasArena)
+    {
+        gioMonitorCrashArena_release();
+    }
+    if(isSuspended)
+    {
+        gioMonitorCrashMachineContext_resumeEnvironment();
+    }
+
+    if(isFatal)
+    {
+        GIOMonitorCrashLOG_DEBUG(@"Calling abort()");
+        abort();
+    }
+}
+
+/** Get the CPU time used by the calling thread, in microseconds. */
+static uint64_t getThreadCPUTimeUSec(void)
+{
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    thread_t thread = mach_thread_self();
+    kern_return_t kr = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if(kr != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return (uint64_t)(info.user_time.seconds + info.system_time.seconds) * 1000000 +
+           (uint64_t)(info.user_time.microseconds + info.system_time.microseconds);
+}
+
+/** Capture the main thread's stack.
+ *
+ * @return The number of frames captured.
+ */
+static int sampleMainThread(uintptr_t* const backtrace, const int maxLength)
+{
+    const thread_t thread = (thread_t)g_mainQueueThread;
+    if(thread_suspend(thread) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    int length = 0;
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+    if(gioMonitorCrashMachineContext_getContextForThread(g_mainQueueThread, machineContext, false))
+    {
+        GIOMonitorCrashStackCursor stackCursor;
+        gioMonitorCrashStackCursor_initWithMachineContext(&stackCursor, maxLength, machineContext);
+        while(length < maxLength && stackCursor.advanceCursor(&stackCursor))
+        {
+            backtrace[length++] = stackCursor.stackEntry.address;
+        }
+    }
+    thread_resume(thread);
+    return length;
+}
+
+/** Sample the main thread until it gets back to its run loop, or until the
+ * hang has lasted the full watchdog interval.
+ *
+ * @return How long the main thread has been hung, in seconds.
+ */
+static double profileHang(const uint32_t heartbeat, double hangDuration, const double interval, const double sampleInterval)
+{
+    uintptr_t backtrace[kMaxHangSampleFrames];
+    gioMonitorCrashHangProfile_begin(sampleInterval);
+    while(hangDuration < interval && __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED) == heartbeat)
+    {
+        int length = sampleMainThread(backtrace, kMaxHangSampleFrames);
+        gioMonitorCrashHangProfile_addSample(backtrace, length, hangDuration);
+        usleep((useconds_t)(sampleInterval * 1000000));
+        hangDuration += sampleInterval;
+    }
+    if(__atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED) != heartbeat)
+    {
+        gioMonitorCrashHangProfile_end();
+    }
+    return hangDuration;
+}
+
+static void* watchdogThread(void* userData)
+{
+    const uint32_t generation = (uint32_t)(uintptr_t)userData;
+    uint32_t lastHeartbeat = __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED);
+    double hangDuration = 0;
+    bool isHangReported = false;
+    unsigned checkCount = 0;
+    uint64_t cpuTime = 0;
+
+    usleep((useconds_t)(kIdleInterval * 1000000));
+    while(__atomic_load_n(&g_watchdogGeneration, __ATOMIC_RELAXED) == generation)
+    {
+        const double interval = g_watchdogInterval;
+        if(interval <= 0)
+        {
+            usleep((useconds_t)(kIdleInterval * 1000000));
+            lastHeartbeat = __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED);
+            hangDuration = 0;
+            continue;
+        }
+
+        // When profiling hangs, check often enough to notice one early.
+        const double sampleInterval = g_hangSampleInterval;
+        const bool shouldProfile = sampleInterval > 0 && kHangThreshold < interval;
+        const double checkInterval = shouldProfile ? kHangThreshold : interval;
+        usleep((useconds_t)(checkInterval * 1000000));
+        checkCount++;
+        // The thread normally never exits, so keep the total up to date.
+        const uint64_t newCPUTime = getThreadCPUTimeUSec();
+        __atomic_add_fetch(&g_watchdogCPUTimeUSec, newCPUTime - cpuTime, __ATOMIC_RELAXED);
+        cpuTime = newCPUTime;
+        const uint32_t heartbeat = __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED);
+        if(heartbeat != lastHeartbeat || (heartbeat & 1) == 0)
+        {
+            lastHeartbeat = heartbeat;
+            hangDuration = 0;
+            isHangReported = false;
+            continue;
+        }
+        if(isHangReported)
+        {
+            continue;
+        }
+
+        hangDuration += checkInterval;
+        if(shouldProfile && hangDuration < interval)
+        {
+            hangDuration = profileHang(heartbeat, hangDuration, interval, sampleInterval);
+        }
+        if(hangDuration >= interval && __atomic_load_n(&g_heartbeat, __ATOMIC_RELAXED) == heartbeat &&
+           __atomic_load_n(&g_watchdogGeneration, __ATOMIC_RELAXED) == generation)
+        {
+            GIOMonitorCrashLOG_ERROR(@"Main thread has not returned to its run loop for %f seconds", hangDuration);
+            handleDeadlock();
+            // Only once per hang when the app is left running.
+            isHangReported = true;
+        }
+    }
+
+    GIOMonitorCrashLOG_DEBUG(@"Watchdog used %llu us of CPU time over %u checks.", getThreadCPUTimeUSec(), checkCount);
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void startWatchdog(void)
+{
+    g_mainQueueThread = (GIOMonitorCrashThread)pthread_mach_thread_np(pthread_main_thread_np());
+
+    if(g_runLoopObserver == NULL)
+    {
+        g_runLoopObserver = CFRunLoopObserverCreate(kCFAllocatorDefault, kCFRunLoopAllActivities, true, 0,
+                                                    onMainRunLoopActivity, NULL);
+        CFRunLoopAddObserver(CFRunLoopGetMain(), g_runLoopObserver, kCFRunLoopCommonModes);
+    }
+
+    uint32_t generation = __atomic_add_fetch(&g_watchdogGeneration, 1, __ATOMIC_RELAXED);
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int error = pthread_create(&thread, &attr, watchdogThread, (void*)(uintptr_t)generation);
+    pthread_attr_destroy(&attr);
+    if(error != 0)
+    {
+        GIOMonitorCrashLOG_ERROR(@"pthread_create: %s", strerror(error));
+    }
+}
+
+static void stopWatchdog(void)
+{
+    // This can happen while handling a crash, so only tell the watchdog
+    // thread to exit. The run loop observer is cheap enough to leave in place.
+    __atomic_add_fetch(&g_watchdogGeneration, 1, __ATOMIC_RELAXED);
+}
+
+static void setEnabled(bool isEnabled)
+{
+    if(isEnabled != g_isEnabled)
+    {
+        g_isEnabled = isEnabled;
+        if(isEnabled)
+        {
+            GIOMonitorCrashLOG_DEBUG(@"Creating new deadlock monitor.");
+            startWatchdog();
+        }
+        else
+        {
+            GIOMonitorCrashLOG_DEBUG(@"Stopping deadlock monitor.");
+            stopWatchdog();
+        }
+    }
+}
+
+static bool isEnabled()
+{
+    return g_isEnabled;
+}
+
+GIOMonitorCrashMonitorAPI* gioMonitorCrashCM_deadlock_getAPI()
+{
+    static GIOMonitorCrashMonitorAPI api =
+    {
+        .setEnabled = setEnabled,
+        .isEnabled = isEnabled
+    };
+    return &api;
+}
+
+void gioMonitorCrashCM_setDeadlockHandlerWatchdogInterval(double value)
+{
+    g_watchdogInterval = value;
+}
+
+void gioMonitorCrashCM_setHangSampleInterval(double value)
+{
+    g_hangSampleInterval = value;
+}
+
+void gioMonitorCrashCM_setTerminateOnDeadlock(bool shouldTerminate)
+{
+    g_shouldTerminateOnDeadlock = shouldTerminate;
+}
+
+uint64_t gioMonitorCrashCM_getDeadlockWatchdogCPUTime(void)
+{
+    return __atomic_load_n(&g_watchdogCPUTimeUSec, __ATOMIC_RELAXED);
+}
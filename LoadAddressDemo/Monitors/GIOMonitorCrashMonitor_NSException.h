@@ -38,6 +38,7 @@ extern "C" {
 
 #import <Foundation/Foundation.h>
 #include "GIOMonitorCrashMonitor.h"
+#include "GIOMonitorCrashReportProfile.h"
 
 
 /** Access the Monitor API.
@@ -46,6 +47,21 @@ GIOMonitorCrashMonitorAPI* gioMonitorCrashCM_nsexception_getAPI(void);
 
 void handleException(NSException* exception, BOOL currentSnapshotUserReported);
 
+/** Handle an exception, writing the report with the given profile rather
+ * than the one configured for its crash type.
+ *
+ * @param exception The exception.
+ *
+ * @param currentSnapshotUserReported If true, the exception is a user reported
+ *                                    snapshot, and the app keeps running.
+ *
+ * @param reportProfile The profile to write the report with (Default = the
+ *                      crash type's).
+ */
+void handleExceptionWithReportProfile(NSException* exception,
+                                      BOOL currentSnapshotUserReported,
+                                      GIOMonitorCrashReportProfile reportProfile);
+
 #ifdef __cplusplus
 }
 #endif
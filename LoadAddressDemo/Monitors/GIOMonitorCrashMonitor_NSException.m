@@ -27,6 +27,8 @@
 //#import "GIOMonitorCrash.h"
 #import "GIOMonitorCrashMonitor_NSException.h"
 #import "GIOMonitorCrashStackCursor_Backtrace.h"
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashSnapshotLimiter.h"
 #include "GIOMonitorCrashMonitorContext.h"
 //#include "GIOMonitorCrashID.h"
 #include "GIOMonitorCrashThread.h"
@@ -57,11 +59,18 @@ static NSUncaughtExceptionHandler* g_previousUncaughtExceptionHandler;
  * @param exception The exception that was raised.
  */
 
-void handleException(NSException* exception, BOOL currentSnapshotUserReported) {
+void handleExceptionWithReportProfile(NSException* exception,
+                                      BOOL currentSnapshotUserReported,
+                                      GIOMonitorCrashReportProfile reportProfile) {
     GIOMonitorCrashLOG_DEBUG(@"Trapped exception %@", exception);
     if(g_isEnabled)
     {
-        gioMonitorCrashMachineContext_suspendEnvironment();
+        if(currentSnapshotUserReported &&
+           !gioMonitorCrashSnapshotLimiter_shouldCapture([[exception name] UTF8String]))
+        {
+            return;
+        }
+        const bool isSuspended = gioMonitorCrashMachineContext_suspendEnvironment(GIOMonitorCrashMC_SUSPEND_WAIT_MILLISECONDS);
         gioMonitorCrashCM_notifyFatalExceptionCaptured(false);
 
         GIOMonitorCrashLOG_DEBUG(@"Filling out context.");
@@ -71,7 +80,13 @@ void handleException(NSException* exception, BOOL currentSnapshotUserReported) {
         NSArray *addresses = [NSThread callStackReturnAddresses];
         
         NSUInteger numFrames = addresses.count;
-        uintptr_t* callstack = malloc(numFrames * sizeof(*callstack));
+        const bool hasArena = gioMonitorCrashArena_acquire();
+        uintptr_t* callstack = gioMonitorCrashArena_allocate((int)(numFrames * sizeof(*callstack)));
+        const bool isCallstackOnHeap = callstack == NULL;
+        if(isCallstackOnHeap)
+        {
+            callstack = malloc(numFrames * sizeof(*callstack));
+        }
         for(NSUInteger i = 0; i < numFrames; i++)
         {
             callstack[i] = (uintptr_t)[addresses[i] unsignedLongLongValue];
@@ -96,17 +111,30 @@ void handleException(NSException* exception, BOOL currentSnapshotUserReported) {
         crashContext->crashReason = [[exception reason] UTF8String];
         crashContext->stackCursor = &cursor;
         crashContext->currentSnapshotUserReported = currentSnapshotUserReported;
+        crashContext->reportProfile = reportProfile;
+        crashContext->threadsNotSuspended = !isSuspended;
 
         GIOMonitorCrashLOG_DEBUG(@"Calling main crash handler.");
         gioMonitorCrashCM_handleException(crashContext);
 
-        free(callstack);
-        if (currentSnapshotUserReported) {
+        if(isCallstackOnHeap)
+        {
+            free(callstack);
+        }
+        if(hasArena)
+        {
+            gioMonitorCrashArena_release();
+        }
+        if (currentSnapshotUserReported && isSuspended) {
             gioMonitorCrashMachineContext_resumeEnvironment();
         }
     }
 }
 
+void handleException(NSException* exception, BOOL currentSnapshotUserReported) {
+    handleExceptionWithReportProfile(exception, currentSnapshotUserReported, GIOMonitorCrashReportProfileDefault);
+}
+
 static void handleUncaughtException(NSException* exception) {
     handleException(exception, false);
 }
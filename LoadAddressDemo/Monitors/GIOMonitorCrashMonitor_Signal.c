@@ -0,0 +1,253 @@
+//
+//  GIOMonitorCrashMonitor_Signal.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashMonitor_Signal.h"
+#include "GIOMonitorCrashMonitorContext.h"
+#include "GIOMonitorCrashSignalInfo.h"
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashMachineContext.h"
+#include "GIOMonitorCrashStackCursor_MachineContext.h"
+#include "GIOMonitorCrashSystemCapabilities.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#if GIOMonitorCrashCRASH_HAS_SIGNAL
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uuid/uuid.h>
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static volatile bool g_isEnabled = false;
+
+/* Everything the handler needs is set up when the monitor is enabled, so
+ * that handling a signal never touches the heap.
+ */
+
+static GIOMonitorCrash_MonitorContext g_monitorContext;
+static GIOMonitorCrashStackCursor g_stackCursor;
+static struct GIOMonitorCrashMachineContext* g_machineContext;
+static char g_eventID[37];
+
+#if GIOMonitorCrashCRASH_HAS_SIGNAL_STACK
+/** Our custom signal stack. The signal handler will use this as its stack. */
+static char g_signalStackMemory[SIGSTKSZ];
+static stack_t g_signalStack = {0};
+#endif
+
+/** Signal handlers that were installed before we installed ours. */
+static struct sigaction g_previousSignalHandlers[NSIG];
+
+
+// ============================================================================
+#pragma mark - Callbacks -
+// ============================================================================
+
+/** Our custom signal handler.
+ * Restore the default signal handlers, record the signal information, and
+ * write a crash report.
+ * Once we're done, re-raise the signal and let the default handlers deal with
+ * it.
+ *
+ * @param sigNum The signal that was raised.
+ *
+ * @param signalInfo Information about the signal.
+ *
+ * @param userContext Other contextual information.
+ */
+static void handleSignal(int sigNum, siginfo_t* signalInfo, void* userContext)
+{
+    GIOMonitorCrashLOG_DEBUG("Trapped signal %d", sigNum);
+    if(g_isEnabled)
+    {
+        // Another thread holding the environment may never resume it, so
+        // only wait briefly and report without suspending.
+        const bool isSuspended = gioMonitorCrashMachineContext_suspendEnvironment(GIOMonitorCrashMC_SIGNAL_SUSPEND_WAIT_MILLISECONDS);
+        gioMonitorCrashCM_notifyFatalExceptionCaptured(false);
+        // Held from here so that the crashed context can keep data in it.
+        const bool hasArena = gioMonitorCrashArena_acquire();
+
+        GIOMonitorCrashLOG_DEBUG("Filling out context.");
+        struct GIOMonitorCrashMachineContext* machineContext = g_machineContext;
+        gioMonitorCrashMachineContext_getContextForSignal(userContext, machineContext);
+        gioMonitorCrashStackCursor_initWithMachineContext(&g_stackCursor, GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD, machineContext);
+
+        GIOMonitorCrash_MonitorContext* crashContext = &g_monitorContext;
+        memset(crashContext, 0, sizeof(*crashContext));
+        crashContext->crashType = GIOMonitorCrashMonitorTypeSignal;
+        crashContext->eventID = g_eventID;
+        crashContext->offendingMachineContext = machineContext;
+        crashContext->registersAreValid = true;
+        crashContext->faultAddress = (uintptr_t)signalInfo->si_addr;
+        crashContext->signal.userContext = userContext;
+        crashContext->signal.signum = signalInfo->si_signo;
+        crashContext->signal.sigcode = signalInfo->si_code;
+        crashContext->stackCursor = &g_stackCursor;
+        crashContext->threadsNotSuspended = !isSuspended;
+
+        gioMonitorCrashCM_handleException(crashContext);
+        if(hasArena)
+        {
+            gioMonitorCrashArena_release();
+        }
+        if(isSuspended)
+        {
+            gioMonitorCrashMachineContext_resumeEnvironment();
+        }
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Re-raising signal for regular handlers to catch.");
+    // This is technically not allowed, but it works in OSX and iOS.
+    raise(sigNum);
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static bool installSignalHandler(void)
+{
+    GIOMonitorCrashLOG_DEBUG("Installing signal handler.");
+
+    if(g_machineContext == NULL)
+    {
+        g_machineContext = calloc(1, (size_t)gioMonitorCrashMachineContext_contextSize());
+        if(g_machineContext == NULL)
+        {
+            GIOMonitorCrashLOG_ERROR("Could not allocate the crash machine context");
+            return false;
+        }
+    }
+
+#if GIOMonitorCrashCRASH_HAS_SIGNAL_STACK
+    if(g_signalStack.ss_size == 0)
+    {
+        GIOMonitorCrashLOG_DEBUG("Setting up signal stack.");
+        g_signalStack.ss_size = sizeof(g_signalStackMemory);
+        g_signalStack.ss_sp = g_signalStackMemory;
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Installing alternate stack location.");
+    if(sigaltstack(&g_signalStack, NULL) != 0)
+    {
+        GIOMonitorCrashLOG_ERROR("signalstack: %s", strerror(errno));
+        return false;
+    }
+#endif
+
+    const int* fatalSignals = gioMonitorCrashSignal_fatalSignals();
+    int fatalSignalsCount = gioMonitorCrashSignal_numFatalSignals();
+
+    struct sigaction action = {{0}};
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+#if GIOMonitorCrashCRASH_HOST_APPLE && defined(__LP64__)
+    action.sa_flags |= SA_64REGSET;
+#endif
+    sigemptyset(&action.sa_mask);
+    action.sa_sigaction = &handleSignal;
+
+    for(int i = 0; i < fatalSignalsCount; i++)
+    {
+        GIOMonitorCrashLOG_DEBUG("Assigning handler for signal %d", fatalSignals[i]);
+        if(sigaction(fatalSignals[i], &action, &g_previousSignalHandlers[i]) != 0)
+        {
+            char sigNameBuff[30];
+            const char* sigName = gioMonitorCrashSignal_signalName(fatalSignals[i]);
+            if(sigName == NULL)
+            {
+                snprintf(sigNameBuff, sizeof(sigNameBuff), "%d", fatalSignals[i]);
+                sigName = sigNameBuff;
+            }
+            GIOMonitorCrashLOG_ERROR("sigaction (%s): %s", sigName, strerror(errno));
+            // Try to reverse the damage
+            for(i--;i >= 0; i--)
+            {
+                sigaction(fatalSignals[i], &g_previousSignalHandlers[i], NULL);
+            }
+            return false;
+        }
+    }
+    GIOMonitorCrashLOG_DEBUG("Signal handlers installed.");
+    return true;
+}
+
+static void uninstallSignalHandler(void)
+{
+    GIOMonitorCrashLOG_DEBUG("Uninstalling signal handlers.");
+
+    const int* fatalSignals = gioMonitorCrashSignal_fatalSignals();
+    int fatalSignalsCount = gioMonitorCrashSignal_numFatalSignals();
+
+    for(int i = 0; i < fatalSignalsCount; i++)
+    {
+        GIOMonitorCrashLOG_DEBUG("Restoring original handler for signal %d", fatalSignals[i]);
+        sigaction(fatalSignals[i], &g_previousSignalHandlers[i], NULL);
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Signal handlers uninstalled.");
+}
+
+static void setEnabled(bool isEnabled)
+{
+    if(isEnabled != g_isEnabled)
+    {
+        g_isEnabled = isEnabled;
+        if(isEnabled)
+        {
+            uuid_t uuid;
+            uuid_generate(uuid);
+            uuid_unparse_upper(uuid, g_eventID);
+            if(!installSignalHandler())
+            {
+                g_isEnabled = false;
+            }
+        }
+        else
+        {
+            uninstallSignalHandler();
+        }
+    }
+}
+
+static bool isEnabled(void)
+{
+    return g_isEnabled;
+}
+
+static void addContextualInfoToEvent(struct GIOMonitorCrash_MonitorContext* eventContext)
+{
+    if(!(eventContext->crashType & (GIOMonitorCrashMonitorTypeSignal | GIOMonitorCrashMonitorTypeMachException)))
+    {
+        eventContext->signal.signum = SIGABRT;
+    }
+}
+
+#endif
+
+GIOMonitorCrashMonitorAPI* gioMonitorCrashCM_signal_getAPI(void)
+{
+    static GIOMonitorCrashMonitorAPI api =
+    {
+#if GIOMonitorCrashCRASH_HAS_SIGNAL
+        .setEnabled = setEnabled,
+        .isEnabled = isEnabled,
+        .addContextualInfoToEvent = addContextualInfoToEvent
+#endif
+    };
+    return &api;
+}
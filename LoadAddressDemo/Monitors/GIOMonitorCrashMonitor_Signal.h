@@ -0,0 +1,34 @@
+//
+//  GIOMonitorCrashMonitor_Signal.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Catches fatal unix signals.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashMonitor_Signal_h
+#define HDR_GIOMonitorCrashMonitor_Signal_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "GIOMonitorCrashMonitor.h"
+
+
+/** Access the Monitor API.
+ */
+GIOMonitorCrashMonitorAPI* gioMonitorCrashCM_signal_getAPI(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashMonitor_Signal_h
@@ -30,6 +30,7 @@
 #import "GIOMonitorCrashReportWriter.h"
 //#import "GIOMonitorCrashReportFilter.h"
 #import "GIOMonitorCrashMonitorType.h"
+#import "GIOMonitorCrashReportProfile.h"
 
 typedef enum
 {
@@ -85,10 +86,10 @@ typedef enum
  */
 @property(nonatomic,readwrite,assign) GIOMonitorCrashMonitorType monitoring;
 
-/** Maximum time to allow the main thread to run without returning.
- * If a task occupies the main thread for longer than this interval, the
- * watchdog will consider the queue deadlocked and shut down the app and write a
- * crash report.
+/** Maximum time to allow the main thread to run without returning to its
+ * run loop. If a task occupies the main thread for longer than this interval, the
+ * watchdog will consider the queue deadlocked and write a report. The app is
+ * only shut down if terminateOnDeadlock is set.
  *
  * Note: You must have added GIOMonitorCrashMonitorTypeMainThreadDeadlock to the monitoring
  *       property in order for this to have any effect.
@@ -107,6 +108,37 @@ typedef enum
  */
 @property(nonatomic,readwrite,assign) double deadlockWatchdogInterval;
 
+/** If true, shut down the app once a deadlock is reported. Otherwise the
+ * deadlock is reported once per hang as a snapshot and the app keeps running.
+ *
+ * A main thread running a nested run loop in a mode outside the common modes
+ * looks hung to the watchdog, so terminating can kill a working app.
+ *
+ * Default: NO
+ */
+@property(nonatomic,readwrite,assign) BOOL terminateOnDeadlock;
+
+/** If nonzero, once the main thread has been busy for a quarter of a second
+ * its stack is sampled at this interval (in seconds) until it returns to its
+ * run loop. Identical stacks are aggregated, and the most recent hang profile
+ * is added to the debug section of reports.
+ *
+ * Note: Only works while the deadlock watchdog is running.
+ *
+ * Default: 0
+ */
+@property(nonatomic,readwrite,assign) double hangSampleInterval;
+
+/** If nonzero, the stacks of all threads are sampled at this interval (in
+ * seconds) and aggregated into a call tree, which is periodically written
+ * to the report store as a "cpu_profile" report. The time spent sampling and
+ * the CPU time used by the profiler are recorded in each profile. Only the
+ * latest 2 profiles are kept, and they don't count toward maxReportCount.
+ *
+ * Default: 0
+ */
+@property(nonatomic,readwrite,assign) double cpuProfileSampleInterval;
+
 /** If YES, introspect memory contents during a crash.
  * Any Objective-C objects or C strings near the stack pointer or referenced by
  * cpu registers or exceptions will be recorded in the crash report, along with
@@ -124,12 +156,108 @@ typedef enum
  */
 @property(nonatomic,readwrite,retain) NSArray* doNotIntrospectClasses;
 
+/** If true, frames that several threads have in common are written once to a
+ * shared frames table instead of being repeated in every thread's backtrace.
+ * This makes reports of apps with many threads much smaller.
+ * Use report_converter.py to get full backtraces back.
+ *
+ * Default: NO
+ */
+@property(nonatomic,readwrite,assign) BOOL shareBacktraceSuffixes;
+
+/** The longest writing a crash report may take, in seconds. Past it, the low
+ * priority sections still to be written (registers of non-crashed threads,
+ * stack contents, notable addresses, console log) are left out, and the
+ * debug section records what was dropped.
+ *
+ * Default: 0 (no limit)
+ */
+@property(nonatomic,readwrite,assign) double reportTimeLimit;
+
+/** The largest a crash report may get, in bytes, before its remaining low
+ * priority sections are left out, as with reportTimeLimit.
+ *
+ * Default: 0 (no limit)
+ */
+@property(nonatomic,readwrite,assign) int reportSizeLimit;
+
+/** How many user reported snapshots per second each exception name may take
+ * on average. Each snapshot suspends all threads, so this protects the app
+ * from a caller reporting in a loop. Suppressed snapshots are counted by name,
+ * and the counts are written to the next report that is kept.
+ *
+ * Default: 0 (no limit)
+ */
+@property(nonatomic,readwrite,assign) double snapshotRateLimit;
+
+/** How many user reported snapshots of an exception name may be taken in a
+ * burst before snapshotRateLimit applies.
+ *
+ * Default: 5
+ */
+@property(nonatomic,readwrite,assign) int snapshotBurstLimit;
+
+/** The fraction of user reported snapshots to take (0.0 - 1.0). The rest are
+ * counted as sampled out, and don't use up the rate limit.
+ *
+ * Default: 1.0
+ */
+@property(nonatomic,readwrite,assign) double snapshotSampleRate;
+
+/** Set how much reports of the given crash types capture about each thread.
+ * Use minimal for cheap, small non-fatal reports, and forensic when every
+ * thread's stack and notable addresses are wanted. User reported snapshots
+ * use the profile set for GIOMonitorCrashMonitorTypeUserReported.
+ *
+ * Default: GIOMonitorCrashReportProfileStandard for all crash types
+ *
+ * @param reportProfile The profile.
+ *
+ * @param crashTypes The crash types to use it for.
+ */
+- (void) setReportProfile:(GIOMonitorCrashReportProfile) reportProfile
+            forCrashTypes:(GIOMonitorCrashMonitorType) crashTypes;
+
+/** If true, a fatal crash only dumps the raw crash state to a compact binary
+ * file, which is formatted into a report on the next launch. This makes crash
+ * handling much quicker, but the report has no memory introspection, and
+ * onCrash isn't called.
+ *
+ * Default: NO
+ */
+@property(nonatomic,readwrite,assign) BOOL deferReportFormatting;
+
+/** If true, fatal crash reports are written on a dedicated thread with its
+ * own stack, started at install, rather than on the crashed thread's stack.
+ * Stack overflows and stack corruption then no longer get in the way of
+ * writing the report.
+ *
+ * Default: NO
+ */
+@property(nonatomic,readwrite,assign) BOOL useCrashHandlerThread;
+
 /** The maximum number of reports allowed on disk before old ones get deleted.
+ * Older reports of a crash that a newer report also has are deleted first.
  *
  * Default: 5
  */
 @property(nonatomic,readwrite,assign) int maxReportCount;
 
+/** If YES, a crash report is deleted if an earlier report of the same crash
+ * is still on disk, and the earlier one's duplicate count goes up instead.
+ * User reported snapshots are always kept.
+ *
+ * Default: YES
+ */
+@property(nonatomic,readwrite,assign) BOOL coalesceReports;
+
+/** The maximum number of threads recorded in a crash report.
+ * Any threads beyond this are left out. Must be set before installing.
+ *
+ * Default: 512
+ */
+@property(nonatomic,readwrite,assign) int maxThreadCount;
+
 /** The report sink where reports get sent.
  * This MUST be set or else the reporter will not send reports (although it will
  * still record them).
@@ -159,6 +287,41 @@ typedef enum
  */
 @property(nonatomic,readwrite,assign) BOOL printPreviousLog;
 
+/** If nonzero, console log messages are queued in a memory mapped ring buffer
+ *  of this many bytes and written out by a background thread. Messages that
+ *  were never written out are recovered on the next launch.
+ *  Must be set before installing.
+ *
+ * Default: 0
+ */
+@property(nonatomic,readwrite,assign) int logRingBufferSize;
+
+/** If true, console log messages queued in the ring buffer are stored as a
+ *  format string plus arguments, and only formatted when written out.
+ *  Only applies if logRingBufferSize is nonzero. Must be set before installing.
+ *
+ * Default: NO
+ */
+@property(nonatomic,readwrite,assign) BOOL deferLogFormatting;
+
+/** If nonzero, the console log is kept as a circular file of this many bytes,
+ *  so it never grows, and only the latest messages are added to reports.
+ *  If 0, the log grows until the next launch.
+ *  Must be set before installing.
+ *
+ * Default: 0
+ */
+@property(nonatomic,readwrite,assign) int consoleLogSize;
+
+/** The size of the memory reserved at install for handling crashes. The crash
+ *  handler takes its buffers from it rather than from the stack or the heap.
+ *  If 0, nothing is reserved.
+ *  Must be set before installing.
+ *
+ * Default: 131072
+ */
+@property(nonatomic,readwrite,assign) int crashArenaSize;
+
 /** Which languages to demangle when getting stack traces (default GIOMonitorCrashDemangleLanguageAll) */
 @property(nonatomic,readwrite,assign) GIOMonitorCrashDemangleLanguage demangleLanguages;
 
@@ -240,6 +403,32 @@ typedef enum
  */
 - (NSDictionary*) reportWithID:(NSNumber*) reportID;
 
+/** Get how many later identical crashes were counted against a report
+ * instead of being stored as reports of their own.
+ *
+ * @param reportID The report's ID.
+ *
+ * @return The number of duplicates.
+ */
+- (int) duplicateCountForReportID:(NSNumber*) reportID;
+
+/** Get how long writing crash reports took in this process. The dictionary
+ * has "report", "thread" and "sections" entries. "sections" maps each section
+ * name to its timing. Each timing has "count", "total" and "max" (in seconds).
+ *
+ * @return The report timings.
+ */
+- (NSDictionary*) reportTimings;
+
+/** Forget the report timings collected so far.
+ */
+- (void) resetReportTimings;
+
+/** The CPU time the deadlock watchdog has used so far, including hang
+ * sampling, in seconds.
+ */
+@property(nonatomic,readonly,assign) double deadlockWatchdogCPUTime;
+
 /** Delete all unsent reports.
  */
 - (void) deleteAllReports;
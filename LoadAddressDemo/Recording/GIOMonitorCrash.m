@@ -81,6 +81,13 @@ static NSString* getBasePath()
     return [cachePath stringByAppendingPathComponent:pathEnd];
 }
 
+static NSDictionary* timingToDictionary(const GIOMonitorCrashReportTiming* const timing)
+{
+    return @{@"count": @(timing->count),
+             @"total": @(timing->totalNanoseconds / 1000000000.0),
+             @"max": @(timing->maxNanoseconds / 1000000000.0)};
+}
+
 
 @implementation GIOMonitorCrash
 
@@ -92,15 +99,32 @@ static NSString* getBasePath()
 @synthesize deleteBehaviorAfterSendAll = _deleteBehaviorAfterSendAll;
 @synthesize monitoring = _monitoring;
 @synthesize deadlockWatchdogInterval = _deadlockWatchdogInterval;
+@synthesize terminateOnDeadlock = _terminateOnDeadlock;
+@synthesize hangSampleInterval = _hangSampleInterval;
+@synthesize cpuProfileSampleInterval = _cpuProfileSampleInterval;
 @synthesize onCrash = _onCrash;
 @synthesize bundleName = _bundleName;
 @synthesize basePath = _basePath;
 @synthesize introspectMemory = _introspectMemory;
 @synthesize doNotIntrospectClasses = _doNotIntrospectClasses;
+@synthesize shareBacktraceSuffixes = _shareBacktraceSuffixes;
+@synthesize reportTimeLimit = _reportTimeLimit;
+@synthesize reportSizeLimit = _reportSizeLimit;
+@synthesize snapshotRateLimit = _snapshotRateLimit;
+@synthesize snapshotBurstLimit = _snapshotBurstLimit;
+@synthesize snapshotSampleRate = _snapshotSampleRate;
+@synthesize deferReportFormatting = _deferReportFormatting;
+@synthesize useCrashHandlerThread = _useCrashHandlerThread;
 @synthesize demangleLanguages = _demangleLanguages;
 @synthesize addConsoleLogToReport = _addConsoleLogToReport;
 @synthesize printPreviousLog = _printPreviousLog;
+@synthesize logRingBufferSize = _logRingBufferSize;
+@synthesize deferLogFormatting = _deferLogFormatting;
+@synthesize consoleLogSize = _consoleLogSize;
+@synthesize crashArenaSize = _crashArenaSize;
 @synthesize maxReportCount = _maxReportCount;
+@synthesize coalesceReports = _coalesceReports;
+@synthesize maxThreadCount = _maxThreadCount;
 @synthesize uncaughtExceptionHandler = _uncaughtExceptionHandler;
 @synthesize currentSnapshotUserReportedExceptionHandler = _currentSnapshotUserReportedExceptionHandler;
 
@@ -138,6 +162,11 @@ static NSString* getBasePath()
         self.deleteBehaviorAfterSendAll = GIOMonitorCrashCDeleteAlways;
         self.introspectMemory = YES;
         self.maxReportCount = 5;
+        self.coalesceReports = YES;
+        self.maxThreadCount = 512;
+        self.crashArenaSize = 128 * 1024;
+        self.snapshotBurstLimit = 5;
+        self.snapshotSampleRate = 1.0;
         self.monitoring = GIOMonitorCrashMonitorTypeProductionSafeMinimal;
     }
     return self;
@@ -178,7 +207,31 @@ static NSString* getBasePath()
 
 - (void) setMonitoring:(GIOMonitorCrashMonitorType)monitoring
 {
+    _monitoring = gioMonitorCrash_setMonitoring(monitoring);
+}
+
+- (void) setDeadlockWatchdogInterval:(double) deadlockWatchdogInterval
+{
+    _deadlockWatchdogInterval = deadlockWatchdogInterval;
+    gioMonitorCrash_setDeadlockWatchdogInterval(deadlockWatchdogInterval);
+}
 
+- (void) setTerminateOnDeadlock:(BOOL) terminateOnDeadlock
+{
+    _terminateOnDeadlock = terminateOnDeadlock;
+    gioMonitorCrash_setTerminateOnDeadlock(terminateOnDeadlock);
+}
+
+- (void) setHangSampleInterval:(double) hangSampleInterval
+{
+    _hangSampleInterval = hangSampleInterval;
+    gioMonitorCrash_setHangSampleInterval(hangSampleInterval);
+}
+
+- (void) setCpuProfileSampleInterval:(double) cpuProfileSampleInterval
+{
+    _cpuProfileSampleInterval = cpuProfileSampleInterval;
+    gioMonitorCrash_setCPUProfileSampleInterval(cpuProfileSampleInterval);
 }
 
 - (void) setOnCrash:(GIOMonitorCrashReportWriteCallback) onCrash
@@ -213,12 +266,78 @@ static NSString* getBasePath()
     }
 }
 
+- (void) setShareBacktraceSuffixes:(BOOL) shareBacktraceSuffixes
+{
+    _shareBacktraceSuffixes = shareBacktraceSuffixes;
+    gioMonitorCrash_setShareBacktraceSuffixes(shareBacktraceSuffixes);
+}
+
+- (void) setReportTimeLimit:(double) reportTimeLimit
+{
+    _reportTimeLimit = reportTimeLimit;
+    gioMonitorCrash_setReportTimeLimit(reportTimeLimit);
+}
+
+- (void) setReportSizeLimit:(int) reportSizeLimit
+{
+    _reportSizeLimit = reportSizeLimit;
+    gioMonitorCrash_setReportSizeLimit(reportSizeLimit);
+}
+
+- (void) setSnapshotRateLimit:(double) snapshotRateLimit
+{
+    _snapshotRateLimit = snapshotRateLimit;
+    gioMonitorCrash_setSnapshotRateLimit(snapshotRateLimit);
+}
+
+- (void) setSnapshotBurstLimit:(int) snapshotBurstLimit
+{
+    _snapshotBurstLimit = snapshotBurstLimit;
+    gioMonitorCrash_setSnapshotBurstLimit(snapshotBurstLimit);
+}
+
+- (void) setSnapshotSampleRate:(double) snapshotSampleRate
+{
+    _snapshotSampleRate = snapshotSampleRate;
+    gioMonitorCrash_setSnapshotSampleRate(snapshotSampleRate);
+}
+
+- (void) setReportProfile:(GIOMonitorCrashReportProfile) reportProfile
+            forCrashTypes:(GIOMonitorCrashMonitorType) crashTypes
+{
+    gioMonitorCrash_setReportProfile(crashTypes, reportProfile);
+}
+
+- (void) setDeferReportFormatting:(BOOL) deferReportFormatting
+{
+    _deferReportFormatting = deferReportFormatting;
+    gioMonitorCrash_setDeferReportFormatting(deferReportFormatting);
+}
+
+- (void) setUseCrashHandlerThread:(BOOL) useCrashHandlerThread
+{
+    _useCrashHandlerThread = useCrashHandlerThread;
+    gioMonitorCrash_setUseCrashHandlerThread(useCrashHandlerThread);
+}
+
 - (void) setMaxReportCount:(int)maxReportCount
 {
     _maxReportCount = maxReportCount;
     gioMonitorCrash_setMaxReportCount(maxReportCount);
 }
 
+- (void) setCoalesceReports:(BOOL)coalesceReports
+{
+    _coalesceReports = coalesceReports;
+    gioMonitorCrash_setCoalesceReports(coalesceReports);
+}
+
+- (void) setMaxThreadCount:(int)maxThreadCount
+{
+    _maxThreadCount = maxThreadCount;
+    gioMonitorCrash_setMaxThreadCount(maxThreadCount);
+}
+
 - (NSDictionary*) systemInfo
 {
     GIOMonitorCrash_MonitorContext fakeEvent = {0};
@@ -274,6 +393,36 @@ static NSString* getBasePath()
     return true;
 }
 
+- (int) duplicateCountForReportID:(NSNumber*) reportID
+{
+    return gioMonitorCrash_getDuplicateCount([reportID longLongValue]);
+}
+
+- (NSDictionary*) reportTimings
+{
+    GIOMonitorCrashReportTimings timings;
+    gioMonitorCrash_getReportTimings(&timings);
+    NSMutableDictionary* sections = [NSMutableDictionary dictionary];
+    for(int i = 0; i < GIOMonitorCrashReportSectionCount; i++)
+    {
+        NSString* name = [NSString stringWithUTF8String:gioMonitorCrashReport_getSectionName((GIOMonitorCrashReportSection)i)];
+        sections[name] = timingToDictionary(&timings.sections[i]);
+    }
+    return @{@"report": timingToDictionary(&timings.report),
+             @"thread": timingToDictionary(&timings.thread),
+             @"sections": sections};
+}
+
+- (void) resetReportTimings
+{
+    gioMonitorCrash_resetReportTimings();
+}
+
+- (double) deadlockWatchdogCPUTime
+{
+    return gioMonitorCrash_getDeadlockWatchdogCPUTime();
+}
+
 - (void) deleteAllReports
 {
     gioMonitorCrash_deleteAllReports();
@@ -315,6 +464,30 @@ static NSString* getBasePath()
     gioMonitorCrash_setPrintPreviousLog(shouldPrintPreviousLog);
 }
 
+- (void) setLogRingBufferSize:(int) logRingBufferSize
+{
+    _logRingBufferSize = logRingBufferSize;
+    gioMonitorCrash_setLogRingBufferSize(logRingBufferSize);
+}
+
+- (void) setDeferLogFormatting:(BOOL) deferLogFormatting
+{
+    _deferLogFormatting = deferLogFormatting;
+    gioMonitorCrash_setDeferLogFormatting(deferLogFormatting);
+}
+
+- (void) setConsoleLogSize:(int) consoleLogSize
+{
+    _consoleLogSize = consoleLogSize;
+    gioMonitorCrash_setConsoleLogSize(consoleLogSize);
+}
+
+- (void) setCrashArenaSize:(int) crashArenaSize
+{
+    _crashArenaSize = crashArenaSize;
+    gioMonitorCrash_setCrashArenaSize(crashArenaSize);
+}
+
 
 // ============================================================================
 #pragma mark - Utility -
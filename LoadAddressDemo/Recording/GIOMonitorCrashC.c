@@ -28,17 +28,23 @@
 #include "GIOMonitorCrashC.h"
 
 #include "GIOMonitorCrashCachedData.h"
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashCPUProfiler.h"
+#include "GIOMonitorCrashHandlerThread.h"
 #include "GIOMonitorCrashReport.h"
 //#include "GIOMonitorCrashReportFixer.h"
 #include "GIOMonitorCrashReportStore.h"
-//#include "GIOMonitorCrashMonitor_Deadlock.h"
+#include "GIOMonitorCrashSnapshotLimiter.h"
+#include "GIOMonitorCrashMonitor_Deadlock.h"
 //#include "GIOMonitorCrashMonitor_User.h"
 #include "GIOMonitorCrashFileUtils.h"
+#include "GIOMonitorCrashMachineContext.h"
 #include "GIOMonitorCrashObjC.h"
 #include "GIOMonitorCrashString.h"
 //#include "GIOMonitorCrashMonitor_System.h"
 //#include "GIOMonitorCrashMonitor_Zombie.h"
 //#include "GIOMonitorCrashMonitor_AppState.h"
+#include "GIOMonitorCrashMonitor.h"
 #include "GIOMonitorCrashMonitorContext.h"
 #include "GIOMonitorCrashSystemCapabilities.h"
 
@@ -59,7 +65,14 @@
 static volatile bool g_installed = 0;
 
 static bool g_shouldAddConsoleLogToReport = false;
+static bool g_shouldShareBacktraceSuffixes = false;
 static bool g_shouldPrintPreviousLog = false;
+static int g_logRingBufferSize = 0;
+static bool g_shouldDeferLogFormatting = false;
+static int g_consoleLogSize = 0;
+static int g_crashArenaSize = 128 * 1024;
+static double g_cpuProfileSampleInterval = 0;
+static bool g_shouldUseCrashHandlerThread = false;
 static char g_consoleLogPath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
 static GIOMonitorCrashMonitorType g_monitoring = GIOMonitorCrashMonitorTypeProductionSafeMinimal;
 static char g_lastCrashReportFilePath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
@@ -69,12 +82,33 @@ static char g_lastCrashReportFilePath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
 #pragma mark - Utility -
 // ============================================================================
 
+/** Format a raw crash capture left by an earlier launch, and coalesce the
+ * report like one written at crash time.
+ */
+static bool formatRawCapture(const char* capturePath, const char* reportPath, int64_t reportID)
+{
+    if(!gioMonitorCrashReport_writeStandardReportFromRawCapture(capturePath, reportPath))
+    {
+        return false;
+    }
+    if(!gioMonitorCRS_coalesceReport(reportID, gioMonitorCrashReport_getLastFingerprint(), false))
+    {
+        gioMonitorCrashSnapshotLimiter_commitSuppressedCounts();
+    }
+    return true;
+}
+
 static void printPreviousLog(const char* filePath)
 {
     char* data;
     int length;
     if(gioMonitorCrashFileUtils_readEntireFile(filePath, &data, &length, 0))
     {
+        int logLength = gioMonitorCrashLog_unrollCircularLog(data, length);
+        if(logLength >= 0)
+        {
+            data[logLength] = '\0';
+        }
         printf("\nvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv Previous Log vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv\n\n");
         printf("%s\n", data);
         printf("^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\n\n");
@@ -102,6 +136,9 @@ GIOMonitorCrashMonitorType gioMonitorCrash_install(const char* appName, const ch
     snprintf(path, sizeof(path), "%s/Reports", installPath);
     gioMonitorCrashFileUtils_makePath(path);
     gioMonitorCRS_initialize(appName, path);
+    gioMonitorCrashArena_reserve(g_crashArenaSize);
+    // Before the console log is reopened, since captures may refer to it.
+    gioMonitorCRS_formatRawCaptures(formatRawCapture);
 
     snprintf(path, sizeof(path), "%s/Data", installPath);
     gioMonitorCrashFileUtils_makePath(path);
@@ -113,18 +150,82 @@ GIOMonitorCrashMonitorType gioMonitorCrash_install(const char* appName, const ch
     {
         printPreviousLog(g_consoleLogPath);
     }
-    gioMonitorCrashLog_setLogFilename(g_consoleLogPath, true);
+    if(g_consoleLogSize <= 0 || !gioMonitorCrashLog_setCircularLogFilename(g_consoleLogPath, g_consoleLogSize))
+    {
+        gioMonitorCrashLog_setLogFilename(g_consoleLogPath, true);
+    }
+    if(g_logRingBufferSize > 0)
+    {
+        snprintf(path, sizeof(path), "%s/Data/ConsoleLog.ring", installPath);
+        gioMonitorCrashLog_setRingBuffer(path, g_logRingBufferSize);
+        gioMonitorCrashLog_setDeferredFormatting(g_shouldDeferLogFormatting);
+    }
 
     gioMonitorCCD_init(60);
+    // Sized together, and before any monitor can use them.
+    gioMonitorCrashMachineContext_reserveThreadStorage();
+    gioMonitorCrashReport_setShareBacktraceSuffixes(g_shouldShareBacktraceSuffixes);
+    if(g_cpuProfileSampleInterval > 0)
+    {
+        gioMonitorCrashCPUProfiler_setSampleInterval(g_cpuProfileSampleInterval);
+    }
+
+    if(g_shouldUseCrashHandlerThread)
+    {
+        gioMonitorCrashHandlerThread_start();
+    }
 
 //    gioMonitorCrashCM_setEventCallback(onCrash);
-//    GIOMonitorCrashMonitorType monitors = gioMonitorCrash_setMonitoring(g_monitoring);
+    GIOMonitorCrashMonitorType monitors = gioMonitorCrash_setMonitoring(g_monitoring);
 
     GIOMonitorCrashLOG_DEBUG("Installation complete.");
-    return GIOMonitorCrashMonitorTypeNone;
+    return monitors;
+}
+
+GIOMonitorCrashMonitorType gioMonitorCrash_setMonitoring(GIOMonitorCrashMonitorType monitors)
+{
+    g_monitoring = monitors;
+
+    if(g_installed)
+    {
+        gioMonitorCrashCM_setActiveMonitors(monitors);
+        return gioMonitorCrashCM_getActiveMonitors();
+    }
+    // Return what we will be monitoring in future.
+    return g_monitoring;
+}
+
+
+
+void gioMonitorCrash_setDeadlockWatchdogInterval(double deadlockWatchdogInterval)
+{
+#if GIOMonitorCrashCRASH_HAS_OBJC
+    gioMonitorCrashCM_setDeadlockHandlerWatchdogInterval(deadlockWatchdogInterval);
+#endif
 }
 
+void gioMonitorCrash_setTerminateOnDeadlock(bool shouldTerminateOnDeadlock)
+{
+#if GIOMonitorCrashCRASH_HAS_OBJC
+    gioMonitorCrashCM_setTerminateOnDeadlock(shouldTerminateOnDeadlock);
+#endif
+}
 
+void gioMonitorCrash_setHangSampleInterval(double hangSampleInterval)
+{
+#if GIOMonitorCrashCRASH_HAS_OBJC
+    gioMonitorCrashCM_setHangSampleInterval(hangSampleInterval);
+#endif
+}
+
+void gioMonitorCrash_setCPUProfileSampleInterval(double cpuProfileSampleInterval)
+{
+    g_cpuProfileSampleInterval = cpuProfileSampleInterval;
+    if(g_installed)
+    {
+        gioMonitorCrashCPUProfiler_setSampleInterval(cpuProfileSampleInterval);
+    }
+}
 
 void gioMonitorCrash_setUserInfoJSON(const char* const userInfoJSON)
 {
@@ -141,6 +242,59 @@ void gioMonitorCrash_setDoNotIntrospectClasses(const char** doNotIntrospectClass
     gioMonitorCrashReport_setDoNotIntrospectClasses(doNotIntrospectClasses, length);
 }
 
+void gioMonitorCrash_setShareBacktraceSuffixes(bool shareBacktraceSuffixes)
+{
+    g_shouldShareBacktraceSuffixes = shareBacktraceSuffixes;
+    if(g_installed)
+    {
+        gioMonitorCrashReport_setShareBacktraceSuffixes(shareBacktraceSuffixes);
+    }
+}
+
+void gioMonitorCrash_setReportTimeLimit(double reportTimeLimit)
+{
+    gioMonitorCrashReport_setTimeLimit(reportTimeLimit);
+}
+
+void gioMonitorCrash_setReportSizeLimit(int reportSizeLimit)
+{
+    gioMonitorCrashReport_setSizeLimit(reportSizeLimit);
+}
+
+void gioMonitorCrash_setReportProfile(GIOMonitorCrashMonitorType crashTypes, GIOMonitorCrashReportProfile reportProfile)
+{
+    gioMonitorCrashReport_setProfile(crashTypes, reportProfile);
+}
+
+void gioMonitorCrash_setSnapshotRateLimit(double snapshotRateLimit)
+{
+    gioMonitorCrashSnapshotLimiter_setRateLimit(snapshotRateLimit);
+}
+
+void gioMonitorCrash_setSnapshotBurstLimit(int snapshotBurstLimit)
+{
+    gioMonitorCrashSnapshotLimiter_setBurstLimit(snapshotBurstLimit);
+}
+
+void gioMonitorCrash_setSnapshotSampleRate(double snapshotSampleRate)
+{
+    gioMonitorCrashSnapshotLimiter_setSampleRate(snapshotSampleRate);
+}
+
+void gioMonitorCrash_setDeferReportFormatting(bool shouldDeferReportFormatting)
+{
+    gioMonitorCrashCM_setDeferReportFormatting(shouldDeferReportFormatting);
+}
+
+void gioMonitorCrash_setUseCrashHandlerThread(bool shouldUseCrashHandlerThread)
+{
+    g_shouldUseCrashHandlerThread = shouldUseCrashHandlerThread;
+    if(g_installed && shouldUseCrashHandlerThread)
+    {
+        gioMonitorCrashHandlerThread_start();
+    }
+}
+
 void gioMonitorCrash_setCrashNotifyCallback(const GIOMonitorCrashReportWriteCallback onCrashNotify)
 {
     gioMonitorCrashReport_setUserSectionWriteCallback(onCrashNotify);
@@ -156,11 +310,46 @@ void gioMonitorCrash_setPrintPreviousLog(bool shouldPrintPreviousLog)
     g_shouldPrintPreviousLog = shouldPrintPreviousLog;
 }
 
+void gioMonitorCrash_setLogRingBufferSize(int logRingBufferSize)
+{
+    g_logRingBufferSize = logRingBufferSize;
+}
+
+void gioMonitorCrash_setDeferLogFormatting(bool shouldDeferLogFormatting)
+{
+    g_shouldDeferLogFormatting = shouldDeferLogFormatting;
+}
+
+void gioMonitorCrash_setConsoleLogSize(int consoleLogSize)
+{
+    g_consoleLogSize = consoleLogSize;
+}
+
+void gioMonitorCrash_setCrashArenaSize(int crashArenaSize)
+{
+    g_crashArenaSize = crashArenaSize;
+}
+
 void gioMonitorCrash_setMaxReportCount(int maxReportCount)
 {
     gioMonitorCRS_setMaxReportCount(maxReportCount);
 }
 
+void gioMonitorCrash_setCoalesceReports(bool shouldCoalesceReports)
+{
+    gioMonitorCRS_setCoalesceReports(shouldCoalesceReports);
+}
+
+void gioMonitorCrash_setMaxThreadCount(int maxThreadCount)
+{
+    if(g_installed)
+    {
+        GIOMonitorCrashLOG_ERROR("The max thread count can't be changed after installing.");
+        return;
+    }
+    gioMonitorCrashMachineContext_setMaxThreadCount(maxThreadCount);
+}
+
 int gioMonitorCrash_getReportCount()
 {
     return gioMonitorCRS_getReportCount();
@@ -176,6 +365,30 @@ int64_t gioMonitorCrash_addUserReport(const char* report, int reportLength)
     return gioMonitorCRS_addUserReport(report, reportLength);
 }
 
+int gioMonitorCrash_getDuplicateCount(int64_t reportID)
+{
+    return gioMonitorCRS_getDuplicateCount(reportID, NULL);
+}
+
+void gioMonitorCrash_getReportTimings(GIOMonitorCrashReportTimings* timings)
+{
+    gioMonitorCrashReport_getTimings(timings);
+}
+
+void gioMonitorCrash_resetReportTimings()
+{
+    gioMonitorCrashReport_resetTimings();
+}
+
+double gioMonitorCrash_getDeadlockWatchdogCPUTime()
+{
+#if GIOMonitorCrashCRASH_HAS_OBJC
+    return (double)gioMonitorCrashCM_getDeadlockWatchdogCPUTime() / 1000000.0;
+#else
+    return 0;
+#endif
+}
+
 void gioMonitorCrash_deleteAllReports()
 {
     gioMonitorCRS_deleteAllReports();
@@ -38,6 +38,7 @@ extern "C" {
 
 
 #include "GIOMonitorCrashMonitorType.h"
+#include "GIOMonitorCrashReport.h"
 #include "GIOMonitorCrashReportWriter.h"
 
 #include <stdbool.h>
@@ -52,6 +53,19 @@ extern "C" {
  */
 GIOMonitorCrashMonitorType gioMonitorCrash_install(const char* appName, const char* const installPath);
 
+/** Set the crash types that will be handled.
+ * Some crash types may not be enabled depending on circumstances (e.g. running
+ * in a debugger).
+ *
+ * @param monitors The monitors to install.
+ *
+ * @return The monitors that were installed. If GIOMonitorCrash has been
+ *         installed, the return value represents the monitors that were
+ *         successfully installed. Otherwise it represents which monitors it
+ *         will attempt to activate when GIOMonitorCrash installs.
+ */
+GIOMonitorCrashMonitorType gioMonitorCrash_setMonitoring(GIOMonitorCrashMonitorType monitors);
+
 /** Set the user-supplied data in JSON format.
  *
  * @param userInfoJSON Pre-baked JSON containing user-supplied information.
@@ -59,6 +73,56 @@ GIOMonitorCrashMonitorType gioMonitorCrash_install(const char* appName, const ch
  */
 void gioMonitorCrash_setUserInfoJSON(const char* const userInfoJSON);
 
+/** Set the maximum time to allow the main thread to run without returning to
+ * its run loop. If a task occupies the main thread for longer than this
+ * interval, the watchdog will consider the queue deadlocked and write a
+ * report. The app is only shut down if terminate on deadlock is set.
+ *
+ * Warning: Make SURE that nothing in your app that runs on the main thread
+ * takes longer to complete than this value or it WILL be reported! This
+ * includes your app startup process, so you may need to push app
+ * initialization to another thread, or perhaps set this to a higher value
+ * until your application has been fully initialized.
+ *
+ * 0 = Disabled.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setDeadlockWatchdogInterval(double deadlockWatchdogInterval);
+
+/** If true, shut down the app with abort() once a deadlock is reported.
+ * Otherwise the deadlock is reported once per hang as a snapshot and the app
+ * keeps running. A main thread running a nested run loop in a mode outside the
+ * common modes looks hung to the watchdog, so terminating can kill a working
+ * app.
+ *
+ * Default: false
+ */
+void gioMonitorCrash_setTerminateOnDeadlock(bool shouldTerminateOnDeadlock);
+
+/** Set the interval between samples of the main thread's stack once it has
+ * been busy for a quarter of a second. Identical stacks are aggregated with
+ * counts, and the most recent hang profile is added to the debug section of
+ * reports. Needs a deadlock watchdog interval.
+ *
+ * 0 = Disabled.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setHangSampleInterval(double hangSampleInterval);
+
+/** Set the interval between passes of the CPU profiler, which samples the
+ * stacks of all threads and aggregates them into a call tree. The profile is
+ * periodically written to the report store as a "cpu_profile" report. The
+ * profiler backs off if sampling takes more than 2% of wall time. Only the
+ * latest 2 profiles are kept, and they don't count toward the max report count.
+ *
+ * 0 = Disabled.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setCPUProfileSampleInterval(double cpuProfileSampleInterval);
+
 /** If true, introspect memory contents during a crash.
  * Any Objective-C objects or C strings near the stack pointer or referenced by
  * cpu registers or exceptions will be recorded in the crash report, along with
@@ -76,6 +140,92 @@ void gioMonitorCrash_setIntrospectMemory(bool introspectMemory);
  */
 void gioMonitorCrash_setDoNotIntrospectClasses(const char** doNotIntrospectClasses, int length);
 
+/** If true, frames that several threads have in common (start, main, the
+ * run loop...) are written once to a shared frames table instead of being
+ * repeated in every thread's backtrace. report_converter.py expands them again.
+ *
+ * Default: false
+ */
+void gioMonitorCrash_setShareBacktraceSuffixes(bool shareBacktraceSuffixes);
+
+/** Set how long writing a crash report may take, in seconds. Once it is
+ * exceeded, the low priority sections still to be written (registers of
+ * non-crashed threads, stack contents, notable addresses, console log) are
+ * left out, so that the report is complete before the OS kills the process.
+ * What was dropped is recorded in the debug section.
+ *
+ * 0 = No limit.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setReportTimeLimit(double reportTimeLimit);
+
+/** Set how large a crash report may get, in bytes, before its remaining low
+ * priority sections are left out, as with the time limit.
+ *
+ * 0 = No limit.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setReportSizeLimit(int reportSizeLimit);
+
+/** Set how much reports of the given crash types capture about each thread.
+ * Minimal reports leave out stack contents, notable addresses, registers of
+ * non-crashed threads and the console log. Forensic reports add stack
+ * contents and notable addresses for every thread.
+ * User reported snapshots use the profile set for
+ * GIOMonitorCrashMonitorTypeUserReported, unless one is passed with the
+ * snapshot.
+ *
+ * Default: GIOMonitorCrashReportProfileStandard for all crash types
+ */
+void gioMonitorCrash_setReportProfile(GIOMonitorCrashMonitorType crashTypes, GIOMonitorCrashReportProfile reportProfile);
+
+/** Set how many user reported snapshots per second each exception name may
+ * take on average. Each snapshot suspends all threads, so this protects the
+ * app from a caller reporting in a loop. Suppressed snapshots are counted by
+ * name, and the counts are written to the next report that is kept.
+ *
+ * 0 = No limit.
+ *
+ * Default: 0
+ */
+void gioMonitorCrash_setSnapshotRateLimit(double snapshotRateLimit);
+
+/** Set how many user reported snapshots of an exception name may be taken in
+ * a burst before the rate limit applies.
+ *
+ * Default: 5
+ */
+void gioMonitorCrash_setSnapshotBurstLimit(int snapshotBurstLimit);
+
+/** Set the fraction of user reported snapshots to take (0.0 - 1.0). The rest
+ * are counted as sampled out, and don't use up the rate limit.
+ *
+ * Default: 1.0
+ */
+void gioMonitorCrash_setSnapshotSampleRate(double snapshotSampleRate);
+
+/** If true, a fatal crash only dumps the raw crash state (registers,
+ * unsymbolicated backtraces, stack bytes, image table) to a binary file, and
+ * the report is formatted from it on the next launch. This makes crash
+ * handling much quicker, but the report has no memory introspection, and the
+ * crash notify callback isn't called.
+ *
+ * Default: false
+ */
+void gioMonitorCrash_setDeferReportFormatting(bool shouldDeferReportFormatting);
+
+/** If true, a thread with its own 512 KB stack is started at install, and
+ * fatal crash reports are written on it while the crashed thread waits. This
+ * keeps report writing off a stack that may have overflowed or been
+ * corrupted. The thread is left running when other threads are suspended.
+ * It can't be stopped once started.
+ *
+ * Default: false
+ */
+void gioMonitorCrash_setUseCrashHandlerThread(bool shouldUseCrashHandlerThread);
+
 /** Set the callback to invoke upon a crash.
  *
  * WARNING: Only call async-safe functions from this function! DO NOT call
@@ -100,12 +250,75 @@ void gioMonitorCrash_setAddConsoleLogToReport(bool shouldAddConsoleLogToReport);
  */
 void gioMonitorCrash_setPrintPreviousLog(bool shouldPrintPreviousLog);
 
+/** Set the size of the console log ring buffer. If nonzero, log entries are
+ *  queued in a memory mapped ring buffer and written out by a background
+ *  thread, instead of being written synchronously. Must be set before install.
+ *
+ * Default: 0 (write log entries synchronously)
+ *
+ * @param logRingBufferSize The ring buffer size in bytes.
+ */
+void gioMonitorCrash_setLogRingBufferSize(int logRingBufferSize);
+
+/** If true, log entries queued in the ring buffer hold their format string and
+ *  raw arguments, and are only formatted when written out. Has no effect unless
+ *  a log ring buffer size is set. Must be set before install.
+ *
+ * Default: false
+ *
+ * @param shouldDeferLogFormatting If true, defer log formatting.
+ */
+void gioMonitorCrash_setDeferLogFormatting(bool shouldDeferLogFormatting);
+
+/** Set the size of the console log file. If nonzero, the console log is kept
+ *  as a circular file holding the latest this many bytes, and only those are
+ *  added to reports. If 0, the log file grows until the next install.
+ *  Must be set before install.
+ *
+ * Default: 0
+ *
+ * @param consoleLogSize The console log size in bytes (at least 1024, or 0).
+ */
+void gioMonitorCrash_setConsoleLogSize(int consoleLogSize);
+
+/** Set the size of the memory reserved at install for handling crashes.
+ *  It is pre-faulted, and the crash handler takes its buffers from it
+ *  instead of the stack or the heap, which lets it write the report in 64 KB
+ *  chunks. If 0 or too small, the crash handler uses small stack buffers.
+ *  Must be set before install.
+ *
+ * Default: 131072
+ *
+ * @param crashArenaSize The arena size in bytes.
+ */
+void gioMonitorCrash_setCrashArenaSize(int crashArenaSize);
+
 /** Set the maximum number of reports allowed on disk before old ones get deleted.
+ * Older reports of a crash that a newer report also has are deleted first.
  *
  * @param maxReportCount The maximum number of reports.
  */
 void gioMonitorCrash_setMaxReportCount(int maxReportCount);
 
+/** If true, a crash report is deleted if an earlier report of the same crash
+ * (same crash type and crashed thread frames) is still on disk, and the
+ * earlier one's duplicate count goes up instead. User reported snapshots are
+ * always kept.
+ *
+ * Default: true
+ */
+void gioMonitorCrash_setCoalesceReports(bool shouldCoalesceReports);
+
+/** Set the maximum number of threads recorded in a crash report.
+ * Storage for the thread list and shared backtraces is allocated when
+ * installing, not during a crash, so this must be set before installing.
+ *
+ * Default: 100
+ *
+ * @param maxThreadCount The maximum number of threads.
+ */
+void gioMonitorCrash_setMaxThreadCount(int maxThreadCount);
+
 /** Report a custom, user defined exception.
  * This can be useful when dealing with scripting languages.
  *
@@ -174,6 +387,32 @@ int gioMonitorCrash_getReportIDs(int64_t* reportIDs, int count);
  */
 int64_t gioMonitorCrash_addUserReport(const char* report, int reportLength);
 
+/** Get how many later identical crashes were coalesced into a report instead
+ * of being stored as reports of their own.
+ *
+ * @param reportID The report's ID.
+ *
+ * @return The number of duplicates.
+ */
+int gioMonitorCrash_getDuplicateCount(int64_t reportID);
+
+/** Get how long writing crash reports took in this process, in total, per
+ * section, and per thread. Each report also has its own timings in its debug
+ * section, so slow phases can be found in reports from the field.
+ *
+ * @param timings Filled with the timings.
+ */
+void gioMonitorCrash_getReportTimings(GIOMonitorCrashReportTimings* timings);
+
+/** Forget the report timings collected so far.
+ */
+void gioMonitorCrash_resetReportTimings(void);
+
+/** Get the CPU time the deadlock watchdog has used so far, including hang
+ * sampling, in seconds.
+ */
+double gioMonitorCrash_getDeadlockWatchdogCPUTime(void);
+
 /** Delete all reports on disk.
  */
 void gioMonitorCrash_deleteAllReports(void);
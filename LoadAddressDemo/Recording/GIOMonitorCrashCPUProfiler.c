@@ -0,0 +1,414 @@
+//
+//  GIOMonitorCrashCPUProfiler.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashCPUProfiler.h"
+#include "GIOMonitorCrashReport.h"
+#include "GIOMonitorCrashReportStore.h"
+#include "GIOMonitorCrashMachineContext.h"
+#include "GIOMonitorCrashStackCursor_MachineContext.h"
+#include "GIOMonitorCrashThread.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uuid/uuid.h>
+
+
+/** Frames kept per thread stack. */
+#define kMaxSampleFrames 128
+
+/** Size of the sample ring, in addresses. Must be a power of 2. */
+#define kRingCapacity (1 << 15)
+
+/** Maximum number of frames in the call tree of one profile. */
+#define kMaxCallTreeNodes 16384
+
+/** Maximum fraction of wall time the sampler may spend in sampling passes. */
+#define kMaxSamplingOverhead 0.02
+
+/** Time between drains of the sample ring, in seconds. */
+#define kAggregateInterval 1.0
+
+/** Time between writes of the current profile to the report store, in seconds. */
+#define kPersistInterval 60.0
+
+#define kIdleInterval 1.0
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+/* The ring is single producer (the sampler thread), single consumer (the
+ * aggregator thread). Each record is a frame count followed by that many
+ * addresses, innermost first. The head and tail only ever grow, and are only
+ * written by the producer and consumer respectively.
+ */
+static uintptr_t* g_ring;
+static volatile uint32_t g_ringHead;
+static volatile uint32_t g_ringTail;
+
+/** Time between sampling passes, in seconds (0 = don't sample). */
+static volatile double g_sampleInterval = 0;
+
+static bool g_isStarted = false;
+
+/** Published by each profiler thread before it starts work, so that the
+ * other one never sees a stale ID. 0 until then.
+ */
+static thread_t g_samplerThread;
+static thread_t g_aggregatorThread;
+
+/** Counters updated by the sampler and collected by the aggregator. */
+static volatile uint64_t g_samplingTimeNanoseconds;
+static volatile uint32_t g_passCount;
+static volatile uint32_t g_ringDroppedSampleCount;
+
+/** The profile being aggregated. Only touched by the aggregator thread. */
+static GIOMonitorCrashStackTrie g_callTree;
+static GIOMonitorCrashCPUProfile g_profile;
+static uint64_t g_profileStartTime;
+static uint64_t g_profileStartCPUTime;
+static char g_profileReportID[37];
+static char g_profileReportPath[GrowingMonitorCRS_MAX_PATH_LENGTH];
+static bool g_hasUnsavedSamples;
+
+/** Makes each temporary profile file name unique. */
+static volatile uint32_t g_tempFileCounter;
+
+
+// ============================================================================
+#pragma mark - Utility -
+// ============================================================================
+
+static uint64_t getMonotonicTimeNanoseconds(void)
+{
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0)
+    {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+/** Get the CPU time used by a thread, in microseconds. */
+static uint64_t getThreadCPUTimeUSec(const thread_t thread)
+{
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if(thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return (uint64_t)(info.user_time.seconds + info.system_time.seconds) * 1000000 +
+           (uint64_t)(info.user_time.microseconds + info.system_time.microseconds);
+}
+
+static uint64_t getProfilerCPUTimeUSec(void)
+{
+    return getThreadCPUTimeUSec(__atomic_load_n(&g_samplerThread, __ATOMIC_ACQUIRE)) +
+           getThreadCPUTimeUSec(__atomic_load_n(&g_aggregatorThread, __ATOMIC_ACQUIRE));
+}
+
+static void sleepSeconds(const double seconds)
+{
+    usleep((useconds_t)(seconds * 1000000));
+}
+
+
+// ============================================================================
+#pragma mark - Sampling -
+// ============================================================================
+
+/** Queue a stack in the ring. Only called from the sampler thread.
+ *
+ * @return false if the ring is full.
+ */
+static bool pushSample(const uintptr_t* const backtrace, const int length)
+{
+    const uint32_t head = g_ringHead;
+    const uint32_t tail = __atomic_load_n(&g_ringTail, __ATOMIC_ACQUIRE);
+    if(kRingCapacity - (head - tail) < (uint32_t)length + 1)
+    {
+        return false;
+    }
+    g_ring[head & (kRingCapacity - 1)] = (uintptr_t)length;
+    for(int i = 0; i < length; i++)
+    {
+        g_ring[(head + 1 + (uint32_t)i) & (kRingCapacity - 1)] = backtrace[i];
+    }
+    __atomic_store_n(&g_ringHead, head + (uint32_t)length + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/** Capture a thread's stack. The thread stays suspended until this returns,
+ * so anything that waits on a lock the thread holds would hang the sampler.
+ * Stack walking doesn't, and the logger only writes through a file descriptor.
+ *
+ * @return The number of frames captured.
+ */
+static int sampleThread(const thread_t thread, uintptr_t* const backtrace, const int maxLength)
+{
+    if(thread_suspend(thread) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    int length = 0;
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+    if(gioMonitorCrashMachineContext_getContextForThread((GIOMonitorCrashThread)thread, machineContext, false))
+    {
+        GIOMonitorCrashStackCursor stackCursor;
+        gioMonitorCrashStackCursor_initWithMachineContext(&stackCursor, maxLength, machineContext);
+        while(length < maxLength && stackCursor.advanceCursor(&stackCursor))
+        {
+            backtrace[length++] = stackCursor.stackEntry.address;
+        }
+    }
+    thread_resume(thread);
+    return length;
+}
+
+/** Sample every thread except the profiler's own. */
+static void samplePass(const thread_t thisThread)
+{
+    const task_t thisTask = mach_task_self();
+    thread_act_array_t threads;
+    mach_msg_type_number_t threadCount;
+    if(task_threads(thisTask, &threads, &threadCount) != KERN_SUCCESS)
+    {
+        return;
+    }
+
+    uintptr_t backtrace[kMaxSampleFrames];
+    uint32_t droppedSampleCount = 0;
+    for(mach_msg_type_number_t i = 0; i < threadCount; i++)
+    {
+        const thread_t thread = threads[i];
+        if(thread == thisThread || thread == __atomic_load_n(&g_aggregatorThread, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+        const int length = sampleThread(thread, backtrace, kMaxSampleFrames);
+        if(length > 0 && !pushSample(backtrace, length))
+        {
+            droppedSampleCount++;
+        }
+    }
+    if(droppedSampleCount > 0)
+    {
+        __atomic_add_fetch(&g_ringDroppedSampleCount, droppedSampleCount, __ATOMIC_RELAXED);
+    }
+
+    for(mach_msg_type_number_t i = 0; i < threadCount; i++)
+    {
+        mach_port_deallocate(thisTask, threads[i]);
+    }
+    vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * threadCount);
+}
+
+static void* samplerThread(void* const userData)
+{
+    pthread_setname_np((const char*)userData);
+    const thread_t thisThread = (thread_t)gioMonitorCrashThread_self();
+    __atomic_store_n(&g_samplerThread, thisThread, __ATOMIC_RELEASE);
+    for(;;)
+    {
+        const double interval = g_sampleInterval;
+        if(interval <= 0)
+        {
+            sleepSeconds(kIdleInterval);
+            continue;
+        }
+
+        const uint64_t startTime = getMonotonicTimeNanoseconds();
+        samplePass(thisThread);
+        const uint64_t passTime = getMonotonicTimeNanoseconds() - startTime;
+        __atomic_add_fetch(&g_samplingTimeNanoseconds, passTime, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_passCount, 1, __ATOMIC_RELAXED);
+
+        // Back off if a pass takes too long for the configured interval.
+        const double passSeconds = (double)passTime / 1000000000.0;
+        double period = passSeconds / kMaxSamplingOverhead;
+        if(period < interval)
+        {
+            period = interval;
+        }
+        sleepSeconds(period - passSeconds);
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - Aggregation -
+// ============================================================================
+
+static void startProfile(void)
+{
+    gioMonitorCrashStackTrie_reset(&g_callTree);
+    memset(&g_profile, 0, sizeof(g_profile));
+    g_profile.callTree = &g_callTree;
+    g_profileStartTime = getMonotonicTimeNanoseconds();
+    g_profileStartCPUTime = getProfilerCPUTimeUSec();
+
+    uuid_t uuid;
+    uuid_generate(uuid);
+    uuid_unparse_upper(uuid, g_profileReportID);
+    gioMonitorCRS_getNextCPUProfilePath(g_profileReportPath);
+    g_hasUnsavedSamples = false;
+}
+
+/** Write the current profile to a temporary file next to its report, then
+ * move it over the report, so that a crash mid-write can't lose the
+ * previous version. The temporary file is named after the process and a
+ * counter, so no other write can be using it.
+ */
+static void persistProfile(void)
+{
+    g_profile.sampleInterval = g_sampleInterval;
+    g_profile.duration = (double)(getMonotonicTimeNanoseconds() - g_profileStartTime) / 1000000000.0;
+    g_profile.cpuTime = (double)(getProfilerCPUTimeUSec() - g_profileStartCPUTime) / 1000000.0;
+
+    char tempPath[GrowingMonitorCRS_MAX_PATH_LENGTH];
+    strncpy(tempPath, g_profileReportPath, sizeof(tempPath));
+    char* lastSlash = strrchr(tempPath, '/');
+    char* filename = lastSlash == NULL ? tempPath : lastSlash + 1;
+    snprintf(filename, sizeof(tempPath) - (size_t)(filename - tempPath), "cpu_profile-%d-%u.tmp",
+             getpid(), __atomic_fetch_add(&g_tempFileCounter, 1, __ATOMIC_RELAXED));
+
+    gioMonitorCrashReport_writeCPUProfileReport(&g_profile, g_profileReportID, tempPath);
+    if(rename(tempPath, g_profileReportPath) < 0)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not move %s to %s: %s", tempPath, g_profileReportPath, strerror(errno));
+    }
+    g_hasUnsavedSamples = false;
+}
+
+/** Move the queued stacks into the call tree.
+ *
+ * @return false if the call tree filled up.
+ */
+static bool drainRing(void)
+{
+    uintptr_t backtrace[kMaxSampleFrames];
+    bool hasRoom = true;
+    uint32_t tail = g_ringTail;
+    const uint32_t head = __atomic_load_n(&g_ringHead, __ATOMIC_ACQUIRE);
+    while(tail != head)
+    {
+        const int length = (int)g_ring[tail & (kRingCapacity - 1)];
+        for(int i = 0; i < length; i++)
+        {
+            backtrace[i] = g_ring[(tail + 1 + (uint32_t)i) & (kRingCapacity - 1)];
+        }
+        tail += (uint32_t)length + 1;
+        __atomic_store_n(&g_ringTail, tail, __ATOMIC_RELEASE);
+
+        if(gioMonitorCrashStackTrie_addBacktrace(&g_callTree, backtrace, length) < 0)
+        {
+            g_profile.droppedSampleCount++;
+            hasRoom = false;
+        }
+        else
+        {
+            g_profile.sampleCount++;
+        }
+        g_hasUnsavedSamples = true;
+    }
+
+    g_profile.passCount += (int)__atomic_exchange_n(&g_passCount, 0, __ATOMIC_RELAXED);
+    g_profile.droppedSampleCount += (int)__atomic_exchange_n(&g_ringDroppedSampleCount, 0, __ATOMIC_RELAXED);
+    g_profile.samplingTime += (double)__atomic_exchange_n(&g_samplingTimeNanoseconds, 0, __ATOMIC_RELAXED) / 1000000000.0;
+    return hasRoom;
+}
+
+static void* aggregatorThread(void* const userData)
+{
+    pthread_setname_np((const char*)userData);
+    __atomic_store_n(&g_aggregatorThread, (thread_t)gioMonitorCrashThread_self(), __ATOMIC_RELEASE);
+    // The profile's CPU time includes the sampler's, so wait until it's known.
+    while(__atomic_load_n(&g_samplerThread, __ATOMIC_ACQUIRE) == 0)
+    {
+        sleepSeconds(0.001);
+    }
+    startProfile();
+    uint64_t lastPersistTime = getMonotonicTimeNanoseconds();
+    for(;;)
+    {
+        sleepSeconds(kAggregateInterval);
+        const bool hasRoom = drainRing();
+        const uint64_t now = getMonotonicTimeNanoseconds();
+        const bool isDue = (double)(now - lastPersistTime) / 1000000000.0 >= kPersistInterval;
+        if(g_hasUnsavedSamples && (!hasRoom || isDue || g_sampleInterval <= 0))
+        {
+            persistProfile();
+            lastPersistTime = now;
+        }
+        if(!hasRoom)
+        {
+            startProfile();
+        }
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static bool startThread(void* (*function)(void*), const char* const name)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int error = pthread_create(&thread, &attr, function, (void*)name);
+    pthread_attr_destroy(&attr);
+    if(error != 0)
+    {
+        GIOMonitorCrashLOG_ERROR("pthread_create: %s", strerror(error));
+        return false;
+    }
+    return true;
+}
+
+static bool startProfiler(void)
+{
+    g_ring = calloc(kRingCapacity, sizeof(*g_ring));
+    if(g_ring == NULL || !gioMonitorCrashStackTrie_create(&g_callTree, kMaxCallTreeNodes))
+    {
+        GIOMonitorCrashLOG_ERROR("Could not allocate CPU profiler storage");
+        free(g_ring);
+        g_ring = NULL;
+        return false;
+    }
+    // The aggregator waits for the sampler, so it must exist first.
+    return startThread(samplerThread, "GIOMonitorCrash CPU Profile Sampler") &&
+           startThread(aggregatorThread, "GIOMonitorCrash CPU Profile Aggregator");
+}
+
+void gioMonitorCrashCPUProfiler_setSampleInterval(double sampleInterval)
+{
+    g_sampleInterval = sampleInterval;
+    if(sampleInterval > 0 && !g_isStarted)
+    {
+        g_isStarted = true;
+        GIOMonitorCrashLOG_DEBUG("Starting CPU profiler with a sample interval of %f seconds", sampleInterval);
+        startProfiler();
+    }
+}
@@ -0,0 +1,80 @@
+//
+//  GIOMonitorCrashCPUProfiler.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Continuous sampling CPU profiler.
+ *
+ * A sampler thread periodically walks the stacks of all threads and queues
+ * the raw addresses in a lock-free ring. An aggregator thread drains the ring
+ * into a call tree and periodically writes it to the report store as a
+ * "cpu_profile" report. Each report holds the profile of one session, and is
+ * rewritten in place until its call tree is full; then a new one is started.
+ *
+ * The time spent sampling is measured, and the sampler backs off so that it
+ * never takes more than a small fraction of wall time. Both the sampling time
+ * and the CPU time used by the profiler threads are part of each profile.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashCPUProfiler_h
+#define HDR_GIOMonitorCrashCPUProfiler_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "GIOMonitorCrashStackTrie.h"
+
+#include <stdbool.h>
+
+
+typedef struct
+{
+    /** The configured time between sampling passes, in seconds. */
+    double sampleInterval;
+
+    /** Wall time covered by the profile, in seconds. */
+    double duration;
+
+    /** Wall time spent in sampling passes, in seconds. Threads are only
+     * suspended during part of this. */
+    double samplingTime;
+
+    /** CPU time used by the sampler and aggregator threads, in seconds. */
+    double cpuTime;
+
+    /** Number of sampling passes. */
+    int passCount;
+
+    /** Number of thread stacks in the call tree. */
+    int sampleCount;
+
+    /** Stacks that were dropped because the ring or the call tree was full. */
+    int droppedSampleCount;
+
+    /** The call tree. Each node's refCount is the number of samples passing
+     * through it (its inclusive count). */
+    const GIOMonitorCrashStackTrie* callTree;
+} GIOMonitorCrashCPUProfile;
+
+
+/** Set the time between sampling passes. The profiler threads are started
+ * the first time this is set to a nonzero value, and must only be started
+ * after the report store has been initialized.
+ *
+ * @param sampleInterval The time between sampling passes, in seconds (0 = stop sampling).
+ */
+void gioMonitorCrashCPUProfiler_setSampleInterval(double sampleInterval);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashCPUProfiler_h
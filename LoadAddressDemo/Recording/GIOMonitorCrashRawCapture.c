@@ -0,0 +1,1034 @@
+//
+//  GIOMonitorCrashRawCapture.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashRawCapture.h"
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashCachedData.h"
+#include "GIOMonitorCrashCPU.h"
+#include "GIOMonitorCrashDynamicLinker.h"
+#include "GIOMonitorCrashFileUtils.h"
+#include "GIOMonitorCrashMachineContext.h"
+#include "GIOMonitorCrashMemory.h"
+#include "GIOMonitorCrashSnapshotLimiter.h"
+#include "GIOMonitorCrashStackCursor_MachineContext.h"
+#include "GIOMonitorCrashThread.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+// ============================================================================
+#pragma mark - Constants -
+// ============================================================================
+
+#define kMagic 0x43524347 // "GCRC"
+#define kFormatVersion 1
+
+/** Frames kept per thread backtrace. */
+#define kMaxBacktraceLength 512
+
+/** Registers kept per thread, of each kind. */
+#define kMaxRegisters 128
+
+/** How much of the stack to dump (in pointer sized jumps). Same as in a standard report. */
+#define kStackContentsPushedDistance 20
+#define kStackContentsPoppedDistance 10
+#define kStackContentsTotalDistance (kStackContentsPushedDistance + kStackContentsPoppedDistance)
+
+/** String IDs past the context's own strings. */
+#define kStringID_UserInfoJSON 1000
+#define kStringID_ConsoleLog 1001
+
+/** Size of the file write buffer when it comes from the crash arena. */
+#define kArenaWriteBufferSize (64 * 1024)
+
+enum
+{
+    kTag_Header = 1,
+    kTag_Context,
+    kTag_String,
+    kTag_Image,
+    kTag_Thread,
+    kTag_Stack,
+    kTag_HangProfile,
+    kTag_End,
+    // Only ever append, so that older captures still read.
+    kTag_SuppressedSnapshots,
+};
+
+enum
+{
+    kContextFlag_RegistersAreValid = 1 << 0,
+    kContextFlag_IsStackOverflow = 1 << 1,
+    kContextFlag_CrashedDuringCrashHandling = 1 << 2,
+    kContextFlag_CurrentSnapshotUserReported = 1 << 3,
+    kContextFlag_IsJailbroken = 1 << 4,
+    kContextFlag_ApplicationIsActive = 1 << 5,
+    kContextFlag_ApplicationIsInForeground = 1 << 6,
+    kContextFlag_CrashedLastLaunch = 1 << 7,
+    kContextFlag_CrashedThisLaunch = 1 << 8,
+    kContextFlag_ThreadsNotSuspended = 1 << 9,
+};
+
+enum
+{
+    kThreadFlag_Crashed = 1 << 0,
+    kThreadFlag_CurrentThread = 1 << 1,
+    kThreadFlag_GaveUp = 1 << 2,
+    kThreadFlag_HasRegisters = 1 << 3,
+    kThreadFlag_HasExceptionRegisters = 1 << 4,
+};
+
+/** The context's string fields, by string ID. Only ever append to this. */
+static const size_t g_contextStrings[] =
+{
+    offsetof(GIOMonitorCrash_MonitorContext, eventID),
+    offsetof(GIOMonitorCrash_MonitorContext, exceptionName),
+    offsetof(GIOMonitorCrash_MonitorContext, crashReason),
+    offsetof(GIOMonitorCrash_MonitorContext, NSException.name),
+    offsetof(GIOMonitorCrash_MonitorContext, NSException.userInfo),
+    offsetof(GIOMonitorCrash_MonitorContext, CPPException.name),
+    offsetof(GIOMonitorCrash_MonitorContext, userException.name),
+    offsetof(GIOMonitorCrash_MonitorContext, userException.language),
+    offsetof(GIOMonitorCrash_MonitorContext, userException.lineOfCode),
+    offsetof(GIOMonitorCrash_MonitorContext, userException.customStackTrace),
+    offsetof(GIOMonitorCrash_MonitorContext, System.systemName),
+    offsetof(GIOMonitorCrash_MonitorContext, System.systemVersion),
+    offsetof(GIOMonitorCrash_MonitorContext, System.machine),
+    offsetof(GIOMonitorCrash_MonitorContext, System.model),
+    offsetof(GIOMonitorCrash_MonitorContext, System.kernelVersion),
+    offsetof(GIOMonitorCrash_MonitorContext, System.osVersion),
+    offsetof(GIOMonitorCrash_MonitorContext, System.bootTime),
+    offsetof(GIOMonitorCrash_MonitorContext, System.appStartTime),
+    offsetof(GIOMonitorCrash_MonitorContext, System.executablePath),
+    offsetof(GIOMonitorCrash_MonitorContext, System.executableName),
+    offsetof(GIOMonitorCrash_MonitorContext, System.bundleID),
+    offsetof(GIOMonitorCrash_MonitorContext, System.bundleName),
+    offsetof(GIOMonitorCrash_MonitorContext, System.bundleVersion),
+    offsetof(GIOMonitorCrash_MonitorContext, System.bundleShortVersion),
+    offsetof(GIOMonitorCrash_MonitorContext, System.appID),
+    offsetof(GIOMonitorCrash_MonitorContext, System.cpuArchitecture),
+    offsetof(GIOMonitorCrash_MonitorContext, System.timezone),
+    offsetof(GIOMonitorCrash_MonitorContext, System.processName),
+    offsetof(GIOMonitorCrash_MonitorContext, System.deviceAppHash),
+    offsetof(GIOMonitorCrash_MonitorContext, System.buildType),
+    offsetof(GIOMonitorCrash_MonitorContext, ZombieException.name),
+    offsetof(GIOMonitorCrash_MonitorContext, ZombieException.reason),
+    offsetof(GIOMonitorCrash_MonitorContext, consoleLogPath),
+};
+static const int g_contextStringCount = sizeof(g_contextStrings) / sizeof(*g_contextStrings);
+
+
+// ============================================================================
+#pragma mark - Records -
+// ============================================================================
+
+/* All fixed size parts are multiples of 8 bytes, so that the arrays following
+ * them stay aligned.
+ */
+
+typedef struct
+{
+    uint32_t tag;
+    uint32_t length;
+} RecordHeader;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pointerSize;
+    uint32_t reserved;
+    int64_t timestamp;
+} CaptureHeader;
+
+typedef struct
+{
+    int64_t crashType;
+    int64_t flags;
+    uint64_t faultAddress;
+    int64_t machType;
+    int64_t machCode;
+    int64_t machSubcode;
+    int64_t signum;
+    int64_t sigcode;
+    uint64_t zombieExceptionAddress;
+
+    int64_t cpuType;
+    int64_t cpuSubType;
+    int64_t binaryCPUType;
+    int64_t binaryCPUSubType;
+    int64_t processID;
+    int64_t parentProcessID;
+    uint64_t storageSize;
+    uint64_t memorySize;
+    uint64_t freeMemory;
+    uint64_t usableMemory;
+
+    double activeDurationSinceLastCrash;
+    double backgroundDurationSinceLastCrash;
+    double activeDurationSinceLaunch;
+    double backgroundDurationSinceLaunch;
+    double appStateTransitionTime;
+    int64_t launchesSinceLastCrash;
+    int64_t sessionsSinceLastCrash;
+    int64_t sessionsSinceLaunch;
+} CaptureContext;
+
+/** Followed by the string and a terminating NUL. */
+typedef struct
+{
+    uint32_t stringID;
+    uint32_t length;
+} CaptureString;
+
+/** Followed by the null terminated name. */
+typedef struct
+{
+    uint64_t address;
+    uint64_t vmAddress;
+    uint64_t size;
+    uint64_t majorVersion;
+    uint64_t minorVersion;
+    uint64_t revisionVersion;
+    int32_t cpuType;
+    int32_t cpuSubType;
+    uint8_t uuid[16];
+    uint32_t nameLength;
+    uint32_t reserved;
+} CaptureImage;
+
+/** Followed by the registers, the exception registers, the backtrace, and
+ * the null terminated thread and queue names (length 0 = no name). */
+typedef struct
+{
+    int32_t index;
+    uint32_t flags;
+    int32_t registerCount;
+    int32_t exceptionRegisterCount;
+    int32_t backtraceLength;
+    uint32_t nameLength;
+    uint32_t queueNameLength;
+    uint32_t reserved;
+} CaptureThread;
+
+/** Followed by the stack contents. */
+typedef struct
+{
+    uint64_t stackPointer;
+    uint64_t dumpStart;
+    uint64_t dumpEnd;
+    int32_t growDirection;
+    int32_t isOverflow;
+} CaptureStack;
+
+/** Followed by the stacks and the address pool. */
+typedef struct
+{
+    double duration;
+    double sampleInterval;
+    int32_t sampleCount;
+    int32_t droppedSampleCount;
+    int32_t isInProgress;
+    int32_t stackCount;
+    int32_t addressCount;
+    int32_t reserved;
+} CaptureHangProfile;
+
+/** Followed by the null terminated exception name. */
+typedef struct
+{
+    int32_t rateLimitedCount;
+    int32_t sampledOutCount;
+} CaptureSuppressedSnapshots;
+
+static inline uint32_t paddedLength(uint32_t length)
+{
+    return (length + 7) & ~7u;
+}
+
+
+// ============================================================================
+#pragma mark - Writing -
+// ============================================================================
+
+static void writeBytes(GIOMonitorCrashBufferedWriter* const writer, const void* const data, const uint32_t length)
+{
+    if(length > 0)
+    {
+        gioMonitorCrashFileUtils_writeBufferedWriter(writer, data, (int)length);
+    }
+}
+
+static void beginRecord(GIOMonitorCrashBufferedWriter* const writer, const uint32_t tag, const uint32_t length)
+{
+    RecordHeader header = {tag, length};
+    writeBytes(writer, &header, sizeof(header));
+}
+
+static void endRecord(GIOMonitorCrashBufferedWriter* const writer, const uint32_t length)
+{
+    static const uint8_t padding[8] = {0};
+    writeBytes(writer, padding, paddedLength(length) - length);
+}
+
+static void writeRecord(GIOMonitorCrashBufferedWriter* const writer, const uint32_t tag, const void* const data, const uint32_t length)
+{
+    beginRecord(writer, tag, length);
+    writeBytes(writer, data, length);
+    endRecord(writer, length);
+}
+
+static void writeString(GIOMonitorCrashBufferedWriter* const writer, const uint32_t stringID, const char* const string, const uint32_t length)
+{
+    if(string == NULL)
+    {
+        return;
+    }
+    CaptureString header = {stringID, length};
+    uint32_t recordLength = (uint32_t)sizeof(header) + length + 1;
+    beginRecord(writer, kTag_String, recordLength);
+    writeBytes(writer, &header, sizeof(header));
+    writeBytes(writer, string, length);
+    writeBytes(writer, "", 1);
+    endRecord(writer, recordLength);
+}
+
+static void writeContext(GIOMonitorCrashBufferedWriter* const writer, const GIOMonitorCrash_MonitorContext* const crash)
+{
+    CaptureContext context;
+    memset(&context, 0, sizeof(context));
+    context.crashType = crash->crashType;
+    context.flags = (crash->registersAreValid ? kContextFlag_RegistersAreValid : 0)
+                  | (crash->isStackOverflow ? kContextFlag_IsStackOverflow : 0)
+                  | (crash->crashedDuringCrashHandling ? kContextFlag_CrashedDuringCrashHandling : 0)
+                  | (crash->currentSnapshotUserReported ? kContextFlag_CurrentSnapshotUserReported : 0)
+                  | (crash->System.isJailbroken ? kContextFlag_IsJailbroken : 0)
+                  | (crash->AppState.applicationIsActive ? kContextFlag_ApplicationIsActive : 0)
+                  | (crash->AppState.applicationIsInForeground ? kContextFlag_ApplicationIsInForeground : 0)
+                  | (crash->AppState.crashedLastLaunch ? kContextFlag_CrashedLastLaunch : 0)
+                  | (crash->AppState.crashedThisLaunch ? kContextFlag_CrashedThisLaunch : 0)
+                  | (crash->threadsNotSuspended ? kContextFlag_ThreadsNotSuspended : 0);
+    context.faultAddress = crash->faultAddress;
+    context.machType = crash->mach.type;
+    context.machCode = crash->mach.code;
+    context.machSubcode = crash->mach.subcode;
+    context.signum = crash->signal.signum;
+    context.sigcode = crash->signal.sigcode;
+    context.zombieExceptionAddress = crash->ZombieException.address;
+
+    context.cpuType = crash->System.cpuType;
+    context.cpuSubType = crash->System.cpuSubType;
+    context.binaryCPUType = crash->System.binaryCPUType;
+    context.binaryCPUSubType = crash->System.binaryCPUSubType;
+    context.processID = crash->System.processID;
+    context.parentProcessID = crash->System.parentProcessID;
+    context.storageSize = crash->System.storageSize;
+    context.memorySize = crash->System.memorySize;
+    context.freeMemory = crash->System.freeMemory;
+    context.usableMemory = crash->System.usableMemory;
+
+    context.activeDurationSinceLastCrash = crash->AppState.activeDurationSinceLastCrash;
+    context.backgroundDurationSinceLastCrash = crash->AppState.backgroundDurationSinceLastCrash;
+    context.activeDurationSinceLaunch = crash->AppState.activeDurationSinceLaunch;
+    context.backgroundDurationSinceLaunch = crash->AppState.backgroundDurationSinceLaunch;
+    context.appStateTransitionTime = crash->AppState.appStateTransitionTime;
+    context.launchesSinceLastCrash = crash->AppState.launchesSinceLastCrash;
+    context.sessionsSinceLastCrash = crash->AppState.sessionsSinceLastCrash;
+    context.sessionsSinceLaunch = crash->AppState.sessionsSinceLaunch;
+
+    writeRecord(writer, kTag_Context, &context, sizeof(context));
+
+    for(int i = 0; i < g_contextStringCount; i++)
+    {
+        const char* string = *(const char* const*)((const char*)crash + g_contextStrings[i]);
+        if(string != NULL)
+        {
+            writeString(writer, (uint32_t)i, string, (uint32_t)strlen(string));
+        }
+    }
+}
+
+static void writeImages(GIOMonitorCrashBufferedWriter* const writer)
+{
+    const int imageCount = gioMonitorCrashDynamicLinker_imageCount();
+    for(int i = 0; i < imageCount; i++)
+    {
+        GIOMonitorCrashBinaryImage image = {0};
+        if(!gioMonitorCrashDynamicLinker_getBinaryImage(i, &image))
+        {
+            continue;
+        }
+        CaptureImage record;
+        memset(&record, 0, sizeof(record));
+        record.address = image.address;
+        record.vmAddress = image.vmAddress;
+        record.size = image.size;
+        record.majorVersion = image.majorVersion;
+        record.minorVersion = image.minorVersion;
+        record.revisionVersion = image.revisionVersion;
+        record.cpuType = image.cpuType;
+        record.cpuSubType = image.cpuSubType;
+        if(image.uuid != NULL)
+        {
+            memcpy(record.uuid, image.uuid, sizeof(record.uuid));
+        }
+        record.nameLength = image.name == NULL ? 0 : (uint32_t)strlen(image.name) + 1;
+
+        uint32_t recordLength = (uint32_t)sizeof(record) + record.nameLength;
+        beginRecord(writer, kTag_Image, recordLength);
+        writeBytes(writer, &record, sizeof(record));
+        writeBytes(writer, image.name, record.nameLength);
+        endRecord(writer, recordLength);
+    }
+}
+
+static void writeStack(GIOMonitorCrashBufferedWriter* const writer,
+                       const struct GIOMonitorCrashMachineContext* const machineContext,
+                       const bool isStackOverflow)
+{
+    uintptr_t sp = gioMonitorCrashCpu_stackPointer(machineContext);
+    if((void*)sp == NULL)
+    {
+        return;
+    }
+
+    uintptr_t lowAddress = sp + (uintptr_t)(kStackContentsPushedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection() * -1);
+    uintptr_t highAddress = sp + (uintptr_t)(kStackContentsPoppedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection());
+    if(highAddress < lowAddress)
+    {
+        uintptr_t tmp = lowAddress;
+        lowAddress = highAddress;
+        highAddress = tmp;
+    }
+    static uint8_t stackBuffer[kStackContentsTotalDistance * sizeof(uintptr_t)];
+    uint32_t copyLength = (uint32_t)(highAddress - lowAddress);
+    if(!gioMonitorCrashMem_copySafely((void*)lowAddress, stackBuffer, (int)copyLength))
+    {
+        copyLength = 0;
+    }
+
+    CaptureStack record;
+    memset(&record, 0, sizeof(record));
+    record.stackPointer = sp;
+    record.dumpStart = lowAddress;
+    record.dumpEnd = highAddress;
+    record.growDirection = gioMonitorCrashCpu_stackGrowDirection();
+    record.isOverflow = isStackOverflow;
+
+    uint32_t recordLength = (uint32_t)sizeof(record) + copyLength;
+    beginRecord(writer, kTag_Stack, recordLength);
+    writeBytes(writer, &record, sizeof(record));
+    writeBytes(writer, stackBuffer, copyLength);
+    endRecord(writer, recordLength);
+}
+
+static void writeThread(GIOMonitorCrashBufferedWriter* const writer,
+                        const GIOMonitorCrash_MonitorContext* const crash,
+                        const struct GIOMonitorCrashMachineContext* const machineContext,
+                        const int threadIndex)
+{
+    // Static, so that the crashed thread's stack isn't used up.
+    static uint64_t registers[kMaxRegisters];
+    static uint64_t exceptionRegisters[kMaxRegisters];
+    static uintptr_t backtrace[kMaxBacktraceLength];
+
+    GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadFromContext(machineContext);
+    bool isCrashedThread = gioMonitorCrashMachineContext_isCrashedContext(machineContext);
+
+    CaptureThread record;
+    memset(&record, 0, sizeof(record));
+    record.index = threadIndex;
+    if(isCrashedThread)
+    {
+        record.flags |= kThreadFlag_Crashed;
+    }
+    // Taken from the crashed context, since this may run on the handler thread.
+    if(isCrashedThread && gioMonitorCrashMachineContext_isCurrentThread(machineContext))
+    {
+        record.flags |= kThreadFlag_CurrentThread;
+    }
+
+    GIOMonitorCrashStackCursor stackCursor;
+    if(thread == gioMonitorCrashMachineContext_getThreadFromContext(crash->offendingMachineContext))
+    {
+        stackCursor = *((GIOMonitorCrashStackCursor*)crash->stackCursor);
+    }
+    else
+    {
+        gioMonitorCrashStackCursor_initWithMachineContext(&stackCursor, GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD, machineContext);
+    }
+    while(record.backtraceLength < kMaxBacktraceLength && stackCursor.advanceCursor(&stackCursor))
+    {
+        backtrace[record.backtraceLength++] = stackCursor.stackEntry.address;
+    }
+    if(stackCursor.state.hasGivenUp)
+    {
+        record.flags |= kThreadFlag_GaveUp;
+    }
+
+    if(gioMonitorCrashMachineContext_canHaveCPUState(machineContext))
+    {
+        record.flags |= kThreadFlag_HasRegisters;
+        int count = gioMonitorCrashCpu_numRegisters();
+        record.registerCount = count < kMaxRegisters ? count : kMaxRegisters;
+        for(int reg = 0; reg < record.registerCount; reg++)
+        {
+            registers[reg] = gioMonitorCrashCpu_registerValue(machineContext, reg);
+        }
+        if(gioMonitorCrashMachineContext_hasValidExceptionRegisters(machineContext))
+        {
+            record.flags |= kThreadFlag_HasExceptionRegisters;
+            count = gioMonitorCrashCpu_numExceptionRegisters();
+            record.exceptionRegisterCount = count < kMaxRegisters ? count : kMaxRegisters;
+            for(int reg = 0; reg < record.exceptionRegisterCount; reg++)
+            {
+                exceptionRegisters[reg] = gioMonitorCrashCpu_exceptionRegisterValue(machineContext, reg);
+            }
+        }
+    }
+
+    const char* name = gioMonitorCCD_getThreadName(thread);
+    const char* queueName = gioMonitorCCD_getQueueName(thread);
+    record.nameLength = name == NULL ? 0 : (uint32_t)strlen(name) + 1;
+    record.queueNameLength = queueName == NULL ? 0 : (uint32_t)strlen(queueName) + 1;
+
+    uint32_t registersLength = (uint32_t)sizeof(uint64_t) * (uint32_t)record.registerCount;
+    uint32_t exceptionRegistersLength = (uint32_t)sizeof(uint64_t) * (uint32_t)record.exceptionRegisterCount;
+    uint32_t backtraceLength = (uint32_t)sizeof(uintptr_t) * (uint32_t)record.backtraceLength;
+    uint32_t recordLength = (uint32_t)sizeof(record) + registersLength + exceptionRegistersLength + backtraceLength
+                          + record.nameLength + record.queueNameLength;
+    beginRecord(writer, kTag_Thread, recordLength);
+    writeBytes(writer, &record, sizeof(record));
+    writeBytes(writer, registers, registersLength);
+    writeBytes(writer, exceptionRegisters, exceptionRegistersLength);
+    writeBytes(writer, backtrace, backtraceLength);
+    writeBytes(writer, name, record.nameLength);
+    writeBytes(writer, queueName, record.queueNameLength);
+    endRecord(writer, recordLength);
+
+    if(isCrashedThread)
+    {
+        writeStack(writer, machineContext, stackCursor.state.hasGivenUp);
+    }
+}
+
+static void writeAllThreads(GIOMonitorCrashBufferedWriter* const writer, const GIOMonitorCrash_MonitorContext* const crash)
+{
+    const struct GIOMonitorCrashMachineContext* const context = crash->offendingMachineContext;
+    GIOMonitorCrashThread offendingThread = gioMonitorCrashMachineContext_getThreadFromContext(context);
+    int threadCount = gioMonitorCrashMachineContext_getThreadCount(context);
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+
+    // The crashed thread goes first, in case walking another stack crashes.
+    writeThread(writer, crash, context, gioMonitorCrashMachineContext_indexOfThread(context, offendingThread));
+    gioMonitorCrashFileUtils_flushBufferedWriter(writer);
+
+    for(int i = 0; i < threadCount; i++)
+    {
+        GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadAtIndex(context, i);
+        if(thread != offendingThread)
+        {
+            gioMonitorCrashMachineContext_getContextForThread(thread, machineContext, false);
+            writeThread(writer, crash, machineContext, i);
+        }
+    }
+}
+
+static void writeHangProfile(GIOMonitorCrashBufferedWriter* const writer)
+{
+    const GIOMonitorCrashHangProfile* profile = gioMonitorCrashHangProfile_get();
+    if(profile == NULL)
+    {
+        return;
+    }
+
+    CaptureHangProfile record;
+    memset(&record, 0, sizeof(record));
+    record.duration = profile->duration;
+    record.sampleInterval = profile->sampleInterval;
+    record.sampleCount = profile->sampleCount;
+    record.droppedSampleCount = profile->droppedSampleCount;
+    record.isInProgress = profile->isInProgress;
+    record.stackCount = profile->stackCount;
+    record.addressCount = profile->addressCount;
+
+    uint32_t stacksLength = (uint32_t)sizeof(*profile->stacks) * (uint32_t)record.stackCount;
+    uint32_t addressesLength = (uint32_t)sizeof(*profile->addresses) * (uint32_t)record.addressCount;
+    uint32_t recordLength = (uint32_t)sizeof(record) + stacksLength + addressesLength;
+    beginRecord(writer, kTag_HangProfile, recordLength);
+    writeBytes(writer, &record, sizeof(record));
+    writeBytes(writer, profile->stacks, stacksLength);
+    writeBytes(writer, profile->addresses, addressesLength);
+    endRecord(writer, recordLength);
+}
+
+static void writeSuppressedSnapshotCounts(const char* name, int rateLimitedCount, int sampledOutCount, void* userData)
+{
+    GIOMonitorCrashBufferedWriter* const writer = userData;
+    CaptureSuppressedSnapshots record = {rateLimitedCount, sampledOutCount};
+    uint32_t nameLength = (uint32_t)strlen(name);
+    uint32_t recordLength = (uint32_t)sizeof(record) + nameLength + 1;
+    beginRecord(writer, kTag_SuppressedSnapshots, recordLength);
+    writeBytes(writer, &record, sizeof(record));
+    writeBytes(writer, name, nameLength + 1);
+    endRecord(writer, recordLength);
+}
+
+bool gioMonitorCrashRawCapture_write(const GIOMonitorCrash_MonitorContext* const monitorContext,
+                                     const char* const userInfoJSON,
+                                     const char* const path)
+{
+    GIOMonitorCrashLOG_INFO("Writing raw crash capture to %s", path);
+    char localWriteBuffer[1024];
+    char* writeBuffer = gioMonitorCrashArena_allocate(kArenaWriteBufferSize);
+    int writeBufferLength = kArenaWriteBufferSize;
+    if(writeBuffer == NULL)
+    {
+        writeBuffer = localWriteBuffer;
+        writeBufferLength = sizeof(localWriteBuffer);
+    }
+    GIOMonitorCrashBufferedWriter writer;
+
+    if(!gioMonitorCrashFileUtils_openBufferedWriter(&writer, path, writeBuffer, writeBufferLength))
+    {
+        return false;
+    }
+
+    gioMonitorCCD_freeze();
+
+    CaptureHeader header = {kMagic, kFormatVersion, sizeof(uintptr_t), 0, (int64_t)time(NULL)};
+    writeRecord(&writer, kTag_Header, &header, sizeof(header));
+    writeContext(&writer, monitorContext);
+    if(userInfoJSON != NULL)
+    {
+        writeString(&writer, kStringID_UserInfoJSON, userInfoJSON, (uint32_t)strlen(userInfoJSON));
+    }
+    gioMonitorCrashFileUtils_flushBufferedWriter(&writer);
+
+    writeImages(&writer);
+    gioMonitorCrashFileUtils_flushBufferedWriter(&writer);
+
+    writeAllThreads(&writer, monitorContext);
+    gioMonitorCrashFileUtils_flushBufferedWriter(&writer);
+
+    writeHangProfile(&writer);
+    gioMonitorCrashSnapshotLimiter_peekSuppressedCounts(writeSuppressedSnapshotCounts, &writer);
+    if(monitorContext->consoleLogPath != NULL)
+    {
+        // Without a circular log, the formatter reads the log file itself.
+        gioMonitorCrashLog_flushRingBuffer();
+        int logLength = 0;
+        const char* log = gioMonitorCrashLog_getLogTail(&logLength);
+        if(log != NULL)
+        {
+            writeString(&writer, kStringID_ConsoleLog, log, (uint32_t)logLength);
+        }
+    }
+    writeRecord(&writer, kTag_End, NULL, 0);
+
+    gioMonitorCrashFileUtils_closeBufferedWriter(&writer);
+    gioMonitorCCD_unfreeze();
+    return true;
+}
+
+
+// ============================================================================
+#pragma mark - Reading -
+// ============================================================================
+
+/** Get the next complete record.
+ *
+ * @param data The file contents.
+ *
+ * @param length The length of the file contents.
+ *
+ * @param offset The offset of the record. Advanced to the next record.
+ *
+ * @param payload Receives the record's payload.
+ *
+ * @return The record header, or NULL if there are no more complete records.
+ */
+static const RecordHeader* nextRecord(const char* const data, const int length, int* const offset, const char** const payload)
+{
+    if(*offset < 0 || length - *offset < (int)sizeof(RecordHeader))
+    {
+        return NULL;
+    }
+    const RecordHeader* header = (const RecordHeader*)(data + *offset);
+    if(header->length > (uint32_t)(length - *offset - (int)sizeof(RecordHeader)))
+    {
+        return NULL;
+    }
+    *payload = data + *offset + sizeof(RecordHeader);
+    int64_t next = (int64_t)*offset + (int64_t)sizeof(RecordHeader) + paddedLength(header->length);
+    *offset = next > length ? length : (int)next;
+    return header;
+}
+
+static int compareThreadIndices(const void* a, const void* b)
+{
+    return ((const GIOMonitorCrashRawThread*)a)->index - ((const GIOMonitorCrashRawThread*)b)->index;
+}
+
+static bool readString(GIOMonitorCrashRawCapture* const capture, const char* const payload, const uint32_t length)
+{
+    CaptureString header;
+    if(length < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, payload, sizeof(header));
+    if((uint64_t)sizeof(header) + header.length + 1 > length || payload[sizeof(header) + header.length] != '\0')
+    {
+        return false;
+    }
+    const char* string = payload + sizeof(header);
+    if(header.stringID < (uint32_t)g_contextStringCount)
+    {
+        *(const char**)((char*)&capture->context + g_contextStrings[header.stringID]) = string;
+    }
+    else if(header.stringID == kStringID_UserInfoJSON)
+    {
+        capture->userInfoJSON = string;
+    }
+    else if(header.stringID == kStringID_ConsoleLog)
+    {
+        capture->consoleLog = string;
+        capture->consoleLogLength = (int)header.length;
+    }
+    return true;
+}
+
+static void readContext(GIOMonitorCrashRawCapture* const capture, const CaptureContext* const context)
+{
+    GIOMonitorCrash_MonitorContext* crash = &capture->context;
+    crash->handlingCrash = true;
+    crash->crashType = (GIOMonitorCrashMonitorType)context->crashType;
+    crash->registersAreValid = (context->flags & kContextFlag_RegistersAreValid) != 0;
+    crash->isStackOverflow = (context->flags & kContextFlag_IsStackOverflow) != 0;
+    crash->crashedDuringCrashHandling = (context->flags & kContextFlag_CrashedDuringCrashHandling) != 0;
+    crash->currentSnapshotUserReported = (context->flags & kContextFlag_CurrentSnapshotUserReported) != 0;
+    crash->threadsNotSuspended = (context->flags & kContextFlag_ThreadsNotSuspended) != 0;
+    crash->faultAddress = (uintptr_t)context->faultAddress;
+    crash->mach.type = (int)context->machType;
+    crash->mach.code = context->machCode;
+    crash->mach.subcode = context->machSubcode;
+    crash->signal.signum = (int)context->signum;
+    crash->signal.sigcode = (int)context->sigcode;
+    crash->ZombieException.address = (uintptr_t)context->zombieExceptionAddress;
+
+    crash->System.isJailbroken = (context->flags & kContextFlag_IsJailbroken) != 0;
+    crash->System.cpuType = (int)context->cpuType;
+    crash->System.cpuSubType = (int)context->cpuSubType;
+    crash->System.binaryCPUType = (int)context->binaryCPUType;
+    crash->System.binaryCPUSubType = (int)context->binaryCPUSubType;
+    crash->System.processID = (int)context->processID;
+    crash->System.parentProcessID = (int)context->parentProcessID;
+    crash->System.storageSize = context->storageSize;
+    crash->System.memorySize = context->memorySize;
+    crash->System.freeMemory = context->freeMemory;
+    crash->System.usableMemory = context->usableMemory;
+
+    crash->AppState.applicationIsActive = (context->flags & kContextFlag_ApplicationIsActive) != 0;
+    crash->AppState.applicationIsInForeground = (context->flags & kContextFlag_ApplicationIsInForeground) != 0;
+    crash->AppState.crashedLastLaunch = (context->flags & kContextFlag_CrashedLastLaunch) != 0;
+    crash->AppState.crashedThisLaunch = (context->flags & kContextFlag_CrashedThisLaunch) != 0;
+    crash->AppState.activeDurationSinceLastCrash = context->activeDurationSinceLastCrash;
+    crash->AppState.backgroundDurationSinceLastCrash = context->backgroundDurationSinceLastCrash;
+    crash->AppState.activeDurationSinceLaunch = context->activeDurationSinceLaunch;
+    crash->AppState.backgroundDurationSinceLaunch = context->backgroundDurationSinceLaunch;
+    crash->AppState.appStateTransitionTime = context->appStateTransitionTime;
+    crash->AppState.launchesSinceLastCrash = (int)context->launchesSinceLastCrash;
+    crash->AppState.sessionsSinceLastCrash = (int)context->sessionsSinceLastCrash;
+    crash->AppState.sessionsSinceLaunch = (int)context->sessionsSinceLaunch;
+}
+
+static bool readImage(GIOMonitorCrashRawImage* const image, const char* const payload, const uint32_t length)
+{
+    CaptureImage record;
+    if(length < sizeof(record))
+    {
+        return false;
+    }
+    memcpy(&record, payload, sizeof(record));
+    const char* name = payload + sizeof(record);
+    if((uint64_t)sizeof(record) + record.nameLength > length || (record.nameLength > 0 && name[record.nameLength - 1] != '\0'))
+    {
+        return false;
+    }
+    image->address = record.address;
+    image->vmAddress = record.vmAddress;
+    image->size = record.size;
+    image->name = record.nameLength > 0 ? name : NULL;
+    memcpy(image->uuid, record.uuid, sizeof(image->uuid));
+    image->cpuType = record.cpuType;
+    image->cpuSubType = record.cpuSubType;
+    image->majorVersion = record.majorVersion;
+    image->minorVersion = record.minorVersion;
+    image->revisionVersion = record.revisionVersion;
+    return true;
+}
+
+static bool readThread(GIOMonitorCrashRawThread* const thread, const char* const payload, const uint32_t length)
+{
+    CaptureThread record;
+    if(length < sizeof(record))
+    {
+        return false;
+    }
+    memcpy(&record, payload, sizeof(record));
+    if(record.registerCount < 0 || record.registerCount > kMaxRegisters ||
+       record.exceptionRegisterCount < 0 || record.exceptionRegisterCount > kMaxRegisters ||
+       record.backtraceLength < 0 || record.backtraceLength > kMaxBacktraceLength)
+    {
+        return false;
+    }
+    const char* registers = payload + sizeof(record);
+    const char* exceptionRegisters = registers + sizeof(uint64_t) * (size_t)record.registerCount;
+    const char* backtrace = exceptionRegisters + sizeof(uint64_t) * (size_t)record.exceptionRegisterCount;
+    const char* name = backtrace + sizeof(uintptr_t) * (size_t)record.backtraceLength;
+    const char* queueName = name + record.nameLength;
+    const char* end = queueName + record.queueNameLength;
+    if(end > payload + length ||
+       (record.nameLength > 0 && name[record.nameLength - 1] != '\0') ||
+       (record.queueNameLength > 0 && queueName[record.queueNameLength - 1] != '\0'))
+    {
+        return false;
+    }
+    thread->index = record.index;
+    thread->isCrashed = (record.flags & kThreadFlag_Crashed) != 0;
+    thread->isCurrentThread = (record.flags & kThreadFlag_CurrentThread) != 0;
+    thread->hasGivenUp = (record.flags & kThreadFlag_GaveUp) != 0;
+    thread->registers = (record.flags & kThreadFlag_HasRegisters) ? (const uint64_t*)registers : NULL;
+    thread->registerCount = record.registerCount;
+    thread->exceptionRegisters = (record.flags & kThreadFlag_HasExceptionRegisters) ? (const uint64_t*)exceptionRegisters : NULL;
+    thread->exceptionRegisterCount = record.exceptionRegisterCount;
+    thread->backtrace = (const uintptr_t*)backtrace;
+    thread->backtraceLength = record.backtraceLength;
+    thread->name = record.nameLength > 0 ? name : NULL;
+    thread->dispatchQueue = record.queueNameLength > 0 ? queueName : NULL;
+    return true;
+}
+
+static bool readStack(GIOMonitorCrashRawCapture* const capture, const char* const payload, const uint32_t length)
+{
+    CaptureStack record;
+    if(length < sizeof(record))
+    {
+        return false;
+    }
+    memcpy(&record, payload, sizeof(record));
+    capture->stack.stackPointer = (uintptr_t)record.stackPointer;
+    capture->stack.dumpStart = (uintptr_t)record.dumpStart;
+    capture->stack.dumpEnd = (uintptr_t)record.dumpEnd;
+    capture->stack.growDirection = record.growDirection;
+    capture->stack.isOverflow = record.isOverflow != 0;
+    capture->stack.contents = (const uint8_t*)payload + sizeof(record);
+    capture->stack.length = (int)(length - sizeof(record));
+    return true;
+}
+
+static bool readHangProfile(GIOMonitorCrashRawCapture* const capture, const char* const payload, const uint32_t length)
+{
+    CaptureHangProfile record;
+    if(length < sizeof(record))
+    {
+        return false;
+    }
+    memcpy(&record, payload, sizeof(record));
+    if(record.stackCount < 0 || record.stackCount > GIOMonitorCrashHP_MAX_STACKS ||
+       record.addressCount < 0 || record.addressCount > GIOMonitorCrashHP_MAX_ADDRESSES)
+    {
+        return false;
+    }
+    GIOMonitorCrashHangProfile* profile = calloc(1, sizeof(*profile));
+    if(profile == NULL)
+    {
+        return false;
+    }
+    size_t stacksLength = sizeof(*profile->stacks) * (size_t)record.stackCount;
+    size_t addressesLength = sizeof(*profile->addresses) * (size_t)record.addressCount;
+    if(sizeof(record) + stacksLength + addressesLength > length)
+    {
+        free(profile);
+        return false;
+    }
+    profile->duration = record.duration;
+    profile->sampleInterval = record.sampleInterval;
+    profile->sampleCount = record.sampleCount;
+    profile->droppedSampleCount = record.droppedSampleCount;
+    profile->isInProgress = record.isInProgress != 0;
+    profile->stackCount = record.stackCount;
+    profile->addressCount = record.addressCount;
+    memcpy(profile->stacks, payload + sizeof(record), stacksLength);
+    memcpy(profile->addresses, payload + sizeof(record) + stacksLength, addressesLength);
+    for(int i = 0; i < profile->stackCount; i++)
+    {
+        const GIOMonitorCrashHangStack* stack = &profile->stacks[i];
+        if(stack->firstAddress < 0 || stack->length < 0 || stack->firstAddress > profile->addressCount - stack->length)
+        {
+            free(profile);
+            return false;
+        }
+    }
+    free(capture->hangProfile);
+    capture->hangProfile = profile;
+    return true;
+}
+
+static bool readSuppressedSnapshots(GIOMonitorCrashRawSuppressedSnapshots* const snapshots,
+                                    const char* const payload,
+                                    const uint32_t length)
+{
+    CaptureSuppressedSnapshots record;
+    if(length <= sizeof(record) || payload[length - 1] != '\0')
+    {
+        return false;
+    }
+    memcpy(&record, payload, sizeof(record));
+    snapshots->name = payload + sizeof(record);
+    snapshots->rateLimitedCount = record.rateLimitedCount;
+    snapshots->sampledOutCount = record.sampledOutCount;
+    return true;
+}
+
+bool gioMonitorCrashRawCapture_read(const char* const path, GIOMonitorCrashRawCapture* const capture)
+{
+    memset(capture, 0, sizeof(*capture));
+    int length = 0;
+    if(!gioMonitorCrashFileUtils_readEntireFile(path, &capture->data, &length, 0))
+    {
+        return false;
+    }
+    const char* data = capture->data;
+    const char* payload;
+    const RecordHeader* record;
+    int offset = 0;
+
+    record = nextRecord(data, length, &offset, &payload);
+    CaptureHeader header;
+    if(record == NULL || record->tag != kTag_Header || record->length < sizeof(header))
+    {
+        GIOMonitorCrashLOG_ERROR("%s is not a raw crash capture", path);
+        goto failed;
+    }
+    memcpy(&header, payload, sizeof(header));
+    if(header.magic != kMagic || header.version != kFormatVersion || header.pointerSize != sizeof(uintptr_t))
+    {
+        GIOMonitorCrashLOG_ERROR("%s: unsupported raw crash capture (version %u, pointer size %u)", path, header.version, header.pointerSize);
+        goto failed;
+    }
+    capture->timestamp = header.timestamp;
+    const int firstRecordOffset = offset;
+
+    // Count the variable length parts.
+    int threadCount = 0;
+    int imageCount = 0;
+    int suppressedSnapshotsCount = 0;
+    while((record = nextRecord(data, length, &offset, &payload)) != NULL)
+    {
+        threadCount += record->tag == kTag_Thread;
+        imageCount += record->tag == kTag_Image;
+        suppressedSnapshotsCount += record->tag == kTag_SuppressedSnapshots;
+    }
+    capture->threads = calloc((size_t)threadCount + 1, sizeof(*capture->threads));
+    capture->images = calloc((size_t)imageCount + 1, sizeof(*capture->images));
+    capture->suppressedSnapshots = calloc((size_t)suppressedSnapshotsCount + 1, sizeof(*capture->suppressedSnapshots));
+    if(capture->threads == NULL || capture->images == NULL || capture->suppressedSnapshots == NULL)
+    {
+        GIOMonitorCrashLOG_ERROR("Out of memory");
+        goto failed;
+    }
+
+    bool hasContext = false;
+    capture->isTruncated = true;
+    offset = firstRecordOffset;
+    while((record = nextRecord(data, length, &offset, &payload)) != NULL)
+    {
+        bool isValid = true;
+        switch(record->tag)
+        {
+            case kTag_Context:
+                isValid = record->length >= sizeof(CaptureContext);
+                if(isValid)
+                {
+                    CaptureContext context;
+                    memcpy(&context, payload, sizeof(context));
+                    readContext(capture, &context);
+                    hasContext = true;
+                }
+                break;
+            case kTag_String:
+                isValid = readString(capture, payload, record->length);
+                break;
+            case kTag_Image:
+                isValid = readImage(&capture->images[capture->imageCount], payload, record->length);
+                capture->imageCount += isValid;
+                break;
+            case kTag_Thread:
+                isValid = readThread(&capture->threads[capture->threadCount], payload, record->length);
+                capture->threadCount += isValid;
+                break;
+            case kTag_Stack:
+                isValid = readStack(capture, payload, record->length);
+                break;
+            case kTag_HangProfile:
+                isValid = readHangProfile(capture, payload, record->length);
+                break;
+            case kTag_SuppressedSnapshots:
+                isValid = readSuppressedSnapshots(&capture->suppressedSnapshots[capture->suppressedSnapshotsCount],
+                                                  payload, record->length);
+                capture->suppressedSnapshotsCount += isValid;
+                break;
+            case kTag_End:
+                capture->isTruncated = false;
+                break;
+            default:
+                // Unknown records are skipped.
+                break;
+        }
+        if(!isValid)
+        {
+            GIOMonitorCrashLOG_ERROR("%s: bad record (tag %u) at offset %d", path, record->tag, (int)(payload - data));
+            break;
+        }
+    }
+
+    if(!hasContext)
+    {
+        GIOMonitorCrashLOG_ERROR("%s: raw crash capture has no crash context", path);
+        goto failed;
+    }
+    qsort(capture->threads, (size_t)capture->threadCount, sizeof(*capture->threads), compareThreadIndices);
+    if(capture->isTruncated)
+    {
+        GIOMonitorCrashLOG_INFO("%s: raw crash capture is truncated. Its report will be marked as such.", path);
+    }
+    return true;
+
+failed:
+    gioMonitorCrashRawCapture_free(capture);
+    return false;
+}
+
+void gioMonitorCrashRawCapture_free(GIOMonitorCrashRawCapture* const capture)
+{
+    free(capture->threads);
+    free(capture->images);
+    free(capture->suppressedSnapshots);
+    free(capture->hangProfile);
+    free(capture->data);
+    memset(capture, 0, sizeof(*capture));
+}
@@ -0,0 +1,169 @@
+//
+//  GIOMonitorCrashRawCapture.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Raw crash capture.
+ *
+ * Instead of formatting a JSON report inside the crash handler, the crash
+ * state is dumped as-is into a compact binary file: the crash context, each
+ * thread's registers and unsymbolicated backtrace, the crashed thread's stack
+ * bytes, and the binary image table. On the next launch the capture is read
+ * back and formatted into a standard report, with symbolication that doesn't
+ * need to be async-safe.
+ *
+ * The file is a sequence of records, each an 8 byte header (tag, payload
+ * length) followed by the payload, padded to 8 bytes. A capture cut short
+ * by a second crash can still be read up to its last complete record.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashRawCapture_h
+#define HDR_GIOMonitorCrashRawCapture_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "GIOMonitorCrashMonitorContext.h"
+#include "GIOMonitorCrashHangProfile.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct
+{
+    uint64_t address;
+    uint64_t vmAddress;
+    uint64_t size;
+    const char* name;
+    uint8_t uuid[16];
+    int cpuType;
+    int cpuSubType;
+    uint64_t majorVersion;
+    uint64_t minorVersion;
+    uint64_t revisionVersion;
+} GIOMonitorCrashRawImage;
+
+typedef struct
+{
+    int index;
+    bool isCrashed;
+    bool isCurrentThread;
+    bool hasGivenUp;
+    const char* name;
+    const char* dispatchQueue;
+
+    /** NULL if the thread had no CPU state. */
+    const uint64_t* registers;
+    int registerCount;
+
+    /** NULL if the exception registers weren't valid. */
+    const uint64_t* exceptionRegisters;
+    int exceptionRegisterCount;
+
+    /** Return addresses, innermost first. */
+    const uintptr_t* backtrace;
+    int backtraceLength;
+} GIOMonitorCrashRawThread;
+
+typedef struct
+{
+    const char* name;
+    int rateLimitedCount;
+    int sampledOutCount;
+} GIOMonitorCrashRawSuppressedSnapshots;
+
+typedef struct
+{
+    /** The crash context. String fields point into the capture's data. The
+     * machine context and stack cursor are NULL. */
+    GIOMonitorCrash_MonitorContext context;
+
+    /** When the crash happened (seconds since 1970). */
+    int64_t timestamp;
+
+    /** The user info JSON set at the time of the crash, if any. */
+    const char* userInfoJSON;
+
+    /** The tail of the console log (not null terminated), if any. */
+    const char* consoleLog;
+    int consoleLogLength;
+
+    /** The threads, in index order. */
+    int threadCount;
+    GIOMonitorCrashRawThread* threads;
+
+    int imageCount;
+    GIOMonitorCrashRawImage* images;
+
+    /** The crashed thread's stack around the stack pointer. */
+    struct
+    {
+        uintptr_t stackPointer;
+        uintptr_t dumpStart;
+        uintptr_t dumpEnd;
+        int growDirection;
+        bool isOverflow;
+        const uint8_t* contents;
+        int length;
+    } stack;
+
+    /** The last main thread hang profile, or NULL. */
+    GIOMonitorCrashHangProfile* hangProfile;
+
+    /** User reported snapshots that were suppressed, by exception name. */
+    int suppressedSnapshotsCount;
+    GIOMonitorCrashRawSuppressedSnapshots* suppressedSnapshots;
+
+    /** True if the capture ended before it was complete. */
+    bool isTruncated;
+
+    /** The file contents. */
+    char* data;
+} GIOMonitorCrashRawCapture;
+
+
+/** Dump the crash state to a raw capture file. This is async-safe.
+ *
+ * @param monitorContext Contextual information about the crash.
+ *
+ * @param userInfoJSON The current user info JSON (can be NULL).
+ *
+ * @param path The file to write to.
+ *
+ * @return true if the capture was written.
+ */
+bool gioMonitorCrashRawCapture_write(const GIOMonitorCrash_MonitorContext* const monitorContext,
+                                     const char* const userInfoJSON,
+                                     const char* const path);
+
+/** Read a raw capture file. This allocates memory, so never call it from a
+ * crash handler.
+ *
+ * @param path The file to read.
+ *
+ * @param capture The capture to fill. Free it with gioMonitorCrashRawCapture_free().
+ *
+ * @return true if the file was a raw capture with at least its crash context.
+ */
+bool gioMonitorCrashRawCapture_read(const char* const path, GIOMonitorCrashRawCapture* const capture);
+
+/** Free the memory held by a capture read with gioMonitorCrashRawCapture_read().
+ *
+ * @param capture The capture.
+ */
+void gioMonitorCrashRawCapture_free(GIOMonitorCrashRawCapture* const capture);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashRawCapture_h
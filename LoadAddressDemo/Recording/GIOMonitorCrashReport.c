@@ -29,29 +29,38 @@
 
 #include "GIOMonitorCrashReportFields.h"
 #include "GIOMonitorCrashReportWriter.h"
+#include "GIOMonitorCrashArena.h"
 #include "GIOMonitorCrashDynamicLinker.h"
 #include "GIOMonitorCrashFileUtils.h"
+#include "GIOMonitorCrashHangProfile.h"
 #include "GIOMonitorCrashJSONCodec.h"
 #include "GIOMonitorCrashCPU.h"
 #include "GIOMonitorCrashMemory.h"
 //#include "GIOMonitorCrashMach.h"
 #include "GIOMonitorCrashThread.h"
 #include "GIOMonitorCrashObjC.h"
-//#include "GIOMonitorCrashSignalInfo.h"
+#include "GIOMonitorCrashSignalInfo.h"
 //#include "GIOMonitorCrashMonitor_Zombie.h"
 #include "GIOMonitorCrashString.h"
 //#include "GIOMonitorCrashReportVersion.h"
 #include "GIOMonitorCrashStackCursor_Backtrace.h"
 #include "GIOMonitorCrashStackCursor_MachineContext.h"
+#include "GIOMonitorCrashStackTrie.h"
+#include "GIOMonitorCrashSymbolicator.h"
 #include "GIOMonitorCrashSystemCapabilities.h"
 #include "GIOMonitorCrashCachedData.h"
+#include "GIOMonitorCrashRawCapture.h"
+#include "GIOMonitorCrashSnapshotLimiter.h"
 
 //#define GIOMonitorCrashLogger_LocalLevel TRACE
 #include "GIOMonitorCrashLogger.h"
 //#include "GrowingMonitorFindSubString.h"
 
+#include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <mach/mach_time.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -78,6 +87,24 @@
 /** The minimum length for a valid string. */
 #define kMinStringLength 4
 
+/** How many distinct frames to keep when sharing backtrace suffixes between threads. */
+#define kSharedBacktraceMaxFrames 4096
+
+/** How many of the crashed thread's innermost frames go into the crash fingerprint. */
+#define kFingerprintFrameCount 8
+
+/** How many symbol lookups are cached while formatting a raw capture. */
+#define kRawCaptureSymbolCacheSize 512
+
+/** How many threads have their write time recorded in a report. */
+#define kMaxTimedThreads 256
+
+/** Size of the report file write buffer when it comes from the crash arena. */
+#define kArenaWriteBufferSize (64 * 1024)
+
+/** How many crash types (monitor type bits) can have their own profile. */
+#define kMaxProfileCrashTypes 16
+
 
 // ============================================================================
 #pragma mark - JSON Encoding -
@@ -96,6 +123,23 @@ static const char g_hexNybbles[] =
 #pragma mark - Runtime Config -
 // ============================================================================
 
+typedef struct
+{
+    uint32_t hash;
+    const char* name;
+} GIOMonitorCrash_RestrictedClassEntry;
+
+/** Open addressing hash set of the restricted classes, for lookup by name.
+ * The mask, the entries and the names they point to share one allocation, so
+ * the set is published with a single pointer store.
+ * Its size is a power of two, and always has empty slots.
+ */
+typedef struct
+{
+    uint32_t mask;
+    GIOMonitorCrash_RestrictedClassEntry entries[];
+} GIOMonitorCrash_RestrictedClassSet;
+
 typedef struct
 {
     /** If YES, introspect memory contents during a crash.
@@ -105,15 +149,124 @@ typedef struct
      */
     bool enabled;
 
-    /** List of classes that should never be introspected.
-     * Whenever a class in this list is encountered, only the class name will be recorded.
+    /** Classes that should never be introspected.
+     * Whenever a class in this set is encountered, only the class name will be recorded.
+     * Replaced sets are never freed, since a crash on another thread may still be reading them.
      */
-    const char** restrictedClasses;
-    int restrictedClassesCount;
+    GIOMonitorCrash_RestrictedClassSet* restrictedClassSet;
 } GIOMonitorCrash_IntrospectionRules;
 
+typedef struct
+{
+    /** If true, frames that end more than one thread's backtrace are written
+     * once to a shared frames table and referenced by index.
+     */
+    bool enabled;
+
+    /** True while writing the threads of a report that uses the shared table. */
+    bool active;
+
+    /** All thread backtraces of the report being written. */
+    GIOMonitorCrashStackTrie trie;
+
+    /** Innermost trie node of each thread's backtrace, or -1 to write it in full. */
+    int* threadLeaves;
+
+    /** Whether walking each thread's stack gave up (stack overflow). */
+    bool* threadGaveUp;
+
+    /** How many threads can have their backtrace suffixes shared. Sized from
+     * the max thread count, so any others are only left out of the report.
+     */
+    int maxThreads;
+
+    /** Scratch space for a single backtrace. */
+    uintptr_t backtrace[GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD];
+} GIOMonitorCrash_SharedBacktraces;
+
+typedef struct
+{
+    /** FNV-1a hash of the exception type and the frames added so far. */
+    uint64_t hash;
+
+    /** How many more frames to add while the crashed thread is being written. */
+    int framesLeft;
+
+    /** How many frames were added. */
+    int frameCount;
+} GIOMonitorCrash_Fingerprint;
+
+typedef struct
+{
+    /** The captured address, or 0 if the slot is unused. */
+    uintptr_t address;
+    const char* symbolName;
+    uintptr_t symbolAddress;
+} GIOMonitorCrash_RawCaptureSymbol;
+
+typedef struct
+{
+    /** The capture being formatted, or NULL. Its addresses belong to a
+     * process that no longer exists, so its memory can't be introspected.
+     */
+    const GIOMonitorCrashRawCapture* capture;
+
+    /** Where each captured image is loaded in this process, or 0 if it isn't. */
+    uintptr_t* loadAddresses;
+
+    /** Symbols already looked up, by captured address. Threads share most of
+     * their outer frames, so this saves most of the dladdr calls.
+     */
+    GIOMonitorCrash_RawCaptureSymbol symbolCache[kRawCaptureSymbolCacheSize];
+} GIOMonitorCrash_RawCaptureFormatting;
+
+/** Low priority parts of a report, dropped once it is over its write budget. */
+typedef enum
+{
+    GIOMonitorCrash_DroppedSection_Registers,
+    GIOMonitorCrash_DroppedSection_StackContents,
+    GIOMonitorCrash_DroppedSection_NotableAddresses,
+    GIOMonitorCrash_DroppedSection_ConsoleLog,
+    GIOMonitorCrash_DroppedSectionCount,
+} GIOMonitorCrash_DroppedSection;
+
+typedef struct
+{
+    /** Time allowed for writing a standard report, in seconds (0 = no limit). */
+    double timeLimit;
+
+    /** Bytes allowed in a standard report (0 = no limit). */
+    int sizeLimit;
+
+    /** True while writing a standard report. */
+    bool active;
+
+    /** Monotonic time at which the time limit is reached, or 0. */
+    uint64_t deadline;
+
+    /** Bytes written to the report so far. */
+    int bytesWritten;
+
+    /** The limit that was exceeded, or NULL if the report is within budget. */
+    const char* exceededLimit;
+
+    /** How many of each low priority section were left out. */
+    int droppedCounts[GIOMonitorCrash_DroppedSectionCount];
+} GIOMonitorCrash_WriteBudget;
+
 static const char* g_userInfoJSON;
 static GIOMonitorCrash_IntrospectionRules g_introspectionRules;
+static GIOMonitorCrash_SharedBacktraces g_sharedBacktraces;
+static GIOMonitorCrash_Fingerprint g_fingerprint;
+static uint64_t g_lastFingerprint;
+static GIOMonitorCrash_RawCaptureFormatting g_rawCaptureFormatting;
+
+/** Stack contents are copied here, one thread at a time. Taken from the crash
+ * arena the first time a report needs it, or NULL.
+ */
+static uint8_t* g_stackContentsBuffer;
+static GIOMonitorCrash_WriteBudget g_writeBudget;
+static GIOMonitorCrashReportProfile g_crashTypeProfiles[kMaxProfileCrashTypes];
 static GIOMonitorCrashReportWriteCallback g_userSectionWriteCallback;
 
 
@@ -326,13 +479,52 @@ static void addTextLinesFromFile(const GIOMonitorCrashReportWriter* const writer
     gioMonitorCrashFileUtils_closeBufferedReader(&reader);
 }
 
+static void addTextLinesFromBuffer(const GIOMonitorCrashReportWriter* const writer,
+                                   const char* const key,
+                                   const char* const text,
+                                   const int textLength)
+{
+    const char* const end = text + textLength;
+    beginArray(writer, key);
+    {
+        for(const char* line = text; line < end;)
+        {
+            const char* newline = memchr(line, '\n', (size_t)(end - line));
+            const char* lineEnd = newline == NULL ? end : newline;
+            gioMonitorCrashJSON_addStringElement(getJsonContext(writer), NULL, line, (int)(lineEnd - line));
+            line = lineEnd + 1;
+        }
+    }
+    endContainer(writer);
+}
+
 static int addJSONData(const char* restrict const data, const int length, void* restrict userData)
 {
     GIOMonitorCrashBufferedWriter* writer = (GIOMonitorCrashBufferedWriter*)userData;
+    g_writeBudget.bytesWritten += length;
     const bool success = gioMonitorCrashFileUtils_writeBufferedWriter(writer, data, length);
     return success ? GIOMonitorCrashJSON_OK : GIOMonitorCrashJSON_ERROR_CANNOT_ADD_DATA;
 }
 
+/** Open a report file for writing. The write buffer comes from the crash arena
+ * if this thread holds it, so that the report is written in fewer, larger
+ * writes. Otherwise the fallback buffer is used.
+ */
+static bool openReportFile(GIOMonitorCrashBufferedWriter* const bufferedWriter,
+                           const char* const path,
+                           char* const fallbackBuffer,
+                           const int fallbackBufferLength)
+{
+    // Any earlier report's buffer went back with the arena.
+    g_stackContentsBuffer = NULL;
+    char* writeBuffer = gioMonitorCrashArena_allocate(kArenaWriteBufferSize);
+    if(writeBuffer != NULL)
+    {
+        return gioMonitorCrashFileUtils_openBufferedWriter(bufferedWriter, path, writeBuffer, kArenaWriteBufferSize);
+    }
+    return gioMonitorCrashFileUtils_openBufferedWriter(bufferedWriter, path, fallbackBuffer, fallbackBufferLength);
+}
+
 
 // ============================================================================
 #pragma mark - Utility -
@@ -646,14 +838,21 @@ static void writeUnknownObjectContents(const GIOMonitorCrashReportWriter* const
 
 static bool isRestrictedClass(const char* name)
 {
-    if(g_introspectionRules.restrictedClasses != NULL)
+    const GIOMonitorCrash_RestrictedClassSet* const classSet =
+        __atomic_load_n(&g_introspectionRules.restrictedClassSet, __ATOMIC_ACQUIRE);
+    if(classSet == NULL || name == NULL)
+    {
+        return false;
+    }
+
+    const GIOMonitorCrash_RestrictedClassEntry* const set = classSet->entries;
+    const uint32_t mask = classSet->mask;
+    const uint32_t hash = gioMonitorCrashString_hash(name);
+    for(uint32_t i = hash & mask; set[i].name != NULL; i = (i + 1) & mask)
     {
-        for(int i = 0; i < g_introspectionRules.restrictedClassesCount; i++)
+        if(set[i].hash == hash && strcmp(name, set[i].name) == 0)
         {
-            if(strcmp(name, g_introspectionRules.restrictedClasses[i]) == 0)
-            {
-                return true;
-            }
+            return true;
         }
     }
     return false;
@@ -867,6 +1066,10 @@ static void writeAddressReferencedByString(const GIOMonitorCrashReportWriter* co
                                            const char* string)
 {
     uint64_t address = 0;
+    if(g_rawCaptureFormatting.capture != NULL)
+    {
+        return;
+    }
     if(string == NULL || !gioMonitorCrashString_extractHexValue(string, (int)strlen(string), &address))
     {
         return;
@@ -876,737 +1079,1965 @@ static void writeAddressReferencedByString(const GIOMonitorCrashReportWriter* co
     writeMemoryContents(writer, key, (uintptr_t)address, &limit);
 }
 
-#pragma mark Backtrace
+#pragma mark Timing
 
-/** Write a backtrace to the report.
- *
- * @param writer The writer to write the backtrace to.
- *
- * @param key The object key, if needed.
- *
- * @param stackCursor The stack cursor to read from.
+/** Get a monotonic timestamp in nanoseconds. This is async-safe.
  */
-static void writeBacktrace(const GIOMonitorCrashReportWriter* const writer,
-                           const char* const key,
-                           GIOMonitorCrashStackCursor* stackCursor)
+static uint64_t getMonotonicTimeNanoseconds(void)
 {
-    writer->beginObject(writer, key);
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0)
     {
-        writer->beginArray(writer, GIOMonitorCrashField_Contents);
-        {
-            while(stackCursor->advanceCursor(stackCursor))
-            {
-                writer->beginObject(writer, NULL);
-                {
-                    if(stackCursor->symbolicate(stackCursor))
-                    {
-                        if(stackCursor->stackEntry.imageName != NULL)
-                        {
-                            writer->addStringElement(writer, GIOMonitorCrashField_ObjectName, gioMonitorCrashFileUtils_lastPathEntry(stackCursor->stackEntry.imageName));
-                        }
-                        writer->addUIntegerElement(writer, GIOMonitorCrashField_ObjectAddr, stackCursor->stackEntry.imageAddress);
-                        if(stackCursor->stackEntry.symbolName != NULL)
-                        {
-                            writer->addStringElement(writer, GIOMonitorCrashField_SymbolName, stackCursor->stackEntry.symbolName);
-                            //  拼接崩溃位置偏移
-//                            writer->addStringElement(writer, GIOMonitorCrashField_SymbolName,
-//                                                     growingLongToStrig(stackCursor->stackEntry.symbolName, (stackCursor->stackEntry.address - stackCursor->stackEntry.symbolAddress)));
-                        }
-                        writer->addUIntegerElement(writer, GIOMonitorCrashField_SymbolAddr, stackCursor->stackEntry.symbolAddress);
-                    }
-                    writer->addUIntegerElement(writer, GIOMonitorCrashField_InstructionAddr, stackCursor->stackEntry.address);
-                }
-                writer->endContainer(writer);
-            }
-        }
-        writer->endContainer(writer);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_Skipped, 0);
+        mach_timebase_info(&timebase);
     }
-    writer->endContainer(writer);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
 }
 
+static const char* g_sectionNames[GIOMonitorCrashReportSectionCount] =
+{
+    [GIOMonitorCrashReportSection_ReportInfo] = "report_info",
+    [GIOMonitorCrashReportSection_BinaryImages] = "binary_images",
+    [GIOMonitorCrashReportSection_ProcessState] = "process_state",
+    [GIOMonitorCrashReportSection_System] = "system",
+    [GIOMonitorCrashReportSection_Error] = "error",
+    [GIOMonitorCrashReportSection_Threads] = "threads",
+    [GIOMonitorCrashReportSection_User] = "user",
+    [GIOMonitorCrashReportSection_UserCallback] = "user_callback",
+    [GIOMonitorCrashReportSection_Debug] = "debug",
+    [GIOMonitorCrashReportSection_Flush] = "flush",
+};
 
-#pragma mark Stack
-
-/** Write a dump of the stack contents to the report.
- *
- * @param writer The writer.
- *
- * @param key The object key, if needed.
- *
- * @param machineContext The context to retrieve the stack from.
- *
- * @param isStackOverflow If true, the stack has overflowed.
+/** Timings of the standard report being written. */
+static struct
+{
+    bool isActive;
+    uint64_t startTime;
+    uint64_t sectionNanoseconds[GIOMonitorCrashReportSectionCount];
+    bool wasSectionTimed[GIOMonitorCrashReportSectionCount];
+    int flushCount;
+    uint64_t threadNanoseconds[kMaxTimedThreads];
+    int threadCount;
+} g_reportTiming;
+
+/** Timings of all standard reports written by this process. Crash and user
+ * reports can be written at the same time, so every field is only accessed
+ * atomically.
  */
-static void writeStackContents(const GIOMonitorCrashReportWriter* const writer,
-                               const char* const key,
-                               const struct GIOMonitorCrashMachineContext* const machineContext,
-                               const bool isStackOverflow)
+static GIOMonitorCrashReportTimings g_timings;
+
+static void beginReportTiming(void)
 {
-    uintptr_t sp = gioMonitorCrashCpu_stackPointer(machineContext);
-    if((void*)sp == NULL)
-    {
-        return;
-    }
+    memset(&g_reportTiming, 0, sizeof(g_reportTiming));
+    g_reportTiming.isActive = true;
+    g_reportTiming.startTime = getMonotonicTimeNanoseconds();
+}
 
-    uintptr_t lowAddress = sp + (uintptr_t)(kStackContentsPushedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection() * -1);
-    uintptr_t highAddress = sp + (uintptr_t)(kStackContentsPoppedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection());
-    if(highAddress < lowAddress)
+static void endSectionTiming(const GIOMonitorCrashReportSection section, const uint64_t startTime)
+{
+    if(g_reportTiming.isActive)
     {
-        uintptr_t tmp = lowAddress;
-        lowAddress = highAddress;
-        highAddress = tmp;
+        g_reportTiming.sectionNanoseconds[section] += getMonotonicTimeNanoseconds() - startTime;
+        g_reportTiming.wasSectionTimed[section] = true;
     }
-    writer->beginObject(writer, key);
+}
+
+static void endThreadTiming(const uint64_t startTime)
+{
+    if(g_reportTiming.isActive && g_reportTiming.threadCount < kMaxTimedThreads)
     {
-        writer->addStringElement(writer, GIOMonitorCrashField_GrowDirection, gioMonitorCrashCpu_stackGrowDirection() > 0 ? "+" : "-");
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpStart, lowAddress);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpEnd, highAddress);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_StackPtr, sp);
-        writer->addBooleanElement(writer, GIOMonitorCrashField_Overflow, isStackOverflow);
-        uint8_t stackBuffer[kStackContentsTotalDistance * sizeof(sp)];
-        int copyLength = (int)(highAddress - lowAddress);
-        if(gioMonitorCrashMem_copySafely((void*)lowAddress, stackBuffer, copyLength))
-        {
-            writer->addDataElement(writer, GIOMonitorCrashField_Contents, (void*)stackBuffer, copyLength);
-        }
-        else
-        {
-            writer->addStringElement(writer, GIOMonitorCrashField_Error, "Stack contents not accessible");
-        }
+        g_reportTiming.threadNanoseconds[g_reportTiming.threadCount++] = getMonotonicTimeNanoseconds() - startTime;
     }
-    writer->endContainer(writer);
 }
 
-/** Write any notable addresses near the stack pointer (above and below).
- *
- * @param writer The writer.
- *
- * @param machineContext The context to retrieve the stack from.
- *
- * @param backDistance The distance towards the beginning of the stack to check.
- *
- * @param forwardDistance The distance past the end of the stack to check.
- */
-static void writeNotableStackContents(const GIOMonitorCrashReportWriter* const writer,
-                                      const struct GIOMonitorCrashMachineContext* const machineContext,
-                                      const int backDistance,
-                                      const int forwardDistance)
+static void addTiming(GIOMonitorCrashReportTiming* const timing, const uint64_t nanoseconds)
 {
-    uintptr_t sp = gioMonitorCrashCpu_stackPointer(machineContext);
-    if((void*)sp == NULL)
+    __atomic_fetch_add(&timing->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&timing->totalNanoseconds, nanoseconds, __ATOMIC_RELAXED);
+    uint64_t maxNanoseconds = __atomic_load_n(&timing->maxNanoseconds, __ATOMIC_RELAXED);
+    while(nanoseconds > maxNanoseconds &&
+          !__atomic_compare_exchange_n(&timing->maxNanoseconds, &maxNanoseconds, nanoseconds,
+                                       true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
     {
-        return;
     }
+}
 
-    uintptr_t lowAddress = sp + (uintptr_t)(backDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection() * -1);
-    uintptr_t highAddress = sp + (uintptr_t)(forwardDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection());
-    if(highAddress < lowAddress)
+static void copyTiming(GIOMonitorCrashReportTiming* const destination, const GIOMonitorCrashReportTiming* const timing)
+{
+    destination->count = __atomic_load_n(&timing->count, __ATOMIC_RELAXED);
+    destination->totalNanoseconds = __atomic_load_n(&timing->totalNanoseconds, __ATOMIC_RELAXED);
+    destination->maxNanoseconds = __atomic_load_n(&timing->maxNanoseconds, __ATOMIC_RELAXED);
+}
+
+static void resetTiming(GIOMonitorCrashReportTiming* const timing)
+{
+    __atomic_store_n(&timing->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->totalNanoseconds, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->maxNanoseconds, 0, __ATOMIC_RELAXED);
+}
+
+/** Add the report's timings to the process wide ones. */
+static void endReportTiming(void)
+{
+    if(!g_reportTiming.isActive)
     {
-        uintptr_t tmp = lowAddress;
-        lowAddress = highAddress;
-        highAddress = tmp;
+        return;
     }
-    uintptr_t contentsAsPointer;
-    char nameBuffer[40];
-    for(uintptr_t address = lowAddress; address < highAddress; address += sizeof(address))
+    g_reportTiming.isActive = false;
+    addTiming(&g_timings.report, getMonotonicTimeNanoseconds() - g_reportTiming.startTime);
+    for(int i = 0; i < GIOMonitorCrashReportSectionCount; i++)
     {
-        if(gioMonitorCrashMem_copySafely((void*)address, &contentsAsPointer, sizeof(contentsAsPointer)))
+        if(g_reportTiming.wasSectionTimed[i])
         {
-            sprintf(nameBuffer, "stack@%p", (void*)address);
-            writeMemoryContentsIfNotable(writer, nameBuffer, contentsAsPointer);
+            addTiming(&g_timings.sections[i], g_reportTiming.sectionNanoseconds[i]);
         }
     }
+    for(int i = 0; i < g_reportTiming.threadCount; i++)
+    {
+        addTiming(&g_timings.thread, g_reportTiming.threadNanoseconds[i]);
+    }
 }
 
+/** Flush the report file, and time it. */
+static void flushReport(GIOMonitorCrashBufferedWriter* const bufferedWriter)
+{
+    uint64_t startTime = getMonotonicTimeNanoseconds();
+    gioMonitorCrashFileUtils_flushBufferedWriter(bufferedWriter);
+    endSectionTiming(GIOMonitorCrashReportSection_Flush, startTime);
+    g_reportTiming.flushCount++;
+}
 
-#pragma mark Registers
-
-/** Write the contents of all regular registers to the report.
+/** Write the timings of the report so far.
  *
  * @param writer The writer.
  *
- * @param key The object key, if needed.
- *
- * @param machineContext The context to retrieve the registers from.
+ * @param key The object key.
  */
-static void writeBasicRegisters(const GIOMonitorCrashReportWriter* const writer,
-                                const char* const key,
-                                const struct GIOMonitorCrashMachineContext* const machineContext)
+static void writeReportTiming(const GIOMonitorCrashReportWriter* const writer, const char* const key)
 {
-    char registerNameBuff[30];
-    const char* registerName;
+    if(!g_reportTiming.isActive)
+    {
+        return;
+    }
+    const double nanosecondsPerSecond = 1000000000.0;
     writer->beginObject(writer, key);
     {
-        const int numRegisters = gioMonitorCrashCpu_numRegisters();
-        for(int reg = 0; reg < numRegisters; reg++)
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_TotalTime,
+                                        (getMonotonicTimeNanoseconds() - g_reportTiming.startTime) / nanosecondsPerSecond);
+        writer->beginObject(writer, GIOMonitorCrashField_Sections);
         {
-            registerName = gioMonitorCrashCpu_registerName(reg);
-            if(registerName == NULL)
+            for(int i = 0; i < GIOMonitorCrashReportSectionCount; i++)
             {
-                snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
-                registerName = registerNameBuff;
+                if(g_reportTiming.wasSectionTimed[i])
+                {
+                    writer->addFloatingPointElement(writer, g_sectionNames[i],
+                                                    g_reportTiming.sectionNanoseconds[i] / nanosecondsPerSecond);
+                }
             }
-            writer->addUIntegerElement(writer, registerName,
-                                       gioMonitorCrashCpu_registerValue(machineContext, reg));
         }
-    }
-    writer->endContainer(writer);
-}
-
-/** Write the contents of all exception registers to the report.
- *
- * @param writer The writer.
- *
- * @param key The object key, if needed.
- *
- * @param machineContext The context to retrieve the registers from.
- */
-static void writeExceptionRegisters(const GIOMonitorCrashReportWriter* const writer,
-                                    const char* const key,
-                                    const struct GIOMonitorCrashMachineContext* const machineContext)
-{
-    char registerNameBuff[30];
-    const char* registerName;
-    writer->beginObject(writer, key);
-    {
-        const int numRegisters = gioMonitorCrashCpu_numExceptionRegisters();
-        for(int reg = 0; reg < numRegisters; reg++)
+        writer->endContainer(writer);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_FlushCount, g_reportTiming.flushCount);
+        writer->beginArray(writer, GIOMonitorCrashField_ThreadTimes);
         {
-            registerName = gioMonitorCrashCpu_exceptionRegisterName(reg);
-            if(registerName == NULL)
+            for(int i = 0; i < g_reportTiming.threadCount; i++)
             {
-                snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
-                registerName = registerNameBuff;
+                writer->addFloatingPointElement(writer, NULL, g_reportTiming.threadNanoseconds[i] / nanosecondsPerSecond);
             }
-            writer->addUIntegerElement(writer,registerName,
-                                       gioMonitorCrashCpu_exceptionRegisterValue(machineContext, reg));
         }
+        writer->endContainer(writer);
     }
     writer->endContainer(writer);
 }
 
-/** Write all applicable registers.
- *
- * @param writer The writer.
- *
- * @param key The object key, if needed.
- *
- * @param machineContext The context to retrieve the registers from.
- */
-static void writeRegisters(const GIOMonitorCrashReportWriter* const writer,
-                           const char* const key,
-                           const struct GIOMonitorCrashMachineContext* const machineContext)
+#pragma mark Write Budget
+
+static const char* g_droppedSectionNames[GIOMonitorCrash_DroppedSectionCount] =
 {
-    writer->beginObject(writer, key);
+    [GIOMonitorCrash_DroppedSection_Registers] = GIOMonitorCrashField_Registers,
+    [GIOMonitorCrash_DroppedSection_StackContents] = GIOMonitorCrashField_Stack,
+    [GIOMonitorCrash_DroppedSection_NotableAddresses] = GIOMonitorCrashField_NotableAddresses,
+    [GIOMonitorCrash_DroppedSection_ConsoleLog] = GIOMonitorCrashField_ConsoleLog,
+};
+
+static void beginWriteBudget(void)
+{
+    g_writeBudget.active = true;
+    g_writeBudget.bytesWritten = 0;
+    g_writeBudget.exceededLimit = NULL;
+    memset(g_writeBudget.droppedCounts, 0, sizeof(g_writeBudget.droppedCounts));
+    g_writeBudget.deadline = 0;
+    if(g_writeBudget.timeLimit > 0)
     {
-        writeBasicRegisters(writer, GIOMonitorCrashField_Basic, machineContext);
-        if(gioMonitorCrashMachineContext_hasValidExceptionRegisters(machineContext))
-        {
-            writeExceptionRegisters(writer, GIOMonitorCrashField_Exception, machineContext);
-        }
+        g_writeBudget.deadline = getMonotonicTimeNanoseconds() + (uint64_t)(g_writeBudget.timeLimit * 1000000000.0);
     }
-    writer->endContainer(writer);
 }
 
-/** Write any notable addresses contained in the CPU registers.
- *
- * @param writer The writer.
- *
- * @param machineContext The context to retrieve the registers from.
+static void endWriteBudget(void)
+{
+    g_writeBudget.active = false;
+}
+
+/** Check if the report being written is still within its time and size
+ * limits. Once a limit is exceeded, the report stays over budget.
  */
-static void writeNotableRegisters(const GIOMonitorCrashReportWriter* const writer,
-                                  const struct GIOMonitorCrashMachineContext* const machineContext)
+static bool isWithinWriteBudget(void)
 {
-    char registerNameBuff[30];
-    const char* registerName;
-    const int numRegisters = gioMonitorCrashCpu_numRegisters();
-    for(int reg = 0; reg < numRegisters; reg++)
+    if(!g_writeBudget.active)
     {
-        registerName = gioMonitorCrashCpu_registerName(reg);
-        if(registerName == NULL)
-        {
-            snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
-            registerName = registerNameBuff;
-        }
-        writeMemoryContentsIfNotable(writer,
-                                     registerName,
-                                     (uintptr_t)gioMonitorCrashCpu_registerValue(machineContext, reg));
+        return true;
+    }
+    if(g_writeBudget.exceededLimit != NULL)
+    {
+        return false;
+    }
+    if(g_writeBudget.sizeLimit > 0 && g_writeBudget.bytesWritten >= g_writeBudget.sizeLimit)
+    {
+        g_writeBudget.exceededLimit = "size_limit";
+    }
+    else if(g_writeBudget.deadline != 0 && getMonotonicTimeNanoseconds() >= g_writeBudget.deadline)
+    {
+        g_writeBudget.exceededLimit = "time_limit";
+    }
+    else
+    {
+        return true;
     }
+    GIOMonitorCrashLOG_INFO("Report exceeded its %s after %d bytes. Dropping low priority sections.",
+                            g_writeBudget.exceededLimit, g_writeBudget.bytesWritten);
+    return false;
 }
 
-#pragma mark Thread-specific
-
-/** Write any notable addresses in the stack or registers to the report.
- *
- * @param writer The writer.
- *
- * @param key The object key, if needed.
- *
- * @param machineContext The context to retrieve the registers from.
+/** Check if a low priority section should be written, and count it as
+ * dropped if not.
  */
-static void writeNotableAddresses(const GIOMonitorCrashReportWriter* const writer,
-                                  const char* const key,
-                                  const struct GIOMonitorCrashMachineContext* const machineContext)
+static bool shouldWriteLowPrioritySection(const GIOMonitorCrash_DroppedSection section)
 {
-    writer->beginObject(writer, key);
+    if(isWithinWriteBudget())
     {
-        writeNotableRegisters(writer, machineContext);
-        writeNotableStackContents(writer,
-                                  machineContext,
-                                  kStackNotableSearchBackDistance,
-                                  kStackNotableSearchForwardDistance);
+        return true;
     }
-    writer->endContainer(writer);
+    g_writeBudget.droppedCounts[section]++;
+    return false;
 }
 
-/** Write information about a thread to the report.
+/** Write which limit the report exceeded and what was dropped because of it.
  *
  * @param writer The writer.
  *
- * @param key The object key, if needed.
- *
- * @param crash The crash handler context.
- *
- * @param machineContext The context whose thread to write about.
- *
- * @param shouldWriteNotableAddresses If true, write any notable addresses found.
+ * @param key The object key.
  */
-static void writeThread(const GIOMonitorCrashReportWriter* const writer,
-                        const char* const key,
-                        const GIOMonitorCrash_MonitorContext* const crash,
-                        const struct GIOMonitorCrashMachineContext* const machineContext,
-                        const int threadIndex,
-                        const bool shouldWriteNotableAddresses)
+static void writeTruncation(const GIOMonitorCrashReportWriter* const writer, const char* const key)
 {
-    bool isCrashedThread = gioMonitorCrashMachineContext_isCrashedContext(machineContext);
-    GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadFromContext(machineContext);
-    GIOMonitorCrashLOG_DEBUG("Writing thread %x (index %d). is crashed: %d", thread, threadIndex, isCrashedThread);
-
-    GIOMonitorCrashStackCursor stackCursor;
-    bool hasBacktrace = getStackCursor(crash, machineContext, &stackCursor);
-
+    if(g_writeBudget.exceededLimit == NULL)
+    {
+        return;
+    }
     writer->beginObject(writer, key);
     {
-        if(hasBacktrace)
-        {
-            writeBacktrace(writer, GIOMonitorCrashField_Backtrace, &stackCursor);
-        }
-        if(gioMonitorCrashMachineContext_canHaveCPUState(machineContext))
-        {
-            writeRegisters(writer, GIOMonitorCrashField_Registers, machineContext);
-        }
-        writer->addIntegerElement(writer, GIOMonitorCrashField_Index, threadIndex);
-        const char* name = gioMonitorCCD_getThreadName(thread);
-        if(name != NULL)
+        writer->addStringElement(writer, GIOMonitorCrashField_Reason, g_writeBudget.exceededLimit);
+        writer->beginObject(writer, GIOMonitorCrashField_Dropped);
         {
-            writer->addStringElement(writer, GIOMonitorCrashField_Name, name);
-        }
-        name = gioMonitorCCD_getQueueName(thread);
-        if(name != NULL)
-        {
-            writer->addStringElement(writer, GIOMonitorCrashField_DispatchQueue, name);
-        }
-        writer->addBooleanElement(writer, GIOMonitorCrashField_Crashed, isCrashedThread);
-        writer->addBooleanElement(writer, GIOMonitorCrashField_CurrentThread, thread == gioMonitorCrashThread_self());
-        if(isCrashedThread)
-        {
-            writeStackContents(writer, GIOMonitorCrashField_Stack, machineContext, stackCursor.state.hasGivenUp);
-            if(shouldWriteNotableAddresses)
+            for(int i = 0; i < GIOMonitorCrash_DroppedSectionCount; i++)
             {
-                writeNotableAddresses(writer, GIOMonitorCrashField_NotableAddresses, machineContext);
+                if(g_writeBudget.droppedCounts[i] > 0)
+                {
+                    writer->addIntegerElement(writer, g_droppedSectionNames[i], g_writeBudget.droppedCounts[i]);
+                }
             }
         }
+        writer->endContainer(writer);
     }
     writer->endContainer(writer);
 }
 
+#pragma mark Profile
 
-/** Write information about all threads to the report.
- *
- * @param writer The writer.
+static const char* g_profileNames[] =
+{
+    [GIOMonitorCrashReportProfileMinimal] = "minimal",
+    [GIOMonitorCrashReportProfileStandard] = "standard",
+    [GIOMonitorCrashReportProfileForensic] = "forensic",
+};
+
+/** Get the profile a report should be written with.
+ * User reported snapshots use the profile of GIOMonitorCrashMonitorTypeUserReported
+ * rather than that of the monitor that captured them.
  *
- * @param key The object key, if needed.
+ * @param monitorContext The crash context.
  *
- * @param crash The crash handler context.
+ * @return The profile. Never Default.
  */
-static void writeAllThreads(const GIOMonitorCrashReportWriter* const writer,
-                            const char* const key,
-                            const GIOMonitorCrash_MonitorContext* const crash,
-                            bool writeNotableAddresses)
+static GIOMonitorCrashReportProfile getReportProfile(const GIOMonitorCrash_MonitorContext* const monitorContext)
 {
-    const struct GIOMonitorCrashMachineContext* const context = crash->offendingMachineContext;
-    GIOMonitorCrashThread offendingThread = gioMonitorCrashMachineContext_getThreadFromContext(context);
-    int threadCount = gioMonitorCrashMachineContext_getThreadCount(context);
-    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
-    
-    // Fetch info for all threads.
-    writer->beginArray(writer, key);
+    GIOMonitorCrashReportProfile profile = monitorContext->reportProfile;
+    if(profile == GIOMonitorCrashReportProfileDefault)
     {
-        GIOMonitorCrashLOG_DEBUG("Writing %d threads.", threadCount);
-        for(int i = 0; i < threadCount; i++)
+        GIOMonitorCrashMonitorType crashType = monitorContext->currentSnapshotUserReported ?
+            GIOMonitorCrashMonitorTypeUserReported : monitorContext->crashType;
+        for(int i = 0; i < kMaxProfileCrashTypes; i++)
         {
-            GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadAtIndex(context, i);
-            if(thread == offendingThread)
-            {
-                writeThread(writer, NULL, crash, context, i, writeNotableAddresses);
-            }
-            else
+            if(crashType & (1 << i))
             {
-                gioMonitorCrashMachineContext_getContextForThread(thread, machineContext, false);
-                writeThread(writer, NULL, crash, machineContext, i, writeNotableAddresses);
+                profile = g_crashTypeProfiles[i];
+                break;
             }
         }
     }
-
-    writer->endContainer(writer);
+    if(profile < GIOMonitorCrashReportProfileMinimal || profile > GIOMonitorCrashReportProfileForensic)
+    {
+        profile = GIOMonitorCrashReportProfileStandard;
+    }
+    return profile;
 }
 
-#pragma mark Global Report Data
+#pragma mark Fingerprint
 
-/** Write information about a binary image to the report.
- *
- * @param writer The writer.
+static uint64_t addToFingerprint(uint64_t hash, const void* const data, const size_t length)
+{
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/** Start the fingerprint of a crash with its exception type.
  *
- * @param key The object key, if needed.
+ * @param crash The crash handler context.
+ */
+static void beginFingerprint(const GIOMonitorCrash_MonitorContext* const crash)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = addToFingerprint(hash, &crash->crashType, sizeof(crash->crashType));
+    switch(crash->crashType)
+    {
+        case GIOMonitorCrashMonitorTypeSignal:
+            hash = addToFingerprint(hash, &crash->signal.signum, sizeof(crash->signal.signum));
+            break;
+        case GIOMonitorCrashMonitorTypeMachException:
+            hash = addToFingerprint(hash, &crash->mach.type, sizeof(crash->mach.type));
+            break;
+        default:
+            break;
+    }
+    if(crash->exceptionName != NULL)
+    {
+        hash = addToFingerprint(hash, crash->exceptionName, strlen(crash->exceptionName));
+    }
+    g_fingerprint.hash = hash;
+    g_fingerprint.framesLeft = 0;
+    g_fingerprint.frameCount = 0;
+}
+
+/** Add a symbolicated frame of the crashed thread to the fingerprint, as its
+ * image name and image relative offset, which don't change with ASLR.
  *
- * @param index Which image to write about.
+ * @param stackCursor The cursor, after symbolicating its current entry.
  */
-static void writeBinaryImage(const GIOMonitorCrashReportWriter* const writer,
-                             const char* const key,
-                             const int index)
+static void addFrameToFingerprint(const GIOMonitorCrashStackCursor* const stackCursor)
 {
-    GIOMonitorCrashBinaryImage image = {0};
-    if(!gioMonitorCrashDynamicLinker_getBinaryImage(index, &image))
+    if(g_fingerprint.framesLeft <= 0)
     {
         return;
     }
+    g_fingerprint.framesLeft--;
+    g_fingerprint.frameCount++;
 
-    writer->beginObject(writer, key);
+    uint64_t hash = g_fingerprint.hash;
+    const char* imageName = stackCursor->stackEntry.imageName;
+    uintptr_t offset = 0;
+    if(imageName != NULL)
     {
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageAddress, image.address);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageVmAddress, image.vmAddress);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageSize, image.size);
-        writer->addStringElement(writer, GIOMonitorCrashField_Name, image.name);
-        writer->addUUIDElement(writer, GIOMonitorCrashField_UUID, image.uuid);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUType, image.cpuType);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUSubType, image.cpuSubType);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMajorVersion, image.majorVersion);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMinorVersion, image.minorVersion);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageRevisionVersion, image.revisionVersion);
+        imageName = gioMonitorCrashFileUtils_lastPathEntry(imageName);
+        hash = addToFingerprint(hash, imageName, strlen(imageName) + 1);
+        offset = stackCursor->stackEntry.address - stackCursor->stackEntry.imageAddress;
     }
-    writer->endContainer(writer);
+    g_fingerprint.hash = addToFingerprint(hash, &offset, sizeof(offset));
 }
 
-/** Write information about all images to the report.
+/** Get the finished fingerprint.
+ *
+ * @return The fingerprint, or 0 if no frames of the crashed thread were written.
+ */
+static uint64_t endFingerprint(void)
+{
+    g_fingerprint.framesLeft = 0;
+    if(g_fingerprint.frameCount == 0)
+    {
+        return 0;
+    }
+    return g_fingerprint.hash == 0 ? 1 : g_fingerprint.hash;
+}
+
+/** Write a fingerprint as 16 hex digits.
  *
  * @param writer The writer.
  *
- * @param key The object key, if needed.
+ * @param key The object key.
+ *
+ * @param fingerprint The fingerprint.
  */
-static void writeBinaryImages(const GIOMonitorCrashReportWriter* const writer, const char* const key)
+static void writeFingerprint(const GIOMonitorCrashReportWriter* const writer,
+                             const char* const key,
+                             const uint64_t fingerprint)
 {
-    const int imageCount = gioMonitorCrashDynamicLinker_imageCount();
+    char buffer[17];
+    for(int i = 0; i < 16; i++)
+    {
+        buffer[i] = g_hexNybbles[(fingerprint >> ((15 - i) * 4)) & 15];
+    }
+    buffer[16] = '\0';
+    writer->addStringElement(writer, key, buffer);
+}
 
-    writer->beginArray(writer, key);
+#pragma mark Backtrace
+
+/** Write the fields of the cursor's current stack entry.
+ *
+ * @param writer The writer to write the entry to.
+ *
+ * @param stackCursor The stack cursor whose current entry to write.
+ */
+static void writeBacktraceEntry(const GIOMonitorCrashReportWriter* const writer,
+                                GIOMonitorCrashStackCursor* stackCursor)
+{
+    if(stackCursor->symbolicate(stackCursor))
     {
-        for(int iImg = 0; iImg < imageCount; iImg++)
+        if(stackCursor->stackEntry.imageName != NULL)
         {
-            writeBinaryImage(writer, NULL, iImg);
+            writer->addStringElement(writer, GIOMonitorCrashField_ObjectName, gioMonitorCrashFileUtils_lastPathEntry(stackCursor->stackEntry.imageName));
+        }
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ObjectAddr, stackCursor->stackEntry.imageAddress);
+        if(stackCursor->stackEntry.symbolName != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_SymbolName, stackCursor->stackEntry.symbolName);
+            //  拼接崩溃位置偏移
+//            writer->addStringElement(writer, GIOMonitorCrashField_SymbolName,
+//                                     growingLongToStrig(stackCursor->stackEntry.symbolName, (stackCursor->stackEntry.address - stackCursor->stackEntry.symbolAddress)));
         }
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_SymbolAddr, stackCursor->stackEntry.symbolAddress);
     }
-    writer->endContainer(writer);
+    writer->addUIntegerElement(writer, GIOMonitorCrashField_InstructionAddr, stackCursor->stackEntry.address);
+    addFrameToFingerprint(stackCursor);
 }
 
-/** Write information about system memory to the report.
+/** Write a backtrace to the report.
  *
- * @param writer The writer.
+ * @param writer The writer to write the backtrace to.
  *
  * @param key The object key, if needed.
+ *
+ * @param stackCursor The stack cursor to read from.
  */
-static void writeMemoryInfo(const GIOMonitorCrashReportWriter* const writer,
-                            const char* const key,
-                            const GIOMonitorCrash_MonitorContext* const monitorContext)
+static void writeBacktrace(const GIOMonitorCrashReportWriter* const writer,
+                           const char* const key,
+                           GIOMonitorCrashStackCursor* stackCursor)
 {
     writer->beginObject(writer, key);
     {
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_Size, monitorContext->System.memorySize);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_Usable, monitorContext->System.usableMemory);
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_Free, monitorContext->System.freeMemory);
+        writer->beginArray(writer, GIOMonitorCrashField_Contents);
+        {
+            while(stackCursor->advanceCursor(stackCursor))
+            {
+                writer->beginObject(writer, NULL);
+                {
+                    writeBacktraceEntry(writer, stackCursor);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Skipped, 0);
     }
     writer->endContainer(writer);
 }
 
-/** Write information about the error leading to the crash to the report.
+/** Write a backtrace whose outer frames may be in the shared frames table.
+ * Frames unique to this backtrace are written in full, followed by the index
+ * of the first shared frame, if any.
  *
- * @param writer The writer.
+ * @param writer The writer to write the backtrace to.
  *
  * @param key The object key, if needed.
  *
- * @param crash The crash handler context.
+ * @param node The trie node of the innermost frame.
  */
-static void writeError(const GIOMonitorCrashReportWriter* const writer,
-                       const char* const key,
-                       const GIOMonitorCrash_MonitorContext* const crash)
+static void writeSharedBacktrace(const GIOMonitorCrashReportWriter* const writer,
+                                 const char* const key,
+                                 int node)
 {
+    const GIOMonitorCrashStackTrie* const trie = &g_sharedBacktraces.trie;
+    GIOMonitorCrashStackCursor stackCursor;
+    gioMonitorCrashStackCursor_initCursor(&stackCursor, NULL, NULL);
+
     writer->beginObject(writer, key);
     {
-#if GIOMonitorCrashCRASH_HOST_APPLE
-        writer->beginObject(writer, GIOMonitorCrashField_Mach);
+        writer->beginArray(writer, GIOMonitorCrashField_Contents);
         {
-//            const char* machExceptionName = gioMonitorCrashMach_exceptionName(crash->mach.type);
-//            const char* machCodeName = crash->mach.code == 0 ? NULL : gioMonitorCrashMach_kernelReturnCodeName(crash->mach.code);
-//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Exception, (unsigned)crash->mach.type);
-//            if(machExceptionName != NULL)
-//            {
-//                writer->addStringElement(writer, GIOMonitorCrashField_ExceptionName, machExceptionName);
-//            }
-//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Code, (unsigned)crash->mach.code);
-//            if(machCodeName != NULL)
-//            {
-//                writer->addStringElement(writer, GIOMonitorCrashField_CodeName, machCodeName);
-//            }
-//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Subcode, (unsigned)crash->mach.subcode);
+            for(; node >= 0 && trie->nodes[node].sharedIndex < 0; node = trie->nodes[node].parent)
+            {
+                stackCursor.stackEntry.address = trie->nodes[node].address;
+                writer->beginObject(writer, NULL);
+                {
+                    writeBacktraceEntry(writer, &stackCursor);
+                }
+                writer->endContainer(writer);
+            }
         }
         writer->endContainer(writer);
-#endif
-        writer->beginObject(writer, GIOMonitorCrashField_Signal);
+        if(node >= 0)
         {
-//            const char* sigName = gioMonitorCrashSignal_signalName(crash->signal.signum);
-//            const char* sigCodeName = gioMonitorCrashSignal_signalCodeName(crash->signal.signum, crash->signal.sigcode);
-//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Signal, (unsigned)crash->signal.signum);
-//            if(sigName != NULL)
-//            {
-//                writer->addStringElement(writer, GIOMonitorCrashField_Name, sigName);
-//            }
-//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Code, (unsigned)crash->signal.sigcode);
-//            if(sigCodeName != NULL)
-//            {
-//                writer->addStringElement(writer, GIOMonitorCrashField_CodeName, sigCodeName);
-//            }
+            writer->addIntegerElement(writer, GIOMonitorCrashField_SharedSuffix, trie->nodes[node].sharedIndex);
         }
-        writer->endContainer(writer);
-
-        writer->addUIntegerElement(writer, GIOMonitorCrashField_Address, crash->faultAddress);
-        if(crash->crashReason != NULL)
+        for(; node >= 0 && g_fingerprint.framesLeft > 0; node = trie->nodes[node].parent)
         {
-            writer->addStringElement(writer, GIOMonitorCrashField_Reason, crash->crashReason);
+            stackCursor.stackEntry.address = trie->nodes[node].address;
+            stackCursor.symbolicate(&stackCursor);
+            addFrameToFingerprint(&stackCursor);
         }
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Skipped, 0);
+    }
+    writer->endContainer(writer);
+}
 
-        // Gather specific info.
-        switch(crash->crashType)
-        {
-            case GIOMonitorCrashMonitorTypeMainThreadDeadlock:
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Deadlock);
-                break;
-
-            case GIOMonitorCrashMonitorTypeMachException:
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Mach);
-                break;
+/** Write the table of frames shared by more than one thread.
+ * Each entry refers to the next frame out (its caller) by index.
+ *
+ * @param writer The writer to write the table to.
+ *
+ * @param key The object key, if needed.
+ */
+static void writeSharedFrames(const GIOMonitorCrashReportWriter* const writer,
+                              const char* const key)
+{
+    const GIOMonitorCrashStackTrie* const trie = &g_sharedBacktraces.trie;
+    GIOMonitorCrashStackCursor stackCursor;
+    gioMonitorCrashStackCursor_initCursor(&stackCursor, NULL, NULL);
 
-            case GIOMonitorCrashMonitorTypeCPPException:
-            {
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_CPPException);
-                writer->beginObject(writer, GIOMonitorCrashField_CPPException);
-                {
-                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->CPPException.name);
-                }
-                writer->endContainer(writer);
-                break;
-            }
-            case GIOMonitorCrashMonitorTypeNSException:
+    writer->beginArray(writer, key);
+    {
+        for(int i = 0; i < trie->nodeCount; i++)
+        {
+            const GIOMonitorCrashStackTrieNode* const entry = &trie->nodes[i];
+            if(entry->sharedIndex < 0)
             {
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_NSException);
-                writer->beginObject(writer, GIOMonitorCrashField_NSException);
-                {
-                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->NSException.name);
-                    writer->addStringElement(writer, GIOMonitorCrashField_UserInfo, crash->NSException.userInfo);
-                    writeAddressReferencedByString(writer, GIOMonitorCrashField_ReferencedObject, crash->crashReason);
-                }
-                writer->endContainer(writer);
-                break;
+                continue;
             }
-            case GIOMonitorCrashMonitorTypeSignal:
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Signal);
-                break;
-
-            case GIOMonitorCrashMonitorTypeUserReported:
+            stackCursor.stackEntry.address = entry->address;
+            writer->beginObject(writer, NULL);
             {
-                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_User);
-                writer->beginObject(writer, GIOMonitorCrashField_UserReported);
+                writeBacktraceEntry(writer, &stackCursor);
+                if(entry->parent >= 0)
                 {
-                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->userException.name);
-                    if(crash->userException.language != NULL)
-                    {
-                        writer->addStringElement(writer, GIOMonitorCrashField_Language, crash->userException.language);
-                    }
-                    if(crash->userException.lineOfCode != NULL)
-                    {
-                        writer->addStringElement(writer, GIOMonitorCrashField_LineOfCode, crash->userException.lineOfCode);
-                    }
-                    if(crash->userException.customStackTrace != NULL)
-                    {
-                        writer->addJSONElement(writer, GIOMonitorCrashField_Backtrace, crash->userException.customStackTrace, true);
-                    }
+                    writer->addIntegerElement(writer, GIOMonitorCrashField_Caller, trie->nodes[entry->parent].sharedIndex);
                 }
-                writer->endContainer(writer);
-                break;
             }
-            case GIOMonitorCrashMonitorTypeSystem:
-            case GIOMonitorCrashMonitorTypeApplicationState:
-            case GIOMonitorCrashMonitorTypeZombie:
-                GIOMonitorCrashLOG_ERROR("Crash monitor type 0x%x shouldn't be able to cause events!", crash->crashType);
-                break;
+            writer->endContainer(writer);
         }
     }
     writer->endContainer(writer);
 }
 
-/** Write information about app runtime, etc to the report.
+/** Get the trie node for a thread's shared backtrace.
+ *
+ * @param threadIndex The thread's index in the report.
+ *
+ * @return The innermost node, or -1 if the backtrace must be written in full.
+ */
+static int getSharedBacktraceLeaf(const int threadIndex)
+{
+    if(!g_sharedBacktraces.active || threadIndex < 0 || threadIndex >= g_sharedBacktraces.maxThreads)
+    {
+        return -1;
+    }
+    return g_sharedBacktraces.threadLeaves[threadIndex];
+}
+
+
+#pragma mark Stack
+
+/** Write a dump of the stack contents to the report.
  *
  * @param writer The writer.
  *
  * @param key The object key, if needed.
  *
- * @param monitorContext The event monitor context.
+ * @param machineContext The context to retrieve the stack from.
+ *
+ * @param isStackOverflow If true, the stack has overflowed.
  */
-static void writeAppStats(const GIOMonitorCrashReportWriter* const writer,
-                          const char* const key,
-                          const GIOMonitorCrash_MonitorContext* const monitorContext)
+static void writeStackContents(const GIOMonitorCrashReportWriter* const writer,
+                               const char* const key,
+                               const struct GIOMonitorCrashMachineContext* const machineContext,
+                               const bool isStackOverflow)
 {
+    uintptr_t sp = gioMonitorCrashCpu_stackPointer(machineContext);
+    if((void*)sp == NULL)
+    {
+        return;
+    }
+
+    uintptr_t lowAddress = sp + (uintptr_t)(kStackContentsPushedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection() * -1);
+    uintptr_t highAddress = sp + (uintptr_t)(kStackContentsPoppedDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection());
+    if(highAddress < lowAddress)
+    {
+        uintptr_t tmp = lowAddress;
+        lowAddress = highAddress;
+        highAddress = tmp;
+    }
     writer->beginObject(writer, key);
     {
-        writer->addBooleanElement(writer, GIOMonitorCrashField_AppActive, monitorContext->AppState.applicationIsActive);
-        writer->addBooleanElement(writer, GIOMonitorCrashField_AppInFG, monitorContext->AppState.applicationIsInForeground);
+        writer->addStringElement(writer, GIOMonitorCrashField_GrowDirection, gioMonitorCrashCpu_stackGrowDirection() > 0 ? "+" : "-");
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpStart, lowAddress);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpEnd, highAddress);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_StackPtr, sp);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_Overflow, isStackOverflow);
+        uint8_t localStackBuffer[kStackContentsTotalDistance * sizeof(sp)];
+        if(g_stackContentsBuffer == NULL)
+        {
+            g_stackContentsBuffer = gioMonitorCrashArena_allocate(sizeof(localStackBuffer));
+        }
+        uint8_t* stackBuffer = g_stackContentsBuffer != NULL ? g_stackContentsBuffer : localStackBuffer;
+        int copyLength = (int)(highAddress - lowAddress);
+        if(gioMonitorCrashMem_copySafely((void*)lowAddress, stackBuffer, copyLength))
+        {
+            writer->addDataElement(writer, GIOMonitorCrashField_Contents, (void*)stackBuffer, copyLength);
+        }
+        else
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_Error, "Stack contents not accessible");
+        }
+    }
+    writer->endContainer(writer);
+}
 
-        writer->addIntegerElement(writer, GIOMonitorCrashField_LaunchesSinceCrash, monitorContext->AppState.launchesSinceLastCrash);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_SessionsSinceCrash, monitorContext->AppState.sessionsSinceLastCrash);
-        writer->addFloatingPointElement(writer, GIOMonitorCrashField_ActiveTimeSinceCrash, monitorContext->AppState.activeDurationSinceLastCrash);
-        writer->addFloatingPointElement(writer, GIOMonitorCrashField_BGTimeSinceCrash, monitorContext->AppState.backgroundDurationSinceLastCrash);
+/** Write any notable addresses near the stack pointer (above and below).
+ *
+ * @param writer The writer.
+ *
+ * @param machineContext The context to retrieve the stack from.
+ *
+ * @param backDistance The distance towards the beginning of the stack to check.
+ *
+ * @param forwardDistance The distance past the end of the stack to check.
+ */
+static void writeNotableStackContents(const GIOMonitorCrashReportWriter* const writer,
+                                      const struct GIOMonitorCrashMachineContext* const machineContext,
+                                      const int backDistance,
+                                      const int forwardDistance)
+{
+    uintptr_t sp = gioMonitorCrashCpu_stackPointer(machineContext);
+    if((void*)sp == NULL)
+    {
+        return;
+    }
 
-        writer->addIntegerElement(writer, GIOMonitorCrashField_SessionsSinceLaunch, monitorContext->AppState.sessionsSinceLaunch);
-        writer->addFloatingPointElement(writer, GIOMonitorCrashField_ActiveTimeSinceLaunch, monitorContext->AppState.activeDurationSinceLaunch);
-        writer->addFloatingPointElement(writer, GIOMonitorCrashField_BGTimeSinceLaunch, monitorContext->AppState.backgroundDurationSinceLaunch);
+    uintptr_t lowAddress = sp + (uintptr_t)(backDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection() * -1);
+    uintptr_t highAddress = sp + (uintptr_t)(forwardDistance * (int)sizeof(sp) * gioMonitorCrashCpu_stackGrowDirection());
+    if(highAddress < lowAddress)
+    {
+        uintptr_t tmp = lowAddress;
+        lowAddress = highAddress;
+        highAddress = tmp;
+    }
+    uintptr_t contentsAsPointer;
+    char nameBuffer[40];
+    for(uintptr_t address = lowAddress; address < highAddress; address += sizeof(address))
+    {
+        if(gioMonitorCrashMem_copySafely((void*)address, &contentsAsPointer, sizeof(contentsAsPointer)))
+        {
+            sprintf(nameBuffer, "stack@%p", (void*)address);
+            writeMemoryContentsIfNotable(writer, nameBuffer, contentsAsPointer);
+        }
     }
-    writer->endContainer(writer);
 }
 
-/** Write information about this process.
+
+#pragma mark Registers
+
+/** Write the contents of all regular registers to the report.
  *
  * @param writer The writer.
  *
  * @param key The object key, if needed.
+ *
+ * @param machineContext The context to retrieve the registers from.
  */
-static void writeProcessState(const GIOMonitorCrashReportWriter* const writer,
-                              const char* const key,
-                              const GIOMonitorCrash_MonitorContext* const monitorContext)
+static void writeBasicRegisters(const GIOMonitorCrashReportWriter* const writer,
+                                const char* const key,
+                                const struct GIOMonitorCrashMachineContext* const machineContext)
 {
+    char registerNameBuff[30];
+    const char* registerName;
     writer->beginObject(writer, key);
     {
-        if(monitorContext->ZombieException.address != 0)
+        const int numRegisters = gioMonitorCrashCpu_numRegisters();
+        for(int reg = 0; reg < numRegisters; reg++)
         {
-            writer->beginObject(writer, GIOMonitorCrashField_LastDeallocedNSException);
+            registerName = gioMonitorCrashCpu_registerName(reg);
+            if(registerName == NULL)
             {
-                writer->addUIntegerElement(writer, GIOMonitorCrashField_Address, monitorContext->ZombieException.address);
-                writer->addStringElement(writer, GIOMonitorCrashField_Name, monitorContext->ZombieException.name);
-                writer->addStringElement(writer, GIOMonitorCrashField_Reason, monitorContext->ZombieException.reason);
-                writeAddressReferencedByString(writer, GIOMonitorCrashField_ReferencedObject, monitorContext->ZombieException.reason);
+                snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
+                registerName = registerNameBuff;
             }
-            writer->endContainer(writer);
+            writer->addUIntegerElement(writer, registerName,
+                                       gioMonitorCrashCpu_registerValue(machineContext, reg));
         }
     }
     writer->endContainer(writer);
 }
 
-/** Write basic report information.
+/** Write the contents of all exception registers to the report.
  *
  * @param writer The writer.
  *
  * @param key The object key, if needed.
  *
- * @param type The report type.
- *
- * @param reportID The report ID.
+ * @param machineContext The context to retrieve the registers from.
  */
-static void writeReportInfo(const GIOMonitorCrashReportWriter* const writer,
-                            const char* const key,
-                            const char* const type,
-                            const char* const reportID,
-                            const char* const processName)
+static void writeExceptionRegisters(const GIOMonitorCrashReportWriter* const writer,
+                                    const char* const key,
+                                    const struct GIOMonitorCrashMachineContext* const machineContext)
 {
+    char registerNameBuff[30];
+    const char* registerName;
+    writer->beginObject(writer, key);
+    {
+        const int numRegisters = gioMonitorCrashCpu_numExceptionRegisters();
+        for(int reg = 0; reg < numRegisters; reg++)
+        {
+            registerName = gioMonitorCrashCpu_exceptionRegisterName(reg);
+            if(registerName == NULL)
+            {
+                snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
+                registerName = registerNameBuff;
+            }
+            writer->addUIntegerElement(writer,registerName,
+                                       gioMonitorCrashCpu_exceptionRegisterValue(machineContext, reg));
+        }
+    }
+    writer->endContainer(writer);
+}
+
+/** Write all applicable registers.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param machineContext The context to retrieve the registers from.
+ */
+static void writeRegisters(const GIOMonitorCrashReportWriter* const writer,
+                           const char* const key,
+                           const struct GIOMonitorCrashMachineContext* const machineContext)
+{
+    writer->beginObject(writer, key);
+    {
+        writeBasicRegisters(writer, GIOMonitorCrashField_Basic, machineContext);
+        if(gioMonitorCrashMachineContext_hasValidExceptionRegisters(machineContext))
+        {
+            writeExceptionRegisters(writer, GIOMonitorCrashField_Exception, machineContext);
+        }
+    }
+    writer->endContainer(writer);
+}
+
+/** Write any notable addresses contained in the CPU registers.
+ *
+ * @param writer The writer.
+ *
+ * @param machineContext The context to retrieve the registers from.
+ */
+static void writeNotableRegisters(const GIOMonitorCrashReportWriter* const writer,
+                                  const struct GIOMonitorCrashMachineContext* const machineContext)
+{
+    char registerNameBuff[30];
+    const char* registerName;
+    const int numRegisters = gioMonitorCrashCpu_numRegisters();
+    for(int reg = 0; reg < numRegisters; reg++)
+    {
+        registerName = gioMonitorCrashCpu_registerName(reg);
+        if(registerName == NULL)
+        {
+            snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
+            registerName = registerNameBuff;
+        }
+        writeMemoryContentsIfNotable(writer,
+                                     registerName,
+                                     (uintptr_t)gioMonitorCrashCpu_registerValue(machineContext, reg));
+    }
+}
+
+#pragma mark Thread-specific
+
+/** Write any notable addresses in the stack or registers to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param machineContext The context to retrieve the registers from.
+ */
+static void writeNotableAddresses(const GIOMonitorCrashReportWriter* const writer,
+                                  const char* const key,
+                                  const struct GIOMonitorCrashMachineContext* const machineContext)
+{
+    writer->beginObject(writer, key);
+    {
+        writeNotableRegisters(writer, machineContext);
+        writeNotableStackContents(writer,
+                                  machineContext,
+                                  kStackNotableSearchBackDistance,
+                                  kStackNotableSearchForwardDistance);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about a thread to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param crash The crash handler context.
+ *
+ * @param machineContext The context whose thread to write about.
+ *
+ * @param profile What to capture about the thread.
+ *
+ * @param shouldWriteNotableAddresses If true, write any notable addresses found.
+ */
+static void writeThread(const GIOMonitorCrashReportWriter* const writer,
+                        const char* const key,
+                        const GIOMonitorCrash_MonitorContext* const crash,
+                        const struct GIOMonitorCrashMachineContext* const machineContext,
+                        const int threadIndex,
+                        const GIOMonitorCrashReportProfile profile,
+                        const bool shouldWriteNotableAddresses)
+{
+    bool isCrashedThread = gioMonitorCrashMachineContext_isCrashedContext(machineContext);
+    bool isForensic = profile == GIOMonitorCrashReportProfileForensic;
+    GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadFromContext(machineContext);
+    GIOMonitorCrashLOG_DEBUG("Writing thread %x (index %d). is crashed: %d", thread, threadIndex, isCrashedThread);
+
+    GIOMonitorCrashStackCursor stackCursor;
+    bool hasBacktrace = getStackCursor(crash, machineContext, &stackCursor);
+    int sharedLeaf = getSharedBacktraceLeaf(threadIndex);
+
+    writer->beginObject(writer, key);
+    {
+        g_fingerprint.framesLeft = isCrashedThread ? kFingerprintFrameCount : 0;
+        if(sharedLeaf >= 0)
+        {
+            writeSharedBacktrace(writer, GIOMonitorCrashField_Backtrace, sharedLeaf);
+            stackCursor.state.hasGivenUp = g_sharedBacktraces.threadGaveUp[threadIndex];
+        }
+        else if(hasBacktrace)
+        {
+            writeBacktrace(writer, GIOMonitorCrashField_Backtrace, &stackCursor);
+        }
+        g_fingerprint.framesLeft = 0;
+        if(gioMonitorCrashMachineContext_canHaveCPUState(machineContext) &&
+           (isCrashedThread ||
+            (profile != GIOMonitorCrashReportProfileMinimal &&
+             shouldWriteLowPrioritySection(GIOMonitorCrash_DroppedSection_Registers))))
+        {
+            writeRegisters(writer, GIOMonitorCrashField_Registers, machineContext);
+        }
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Index, threadIndex);
+        const char* name = gioMonitorCCD_getThreadName(thread);
+        if(name != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_Name, name);
+        }
+        name = gioMonitorCCD_getQueueName(thread);
+        if(name != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_DispatchQueue, name);
+        }
+        writer->addBooleanElement(writer, GIOMonitorCrashField_Crashed, isCrashedThread);
+        // The report may be written on the handler thread, so the current
+        // thread is the one the crash was captured on.
+        writer->addBooleanElement(writer, GIOMonitorCrashField_CurrentThread,
+                                  isCrashedThread && gioMonitorCrashMachineContext_isCurrentThread(machineContext));
+        if(isCrashedThread || (isForensic && gioMonitorCrashMachineContext_canHaveCPUState(machineContext)))
+        {
+            if(profile != GIOMonitorCrashReportProfileMinimal &&
+               shouldWriteLowPrioritySection(GIOMonitorCrash_DroppedSection_StackContents))
+            {
+                writeStackContents(writer, GIOMonitorCrashField_Stack, machineContext, stackCursor.state.hasGivenUp);
+            }
+            if(shouldWriteNotableAddresses &&
+               shouldWriteLowPrioritySection(GIOMonitorCrash_DroppedSection_NotableAddresses))
+            {
+                writeNotableAddresses(writer, GIOMonitorCrashField_NotableAddresses, machineContext);
+            }
+        }
+    }
+    writer->endContainer(writer);
+}
+
+
+/** Walk the stacks of all threads and add them to the shared backtrace trie.
+ *
+ * @param crash The crash handler context.
+ *
+ * @param machineContext Scratch space for the contexts of non-crashed threads.
+ *
+ * @return true if thread backtraces should be written with shared suffixes.
+ */
+static bool prepareSharedBacktraces(const GIOMonitorCrash_MonitorContext* const crash,
+                                    struct GIOMonitorCrashMachineContext* const machineContext)
+{
+    GIOMonitorCrash_SharedBacktraces* const shared = &g_sharedBacktraces;
+    if(!shared->enabled || shared->trie.nodes == NULL)
+    {
+        return false;
+    }
+
+    const struct GIOMonitorCrashMachineContext* const context = crash->offendingMachineContext;
+    GIOMonitorCrashThread offendingThread = gioMonitorCrashMachineContext_getThreadFromContext(context);
+    int threadCount = gioMonitorCrashMachineContext_getThreadCount(context);
+    if(threadCount > shared->maxThreads)
+    {
+        threadCount = shared->maxThreads;
+    }
+    const int maxLength = sizeof(shared->backtrace) / sizeof(*shared->backtrace);
+
+    gioMonitorCrashStackTrie_reset(&shared->trie);
+    for(int i = 0; i < threadCount; i++)
+    {
+        GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadAtIndex(context, i);
+        const struct GIOMonitorCrashMachineContext* threadContext = context;
+        if(thread != offendingThread)
+        {
+            gioMonitorCrashMachineContext_getContextForThread(thread, machineContext, false);
+            threadContext = machineContext;
+        }
+
+        GIOMonitorCrashStackCursor stackCursor;
+        getStackCursor(crash, threadContext, &stackCursor);
+        int length = 0;
+        while(stackCursor.advanceCursor(&stackCursor))
+        {
+            if(length >= maxLength)
+            {
+                // Too deep to keep. Write this one in full.
+                length = 0;
+                break;
+            }
+            shared->backtrace[length++] = stackCursor.stackEntry.address;
+        }
+        shared->threadGaveUp[i] = stackCursor.state.hasGivenUp;
+        shared->threadLeaves[i] = gioMonitorCrashStackTrie_addBacktrace(&shared->trie, shared->backtrace, length);
+    }
+    for(int i = threadCount; i < shared->maxThreads; i++)
+    {
+        shared->threadLeaves[i] = -1;
+    }
+    gioMonitorCrashStackTrie_indexSharedNodes(&shared->trie);
+    return true;
+}
+
+/** Write information about all threads to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param crash The crash handler context.
+ *
+ * @param profile What to capture about each thread.
+ *
+ * @param writeNotableAddresses If true, write any notable addresses found.
+ */
+static void writeAllThreads(const GIOMonitorCrashReportWriter* const writer,
+                            const char* const key,
+                            const GIOMonitorCrash_MonitorContext* const crash,
+                            GIOMonitorCrashReportProfile profile,
+                            bool writeNotableAddresses)
+{
+    const struct GIOMonitorCrashMachineContext* const context = crash->offendingMachineContext;
+    GIOMonitorCrashThread offendingThread = gioMonitorCrashMachineContext_getThreadFromContext(context);
+    int threadCount = gioMonitorCrashMachineContext_getThreadCount(context);
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+    uint64_t startTime = getMonotonicTimeNanoseconds();
+    g_sharedBacktraces.active = prepareSharedBacktraces(crash, machineContext);
+
+    // Fetch info for all threads.
+    writer->beginArray(writer, key);
+    {
+        GIOMonitorCrashLOG_DEBUG("Writing %d threads.", threadCount);
+        for(int i = 0; i < threadCount; i++)
+        {
+            uint64_t threadStartTime = getMonotonicTimeNanoseconds();
+            GIOMonitorCrashThread thread = gioMonitorCrashMachineContext_getThreadAtIndex(context, i);
+            if(thread == offendingThread)
+            {
+                writeThread(writer, NULL, crash, context, i, profile, writeNotableAddresses);
+            }
+            else
+            {
+                gioMonitorCrashMachineContext_getContextForThread(thread, machineContext, false);
+                writeThread(writer, NULL, crash, machineContext, i, profile, writeNotableAddresses);
+            }
+            endThreadTiming(threadStartTime);
+        }
+    }
+
+    writer->endContainer(writer);
+
+    if(g_sharedBacktraces.active)
+    {
+        writeSharedFrames(writer, GIOMonitorCrashField_SharedFrames);
+        g_sharedBacktraces.active = false;
+    }
+
+    if(threadCount > 0)
+    {
+        uint64_t elapsed = getMonotonicTimeNanoseconds() - startTime;
+        GIOMonitorCrashLOG_DEBUG("Captured %d threads in %" PRIu64 " us (%" PRIu64 " us per thread, max %d).",
+                                 threadCount, elapsed / 1000, elapsed / 1000 / (uint64_t)threadCount,
+                                 gioMonitorCrashMachineContext_getMaxThreadCount());
+    }
+}
+
+#pragma mark Global Report Data
+
+/** Write information about a binary image to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param index Which image to write about.
+ */
+static void writeBinaryImage(const GIOMonitorCrashReportWriter* const writer,
+                             const char* const key,
+                             const int index)
+{
+    GIOMonitorCrashBinaryImage image = {0};
+    if(!gioMonitorCrashDynamicLinker_getBinaryImage(index, &image))
+    {
+        return;
+    }
+
+    writer->beginObject(writer, key);
+    {
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageAddress, image.address);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageVmAddress, image.vmAddress);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageSize, image.size);
+        writer->addStringElement(writer, GIOMonitorCrashField_Name, image.name);
+        writer->addUUIDElement(writer, GIOMonitorCrashField_UUID, image.uuid);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUType, image.cpuType);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUSubType, image.cpuSubType);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMajorVersion, image.majorVersion);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMinorVersion, image.minorVersion);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageRevisionVersion, image.revisionVersion);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about all images to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ */
+static void writeBinaryImages(const GIOMonitorCrashReportWriter* const writer, const char* const key)
+{
+    const int imageCount = gioMonitorCrashDynamicLinker_imageCount();
+
+    writer->beginArray(writer, key);
+    {
+        for(int iImg = 0; iImg < imageCount; iImg++)
+        {
+            writeBinaryImage(writer, NULL, iImg);
+        }
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about system memory to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ */
+static void writeMemoryInfo(const GIOMonitorCrashReportWriter* const writer,
+                            const char* const key,
+                            const GIOMonitorCrash_MonitorContext* const monitorContext)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_Size, monitorContext->System.memorySize);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_Usable, monitorContext->System.usableMemory);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_Free, monitorContext->System.freeMemory);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about the error leading to the crash to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param crash The crash handler context.
+ */
+static void writeError(const GIOMonitorCrashReportWriter* const writer,
+                       const char* const key,
+                       const GIOMonitorCrash_MonitorContext* const crash)
+{
+    writer->beginObject(writer, key);
+    {
+#if GIOMonitorCrashCRASH_HOST_APPLE
+        writer->beginObject(writer, GIOMonitorCrashField_Mach);
+        {
+//            const char* machExceptionName = gioMonitorCrashMach_exceptionName(crash->mach.type);
+//            const char* machCodeName = crash->mach.code == 0 ? NULL : gioMonitorCrashMach_kernelReturnCodeName(crash->mach.code);
+//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Exception, (unsigned)crash->mach.type);
+//            if(machExceptionName != NULL)
+//            {
+//                writer->addStringElement(writer, GIOMonitorCrashField_ExceptionName, machExceptionName);
+//            }
+//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Code, (unsigned)crash->mach.code);
+//            if(machCodeName != NULL)
+//            {
+//                writer->addStringElement(writer, GIOMonitorCrashField_CodeName, machCodeName);
+//            }
+//            writer->addUIntegerElement(writer, GIOMonitorCrashField_Subcode, (unsigned)crash->mach.subcode);
+        }
+        writer->endContainer(writer);
+#endif
+        writer->beginObject(writer, GIOMonitorCrashField_Signal);
+        {
+            const char* sigName = gioMonitorCrashSignal_signalName(crash->signal.signum);
+            const char* sigCodeName = gioMonitorCrashSignal_signalCodeName(crash->signal.signum, crash->signal.sigcode);
+            writer->addUIntegerElement(writer, GIOMonitorCrashField_Signal, (unsigned)crash->signal.signum);
+            if(sigName != NULL)
+            {
+                writer->addStringElement(writer, GIOMonitorCrashField_Name, sigName);
+            }
+            writer->addUIntegerElement(writer, GIOMonitorCrashField_Code, (unsigned)crash->signal.sigcode);
+            if(sigCodeName != NULL)
+            {
+                writer->addStringElement(writer, GIOMonitorCrashField_CodeName, sigCodeName);
+            }
+        }
+        writer->endContainer(writer);
+
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_Address, crash->faultAddress);
+        if(crash->crashReason != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_Reason, crash->crashReason);
+        }
+
+        // Gather specific info.
+        switch(crash->crashType)
+        {
+            case GIOMonitorCrashMonitorTypeMainThreadDeadlock:
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Deadlock);
+                break;
+
+            case GIOMonitorCrashMonitorTypeMachException:
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Mach);
+                break;
+
+            case GIOMonitorCrashMonitorTypeCPPException:
+            {
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_CPPException);
+                writer->beginObject(writer, GIOMonitorCrashField_CPPException);
+                {
+                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->CPPException.name);
+                }
+                writer->endContainer(writer);
+                break;
+            }
+            case GIOMonitorCrashMonitorTypeNSException:
+            {
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_NSException);
+                writer->beginObject(writer, GIOMonitorCrashField_NSException);
+                {
+                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->NSException.name);
+                    writer->addStringElement(writer, GIOMonitorCrashField_UserInfo, crash->NSException.userInfo);
+                    writeAddressReferencedByString(writer, GIOMonitorCrashField_ReferencedObject, crash->crashReason);
+                }
+                writer->endContainer(writer);
+                break;
+            }
+            case GIOMonitorCrashMonitorTypeSignal:
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_Signal);
+                break;
+
+            case GIOMonitorCrashMonitorTypeUserReported:
+            {
+                writer->addStringElement(writer, GIOMonitorCrashField_Type, GIOMonitorCrashExcType_User);
+                writer->beginObject(writer, GIOMonitorCrashField_UserReported);
+                {
+                    writer->addStringElement(writer, GIOMonitorCrashField_Name, crash->userException.name);
+                    if(crash->userException.language != NULL)
+                    {
+                        writer->addStringElement(writer, GIOMonitorCrashField_Language, crash->userException.language);
+                    }
+                    if(crash->userException.lineOfCode != NULL)
+                    {
+                        writer->addStringElement(writer, GIOMonitorCrashField_LineOfCode, crash->userException.lineOfCode);
+                    }
+                    if(crash->userException.customStackTrace != NULL)
+                    {
+                        writer->addJSONElement(writer, GIOMonitorCrashField_Backtrace, crash->userException.customStackTrace, true);
+                    }
+                }
+                writer->endContainer(writer);
+                break;
+            }
+            case GIOMonitorCrashMonitorTypeSystem:
+            case GIOMonitorCrashMonitorTypeApplicationState:
+            case GIOMonitorCrashMonitorTypeZombie:
+                GIOMonitorCrashLOG_ERROR("Crash monitor type 0x%x shouldn't be able to cause events!", crash->crashType);
+                break;
+        }
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about app runtime, etc to the report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param monitorContext The event monitor context.
+ */
+static void writeAppStats(const GIOMonitorCrashReportWriter* const writer,
+                          const char* const key,
+                          const GIOMonitorCrash_MonitorContext* const monitorContext)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addBooleanElement(writer, GIOMonitorCrashField_AppActive, monitorContext->AppState.applicationIsActive);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_AppInFG, monitorContext->AppState.applicationIsInForeground);
+
+        writer->addIntegerElement(writer, GIOMonitorCrashField_LaunchesSinceCrash, monitorContext->AppState.launchesSinceLastCrash);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_SessionsSinceCrash, monitorContext->AppState.sessionsSinceLastCrash);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_ActiveTimeSinceCrash, monitorContext->AppState.activeDurationSinceLastCrash);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_BGTimeSinceCrash, monitorContext->AppState.backgroundDurationSinceLastCrash);
+
+        writer->addIntegerElement(writer, GIOMonitorCrashField_SessionsSinceLaunch, monitorContext->AppState.sessionsSinceLaunch);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_ActiveTimeSinceLaunch, monitorContext->AppState.activeDurationSinceLaunch);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_BGTimeSinceLaunch, monitorContext->AppState.backgroundDurationSinceLaunch);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write information about this process.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ */
+static void writeProcessState(const GIOMonitorCrashReportWriter* const writer,
+                              const char* const key,
+                              const GIOMonitorCrash_MonitorContext* const monitorContext)
+{
+    writer->beginObject(writer, key);
+    {
+        if(monitorContext->ZombieException.address != 0)
+        {
+            writer->beginObject(writer, GIOMonitorCrashField_LastDeallocedNSException);
+            {
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_Address, monitorContext->ZombieException.address);
+                writer->addStringElement(writer, GIOMonitorCrashField_Name, monitorContext->ZombieException.name);
+                writer->addStringElement(writer, GIOMonitorCrashField_Reason, monitorContext->ZombieException.reason);
+                writeAddressReferencedByString(writer, GIOMonitorCrashField_ReferencedObject, monitorContext->ZombieException.reason);
+            }
+            writer->endContainer(writer);
+        }
+    }
+    writer->endContainer(writer);
+}
+
+/** Write basic report information.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param type The report type.
+ *
+ * @param reportID The report ID.
+ *
+ * @param processName The process name.
+ *
+ * @param timestamp When the report was captured (seconds since 1970).
+ */
+static void writeReportInfo(const GIOMonitorCrashReportWriter* const writer,
+                            const char* const key,
+                            const char* const type,
+                            const char* const reportID,
+                            const char* const processName,
+                            const int64_t timestamp)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addStringElement(writer, GIOMonitorCrashField_Version, "x.x.x");
+        writer->addStringElement(writer, GIOMonitorCrashField_ID, reportID);
+        writer->addStringElement(writer, GIOMonitorCrashField_ProcessName, processName);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Timestamp, timestamp);
+        writer->addStringElement(writer, GIOMonitorCrashField_Type, type);
+    }
+    writer->endContainer(writer);
+}
+
+static void writeRecrash(const GIOMonitorCrashReportWriter* const writer,
+                         const char* const key,
+                         const char* crashReportPath)
+{
+    writer->addJSONFileElement(writer, key, crashReportPath, true);
+}
+
+
+#pragma mark Setup
+
+/** Prepare a report writer for use.
+ *
+ * @oaram writer The writer to prepare.
+ *
+ * @param context JSON writer contextual information.
+ */
+static void prepareReportWriter(GIOMonitorCrashReportWriter* const writer, GIOMonitorCrashJSONEncodeContext* const context)
+{
+    writer->addBooleanElement = addBooleanElement;
+    writer->addFloatingPointElement = addFloatingPointElement;
+    writer->addIntegerElement = addIntegerElement;
+    writer->addUIntegerElement = addUIntegerElement;
+    writer->addStringElement = addStringElement;
+    writer->addTextFileElement = addTextFileElement;
+    writer->addTextFileLinesElement = addTextLinesFromFile;
+    writer->addJSONFileElement = addJSONElementFromFile;
+    writer->addDataElement = addDataElement;
+    writer->beginDataElement = beginDataElement;
+    writer->appendDataElement = appendDataElement;
+    writer->endDataElement = endDataElement;
+    writer->addUUIDElement = addUUIDElement;
+    writer->addJSONElement = addJSONElement;
+    writer->beginObject = beginObject;
+    writer->beginArray = beginArray;
+    writer->endContainer = endContainer;
+    writer->context = context;
+}
+
+
+// ============================================================================
+#pragma mark - Main API -
+// ============================================================================
+
+void gioMonitorCrashReport_writeRecrashReport(const GIOMonitorCrash_MonitorContext* const monitorContext, const char* const path)
+{
+    char writeBuffer[1024];
+    GIOMonitorCrashBufferedWriter bufferedWriter;
+    static char tempPath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
+    strncpy(tempPath, path, sizeof(tempPath) - 10);
+    strncpy(tempPath + strlen(tempPath) - 5, ".old", 5);
+    GIOMonitorCrashLOG_INFO("Writing recrash report to %s", path);
+
+    if(rename(path, tempPath) < 0)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not rename %s to %s: %s", path, tempPath, strerror(errno));
+    }
+    if(!openReportFile(&bufferedWriter, path, writeBuffer, sizeof(writeBuffer)))
+    {
+        return;
+    }
+
+    gioMonitorCCD_freeze();
+
+    GIOMonitorCrashJSONEncodeContext jsonContext;
+    jsonContext.userData = &bufferedWriter;
+    GIOMonitorCrashReportWriter concreteWriter;
+    GIOMonitorCrashReportWriter* writer = &concreteWriter;
+    prepareReportWriter(writer, &jsonContext);
+
+    gioMonitorCrashJSON_beginEncode(getJsonContext(writer), true, addJSONData, &bufferedWriter);
+
+    writer->beginObject(writer, GIOMonitorCrashField_Report);
+    {
+        writeRecrash(writer, GIOMonitorCrashField_RecrashReport, tempPath);
+        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+        if(remove(tempPath) < 0)
+        {
+            GIOMonitorCrashLOG_ERROR("Could not remove %s: %s", tempPath, strerror(errno));
+        }
+        writeReportInfo(writer,
+                        GIOMonitorCrashField_Report,
+                        GIOMonitorCrashReportType_Minimal,
+                        monitorContext->eventID,
+                        monitorContext->System.processName,
+                        time(NULL));
+        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+
+        writer->beginObject(writer, GIOMonitorCrashField_Crash);
+        {
+            writeError(writer, GIOMonitorCrashField_Error, monitorContext);
+            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+            int threadIndex = gioMonitorCrashMachineContext_indexOfThread(monitorContext->offendingMachineContext,
+                                                 gioMonitorCrashMachineContext_getThreadFromContext(monitorContext->offendingMachineContext));
+            writeThread(writer,
+                        GIOMonitorCrashField_CrashedThread,
+                        monitorContext,
+                        monitorContext->offendingMachineContext,
+                        threadIndex,
+                        GIOMonitorCrashReportProfileStandard,
+                        false);
+            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+        }
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+
+    gioMonitorCrashJSON_endEncode(getJsonContext(writer));
+    gioMonitorCrashFileUtils_closeBufferedWriter(&bufferedWriter);
+    gioMonitorCCD_unfreeze();
+}
+
+static void writeSystemInfo(const GIOMonitorCrashReportWriter* const writer,
+                            const char* const key,
+                            const GIOMonitorCrash_MonitorContext* const monitorContext)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addStringElement(writer, GIOMonitorCrashField_SystemName, monitorContext->System.systemName);
+        writer->addStringElement(writer, GIOMonitorCrashField_SystemVersion, monitorContext->System.systemVersion);
+        writer->addStringElement(writer, GIOMonitorCrashField_Machine, monitorContext->System.machine);
+        writer->addStringElement(writer, GIOMonitorCrashField_Model, monitorContext->System.model);
+        writer->addStringElement(writer, GIOMonitorCrashField_KernelVersion, monitorContext->System.kernelVersion);
+        writer->addStringElement(writer, GIOMonitorCrashField_OSVersion, monitorContext->System.osVersion);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_Jailbroken, monitorContext->System.isJailbroken);
+        writer->addStringElement(writer, GIOMonitorCrashField_BootTime, monitorContext->System.bootTime);
+        writer->addStringElement(writer, GIOMonitorCrashField_AppStartTime, monitorContext->System.appStartTime);
+        writer->addStringElement(writer, GIOMonitorCrashField_ExecutablePath, monitorContext->System.executablePath);
+        writer->addStringElement(writer, GIOMonitorCrashField_Executable, monitorContext->System.executableName);
+        writer->addStringElement(writer, GIOMonitorCrashField_BundleID, monitorContext->System.bundleID);
+        writer->addStringElement(writer, GIOMonitorCrashField_BundleName, monitorContext->System.bundleName);
+        writer->addStringElement(writer, GIOMonitorCrashField_BundleVersion, monitorContext->System.bundleVersion);
+        writer->addStringElement(writer, GIOMonitorCrashField_BundleShortVersion, monitorContext->System.bundleShortVersion);
+        writer->addStringElement(writer, GIOMonitorCrashField_AppUUID, monitorContext->System.appID);
+        writer->addStringElement(writer, GIOMonitorCrashField_CPUArch, monitorContext->System.cpuArchitecture);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUType, monitorContext->System.cpuType);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUSubType, monitorContext->System.cpuSubType);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_BinaryCPUType, monitorContext->System.binaryCPUType);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_BinaryCPUSubType, monitorContext->System.binaryCPUSubType);
+        writer->addStringElement(writer, GIOMonitorCrashField_TimeZone, monitorContext->System.timezone);
+        writer->addStringElement(writer, GIOMonitorCrashField_ProcessName, monitorContext->System.processName);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_ProcessID, monitorContext->System.processID);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_ParentProcessID, monitorContext->System.parentProcessID);
+        writer->addStringElement(writer, GIOMonitorCrashField_DeviceAppHash, monitorContext->System.deviceAppHash);
+        writer->addStringElement(writer, GIOMonitorCrashField_BuildType, monitorContext->System.buildType);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Storage, (int64_t)monitorContext->System.storageSize);
+
+        writeMemoryInfo(writer, GIOMonitorCrashField_Memory, monitorContext);
+        writeAppStats(writer, GIOMonitorCrashField_AppStats, monitorContext);
+    }
+    writer->endContainer(writer);
+
+}
+
+/** Write a main thread hang profile.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param profile The profile to write (NULL = don't write anything).
+ */
+static void writeHangProfile(const GIOMonitorCrashReportWriter* const writer,
+                             const char* const key,
+                             const GIOMonitorCrashHangProfile* const profile)
+{
+    if(profile == NULL)
+    {
+        return;
+    }
+
     writer->beginObject(writer, key);
     {
-        writer->addStringElement(writer, GIOMonitorCrashField_Version, "x.x.x");
-        writer->addStringElement(writer, GIOMonitorCrashField_ID, reportID);
-        writer->addStringElement(writer, GIOMonitorCrashField_ProcessName, processName);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_Timestamp, time(NULL));
-        writer->addStringElement(writer, GIOMonitorCrashField_Type, type);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_Duration, profile->duration);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_SampleInterval, profile->sampleInterval);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_SampleCount, profile->sampleCount);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_DroppedSamples, profile->droppedSampleCount);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_InProgress, profile->isInProgress);
+        writer->beginArray(writer, GIOMonitorCrashField_Stacks);
+        {
+            for(int i = 0; i < profile->stackCount; i++)
+            {
+                const GIOMonitorCrashHangStack* stack = &profile->stacks[i];
+                GIOMonitorCrashStackCursor stackCursor;
+                gioMonitorCrashStackCursor_initWithBacktrace(&stackCursor, &profile->addresses[stack->firstAddress], stack->length, 0);
+                writer->beginObject(writer, NULL);
+                {
+                    writer->addIntegerElement(writer, GIOMonitorCrashField_Count, stack->sampleCount);
+                    writeBacktrace(writer, GIOMonitorCrashField_Backtrace, &stackCursor);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+}
+
+typedef struct
+{
+    const GIOMonitorCrashReportWriter* writer;
+    const char* key;
+    bool hasBegun;
+} GIOMonitorCrash_SuppressedSnapshotsWriter;
+
+static void writeSuppressedSnapshotCounts(const char* name, int rateLimitedCount, int sampledOutCount, void* userData)
+{
+    GIOMonitorCrash_SuppressedSnapshotsWriter* const state = userData;
+    const GIOMonitorCrashReportWriter* const writer = state->writer;
+    if(!state->hasBegun)
+    {
+        writer->beginObject(writer, state->key);
+        state->hasBegun = true;
+    }
+    writer->beginObject(writer, name);
+    {
+        writer->addIntegerElement(writer, GIOMonitorCrashField_RateLimited, rateLimitedCount);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_SampledOut, sampledOutCount);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write how many user reported snapshots were suppressed since the last
+ * kept report, by exception name. The counts are only reset once the caller
+ * knows this report is kept, with gioMonitorCrashSnapshotLimiter_commitSuppressedCounts().
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ */
+static void writeSuppressedSnapshots(const GIOMonitorCrashReportWriter* const writer, const char* const key)
+{
+    GIOMonitorCrash_SuppressedSnapshotsWriter state = {writer, key, false};
+    gioMonitorCrashSnapshotLimiter_peekSuppressedCounts(writeSuppressedSnapshotCounts, &state);
+    if(state.hasBegun)
+    {
+        writer->endContainer(writer);
+    }
+}
+
+static void writeDebugInfo(const GIOMonitorCrashReportWriter* const writer,
+                            const char* const key,
+                            const GIOMonitorCrash_MonitorContext* const monitorContext,
+                            const GIOMonitorCrashReportProfile profile)
+{
+    uint64_t startTime = getMonotonicTimeNanoseconds();
+    writer->beginObject(writer, key);
+    {
+        if(monitorContext->consoleLogPath != NULL &&
+           profile != GIOMonitorCrashReportProfileMinimal &&
+           shouldWriteLowPrioritySection(GIOMonitorCrash_DroppedSection_ConsoleLog))
+        {
+            gioMonitorCrashLog_flushRingBuffer();
+            int logLength = 0;
+            const char* log = gioMonitorCrashLog_getLogTail(&logLength);
+            if(log != NULL)
+            {
+                addTextLinesFromBuffer(writer, GIOMonitorCrashField_ConsoleLog, log, logLength);
+            }
+            else
+            {
+                addTextLinesFromFile(writer, GIOMonitorCrashField_ConsoleLog, monitorContext->consoleLogPath);
+            }
+        }
+        writeHangProfile(writer, GIOMonitorCrashField_HangProfile, gioMonitorCrashHangProfile_get());
+        endSectionTiming(GIOMonitorCrashReportSection_Debug, startTime);
+        writer->addStringElement(writer, GIOMonitorCrashField_ReportProfile, g_profileNames[profile]);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_ThreadsSuspended, !monitorContext->threadsNotSuspended);
+        writeSuppressedSnapshots(writer, GIOMonitorCrashField_SuppressedSnapshots);
+        writeTruncation(writer, GIOMonitorCrashField_Truncation);
+        writeReportTiming(writer, GIOMonitorCrashField_ReportTiming);
+    }
+    writer->endContainer(writer);
+
+}
+
+void gioMonitorCrashReport_writeStandardReport(const GIOMonitorCrash_MonitorContext* const monitorContext, const char* const path)
+{
+    GIOMonitorCrashLOG_INFO("Writing crash report to %s", path);
+    g_lastFingerprint = 0;
+    char writeBuffer[1024];
+    GIOMonitorCrashBufferedWriter bufferedWriter;
+
+    if(!openReportFile(&bufferedWriter, path, writeBuffer, sizeof(writeBuffer)))
+    {
+        return;
+    }
+
+    const GIOMonitorCrashReportProfile profile = getReportProfile(monitorContext);
+    const bool shouldWriteNotableAddresses = profile == GIOMonitorCrashReportProfileForensic ||
+        (profile == GIOMonitorCrashReportProfileStandard && g_introspectionRules.enabled);
+    GIOMonitorCrashLOG_DEBUG("Using the %s report profile.", g_profileNames[profile]);
+
+    beginReportTiming();
+    beginWriteBudget();
+    gioMonitorCCD_freeze();
+    if(shouldWriteNotableAddresses)
+    {
+        gioMonitorCrashMem_snapshotReadableRegions();
+    }
+
+    GIOMonitorCrashJSONEncodeContext jsonContext;
+    jsonContext.userData = &bufferedWriter;
+    GIOMonitorCrashReportWriter concreteWriter;
+    GIOMonitorCrashReportWriter* writer = &concreteWriter;
+    prepareReportWriter(writer, &jsonContext);
+
+    gioMonitorCrashJSON_beginEncode(getJsonContext(writer), true, addJSONData, &bufferedWriter);
+
+    uint64_t startTime;
+    writer->beginObject(writer, GIOMonitorCrashField_Report);
+    {
+        startTime = getMonotonicTimeNanoseconds();
+        writeReportInfo(writer,
+                        GIOMonitorCrashField_Report,
+                        GIOMonitorCrashReportType_Standard,
+                        monitorContext->eventID,
+                        monitorContext->System.processName,
+                        time(NULL));
+        endSectionTiming(GIOMonitorCrashReportSection_ReportInfo, startTime);
+
+        startTime = getMonotonicTimeNanoseconds();
+        writeBinaryImages(writer, GIOMonitorCrashField_BinaryImages);
+        endSectionTiming(GIOMonitorCrashReportSection_BinaryImages, startTime);
+
+        startTime = getMonotonicTimeNanoseconds();
+        writeProcessState(writer, GIOMonitorCrashField_ProcessState, monitorContext);
+        endSectionTiming(GIOMonitorCrashReportSection_ProcessState, startTime);
+
+        startTime = getMonotonicTimeNanoseconds();
+        writeSystemInfo(writer, GIOMonitorCrashField_System, monitorContext);
+        endSectionTiming(GIOMonitorCrashReportSection_System, startTime);
+
+        writer->beginObject(writer, GIOMonitorCrashField_Crash);
+        {
+            startTime = getMonotonicTimeNanoseconds();
+            writeError(writer, GIOMonitorCrashField_Error, monitorContext);
+            endSectionTiming(GIOMonitorCrashReportSection_Error, startTime);
+            // The buffer otherwise only goes to disk when it fills up. Walking
+            // stacks and introspecting memory are what most often fault, so
+            // make sure everything before them is kept.
+            flushReport(&bufferedWriter);
+            startTime = getMonotonicTimeNanoseconds();
+            beginFingerprint(monitorContext);
+            writeAllThreads(writer,
+                            GIOMonitorCrashField_Threads,
+                            monitorContext,
+                            profile,
+                            shouldWriteNotableAddresses);
+            g_lastFingerprint = endFingerprint();
+            if(g_lastFingerprint != 0)
+            {
+                writeFingerprint(writer, GIOMonitorCrashField_Fingerprint, g_lastFingerprint);
+            }
+            endSectionTiming(GIOMonitorCrashReportSection_Threads, startTime);
+        }
+        writer->endContainer(writer);
+
+        startTime = getMonotonicTimeNanoseconds();
+        if(g_userInfoJSON != NULL)
+        {
+            addJSONElement(writer, GIOMonitorCrashField_User, g_userInfoJSON, false);
+            endSectionTiming(GIOMonitorCrashReportSection_User, startTime);
+        }
+        else
+        {
+            writer->beginObject(writer, GIOMonitorCrashField_User);
+        }
+        if(g_userSectionWriteCallback != NULL)
+        {
+            if (monitorContext->currentSnapshotUserReported == false) {
+                // The user's callback may fault too.
+                flushReport(&bufferedWriter);
+                startTime = getMonotonicTimeNanoseconds();
+                g_userSectionWriteCallback(writer);
+                endSectionTiming(GIOMonitorCrashReportSection_UserCallback, startTime);
+            }
+        }
+        writer->endContainer(writer);
+
+        writeDebugInfo(writer, GIOMonitorCrashField_Debug, monitorContext, profile);
+    }
+    writer->endContainer(writer);
+
+    gioMonitorCrashJSON_endEncode(getJsonContext(writer));
+    gioMonitorCrashFileUtils_closeBufferedWriter(&bufferedWriter);
+    endWriteBudget();
+    endReportTiming();
+    gioMonitorCrashMem_clearReadableRegions();
+    gioMonitorCCD_unfreeze();
+    gioMonitorCrashLog_flushRingBuffer();
+}
+
+
+/** Symbolicate a frame of a raw capture. The frame is attributed to the
+ * captured image containing it. If the same image (by UUID) is loaded in this
+ * process, the symbol is looked up there and moved back to the captured
+ * image's address.
+ *
+ * @param cursor The cursor, positioned on a captured frame.
+ *
+ * @return true if the frame is inside a captured image.
+ */
+static bool symbolicateRawCaptureFrame(GIOMonitorCrashStackCursor* cursor)
+{
+    const GIOMonitorCrashRawCapture* capture = g_rawCaptureFormatting.capture;
+    cursor->stackEntry.imageAddress = 0;
+    cursor->stackEntry.imageName = NULL;
+    cursor->stackEntry.symbolAddress = 0;
+    cursor->stackEntry.symbolName = NULL;
+
+    // Return addresses point past the call.
+    uintptr_t address = CALL_INSTRUCTION_FROM_RETURN_ADDRESS(cursor->stackEntry.address);
+    for(int i = 0; i < capture->imageCount; i++)
+    {
+        const GIOMonitorCrashRawImage* image = &capture->images[i];
+        if(address < image->address || address - image->address >= image->size)
+        {
+            continue;
+        }
+        cursor->stackEntry.imageAddress = (uintptr_t)image->address;
+        cursor->stackEntry.imageName = image->name;
+
+        uintptr_t loadAddress = g_rawCaptureFormatting.loadAddresses[i];
+        if(loadAddress == 0)
+        {
+            return true;
+        }
+        GIOMonitorCrash_RawCaptureSymbol* symbol =
+            &g_rawCaptureFormatting.symbolCache[(address >> 2) % kRawCaptureSymbolCacheSize];
+        if(symbol->address != address)
+        {
+            Dl_info info;
+            symbol->address = address;
+            symbol->symbolName = NULL;
+            symbol->symbolAddress = 0;
+            if(dladdr((const void*)(loadAddress + (address - (uintptr_t)image->address)), &info) != 0 &&
+               info.dli_sname != NULL)
+            {
+                symbol->symbolName = info.dli_sname;
+                symbol->symbolAddress = (uintptr_t)info.dli_saddr - loadAddress + (uintptr_t)image->address;
+            }
+        }
+        cursor->stackEntry.symbolName = symbol->symbolName;
+        cursor->stackEntry.symbolAddress = symbol->symbolAddress;
+        return true;
+    }
+    return false;
+}
+
+/** Find where each captured image is loaded in this process.
+ *
+ * @param capture The capture.
+ *
+ * @return The load address of each captured image (0 = not loaded), or NULL if out of memory.
+ */
+static uintptr_t* getRawCaptureLoadAddresses(const GIOMonitorCrashRawCapture* const capture)
+{
+    uintptr_t* loadAddresses = calloc((size_t)capture->imageCount + 1, sizeof(*loadAddresses));
+    if(loadAddresses == NULL)
+    {
+        return NULL;
+    }
+    const int imageCount = gioMonitorCrashDynamicLinker_imageCount();
+    for(int iImg = 0; iImg < imageCount; iImg++)
+    {
+        GIOMonitorCrashBinaryImage image = {0};
+        if(!gioMonitorCrashDynamicLinker_getBinaryImage(iImg, &image) || image.uuid == NULL)
+        {
+            continue;
+        }
+        for(int i = 0; i < capture->imageCount; i++)
+        {
+            if(memcmp(capture->images[i].uuid, image.uuid, sizeof(capture->images[i].uuid)) == 0)
+            {
+                loadAddresses[i] = (uintptr_t)image.address;
+            }
+        }
+    }
+    return loadAddresses;
+}
+
+static void writeRawCaptureImages(const GIOMonitorCrashReportWriter* const writer,
+                                  const char* const key,
+                                  const GIOMonitorCrashRawCapture* const capture)
+{
+    writer->beginArray(writer, key);
+    {
+        for(int i = 0; i < capture->imageCount; i++)
+        {
+            const GIOMonitorCrashRawImage* image = &capture->images[i];
+            writer->beginObject(writer, NULL);
+            {
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageAddress, image->address);
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageVmAddress, image->vmAddress);
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageSize, image->size);
+                writer->addStringElement(writer, GIOMonitorCrashField_Name, image->name);
+                writer->addUUIDElement(writer, GIOMonitorCrashField_UUID, image->uuid);
+                writer->addIntegerElement(writer, GIOMonitorCrashField_CPUType, image->cpuType);
+                writer->addIntegerElement(writer, GIOMonitorCrashField_CPUSubType, image->cpuSubType);
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMajorVersion, image->majorVersion);
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageMinorVersion, image->minorVersion);
+                writer->addUIntegerElement(writer, GIOMonitorCrashField_ImageRevisionVersion, image->revisionVersion);
+            }
+            writer->endContainer(writer);
+        }
+    }
+    writer->endContainer(writer);
+}
+
+static void writeRawCaptureRegisters(const GIOMonitorCrashReportWriter* const writer,
+                                     const char* const key,
+                                     const uint64_t* const registers,
+                                     const int registerCount,
+                                     const char* (*getRegisterName)(int regNumber))
+{
+    char registerNameBuff[30];
+    const char* registerName;
+    writer->beginObject(writer, key);
+    {
+        for(int reg = 0; reg < registerCount; reg++)
+        {
+            registerName = getRegisterName(reg);
+            if(registerName == NULL)
+            {
+                snprintf(registerNameBuff, sizeof(registerNameBuff), "r%d", reg);
+                registerName = registerNameBuff;
+            }
+            writer->addUIntegerElement(writer, registerName, registers[reg]);
+        }
+    }
+    writer->endContainer(writer);
+}
+
+static void writeRawCaptureStack(const GIOMonitorCrashReportWriter* const writer,
+                                 const char* const key,
+                                 const GIOMonitorCrashRawCapture* const capture)
+{
+    if(capture->stack.stackPointer == 0)
+    {
+        return;
+    }
+
+    writer->beginObject(writer, key);
+    {
+        writer->addStringElement(writer, GIOMonitorCrashField_GrowDirection, capture->stack.growDirection > 0 ? "+" : "-");
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpStart, capture->stack.dumpStart);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_DumpEnd, capture->stack.dumpEnd);
+        writer->addUIntegerElement(writer, GIOMonitorCrashField_StackPtr, capture->stack.stackPointer);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_Overflow, capture->stack.isOverflow);
+        if(capture->stack.length > 0)
+        {
+            writer->addDataElement(writer, GIOMonitorCrashField_Contents, (const char*)capture->stack.contents, capture->stack.length);
+        }
+        else
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_Error, "Stack contents not accessible");
+        }
+    }
+    writer->endContainer(writer);
+}
+
+static void writeRawCaptureThread(const GIOMonitorCrashReportWriter* const writer,
+                                  const char* const key,
+                                  const GIOMonitorCrashRawCapture* const capture,
+                                  const GIOMonitorCrashRawThread* const thread)
+{
+    writer->beginObject(writer, key);
+    {
+        GIOMonitorCrashStackCursor stackCursor;
+        gioMonitorCrashStackCursor_initWithBacktrace(&stackCursor, thread->backtrace, thread->backtraceLength, 0);
+        stackCursor.symbolicate = symbolicateRawCaptureFrame;
+        g_fingerprint.framesLeft = thread->isCrashed ? kFingerprintFrameCount : 0;
+        writeBacktrace(writer, GIOMonitorCrashField_Backtrace, &stackCursor);
+        g_fingerprint.framesLeft = 0;
+        if(thread->registers != NULL)
+        {
+            writer->beginObject(writer, GIOMonitorCrashField_Registers);
+            {
+                writeRawCaptureRegisters(writer, GIOMonitorCrashField_Basic,
+                                         thread->registers, thread->registerCount,
+                                         gioMonitorCrashCpu_registerName);
+                if(thread->exceptionRegisters != NULL)
+                {
+                    writeRawCaptureRegisters(writer, GIOMonitorCrashField_Exception,
+                                             thread->exceptionRegisters, thread->exceptionRegisterCount,
+                                             gioMonitorCrashCpu_exceptionRegisterName);
+                }
+            }
+            writer->endContainer(writer);
+        }
+        writer->addIntegerElement(writer, GIOMonitorCrashField_Index, thread->index);
+        if(thread->name != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_Name, thread->name);
+        }
+        if(thread->dispatchQueue != NULL)
+        {
+            writer->addStringElement(writer, GIOMonitorCrashField_DispatchQueue, thread->dispatchQueue);
+        }
+        writer->addBooleanElement(writer, GIOMonitorCrashField_Crashed, thread->isCrashed);
+        writer->addBooleanElement(writer, GIOMonitorCrashField_CurrentThread, thread->isCurrentThread);
+        if(thread->isCrashed)
+        {
+            writeRawCaptureStack(writer, GIOMonitorCrashField_Stack, capture);
+        }
     }
     writer->endContainer(writer);
 }
 
-static void writeRecrash(const GIOMonitorCrashReportWriter* const writer,
-                         const char* const key,
-                         const char* crashReportPath)
-{
-    writer->addJSONFileElement(writer, key, crashReportPath, true);
-}
-
-
-#pragma mark Setup
-
-/** Prepare a report writer for use.
- *
- * @oaram writer The writer to prepare.
- *
- * @param context JSON writer contextual information.
- */
-static void prepareReportWriter(GIOMonitorCrashReportWriter* const writer, GIOMonitorCrashJSONEncodeContext* const context)
+bool gioMonitorCrashReport_writeRawCapture(const GIOMonitorCrash_MonitorContext* const monitorContext, const char* const path)
 {
-    writer->addBooleanElement = addBooleanElement;
-    writer->addFloatingPointElement = addFloatingPointElement;
-    writer->addIntegerElement = addIntegerElement;
-    writer->addUIntegerElement = addUIntegerElement;
-    writer->addStringElement = addStringElement;
-    writer->addTextFileElement = addTextFileElement;
-    writer->addTextFileLinesElement = addTextLinesFromFile;
-    writer->addJSONFileElement = addJSONElementFromFile;
-    writer->addDataElement = addDataElement;
-    writer->beginDataElement = beginDataElement;
-    writer->appendDataElement = appendDataElement;
-    writer->endDataElement = endDataElement;
-    writer->addUUIDElement = addUUIDElement;
-    writer->addJSONElement = addJSONElement;
-    writer->beginObject = beginObject;
-    writer->beginArray = beginArray;
-    writer->endContainer = endContainer;
-    writer->context = context;
+    g_lastFingerprint = 0;
+    return gioMonitorCrashRawCapture_write(monitorContext, g_userInfoJSON, path);
 }
 
-
-// ============================================================================
-#pragma mark - Main API -
-// ============================================================================
-
-void gioMonitorCrashReport_writeRecrashReport(const GIOMonitorCrash_MonitorContext* const monitorContext, const char* const path)
+bool gioMonitorCrashReport_writeStandardReportFromRawCapture(const char* const capturePath, const char* const path)
 {
+    GIOMonitorCrashRawCapture capture;
+    if(!gioMonitorCrashRawCapture_read(capturePath, &capture))
+    {
+        return false;
+    }
+    GIOMonitorCrashLOG_INFO("Writing crash report for %s to %s", capturePath, path);
+    g_lastFingerprint = 0;
     char writeBuffer[1024];
     GIOMonitorCrashBufferedWriter bufferedWriter;
-    static char tempPath[GIOMonitorCrashFU_MAX_PATH_LENGTH];
-    strncpy(tempPath, path, sizeof(tempPath) - 10);
-    strncpy(tempPath + strlen(tempPath) - 5, ".old", 5);
-    GIOMonitorCrashLOG_INFO("Writing recrash report to %s", path);
 
-    if(rename(path, tempPath) < 0)
+    g_rawCaptureFormatting.loadAddresses = getRawCaptureLoadAddresses(&capture);
+    if(g_rawCaptureFormatting.loadAddresses == NULL ||
+       !gioMonitorCrashFileUtils_openBufferedWriter(&bufferedWriter, path, writeBuffer, sizeof(writeBuffer)))
     {
-        GIOMonitorCrashLOG_ERROR("Could not rename %s to %s: %s", path, tempPath, strerror(errno));
+        free(g_rawCaptureFormatting.loadAddresses);
+        g_rawCaptureFormatting.loadAddresses = NULL;
+        gioMonitorCrashRawCapture_free(&capture);
+        return false;
     }
-    if(!gioMonitorCrashFileUtils_openBufferedWriter(&bufferedWriter, path, writeBuffer, sizeof(writeBuffer)))
+    g_rawCaptureFormatting.capture = &capture;
+    memset(g_rawCaptureFormatting.symbolCache, 0, sizeof(g_rawCaptureFormatting.symbolCache));
+    // Written with this process's own counts, and kept for the next report
+    // if this one is coalesced away.
+    for(int i = 0; i < capture.suppressedSnapshotsCount; i++)
     {
-        return;
+        gioMonitorCrashSnapshotLimiter_addSuppressedCounts(capture.suppressedSnapshots[i].name,
+                                                           capture.suppressedSnapshots[i].rateLimitedCount,
+                                                           capture.suppressedSnapshots[i].sampledOutCount);
     }
-
-    gioMonitorCCD_freeze();
+    const GIOMonitorCrash_MonitorContext* const monitorContext = &capture.context;
 
     GIOMonitorCrashJSONEncodeContext jsonContext;
     jsonContext.userData = &bufferedWriter;
@@ -1618,32 +3049,70 @@ void gioMonitorCrashReport_writeRecrashReport(const GIOMonitorCrash_MonitorConte
 
     writer->beginObject(writer, GIOMonitorCrashField_Report);
     {
-        writeRecrash(writer, GIOMonitorCrashField_RecrashReport, tempPath);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-        if(remove(tempPath) < 0)
-        {
-            GIOMonitorCrashLOG_ERROR("Could not remove %s: %s", tempPath, strerror(errno));
-        }
         writeReportInfo(writer,
                         GIOMonitorCrashField_Report,
-                        GIOMonitorCrashReportType_Minimal,
+                        GIOMonitorCrashReportType_Standard,
                         monitorContext->eventID,
-                        monitorContext->System.processName);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+                        monitorContext->System.processName,
+                        capture.timestamp);
+        writeRawCaptureImages(writer, GIOMonitorCrashField_BinaryImages, &capture);
+        writeProcessState(writer, GIOMonitorCrashField_ProcessState, monitorContext);
+        writeSystemInfo(writer, GIOMonitorCrashField_System, monitorContext);
 
         writer->beginObject(writer, GIOMonitorCrashField_Crash);
         {
             writeError(writer, GIOMonitorCrashField_Error, monitorContext);
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-            int threadIndex = gioMonitorCrashMachineContext_indexOfThread(monitorContext->offendingMachineContext,
-                                                 gioMonitorCrashMachineContext_getThreadFromContext(monitorContext->offendingMachineContext));
-            writeThread(writer,
-                        GIOMonitorCrashField_CrashedThread,
-                        monitorContext,
-                        monitorContext->offendingMachineContext,
-                        threadIndex,
-                        false);
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
+            beginFingerprint(monitorContext);
+            writer->beginArray(writer, GIOMonitorCrashField_Threads);
+            {
+                for(int i = 0; i < capture.threadCount; i++)
+                {
+                    writeRawCaptureThread(writer, NULL, &capture, &capture.threads[i]);
+                }
+            }
+            writer->endContainer(writer);
+            g_lastFingerprint = endFingerprint();
+            if(g_lastFingerprint != 0)
+            {
+                writeFingerprint(writer, GIOMonitorCrashField_Fingerprint, g_lastFingerprint);
+            }
+        }
+        writer->endContainer(writer);
+
+        // The user section callback can only run at crash time, so it isn't called.
+        if(capture.userInfoJSON != NULL)
+        {
+            addJSONElement(writer, GIOMonitorCrashField_User, capture.userInfoJSON, false);
+        }
+        else
+        {
+            writer->beginObject(writer, GIOMonitorCrashField_User);
+        }
+        writer->endContainer(writer);
+
+        writer->beginObject(writer, GIOMonitorCrashField_Debug);
+        {
+            if(capture.consoleLog != NULL)
+            {
+                addTextLinesFromBuffer(writer, GIOMonitorCrashField_ConsoleLog, capture.consoleLog, capture.consoleLogLength);
+            }
+            else if(monitorContext->consoleLogPath != NULL)
+            {
+                addTextLinesFromFile(writer, GIOMonitorCrashField_ConsoleLog, monitorContext->consoleLogPath);
+            }
+            writeHangProfile(writer, GIOMonitorCrashField_HangProfile, capture.hangProfile);
+            writer->addBooleanElement(writer, GIOMonitorCrashField_ThreadsSuspended, !monitorContext->threadsNotSuspended);
+            writeSuppressedSnapshots(writer, GIOMonitorCrashField_SuppressedSnapshots);
+            if(capture.isTruncated)
+            {
+                // The crash handler didn't finish the capture, so anything after
+                // the last complete record is missing from this report.
+                writer->beginObject(writer, GIOMonitorCrashField_Truncation);
+                {
+                    writer->addStringElement(writer, GIOMonitorCrashField_Reason, "incomplete_capture");
+                }
+                writer->endContainer(writer);
+            }
         }
         writer->endContainer(writer);
     }
@@ -1651,69 +3120,93 @@ void gioMonitorCrashReport_writeRecrashReport(const GIOMonitorCrash_MonitorConte
 
     gioMonitorCrashJSON_endEncode(getJsonContext(writer));
     gioMonitorCrashFileUtils_closeBufferedWriter(&bufferedWriter);
-    gioMonitorCCD_unfreeze();
+
+    g_rawCaptureFormatting.capture = NULL;
+    free(g_rawCaptureFormatting.loadAddresses);
+    g_rawCaptureFormatting.loadAddresses = NULL;
+    gioMonitorCrashRawCapture_free(&capture);
+    return true;
 }
 
-static void writeSystemInfo(const GIOMonitorCrashReportWriter* const writer,
+/** Write the call tree of a CPU profile. Nodes are written in trie order, so
+ * a node's parent (its caller) always comes before it.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param profile The profile to write.
+ */
+static void writeCPUProfile(const GIOMonitorCrashReportWriter* const writer,
                             const char* const key,
-                            const GIOMonitorCrash_MonitorContext* const monitorContext)
+                            const GIOMonitorCrashCPUProfile* const profile)
 {
+    const GIOMonitorCrashStackTrie* callTree = profile->callTree;
     writer->beginObject(writer, key);
     {
-        writer->addStringElement(writer, GIOMonitorCrashField_SystemName, monitorContext->System.systemName);
-        writer->addStringElement(writer, GIOMonitorCrashField_SystemVersion, monitorContext->System.systemVersion);
-        writer->addStringElement(writer, GIOMonitorCrashField_Machine, monitorContext->System.machine);
-        writer->addStringElement(writer, GIOMonitorCrashField_Model, monitorContext->System.model);
-        writer->addStringElement(writer, GIOMonitorCrashField_KernelVersion, monitorContext->System.kernelVersion);
-        writer->addStringElement(writer, GIOMonitorCrashField_OSVersion, monitorContext->System.osVersion);
-        writer->addBooleanElement(writer, GIOMonitorCrashField_Jailbroken, monitorContext->System.isJailbroken);
-        writer->addStringElement(writer, GIOMonitorCrashField_BootTime, monitorContext->System.bootTime);
-        writer->addStringElement(writer, GIOMonitorCrashField_AppStartTime, monitorContext->System.appStartTime);
-        writer->addStringElement(writer, GIOMonitorCrashField_ExecutablePath, monitorContext->System.executablePath);
-        writer->addStringElement(writer, GIOMonitorCrashField_Executable, monitorContext->System.executableName);
-        writer->addStringElement(writer, GIOMonitorCrashField_BundleID, monitorContext->System.bundleID);
-        writer->addStringElement(writer, GIOMonitorCrashField_BundleName, monitorContext->System.bundleName);
-        writer->addStringElement(writer, GIOMonitorCrashField_BundleVersion, monitorContext->System.bundleVersion);
-        writer->addStringElement(writer, GIOMonitorCrashField_BundleShortVersion, monitorContext->System.bundleShortVersion);
-        writer->addStringElement(writer, GIOMonitorCrashField_AppUUID, monitorContext->System.appID);
-        writer->addStringElement(writer, GIOMonitorCrashField_CPUArch, monitorContext->System.cpuArchitecture);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUType, monitorContext->System.cpuType);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_CPUSubType, monitorContext->System.cpuSubType);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_BinaryCPUType, monitorContext->System.binaryCPUType);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_BinaryCPUSubType, monitorContext->System.binaryCPUSubType);
-        writer->addStringElement(writer, GIOMonitorCrashField_TimeZone, monitorContext->System.timezone);
-        writer->addStringElement(writer, GIOMonitorCrashField_ProcessName, monitorContext->System.processName);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_ProcessID, monitorContext->System.processID);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_ParentProcessID, monitorContext->System.parentProcessID);
-        writer->addStringElement(writer, GIOMonitorCrashField_DeviceAppHash, monitorContext->System.deviceAppHash);
-        writer->addStringElement(writer, GIOMonitorCrashField_BuildType, monitorContext->System.buildType);
-        writer->addIntegerElement(writer, GIOMonitorCrashField_Storage, (int64_t)monitorContext->System.storageSize);
-
-        writeMemoryInfo(writer, GIOMonitorCrashField_Memory, monitorContext);
-        writeAppStats(writer, GIOMonitorCrashField_AppStats, monitorContext);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_Duration, profile->duration);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_SampleInterval, profile->sampleInterval);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_SamplingTime, profile->samplingTime);
+        writer->addFloatingPointElement(writer, GIOMonitorCrashField_CPUTime, profile->cpuTime);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_PassCount, profile->passCount);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_SampleCount, profile->sampleCount);
+        writer->addIntegerElement(writer, GIOMonitorCrashField_DroppedSamples, profile->droppedSampleCount);
+        writer->beginArray(writer, GIOMonitorCrashField_Nodes);
+        {
+            for(int i = 0; i < callTree->nodeCount; i++)
+            {
+                const GIOMonitorCrashStackTrieNode* node = &callTree->nodes[i];
+                GIOMonitorCrashStackCursor stackCursor;
+                gioMonitorCrashStackCursor_initWithBacktrace(&stackCursor, &node->address, 1, 0);
+                stackCursor.advanceCursor(&stackCursor);
+                writer->beginObject(writer, NULL);
+                {
+                    writer->addIntegerElement(writer, GIOMonitorCrashField_Parent, node->parent);
+                    writer->addIntegerElement(writer, GIOMonitorCrashField_Count, node->refCount);
+                    writeBacktraceEntry(writer, &stackCursor);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
     }
     writer->endContainer(writer);
+}
 
+void gioMonitorCrashReport_getTimings(GIOMonitorCrashReportTimings* const timings)
+{
+    copyTiming(&timings->report, &g_timings.report);
+    for(int i = 0; i < GIOMonitorCrashReportSectionCount; i++)
+    {
+        copyTiming(&timings->sections[i], &g_timings.sections[i]);
+    }
+    copyTiming(&timings->thread, &g_timings.thread);
 }
 
-static void writeDebugInfo(const GIOMonitorCrashReportWriter* const writer,
-                            const char* const key,
-                            const GIOMonitorCrash_MonitorContext* const monitorContext)
+void gioMonitorCrashReport_resetTimings(void)
 {
-    writer->beginObject(writer, key);
+    resetTiming(&g_timings.report);
+    for(int i = 0; i < GIOMonitorCrashReportSectionCount; i++)
     {
-        if(monitorContext->consoleLogPath != NULL)
-        {
-            addTextLinesFromFile(writer, GIOMonitorCrashField_ConsoleLog, monitorContext->consoleLogPath);
-        }
+        resetTiming(&g_timings.sections[i]);
     }
-    writer->endContainer(writer);
+    resetTiming(&g_timings.thread);
+}
 
+const char* gioMonitorCrashReport_getSectionName(GIOMonitorCrashReportSection section)
+{
+    if((int)section < 0 || section >= GIOMonitorCrashReportSectionCount)
+    {
+        return NULL;
+    }
+    return g_sectionNames[section];
 }
 
-void gioMonitorCrashReport_writeStandardReport(const GIOMonitorCrash_MonitorContext* const monitorContext, const char* const path)
+void gioMonitorCrashReport_writeCPUProfileReport(const GIOMonitorCrashCPUProfile* const profile,
+                                         const char* const reportID,
+                                         const char* const path)
 {
-    GIOMonitorCrashLOG_INFO("Writing crash report to %s", path);
+    GIOMonitorCrashLOG_DEBUG("Writing CPU profile to %s", path);
     char writeBuffer[1024];
     GIOMonitorCrashBufferedWriter bufferedWriter;
 
@@ -1722,75 +3215,35 @@ void gioMonitorCrashReport_writeStandardReport(const GIOMonitorCrash_MonitorCont
         return;
     }
 
-    gioMonitorCCD_freeze();
-
     GIOMonitorCrashJSONEncodeContext jsonContext;
     jsonContext.userData = &bufferedWriter;
     GIOMonitorCrashReportWriter concreteWriter;
     GIOMonitorCrashReportWriter* writer = &concreteWriter;
     prepareReportWriter(writer, &jsonContext);
 
-    gioMonitorCrashJSON_beginEncode(getJsonContext(writer), true, addJSONData, &bufferedWriter);
+    gioMonitorCrashJSON_beginEncode(getJsonContext(writer), false, addJSONData, &bufferedWriter);
 
     writer->beginObject(writer, GIOMonitorCrashField_Report);
     {
         writeReportInfo(writer,
                         GIOMonitorCrashField_Report,
-                        GIOMonitorCrashReportType_Standard,
-                        monitorContext->eventID,
-                        monitorContext->System.processName);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-
+                        GIOMonitorCrashReportType_CPUProfile,
+                        reportID,
+                        getprogname(),
+                        time(NULL));
         writeBinaryImages(writer, GIOMonitorCrashField_BinaryImages);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-
-        writeProcessState(writer, GIOMonitorCrashField_ProcessState, monitorContext);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-
-        writeSystemInfo(writer, GIOMonitorCrashField_System, monitorContext);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-
-        writer->beginObject(writer, GIOMonitorCrashField_Crash);
-        {
-            writeError(writer, GIOMonitorCrashField_Error, monitorContext);
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-            writeAllThreads(writer,
-                            GIOMonitorCrashField_Threads,
-                            monitorContext,
-                            g_introspectionRules.enabled);
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-        }
-        writer->endContainer(writer);
-
-        if(g_userInfoJSON != NULL)
-        {
-            addJSONElement(writer, GIOMonitorCrashField_User, g_userInfoJSON, false);
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-        }
-        else
-        {
-            writer->beginObject(writer, GIOMonitorCrashField_User);
-        }
-        if(g_userSectionWriteCallback != NULL)
-        {
-            gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-            if (monitorContext->currentSnapshotUserReported == false) {
-                g_userSectionWriteCallback(writer);
-            }
-        }
-        writer->endContainer(writer);
-        gioMonitorCrashFileUtils_flushBufferedWriter(&bufferedWriter);
-
-        writeDebugInfo(writer, GIOMonitorCrashField_Debug, monitorContext);
+        writeCPUProfile(writer, GIOMonitorCrashField_CPUProfile, profile);
     }
     writer->endContainer(writer);
 
     gioMonitorCrashJSON_endEncode(getJsonContext(writer));
     gioMonitorCrashFileUtils_closeBufferedWriter(&bufferedWriter);
-    gioMonitorCCD_unfreeze();
 }
 
-
+uint64_t gioMonitorCrashReport_getLastFingerprint(void)
+{
+    return g_lastFingerprint;
+}
 
 void gioMonitorCrashReport_setUserInfoJSON(const char* const userInfoJSON)
 {
@@ -1820,38 +3273,101 @@ void gioMonitorCrashReport_setIntrospectMemory(bool shouldIntrospectMemory)
 
 void gioMonitorCrashReport_setDoNotIntrospectClasses(const char** doNotIntrospectClasses, int length)
 {
-    const char** oldClasses = g_introspectionRules.restrictedClasses;
-    int oldClassesLength = g_introspectionRules.restrictedClassesCount;
-    const char** newClasses = NULL;
-    int newClassesLength = 0;
+    GIOMonitorCrash_RestrictedClassSet* newSet = NULL;
 
     if(doNotIntrospectClasses != NULL && length > 0)
     {
-        newClassesLength = length;
-        newClasses = malloc(sizeof(*newClasses) * (unsigned)newClassesLength);
-        if(newClasses == NULL)
+        uint32_t setSize;
+        // Keep the set at most half full.
+        for(setSize = 4; setSize < (uint32_t)length * 2; setSize *= 2)
+        {
+        }
+        size_t namesOffset = sizeof(*newSet) + setSize * sizeof(newSet->entries[0]);
+        size_t allocSize = namesOffset;
+        for(int i = 0; i < length; i++)
+        {
+            if(doNotIntrospectClasses[i] != NULL)
+            {
+                allocSize += strlen(doNotIntrospectClasses[i]) + 1;
+            }
+        }
+        newSet = calloc(1, allocSize);
+        if(newSet == NULL)
         {
             GIOMonitorCrashLOG_ERROR("Could not allocate memory");
             return;
         }
+        newSet->mask = setSize - 1;
 
-        for(int i = 0; i < newClassesLength; i++)
+        char* names = (char*)newSet + namesOffset;
+        for(int i = 0; i < length; i++)
         {
-            newClasses[i] = strdup(doNotIntrospectClasses[i]);
+            const char* className = doNotIntrospectClasses[i];
+            if(className == NULL)
+            {
+                continue;
+            }
+            size_t nameSize = strlen(className) + 1;
+            memcpy(names, className, nameSize);
+            uint32_t hash = gioMonitorCrashString_hash(names);
+            uint32_t slot = hash & newSet->mask;
+            while(newSet->entries[slot].name != NULL)
+            {
+                slot = (slot + 1) & newSet->mask;
+            }
+            newSet->entries[slot].hash = hash;
+            newSet->entries[slot].name = names;
+            names += nameSize;
         }
     }
 
-    g_introspectionRules.restrictedClasses = newClasses;
-    g_introspectionRules.restrictedClassesCount = newClassesLength;
+    // The previous set is leaked on purpose: a crash being handled on another
+    // thread may still be probing it.
+    __atomic_store_n(&g_introspectionRules.restrictedClassSet, newSet, __ATOMIC_RELEASE);
+}
+
+void gioMonitorCrashReport_setTimeLimit(double timeLimit)
+{
+    g_writeBudget.timeLimit = timeLimit;
+}
+
+void gioMonitorCrashReport_setSizeLimit(int sizeLimit)
+{
+    g_writeBudget.sizeLimit = sizeLimit;
+}
+
+void gioMonitorCrashReport_setProfile(GIOMonitorCrashMonitorType crashTypes, GIOMonitorCrashReportProfile profile)
+{
+    for(int i = 0; i < kMaxProfileCrashTypes; i++)
+    {
+        if(crashTypes & (1 << i))
+        {
+            g_crashTypeProfiles[i] = profile;
+        }
+    }
+}
 
-    if(oldClasses != NULL)
+void gioMonitorCrashReport_setShareBacktraceSuffixes(bool shouldShareBacktraceSuffixes)
+{
+    GIOMonitorCrash_SharedBacktraces* const shared = &g_sharedBacktraces;
+    if(shouldShareBacktraceSuffixes && shared->trie.nodes == NULL)
     {
-        for(int i = 0; i < oldClassesLength; i++)
+        int maxThreads = gioMonitorCrashMachineContext_getMaxThreadCount();
+        shared->threadLeaves = malloc(sizeof(*shared->threadLeaves) * (unsigned)maxThreads);
+        shared->threadGaveUp = malloc(sizeof(*shared->threadGaveUp) * (unsigned)maxThreads);
+        if(shared->threadLeaves == NULL || shared->threadGaveUp == NULL ||
+           !gioMonitorCrashStackTrie_create(&shared->trie, kSharedBacktraceMaxFrames))
         {
-            free((void*)oldClasses[i]);
+            GIOMonitorCrashLOG_ERROR("Could not allocate shared backtraces for %d threads", maxThreads);
+            free(shared->threadLeaves);
+            free(shared->threadGaveUp);
+            shared->threadLeaves = NULL;
+            shared->threadGaveUp = NULL;
+            return;
         }
-        free(oldClasses);
+        shared->maxThreads = maxThreads;
     }
+    shared->enabled = shouldShareBacktraceSuffixes;
 }
 
 void gioMonitorCrashReport_setUserSectionWriteCallback(const GIOMonitorCrashReportWriteCallback userSectionWriteCallback)
@@ -38,8 +38,47 @@ extern "C" {
 
 #import "GIOMonitorCrashReportWriter.h"
 #import "GIOMonitorCrashMonitorContext.h"
+#import "GIOMonitorCrashCPUProfiler.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+
+/** The timed phases of writing a standard report. */
+typedef enum
+{
+    GIOMonitorCrashReportSection_ReportInfo,
+    GIOMonitorCrashReportSection_BinaryImages,
+    GIOMonitorCrashReportSection_ProcessState,
+    GIOMonitorCrashReportSection_System,
+    GIOMonitorCrashReportSection_Error,
+    GIOMonitorCrashReportSection_Threads,
+    GIOMonitorCrashReportSection_User,
+    GIOMonitorCrashReportSection_UserCallback,
+    GIOMonitorCrashReportSection_Debug,
+    GIOMonitorCrashReportSection_Flush,
+    GIOMonitorCrashReportSectionCount,
+} GIOMonitorCrashReportSection;
+
+typedef struct
+{
+    /** How many times it was timed. */
+    int count;
+    uint64_t totalNanoseconds;
+    uint64_t maxNanoseconds;
+} GIOMonitorCrashReportTiming;
+
+typedef struct
+{
+    /** Whole reports. */
+    GIOMonitorCrashReportTiming report;
+
+    /** Each section. The flush section counts explicit flushes only. */
+    GIOMonitorCrashReportTiming sections[GIOMonitorCrashReportSectionCount];
+
+    /** Individual threads in the threads section. */
+    GIOMonitorCrashReportTiming thread;
+} GIOMonitorCrashReportTimings;
 
 
 // ============================================================================
@@ -66,6 +105,41 @@ void gioMonitorCrashReport_setIntrospectMemory(bool shouldIntrospectMemory);
  */
 void gioMonitorCrashReport_setDoNotIntrospectClasses(const char** doNotIntrospectClasses, int length);
 
+/** Configure whether frames common to several threads' backtraces are written
+ *  only once, to a shared frames table referenced from each thread.
+ *  This allocates memory, so call it outside of the crash handler. Room for
+ *  the max thread count at the time it is first enabled is allocated.
+ *
+ * @param shouldShareBacktraceSuffixes If true, share backtrace suffixes.
+ */
+void gioMonitorCrashReport_setShareBacktraceSuffixes(bool shouldShareBacktraceSuffixes);
+
+/** Set how long writing a standard report may take. Once it is exceeded, the
+ *  low priority sections still to be written (non-crashed thread registers,
+ *  stack contents, notable addresses, console log) are left out, and the
+ *  debug section records what was dropped.
+ *
+ * @param timeLimit The time limit in seconds (0 = no limit).
+ */
+void gioMonitorCrashReport_setTimeLimit(double timeLimit);
+
+/** Set how large a standard report may get before its remaining low priority
+ *  sections are left out, as with the time limit.
+ *
+ * @param sizeLimit The size limit in bytes (0 = no limit).
+ */
+void gioMonitorCrashReport_setSizeLimit(int sizeLimit);
+
+/** Set which profile reports of the given crash types are written with.
+ *  User reported snapshots use the profile set for
+ *  GIOMonitorCrashMonitorTypeUserReported.
+ *
+ * @param crashTypes The crash types to set the profile of.
+ *
+ * @param profile The profile (Default = standard).
+ */
+void gioMonitorCrashReport_setProfile(GIOMonitorCrashMonitorType crashTypes, GIOMonitorCrashReportProfile profile);
+
 /** Set the function to call when writing the user section of the report.
  *  This allows the user to add more fields to the user section at the time of the crash.
  *  Note: Only async-safe functions are allowed in the callback.
@@ -99,6 +173,78 @@ void gioMonitorCrashReport_writeStandardReport(const struct GIOMonitorCrash_Moni
 void gioMonitorCrashReport_writeRecrashReport(const struct GIOMonitorCrash_MonitorContext* const monitorContext,
                                       const char* path);
 
+/** Dump the raw crash state to a file, to be formatted into a standard
+ * report later with gioMonitorCrashReport_writeStandardReportFromRawCapture().
+ * This is much quicker than writing a standard report, and does no
+ * symbolication.
+ *
+ * @param monitorContext Contextual information about the crash and environment.
+ *                       The caller must fill this out before passing it in.
+ *
+ * @param path The file to write to.
+ *
+ * @return true if the capture was written.
+ */
+bool gioMonitorCrashReport_writeRawCapture(const struct GIOMonitorCrash_MonitorContext* const monitorContext,
+                                   const char* path);
+
+/** Format a raw capture into a standard crash report. Frames are symbolicated
+ * against the images loaded now, matched to the captured ones by UUID.
+ * Memory introspection and the user section callback are skipped, since the
+ * crashed process is gone.
+ * This allocates memory, so never call it from a crash handler.
+ *
+ * @param capturePath The raw capture to read.
+ *
+ * @param path The file to write to.
+ *
+ * @return true if the report was written.
+ */
+bool gioMonitorCrashReport_writeStandardReportFromRawCapture(const char* capturePath, const char* path);
+
+/** Get the fingerprint of the last standard report written: a hash of the
+ * exception type and the image relative offsets of the crashed thread's
+ * innermost frames. Identical crashes have identical fingerprints.
+ * This is async-safe.
+ *
+ * @return The fingerprint, or 0 if the report had no crashed thread backtrace.
+ */
+uint64_t gioMonitorCrashReport_getLastFingerprint(void);
+
+/** Get how long the standard reports written by this process took, in total
+ * and per section. The last report's timings are also in its debug section.
+ * Each value is read atomically, but a report finishing during the call may
+ * only be partly included.
+ *
+ * @param timings Filled with the timings.
+ */
+void gioMonitorCrashReport_getTimings(GIOMonitorCrashReportTimings* timings);
+
+/** Forget the timings of the reports written so far.
+ */
+void gioMonitorCrashReport_resetTimings(void);
+
+/** Get the name a section's timing is written under in the debug section.
+ *
+ * @param section The section.
+ *
+ * @return The name, or NULL if there is no such section.
+ */
+const char* gioMonitorCrashReport_getSectionName(GIOMonitorCrashReportSection section);
+
+/** Write a CPU profile report to a file.
+ * This allocates memory, so never call it from a crash handler.
+ *
+ * @param profile The profile to write.
+ *
+ * @param reportID The ID of the report.
+ *
+ * @param path The file to write to.
+ */
+void gioMonitorCrashReport_writeCPUProfileReport(const GIOMonitorCrashCPUProfile* const profile,
+                                         const char* reportID,
+                                         const char* path);
+
 
 #ifdef __cplusplus
 }
@@ -34,6 +34,7 @@
 #define GIOMonitorCrashReportType_Minimal          "minimal"
 #define GIOMonitorCrashReportType_Standard         "standard"
 #define GIOMonitorCrashReportType_Custom           "custom"
+#define GIOMonitorCrashReportType_CPUProfile       "cpu_profile"
 
 
 #pragma mark - Memory Types -
@@ -84,6 +85,7 @@
 
 #pragma mark - Backtrace -
 
+#define GIOMonitorCrashField_Caller                "caller"
 #define GIOMonitorCrashField_InstructionAddr       "instruction_addr"
 #define GIOMonitorCrashField_LineOfCode            "line_of_code"
 #define GIOMonitorCrashField_ObjectAddr            "object_addr"
@@ -110,10 +112,47 @@
 #define GIOMonitorCrashField_DispatchQueue         "dispatch_queue"
 #define GIOMonitorCrashField_NotableAddresses      "notable_addresses"
 #define GIOMonitorCrashField_Registers             "registers"
+#define GIOMonitorCrashField_SharedSuffix          "shared_suffix"
 #define GIOMonitorCrashField_Skipped               "skipped"
 #define GIOMonitorCrashField_Stack                 "stack"
 
 
+#pragma mark - Hang Profile -
+
+#define GIOMonitorCrashField_Count                 "count"
+#define GIOMonitorCrashField_DroppedSamples        "dropped_samples"
+#define GIOMonitorCrashField_Duration              "duration"
+#define GIOMonitorCrashField_InProgress            "in_progress"
+#define GIOMonitorCrashField_SampleCount           "sample_count"
+#define GIOMonitorCrashField_SampleInterval        "sample_interval"
+#define GIOMonitorCrashField_Stacks                "stacks"
+
+
+#pragma mark - CPU Profile -
+
+#define GIOMonitorCrashField_CPUTime               "cpu_time"
+#define GIOMonitorCrashField_Nodes                 "nodes"
+#define GIOMonitorCrashField_Parent                "parent"
+#define GIOMonitorCrashField_PassCount             "pass_count"
+#define GIOMonitorCrashField_SamplingTime          "sampling_time"
+
+
+#pragma mark - Report Timing -
+
+#define GIOMonitorCrashField_ReportTiming          "report_timing"
+#define GIOMonitorCrashField_FlushCount            "flush_count"
+#define GIOMonitorCrashField_Sections              "sections"
+#define GIOMonitorCrashField_ThreadTimes           "thread_times"
+#define GIOMonitorCrashField_TotalTime             "total_time"
+#define GIOMonitorCrashField_Truncation            "truncation"
+#define GIOMonitorCrashField_Dropped               "dropped"
+#define GIOMonitorCrashField_ReportProfile         "report_profile"
+#define GIOMonitorCrashField_SuppressedSnapshots   "suppressed_snapshots"
+#define GIOMonitorCrashField_RateLimited           "rate_limited"
+#define GIOMonitorCrashField_SampledOut            "sampled_out"
+#define GIOMonitorCrashField_ThreadsSuspended      "threads_suspended"
+
+
 #pragma mark - Binary Image -
 
 #define GIOMonitorCrashField_CPUSubType            "cpu_subtype"
@@ -171,6 +210,7 @@
 #define GIOMonitorCrashField_Crash                 "crash"
 #define GIOMonitorCrashField_Debug                 "debug"
 #define GIOMonitorCrashField_Diagnosis             "diagnosis"
+#define GIOMonitorCrashField_Fingerprint           "fingerprint"
 #define GIOMonitorCrashField_ID                    "id"
 #define GIOMonitorCrashField_ProcessName           "process_name"
 #define GIOMonitorCrashField_Report                "report"
@@ -185,9 +225,12 @@
 #define GIOMonitorCrashField_BinaryImages          "binary_images"
 #define GIOMonitorCrashField_System                "system"
 #define GIOMonitorCrashField_Memory                "memory"
+#define GIOMonitorCrashField_SharedFrames          "shared_frames"
 #define GIOMonitorCrashField_Threads               "threads"
 #define GIOMonitorCrashField_User                  "user"
 #define GIOMonitorCrashField_ConsoleLog            "console_log"
+#define GIOMonitorCrashField_HangProfile           "hang_profile"
+#define GIOMonitorCrashField_CPUProfile            "cpu_profile"
 
 #pragma mark Incomplete
 #define GIOMonitorCrashField_Incomplete            "incomplete"
@@ -0,0 +1,54 @@
+//
+//  GIOMonitorCrashReportProfile.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* How much a standard report captures about each thread.
+ * Registers, stack contents and notable addresses make up most of the time
+ * and space a report takes, and are rarely needed for non-fatal reports. A
+ * profile is chosen per crash type, and can be overridden per user reported
+ * snapshot.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashReportProfile_h
+#define HDR_GIOMonitorCrashReportProfile_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef enum
+{
+    /* Use the profile configured for the crash type. */
+    GIOMonitorCrashReportProfileDefault = 0,
+
+    /* Backtraces of all threads, and the crashed thread's registers.
+     * No stack contents, notable addresses, other threads' registers or
+     * console log.
+     */
+    GIOMonitorCrashReportProfileMinimal,
+
+    /* Everything for the crashed thread, and backtraces and registers for
+     * the others. Notable addresses are written if memory introspection is
+     * enabled.
+     */
+    GIOMonitorCrashReportProfileStandard,
+
+    /* Stack contents and notable addresses for every thread, even if memory
+     * introspection is disabled.
+     */
+    GIOMonitorCrashReportProfileForensic,
+} GIOMonitorCrashReportProfile;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashReportProfile_h
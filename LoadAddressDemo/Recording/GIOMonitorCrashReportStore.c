@@ -36,16 +36,72 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 
+/** Maximum number of fingerprints in the report index. */
+#define kMaxIndexEntries 64
+
+/** Maximum number of raw crash captures formatted per launch. Any others wait for the next one. */
+#define kMaxRawCaptures 4
+
+/** Formatting runs during install, so no new capture is started once this
+ * many seconds have been spent formatting. The rest wait for the next launch.
+ */
+#define kRawCaptureTimeBudget 0.25
+
+/** Maximum number of CPU profiles kept. They are stored apart from crash
+ * reports, so that they never count toward the max report count.
+ */
+#define kMaxCPUProfiles 2
+
+#define kIndexMagic 0x47435249
+#define kIndexVersion 1
+
+/* The report index maps crash fingerprints to the report they were first
+ * seen in. It lives in memory and in a file next to the reports, one fixed
+ * size slot per entry, so that a crash handler can update a single slot
+ * with one write.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+} IndexHeader;
+
+typedef struct
+{
+    /** The report that holds the full crash, or 0 if the slot is empty. */
+    int64_t reportID;
+
+    uint64_t fingerprint;
+
+    /** Number of later crashes that were coalesced into this report. */
+    int32_t duplicateCount;
+
+    int32_t reserved;
+
+    /** When the latest duplicate happened (seconds since 1970), or 0. */
+    int64_t lastDuplicateTime;
+} IndexEntry;
+
 static int g_maxReportCount = 5;
+static bool g_shouldCoalesceReports = true;
 // Have to use max 32-bit atomics because of MIPS.
 static _Atomic(uint32_t) g_nextUniqueIDLow;
 static int64_t g_nextUniqueIDHigh;
 static const char* g_appName;
 static const char* g_reportsPath;
 static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char g_indexPath[GrowingMonitorCRS_MAX_PATH_LENGTH];
+
+/** Only touched with the index lock held. A crash handler can't wait for a
+ * lock that a suspended thread might be holding, so it only tries once, and
+ * leaves its report as it is if that fails. Everything else waits.
+ */
+static IndexEntry g_index[kMaxIndexEntries];
+static bool g_isIndexLocked = false;
 
 static int compareInt64(const void* a, const void* b)
 {
@@ -61,6 +117,25 @@ static int compareInt64(const void* a, const void* b)
     return 0;
 }
 
+static bool tryLockIndex(void)
+{
+    bool expected = false;
+    return __atomic_compare_exchange_n(&g_isIndexLocked, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void lockIndex(void)
+{
+    while(!tryLockIndex())
+    {
+        usleep(100);
+    }
+}
+
+static void unlockIndex(void)
+{
+    __atomic_store_n(&g_isIndexLocked, false, __ATOMIC_RELEASE);
+}
+
 static inline int64_t getNextUniqueID()
 {
     return g_nextUniqueIDHigh + g_nextUniqueIDLow++;
@@ -72,6 +147,26 @@ static void getCrashReportPathByID(int64_t id, char* pathBuffer)
 
 }
 
+static void getCPUProfilePathByID(int64_t id, char* pathBuffer)
+{
+    snprintf(pathBuffer, GrowingMonitorCRS_MAX_PATH_LENGTH, "%s/%s-cpu_profile-%016llx.json", g_reportsPath, g_appName, id);
+}
+
+static void getRawCapturePathByID(int64_t id, char* pathBuffer)
+{
+    snprintf(pathBuffer, GrowingMonitorCRS_MAX_PATH_LENGTH, "%s/%s-capture-%016llx.dat", g_reportsPath, g_appName, id);
+}
+
+static int64_t getRawCaptureIDFromFilename(const char* filename)
+{
+    char scanFormat[100];
+    sprintf(scanFormat, "%s-capture-%%" PRIx64 ".dat", g_appName);
+
+    int64_t captureID = 0;
+    sscanf(filename, scanFormat, &captureID);
+    return captureID;
+}
+
 static int64_t getReportIDFromFilename(const char* filename)
 {
     char scanFormat[100];
@@ -82,7 +177,26 @@ static int64_t getReportIDFromFilename(const char* filename)
     return reportID;
 }
 
-static int getReportCount()
+static int64_t getCPUProfileIDFromFilename(const char* filename)
+{
+    char scanFormat[100];
+    sprintf(scanFormat, "%s-cpu_profile-%%" PRIx64 ".json", g_appName);
+
+    int64_t profileID = 0;
+    sscanf(filename, scanFormat, &profileID);
+    return profileID;
+}
+
+/** Crash reports and CPU profiles are both handed out as reports. */
+static int64_t getStoredReportIDFromFilename(const char* filename)
+{
+    int64_t reportID = getReportIDFromFilename(filename);
+    return reportID > 0 ? reportID : getCPUProfileIDFromFilename(filename);
+}
+
+typedef int64_t (*GetIDFromFilename)(const char* filename);
+
+static int getReportCount(GetIDFromFilename getIDFromFilename)
 {
     int count = 0;
     DIR* dir = opendir(g_reportsPath);
@@ -94,7 +208,7 @@ static int getReportCount()
     struct dirent* ent;
     while((ent = readdir(dir)) != NULL)
     {
-        if(getReportIDFromFilename(ent->d_name) > 0)
+        if(getIDFromFilename(ent->d_name) > 0)
         {
             count++;
         }
@@ -108,7 +222,7 @@ done:
     return count;
 }
 
-static int getReportIDs(int64_t* reportIDs, int count)
+static int getReportIDs(GetIDFromFilename getIDFromFilename, int64_t* reportIDs, int count)
 {
     int index = 0;
     DIR* dir = opendir(g_reportsPath);
@@ -121,14 +235,14 @@ static int getReportIDs(int64_t* reportIDs, int count)
     struct dirent* ent;
     while((ent = readdir(dir)) != NULL && index < count)
     {
-        int64_t reportID = getReportIDFromFilename(ent->d_name);
+        int64_t reportID = getIDFromFilename(ent->d_name);
         if(reportID > 0)
         {
             reportIDs[index++] = reportID;
         }
     }
 
-    qsort(reportIDs, (unsigned)count, sizeof(reportIDs[0]), compareInt64);
+    qsort(reportIDs, (unsigned)index, sizeof(reportIDs[0]), compareInt64);
 
 done:
     if(dir != NULL)
@@ -138,18 +252,208 @@ done:
     return index;
 }
 
+static int getRawCaptureIDs(int64_t* captureIDs, int count)
+{
+    int index = 0;
+    DIR* dir = opendir(g_reportsPath);
+    if(dir == NULL)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not open directory %s", g_reportsPath);
+        return 0;
+    }
+
+    struct dirent* ent;
+    while((ent = readdir(dir)) != NULL && index < count)
+    {
+        int64_t captureID = getRawCaptureIDFromFilename(ent->d_name);
+        if(captureID > 0)
+        {
+            captureIDs[index++] = captureID;
+        }
+    }
+    closedir(dir);
+
+    qsort(captureIDs, (unsigned)index, sizeof(captureIDs[0]), compareInt64);
+    return index;
+}
+
+static bool reportExists(int64_t reportID)
+{
+    char path[GrowingMonitorCRS_MAX_PATH_LENGTH];
+    getCrashReportPathByID(reportID, path);
+    return access(path, F_OK) == 0;
+}
+
+/** Get the path of a stored report, which is either a crash report or a CPU profile. */
+static void getStoredReportPathByID(int64_t reportID, char* pathBuffer)
+{
+    getCPUProfilePathByID(reportID, pathBuffer);
+    if(access(pathBuffer, F_OK) != 0)
+    {
+        getCrashReportPathByID(reportID, pathBuffer);
+    }
+}
+
+/** Write one index slot to the index file. This is async-safe.
+ */
+static void writeIndexEntry(const IndexEntry* entry)
+{
+    int fd = open(g_indexPath, O_WRONLY | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not open index %s: %s", g_indexPath, strerror(errno));
+        return;
+    }
+    off_t offset = (off_t)(sizeof(IndexHeader) + sizeof(*entry) * (size_t)(entry - g_index));
+    if(pwrite(fd, entry, sizeof(*entry), offset) != (ssize_t)sizeof(*entry))
+    {
+        GIOMonitorCrashLOG_ERROR("Could not write index %s: %s", g_indexPath, strerror(errno));
+    }
+    close(fd);
+}
+
+static void writeIndex()
+{
+    int fd = open(g_indexPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not open index %s: %s", g_indexPath, strerror(errno));
+        return;
+    }
+    IndexHeader header = {kIndexMagic, kIndexVersion};
+    if(!gioMonitorCrashFileUtils_writeBytesToFD(fd, (const char*)&header, sizeof(header)) ||
+       !gioMonitorCrashFileUtils_writeBytesToFD(fd, (const char*)g_index, sizeof(g_index)))
+    {
+        GIOMonitorCrashLOG_ERROR("Could not write index %s", g_indexPath);
+    }
+    close(fd);
+}
+
+/** Load the index, dropping the entries of reports that are gone.
+ */
+static void loadIndex()
+{
+    lockIndex();
+    memset(g_index, 0, sizeof(g_index));
+    int fd = open(g_indexPath, O_RDONLY);
+    if(fd >= 0)
+    {
+        IndexHeader header = {0};
+        if(read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+           header.magic == kIndexMagic && header.version == kIndexVersion)
+        {
+            if(read(fd, g_index, sizeof(g_index)) < 0)
+            {
+                memset(g_index, 0, sizeof(g_index));
+            }
+        }
+        close(fd);
+    }
+
+    for(int i = 0; i < kMaxIndexEntries; i++)
+    {
+        if(g_index[i].reportID != 0 && !reportExists(g_index[i].reportID))
+        {
+            memset(&g_index[i], 0, sizeof(g_index[i]));
+        }
+    }
+    writeIndex();
+    unlockIndex();
+}
+
+static IndexEntry* findIndexEntry(int64_t reportID)
+{
+    for(int i = 0; i < kMaxIndexEntries; i++)
+    {
+        if(g_index[i].reportID == reportID)
+        {
+            return &g_index[i];
+        }
+    }
+    return NULL;
+}
+
+static void removeIndexEntry(int64_t reportID)
+{
+    lockIndex();
+    IndexEntry* entry = findIndexEntry(reportID);
+    if(entry != NULL)
+    {
+        memset(entry, 0, sizeof(*entry));
+        writeIndexEntry(entry);
+    }
+    unlockIndex();
+}
+
+/** Check if a newer report on disk is of the same crash.
+ *
+ * @param reportIDs The IDs of the reports on disk, oldest first (0 = deleted).
+ * @param index The report to check.
+ * @param reportCount The number of IDs.
+ */
+static bool hasNewerDuplicate(const int64_t* reportIDs, int index, int reportCount)
+{
+    bool result = false;
+    lockIndex();
+    IndexEntry* entry = findIndexEntry(reportIDs[index]);
+    uint64_t fingerprint = entry == NULL ? 0 : entry->fingerprint;
+    for(int i = index + 1; i < reportCount && fingerprint != 0 && !result; i++)
+    {
+        entry = reportIDs[i] == 0 ? NULL : findIndexEntry(reportIDs[i]);
+        result = entry != NULL && entry->fingerprint == fingerprint;
+    }
+    unlockIndex();
+    return result;
+}
+
 static void pruneReports()
 {
-    int reportCount = getReportCount();
+    int reportCount = getReportCount(getReportIDFromFilename);
     if(reportCount > g_maxReportCount)
     {
-        int64_t reportIDs[reportCount];
-        reportCount = getReportIDs(reportIDs, reportCount);
+        // Never called while handling a crash, so this can go on the heap
+        // rather than putting an unbounded array on the stack.
+        int64_t* reportIDs = malloc(sizeof(*reportIDs) * (size_t)reportCount);
+        if(reportIDs == NULL)
+        {
+            return;
+        }
+        reportCount = getReportIDs(getReportIDFromFilename, reportIDs, reportCount);
 
-        for(int i = 0; i < reportCount - g_maxReportCount; i++)
+        // Reports of a crash that a newer report also has go first, so that
+        // a repeating crash can't push out the only report of another one.
+        int excess = reportCount - g_maxReportCount;
+        for(int i = 0; i < reportCount && excess > 0; i++)
         {
-            gioMonitorCRS_deleteReportWithID(reportIDs[i]);
+            if(hasNewerDuplicate(reportIDs, i, reportCount))
+            {
+                gioMonitorCRS_deleteReportWithID(reportIDs[i]);
+                reportIDs[i] = 0;
+                excess--;
+            }
         }
+        for(int i = 0; i < reportCount && excess > 0; i++)
+        {
+            if(reportIDs[i] != 0)
+            {
+                gioMonitorCRS_deleteReportWithID(reportIDs[i]);
+                excess--;
+            }
+        }
+        free(reportIDs);
+    }
+}
+
+/** Delete the oldest CPU profiles until at most maxCount are left. */
+static void pruneCPUProfiles(int maxCount)
+{
+    int64_t profileIDs[kMaxCPUProfiles * 2];
+    int profileCount = getReportIDs(getCPUProfileIDFromFilename, profileIDs, kMaxCPUProfiles * 2);
+    for(int i = 0; i < profileCount - maxCount; i++)
+    {
+        char path[GrowingMonitorCRS_MAX_PATH_LENGTH];
+        getCPUProfilePathByID(profileIDs[i], path);
+        gioMonitorCrashFileUtils_removeFile(path, false);
     }
 }
 
@@ -179,20 +483,163 @@ void gioMonitorCRS_initialize(const char* appName, const char* reportsPath)
     g_appName = strdup(appName);
     g_reportsPath = strdup(reportsPath);
     gioMonitorCrashFileUtils_makePath(reportsPath);
+    snprintf(g_indexPath, sizeof(g_indexPath), "%s/%s-index.dat", g_reportsPath, g_appName);
+    loadIndex();
     pruneReports();
     initializeIDs();
     pthread_mutex_unlock(&g_mutex);
 }
 
-void gioMonitorCRS_getNextCrashReportPath(char* crashReportPathBuffer)
+int64_t gioMonitorCRS_getNextCrashReportPath(char* crashReportPathBuffer)
 {
-    getCrashReportPathByID(getNextUniqueID(), crashReportPathBuffer);
+    int64_t reportID = getNextUniqueID();
+    getCrashReportPathByID(reportID, crashReportPathBuffer);
+    return reportID;
+}
+
+int64_t gioMonitorCRS_getNextCPUProfilePath(char* cpuProfilePathBuffer)
+{
+    pthread_mutex_lock(&g_mutex);
+    // Make room for the new one.
+    pruneCPUProfiles(kMaxCPUProfiles - 1);
+    int64_t profileID = getNextUniqueID();
+    getCPUProfilePathByID(profileID, cpuProfilePathBuffer);
+    pthread_mutex_unlock(&g_mutex);
+    return profileID;
+}
+
+int64_t gioMonitorCRS_getNextRawCapturePath(char* rawCapturePathBuffer)
+{
+    int64_t captureID = getNextUniqueID();
+    getRawCapturePathByID(captureID, rawCapturePathBuffer);
+    return captureID;
+}
+
+void gioMonitorCRS_formatRawCaptures(GIOMonitorCRS_FormatRawCaptureCallback formatRawCapture)
+{
+    pthread_mutex_lock(&g_mutex);
+    int64_t captureIDs[kMaxRawCaptures];
+    int captureCount = getRawCaptureIDs(captureIDs, kMaxRawCaptures);
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    for(int i = 0; i < captureCount; i++)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if((double)(now.tv_sec - startTime.tv_sec) + (double)(now.tv_nsec - startTime.tv_nsec) / 1000000000.0 > kRawCaptureTimeBudget)
+        {
+            GIOMonitorCrashLOG_INFO("Leaving %d raw crash captures for the next launch", captureCount - i);
+            break;
+        }
+        char capturePath[GrowingMonitorCRS_MAX_PATH_LENGTH];
+        char reportPath[GrowingMonitorCRS_MAX_PATH_LENGTH];
+        getRawCapturePathByID(captureIDs[i], capturePath);
+        getCrashReportPathByID(captureIDs[i], reportPath);
+        if(!formatRawCapture(capturePath, reportPath, captureIDs[i]))
+        {
+            GIOMonitorCrashLOG_ERROR("Could not format raw crash capture %s", capturePath);
+        }
+        // Delete it either way, so that a bad capture doesn't get retried on every launch.
+        gioMonitorCrashFileUtils_removeFile(capturePath, false);
+    }
+    if(captureCount > 0)
+    {
+        pruneReports();
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+bool gioMonitorCRS_coalesceReport(int64_t reportID, uint64_t fingerprint, bool isCrashing)
+{
+    if(fingerprint == 0 || g_reportsPath == NULL)
+    {
+        return false;
+    }
+    if(!isCrashing)
+    {
+        lockIndex();
+    }
+    else if(!tryLockIndex())
+    {
+        GIOMonitorCrashLOG_INFO("Report index is busy. Keeping report %016llx as it is.", reportID);
+        return false;
+    }
+
+    bool isCoalesced = false;
+    IndexEntry* freeEntry = NULL;
+    for(int i = 0; i < kMaxIndexEntries; i++)
+    {
+        IndexEntry* entry = &g_index[i];
+        if(g_shouldCoalesceReports && entry->reportID != 0 && entry->fingerprint == fingerprint && entry->reportID != reportID)
+        {
+            if(!reportExists(entry->reportID))
+            {
+                // Deleted behind our back. Let the new report take its place.
+                freeEntry = entry;
+                break;
+            }
+            char path[GrowingMonitorCRS_MAX_PATH_LENGTH];
+            getCrashReportPathByID(reportID, path);
+            if(unlink(path) < 0 && errno != ENOENT)
+            {
+                GIOMonitorCrashLOG_ERROR("Could not remove duplicate report %s: %s", path, strerror(errno));
+                goto done;
+            }
+            entry->duplicateCount++;
+            entry->lastDuplicateTime = (int64_t)time(NULL);
+            writeIndexEntry(entry);
+            GIOMonitorCrashLOG_INFO("Coalesced report %016llx into %016llx (%d duplicates)", reportID, entry->reportID, entry->duplicateCount);
+            isCoalesced = true;
+            goto done;
+        }
+        if(freeEntry == NULL && entry->reportID == 0)
+        {
+            freeEntry = entry;
+        }
+    }
+
+    if(freeEntry == NULL)
+    {
+        // Full: forget the oldest report's fingerprint.
+        freeEntry = &g_index[0];
+        for(int i = 1; i < kMaxIndexEntries; i++)
+        {
+            if(g_index[i].reportID < freeEntry->reportID)
+            {
+                freeEntry = &g_index[i];
+            }
+        }
+    }
+    // Recorded even when not coalescing, so that pruning can tell repeats apart.
+    freeEntry->reportID = reportID;
+    freeEntry->fingerprint = fingerprint;
+    freeEntry->duplicateCount = 0;
+    freeEntry->reserved = 0;
+    freeEntry->lastDuplicateTime = 0;
+    writeIndexEntry(freeEntry);
+
+done:
+    unlockIndex();
+    return isCoalesced;
+}
+
+int gioMonitorCRS_getDuplicateCount(int64_t reportID, int64_t* lastDuplicateTime)
+{
+    lockIndex();
+    IndexEntry* entry = reportID == 0 ? NULL : findIndexEntry(reportID);
+    int count = entry == NULL ? 0 : entry->duplicateCount;
+    if(lastDuplicateTime != NULL)
+    {
+        *lastDuplicateTime = entry == NULL ? 0 : entry->lastDuplicateTime;
+    }
+    unlockIndex();
+    return count;
 }
 
 int gioMonitorCRS_getReportCount()
 {
     pthread_mutex_lock(&g_mutex);
-    int count = getReportCount();
+    int count = getReportCount(getStoredReportIDFromFilename);
     pthread_mutex_unlock(&g_mutex);
     return count;
 }
@@ -200,7 +647,7 @@ int gioMonitorCRS_getReportCount()
 int gioMonitorCRS_getReportIDs(int64_t* reportIDs, int count)
 {
     pthread_mutex_lock(&g_mutex);
-    count = getReportIDs(reportIDs, count);
+    count = getReportIDs(getStoredReportIDFromFilename, reportIDs, count);
     pthread_mutex_unlock(&g_mutex);
     return count;
 }
@@ -209,7 +656,7 @@ char* gioMonitorCRS_readReport(int64_t reportID)
 {
     pthread_mutex_lock(&g_mutex);
     char path[GrowingMonitorCRS_MAX_PATH_LENGTH];
-    getCrashReportPathByID(reportID, path);
+    getStoredReportPathByID(reportID, path);
     char* result;
     gioMonitorCrashFileUtils_readEntireFile(path, &result, NULL, 2000000);
     pthread_mutex_unlock(&g_mutex);
@@ -255,17 +702,27 @@ void gioMonitorCRS_deleteAllReports()
 {
     pthread_mutex_lock(&g_mutex);
     gioMonitorCrashFileUtils_deleteContentsOfPath(g_reportsPath);
+    lockIndex();
+    memset(g_index, 0, sizeof(g_index));
+    writeIndex();
+    unlockIndex();
     pthread_mutex_unlock(&g_mutex);
 }
 
 void gioMonitorCRS_deleteReportWithID(int64_t reportID)
 {
     char path[GrowingMonitorCRS_MAX_PATH_LENGTH];
-    getCrashReportPathByID(reportID, path);
+    getStoredReportPathByID(reportID, path);
     gioMonitorCrashFileUtils_removeFile(path, true);
+    removeIndexEntry(reportID);
 }
 
 void gioMonitorCRS_setMaxReportCount(int maxReportCount)
 {
     g_maxReportCount = maxReportCount;
 }
+
+void gioMonitorCRS_setCoalesceReports(bool shouldCoalesceReports)
+{
+    g_shouldCoalesceReports = shouldCoalesceReports;
+}
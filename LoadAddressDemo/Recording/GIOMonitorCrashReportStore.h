@@ -32,6 +32,7 @@ extern "C" {
 #endif
 
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define GrowingMonitorCRS_MAX_PATH_LENGTH 500
@@ -47,8 +48,82 @@ void gioMonitorCRS_initialize(const char* appName, const char* reportsPath);
  * Max length for paths is GrowingMonitorCRS_MAX_PATH_LENGTH
  *
  * @param crashReportPathBuffer Buffer to store the crash report path.
+ *
+ * @return The ID of the report.
+ */
+int64_t gioMonitorCRS_getNextCrashReportPath(char* crashReportPathBuffer);
+
+/** Get the path to the next CPU profile to be generated, deleting the oldest
+ * profiles if there are too many. CPU profiles are read and deleted like
+ * reports, but are kept apart from them, so that they don't count toward the
+ * max report count. This locks, so never call it from a crash handler.
+ * Max length for paths is GrowingMonitorCRS_MAX_PATH_LENGTH
+ *
+ * @param cpuProfilePathBuffer Buffer to store the CPU profile path.
+ *
+ * @return The ID of the profile.
+ */
+int64_t gioMonitorCRS_getNextCPUProfilePath(char* cpuProfilePathBuffer);
+
+/** Get the path to the next raw crash capture to be generated. Once the
+ * capture is formatted, its report gets the same ID.
+ * Max length for paths is GrowingMonitorCRS_MAX_PATH_LENGTH
+ *
+ * @param rawCapturePathBuffer Buffer to store the raw capture path.
+ *
+ * @return The ID of the capture.
+ */
+int64_t gioMonitorCRS_getNextRawCapturePath(char* rawCapturePathBuffer);
+
+/** Formats a raw crash capture into a report.
+ *
+ * @param capturePath The raw capture to read.
+ * @param reportPath The report to write.
+ * @param reportID The ID of the report.
+ *
+ * @return true if the report was written.
+ */
+typedef bool (*GIOMonitorCRS_FormatRawCaptureCallback)(const char* capturePath, const char* reportPath, int64_t reportID);
+
+/** Format the raw crash captures left by earlier launches into reports, and
+ * delete the captures. This runs at install, so at most 4 captures are
+ * formatted, and none is started after 0.25 seconds. Any others are left for
+ * the next launch.
+ *
+ * @param formatRawCapture Called for each capture, oldest first.
+ */
+void gioMonitorCRS_formatRawCaptures(GIOMonitorCRS_FormatRawCaptureCallback formatRawCapture);
+
+/** Record the fingerprint of a crash report that was just written.
+ * If coalescing is enabled and a report with the same fingerprint is still on
+ * disk, the new report is deleted, and the duplicate count of the existing
+ * one goes up instead.
+ *
+ * The fingerprint comes from the crashed thread's frames as they are
+ * symbolicated while writing the report, so it's only known once the report
+ * is written. Deleting the finished report also means that a crash while
+ * writing it leaves a full report rather than none.
+ *
+ * This is async-safe when isCrashing is true.
+ *
+ * @param reportID The ID of the report that was just written.
+ * @param fingerprint The crash fingerprint (0 = none, never coalesce).
+ * @param isCrashing If true, don't wait for the index if another thread
+ *                   holds it, and keep the report as it is instead.
+ *
+ * @return true if the report was coalesced into an existing one.
  */
-void gioMonitorCRS_getNextCrashReportPath(char* crashReportPathBuffer);
+bool gioMonitorCRS_coalesceReport(int64_t reportID, uint64_t fingerprint, bool isCrashing);
+
+/** Get how many later crashes were coalesced into a report.
+ *
+ * @param reportID The report's ID.
+ * @param lastDuplicateTime Receives when the latest duplicate happened
+ *                          (seconds since 1970, or 0). NULL = ignore.
+ *
+ * @return The number of duplicates.
+ */
+int gioMonitorCRS_getDuplicateCount(int64_t reportID, int64_t* lastDuplicateTime);
 
 /** Get the number of reports on disk.
  */
@@ -92,11 +167,19 @@ void gioMonitorCRS_deleteAllReports(void);
 void gioMonitorCRS_deleteReportWithID(int64_t reportID);
 
 /** Set the maximum number of reports allowed on disk before old ones get deleted.
+ * Older reports of a crash that a newer report also has are deleted first.
  *
  * @param maxReportCount The maximum number of reports.
  */
     void gioMonitorCRS_setMaxReportCount(int maxReportCount);
 
+/** Set whether a crash report is deleted in favour of an earlier report of
+ * the same crash, counting it as a duplicate of that one instead.
+ *
+ * @param shouldCoalesceReports If true, coalesce reports.
+ */
+void gioMonitorCRS_setCoalesceReports(bool shouldCoalesceReports);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,127 @@
+//
+//  GIOMonitorCrashArena.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashArena.h"
+#include "GIOMonitorCrashThread.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+#define kAlignment 16
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static char* g_memory;
+static int g_size;
+
+/** The thread that owns the arena, or 0. */
+static volatile GIOMonitorCrashThread g_owner;
+
+/** Only touched by the owner. */
+static int g_acquireDepth;
+static int g_used;
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+bool gioMonitorCrashArena_reserve(int size)
+{
+    if(g_memory != NULL)
+    {
+        return true;
+    }
+    if(size <= 0)
+    {
+        return false;
+    }
+    void* memory = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(memory == MAP_FAILED)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not reserve %d bytes for the crash arena: %s", size, strerror(errno));
+        return false;
+    }
+    // Fault every page in now, so that a crash doesn't have to.
+    memset(memory, 0, (size_t)size);
+    g_size = size;
+    __atomic_store_n(&g_memory, (char*)memory, __ATOMIC_RELEASE);
+    GIOMonitorCrashLOG_DEBUG("Reserved %d bytes for the crash arena.", size);
+    return true;
+}
+
+bool gioMonitorCrashArena_acquire(void)
+{
+    if(__atomic_load_n(&g_memory, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return false;
+    }
+    const GIOMonitorCrashThread thisThread = gioMonitorCrashThread_self();
+    if(g_owner == thisThread)
+    {
+        g_acquireDepth++;
+        return true;
+    }
+    GIOMonitorCrashThread expected = 0;
+    if(!__atomic_compare_exchange_n(&g_owner, &expected, thisThread, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        GIOMonitorCrashLOG_DEBUG("Crash arena is owned by another thread.");
+        return false;
+    }
+    g_acquireDepth = 1;
+    g_used = 0;
+    return true;
+}
+
+bool gioMonitorCrashArena_transfer(GIOMonitorCrashThread thread)
+{
+    if(thread == 0 || g_owner != gioMonitorCrashThread_self())
+    {
+        return false;
+    }
+    __atomic_store_n(&g_owner, thread, __ATOMIC_RELEASE);
+    return true;
+}
+
+void gioMonitorCrashArena_release(void)
+{
+    if(g_owner != gioMonitorCrashThread_self())
+    {
+        return;
+    }
+    if(--g_acquireDepth <= 0)
+    {
+        GIOMonitorCrashLOG_DEBUG("Releasing crash arena. %d of %d bytes were used.", g_used, g_size);
+        __atomic_store_n(&g_owner, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void* gioMonitorCrashArena_allocate(int size)
+{
+    if(size <= 0 || g_owner != gioMonitorCrashThread_self())
+    {
+        return NULL;
+    }
+    int start = (g_used + kAlignment - 1) & ~(kAlignment - 1);
+    if(start > g_size - size)
+    {
+        GIOMonitorCrashLOG_ERROR("Crash arena exhausted: %d bytes requested, %d of %d used", size, g_used, g_size);
+        return NULL;
+    }
+    g_used = start + size;
+    return g_memory + start;
+}
@@ -0,0 +1,83 @@
+//
+//  GIOMonitorCrashArena.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Memory reserved for handling a crash.
+ * The arena is mapped and pre-faulted at install time. While handling a
+ * crash, the handling thread acquires it and bump-allocates its buffers from
+ * it, instead of putting them on a stack that may be about to overflow or
+ * calling malloc on a heap that may be corrupted. Everything allocated is
+ * given back at once when the arena is released.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashArena_h
+#define HDR_GIOMonitorCrashArena_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "GIOMonitorCrashThread.h"
+
+#include <stdbool.h>
+
+
+/** Map and pre-fault the arena. Does nothing if it is already reserved.
+ * This allocates memory, so call it outside of the crash handler.
+ *
+ * @param size The size of the arena, in bytes.
+ *
+ * @return true if the arena is reserved.
+ */
+bool gioMonitorCrashArena_reserve(int size);
+
+/** Take ownership of the arena for the calling thread. If the thread
+ * already owns it, this nests, and the memory allocated so far is kept.
+ * This is async-safe.
+ *
+ * @return true if the calling thread now owns the arena. false if it isn't
+ *         reserved or another thread owns it.
+ */
+bool gioMonitorCrashArena_acquire(void);
+
+/** Hand the arena over to another thread, keeping its acquire depth and
+ * everything allocated so far. Only the owner can do this. The other thread
+ * can then acquire it (nesting), allocate from it, and release it back down
+ * to the depth it was handed over at, before handing it back.
+ * This is async-safe.
+ *
+ * @param thread The new owner.
+ *
+ * @return true if the arena was handed over.
+ */
+bool gioMonitorCrashArena_transfer(GIOMonitorCrashThread thread);
+
+/** Give up one level of ownership of the arena. Once the outermost acquire
+ * is released, everything allocated from it is freed.
+ * This is async-safe.
+ */
+void gioMonitorCrashArena_release(void);
+
+/** Allocate memory from the arena. The memory is 16 byte aligned and not
+ * zeroed. This is async-safe.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return The memory, or NULL if the calling thread doesn't own the arena or
+ *         there isn't enough room left.
+ */
+void* gioMonitorCrashArena_allocate(int size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashArena_h
@@ -0,0 +1,106 @@
+//
+//  GIOMonitorCrashHangProfile.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashHangProfile.h"
+
+#include <string.h>
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+
+static GIOMonitorCrashHangProfile g_profile;
+
+static uint32_t hashBacktrace(const uintptr_t* const backtrace, const int length)
+{
+    uint32_t hash = 2166136261u;
+    for(int i = 0; i < length; i++)
+    {
+        uintptr_t address = backtrace[i];
+        for(unsigned byte = 0; byte < sizeof(address); byte++)
+        {
+            hash ^= (uint32_t)(address & 0xff);
+            hash *= 16777619u;
+            address >>= 8;
+        }
+    }
+    return hash;
+}
+
+static GIOMonitorCrashHangStack* findStack(const uintptr_t* const backtrace, const int length, const uint32_t hash)
+{
+    for(int i = 0; i < g_profile.stackCount; i++)
+    {
+        GIOMonitorCrashHangStack* stack = &g_profile.stacks[i];
+        if(stack->hash == hash && stack->length == length &&
+           memcmp(&g_profile.addresses[stack->firstAddress], backtrace, sizeof(*backtrace) * (unsigned)length) == 0)
+        {
+            return stack;
+        }
+    }
+    return NULL;
+}
+
+void gioMonitorCrashHangProfile_begin(double sampleInterval)
+{
+    g_profile.isInProgress = false;
+    g_profile.duration = 0;
+    g_profile.sampleInterval = sampleInterval;
+    g_profile.sampleCount = 0;
+    g_profile.droppedSampleCount = 0;
+    g_profile.stackCount = 0;
+    g_profile.addressCount = 0;
+    g_profile.isInProgress = true;
+}
+
+void gioMonitorCrashHangProfile_addSample(const uintptr_t* const backtrace, const int length, const double duration)
+{
+    g_profile.duration = duration;
+    g_profile.sampleCount++;
+    if(length <= 0)
+    {
+        g_profile.droppedSampleCount++;
+        return;
+    }
+
+    const uint32_t hash = hashBacktrace(backtrace, length);
+    GIOMonitorCrashHangStack* stack = findStack(backtrace, length, hash);
+    if(stack != NULL)
+    {
+        stack->sampleCount++;
+        return;
+    }
+
+    if(g_profile.stackCount >= GIOMonitorCrashHP_MAX_STACKS ||
+       g_profile.addressCount + length > GIOMonitorCrashHP_MAX_ADDRESSES)
+    {
+        g_profile.droppedSampleCount++;
+        return;
+    }
+    stack = &g_profile.stacks[g_profile.stackCount];
+    stack->hash = hash;
+    stack->firstAddress = g_profile.addressCount;
+    stack->length = length;
+    stack->sampleCount = 1;
+    memcpy(&g_profile.addresses[g_profile.addressCount], backtrace, sizeof(*backtrace) * (unsigned)length);
+    g_profile.addressCount += length;
+    g_profile.stackCount++;
+}
+
+void gioMonitorCrashHangProfile_end(void)
+{
+    g_profile.isInProgress = false;
+    GIOMonitorCrashLOG_DEBUG("Main thread hang of %f seconds: %d samples, %d distinct stacks, %d dropped",
+                             g_profile.duration, g_profile.sampleCount, g_profile.stackCount, g_profile.droppedSampleCount);
+}
+
+const GIOMonitorCrashHangProfile* gioMonitorCrashHangProfile_get(void)
+{
+    return g_profile.sampleCount > 0 ? &g_profile : NULL;
+}
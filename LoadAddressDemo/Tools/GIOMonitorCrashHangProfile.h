@@ -0,0 +1,104 @@
+//
+//  GIOMonitorCrashHangProfile.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Aggregated stack samples of the main thread, taken while it was hung.
+ * Identical stacks are stored once with a sample count. The addresses of all
+ * distinct stacks share one fixed size pool, so a long hang can't use more
+ * memory; samples of new stacks that don't fit are only counted.
+ *
+ * There is a single profile, written by the watchdog thread and read while
+ * writing a report.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashHangProfile_h
+#define HDR_GIOMonitorCrashHangProfile_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define GIOMonitorCrashHP_MAX_STACKS 128
+#define GIOMonitorCrashHP_MAX_ADDRESSES 8192
+
+typedef struct
+{
+    /** Hash of the stack's addresses. */
+    uint32_t hash;
+
+    /** Index of the stack's first (innermost) address in the address pool. */
+    int firstAddress;
+
+    /** Number of addresses in the stack. */
+    int length;
+
+    /** Number of samples with this stack. */
+    int sampleCount;
+} GIOMonitorCrashHangStack;
+
+typedef struct
+{
+    /** How long the main thread was hung, in seconds. Updated while sampling. */
+    double duration;
+
+    /** Time between samples, in seconds. */
+    double sampleInterval;
+
+    /** Total samples taken, including dropped ones. */
+    int sampleCount;
+
+    /** Samples whose stack didn't fit in the profile. */
+    int droppedSampleCount;
+
+    /** True while the hang is still going on. */
+    bool isInProgress;
+
+    int stackCount;
+    GIOMonitorCrashHangStack stacks[GIOMonitorCrashHP_MAX_STACKS];
+
+    int addressCount;
+    uintptr_t addresses[GIOMonitorCrashHP_MAX_ADDRESSES];
+} GIOMonitorCrashHangProfile;
+
+/** Start a new profile, discarding the previous one.
+ *
+ * @param sampleInterval The time between samples, in seconds.
+ */
+void gioMonitorCrashHangProfile_begin(double sampleInterval);
+
+/** Add a sample to the current profile.
+ *
+ * @param backtrace The sampled stack, innermost frame first.
+ *
+ * @param length The number of frames in the stack.
+ *
+ * @param duration How long the hang has lasted so far, in seconds.
+ */
+void gioMonitorCrashHangProfile_addSample(const uintptr_t* backtrace, int length, double duration);
+
+/** Mark the current profile as finished (the main thread recovered). */
+void gioMonitorCrashHangProfile_end(void);
+
+/** Get the most recent profile. This is async-safe.
+ *
+ * @return The profile, or NULL if no hang has been sampled.
+ */
+const GIOMonitorCrashHangProfile* gioMonitorCrashHangProfile_get(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashHangProfile_h
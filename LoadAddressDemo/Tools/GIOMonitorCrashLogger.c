@@ -26,7 +26,10 @@
 
 
 #include "GIOMonitorCrashLogger.h"
+#include "GIOMonitorCrashDynamicLinker.h"
+#include "GIOMonitorCrashMachineContext.h"
 #include "GIOMonitorCrashSystemCapabilities.h"
+#include "GIOMonitorCrashThread.h"
 
 // ===========================================================================
 #pragma mark - Common -
@@ -35,7 +38,10 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -61,6 +67,23 @@
 /** Where console logs will be written */
 static char g_logFilename[1024];
 
+/* A circular log file is a CircularLogHeader followed by capacity bytes of
+ * log data. head counts every byte ever written, so the newest data ends at
+ * head % capacity, and the file has wrapped once head > capacity.
+ */
+
+#define kCircularLogMagic 0x47434c47
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t capacity;
+    uint64_t head;
+} CircularLogHeader;
+
+/** If nonzero, the log file is circular with this many bytes of log data. */
+static int g_circularLogCapacity = 0;
+
 /** Write a formatted string to the log.
  *
  * @param fmt The format string, followed by its arguments.
@@ -75,6 +98,17 @@ static void writeFmtToLog(const char* fmt, ...);
  */
 static void writeFmtArgsToLog(const char* fmt, va_list args);
 
+/** Write a complete log entry: the context prefix, the message and a newline.
+ *
+ * @param level The log level name.
+ * @param file The source file name.
+ * @param line The source line.
+ * @param function The function name.
+ * @param fmt The message format string.
+ * @param args The message arguments.
+ */
+static void writeEntryToLog(const char* level, const char* file, int line, const char* function, const char* fmt, va_list args);
+
 /** Flush the log stream.
  */
 static void flushLog(void);
@@ -86,6 +120,54 @@ static inline const char* lastPathEntry(const char* const path)
     return lastFile == 0 ? path : lastFile + 1;
 }
 
+static void reverseBytes(char* start, char* end)
+{
+    while(start < --end)
+    {
+        char ch = *start;
+        *start++ = *end;
+        *end = ch;
+    }
+}
+
+int gioMonitorCrashLog_unrollCircularLog(char* const data, const int length)
+{
+    CircularLogHeader header;
+    unlikely_if(data == NULL || length < (int)sizeof(header))
+    {
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+    unlikely_if(header.magic != kCircularLogMagic || header.capacity == 0 ||
+                (uint64_t)length < sizeof(header) + header.capacity)
+    {
+        return -1;
+    }
+
+    const int capacity = (int)header.capacity;
+    memmove(data, data + sizeof(header), (size_t)capacity);
+    if(header.head <= header.capacity)
+    {
+        return (int)header.head;
+    }
+
+    // Rotate the oldest data (just after the head) to the front.
+    char* split = data + header.head % header.capacity;
+    reverseBytes(data, split);
+    reverseBytes(split, data + capacity);
+    reverseBytes(data, data + capacity);
+
+    // The oldest line was partly overwritten.
+    char* firstNewline = memchr(data, '\n', (size_t)capacity);
+    if(firstNewline == NULL)
+    {
+        return capacity;
+    }
+    int skipLength = (int)(firstNewline + 1 - data);
+    memmove(data, firstNewline + 1, (size_t)(capacity - skipLength));
+    return capacity - skipLength;
+}
+
 static inline void writeFmtToLog(const char* fmt, ...)
 {
     va_list args;
@@ -96,28 +178,969 @@ static inline void writeFmtToLog(const char* fmt, ...)
 
 #if GIOMonitorCrashLOGGER_CBufferSize > 0
 
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
 /** The file descriptor where log entries get written. */
 static int g_fd = -1;
 
+static void writeFully(const int fd, const char* pos, int bytesToWrite)
+{
+    while(bytesToWrite > 0)
+    {
+        int bytesWritten = (int)write(fd, pos, (unsigned)bytesToWrite);
+        unlikely_if(bytesWritten == -1)
+        {
+            break;
+        }
+        bytesToWrite -= bytesWritten;
+        pos += bytesWritten;
+    }
+}
 
-static void writeToLog(const char* const str)
+static void pwriteFully(const int fd, const char* pos, int bytesToWrite, off_t offset)
+{
+    while(bytesToWrite > 0)
+    {
+        int bytesWritten = (int)pwrite(fd, pos, (unsigned)bytesToWrite, offset);
+        unlikely_if(bytesWritten <= 0)
+        {
+            break;
+        }
+        bytesToWrite -= bytesWritten;
+        pos += bytesWritten;
+        offset += bytesWritten;
+    }
+}
+
+/** Total bytes reserved in the circular log file (see CircularLogHeader). */
+static uint64_t g_circularLogHead;
+
+/** Holds a copy of the circular log file for gioMonitorCrashLog_getLogTail(). */
+static char* g_circularLogBuffer;
+
+/** Write to the circular log file at the head, overwriting the oldest data.
+ * Concurrent writers reserve their own space, and whoever reserved last
+ * stores the new head in the file header.
+ */
+static void writeToCircularLog(const int fd, const char* str, int length)
+{
+    const uint32_t capacity = (uint32_t)g_circularLogCapacity;
+    unlikely_if((uint32_t)length > capacity)
+    {
+        str += (uint32_t)length - capacity;
+        length = (int)capacity;
+    }
+    const uint64_t start = __atomic_fetch_add(&g_circularLogHead, (uint64_t)length, __ATOMIC_RELAXED);
+    const uint32_t offset = (uint32_t)(start % capacity);
+    const int firstLength = capacity - offset < (uint32_t)length ? (int)(capacity - offset) : length;
+    pwriteFully(fd, str, firstLength, (off_t)(sizeof(CircularLogHeader) + offset));
+    pwriteFully(fd, str + firstLength, length - firstLength, (off_t)sizeof(CircularLogHeader));
+
+    uint64_t head = start + (uint64_t)length;
+    if(__atomic_load_n(&g_circularLogHead, __ATOMIC_RELAXED) == head)
+    {
+        pwriteFully(fd, (const char*)&head, sizeof(head), (off_t)offsetof(CircularLogHeader, head));
+    }
+}
+
+static void writeToLogSinks(const char* const str, const int length)
+{
+    const int fd = g_fd;
+    if(fd >= 0)
+    {
+        if(g_circularLogCapacity > 0)
+        {
+            writeToCircularLog(fd, str, length);
+        }
+        else
+        {
+            writeFully(fd, str, length);
+        }
+    }
+    write(STDOUT_FILENO, str, (unsigned)length);
+}
+
+
+// ===========================================================================
+#pragma mark - Structured Entries -
+// ===========================================================================
+
+/* A structured entry holds a log call's format string and raw arguments, so
+ * that the cost of formatting is paid by whoever writes the log out rather
+ * than by the caller.
+ *
+ * The level, file, function and format strings are normally literals in
+ * this image, so they are stored as offsets from the image base. That keeps
+ * them meaningful in the next launch of the same build. Any that isn't in
+ * the image's __TEXT segment (a format string built at runtime, or a literal
+ * from another image) makes the entry fall back to immediate formatting.
+ *
+ * Arguments follow the header in order: integers, doubles and pointers as
+ * 8 bytes each, strings as a 32-bit length (kNullStringLength for NULL)
+ * followed by the characters, up to the precision if one is given. Anything
+ * else (%n, '*' width or precision, wide characters, unknown conversions)
+ * makes the entry fall back to immediate formatting.
+ */
+
+#define kNullStringLength 0xffffffffu
+#define kMaxFormatSpecLength 32
+
+typedef struct
+{
+    uint64_t level;
+    uint64_t file;
+    uint64_t function;
+    uint64_t fmt;
+    uint32_t line;
+    uint32_t reserved;
+} StructuredEntryHeader;
+
+typedef enum
+{
+    FormatArgNone,
+    FormatArgSigned,
+    FormatArgUnsigned,
+    FormatArgDouble,
+    FormatArgPointer,
+    FormatArgString,
+    FormatArgUnsupported,
+} FormatArgType;
+
+typedef struct
+{
+    /** The first character after the conversion specification. */
+    const char* end;
+
+    /** Length modifier (h, hh, l, ll, q, j, z, t, L), or empty. */
+    char lengthModifier[3];
+
+    /** The precision, or -1 if none was given. */
+    int precision;
+
+    FormatArgType type;
+} FormatSpec;
+
+/** Base address of the image containing the logger, or 0 if unknown. */
+static uintptr_t g_imageBase;
+
+/** End of the image's __TEXT segment, or 0 if unknown. */
+static uintptr_t g_imageTextEnd;
+
+/** If true, log calls in ring buffer mode record structured entries. */
+static bool g_isDeferredFormatting = false;
+
+static void parseFormatSpec(const char* const percent, FormatSpec* const spec)
+{
+    const char* ptr = percent + 1;
+    spec->type = FormatArgUnsupported;
+    spec->lengthModifier[0] = '\0';
+    spec->precision = -1;
+
+    while(*ptr == '-' || *ptr == '+' || *ptr == ' ' || *ptr == '#' || *ptr == '0')
+    {
+        ptr++;
+    }
+    while(*ptr >= '0' && *ptr <= '9')
+    {
+        ptr++;
+    }
+    if(*ptr == '.')
+    {
+        ptr++;
+        spec->precision = 0;
+        while(*ptr >= '0' && *ptr <= '9')
+        {
+            spec->precision = spec->precision * 10 + (*ptr++ - '0');
+        }
+    }
+    int modifierLength = 0;
+    while(modifierLength < 2 && *ptr != '\0' && strchr("hlqjztL", *ptr) != NULL)
+    {
+        spec->lengthModifier[modifierLength++] = *ptr++;
+    }
+    spec->lengthModifier[modifierLength] = '\0';
+
+    switch(*ptr)
+    {
+        case 'c':
+            // %lc is a wide character.
+            spec->type = modifierLength == 0 ? FormatArgSigned : FormatArgUnsupported;
+            break;
+        case 'd': case 'i':
+            spec->type = FormatArgSigned;
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            spec->type = FormatArgUnsigned;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = FormatArgDouble;
+            break;
+        case 'p':
+            spec->type = FormatArgPointer;
+            break;
+        case 's':
+            // %ls is a wide string.
+            spec->type = modifierLength == 0 ? FormatArgString : FormatArgUnsupported;
+            break;
+        case '%':
+            spec->type = ptr == percent + 1 ? FormatArgNone : FormatArgUnsupported;
+            break;
+        default:
+            break;
+    }
+    spec->end = *ptr == '\0' ? ptr : ptr + 1;
+}
+
+static int64_t readIntegerArg(const FormatSpec* const spec, va_list* args)
+{
+    const char* modifier = spec->lengthModifier;
+    bool isSigned = spec->type == FormatArgSigned;
+    if(strcmp(modifier, "l") == 0)
+    {
+        return isSigned ? (int64_t)va_arg(*args, long) : (int64_t)va_arg(*args, unsigned long);
+    }
+    if(strcmp(modifier, "ll") == 0 || strcmp(modifier, "q") == 0)
+    {
+        return isSigned ? (int64_t)va_arg(*args, long long) : (int64_t)va_arg(*args, unsigned long long);
+    }
+    if(strcmp(modifier, "j") == 0)
+    {
+        return (int64_t)va_arg(*args, intmax_t);
+    }
+    if(strcmp(modifier, "z") == 0)
+    {
+        return (int64_t)va_arg(*args, size_t);
+    }
+    if(strcmp(modifier, "t") == 0)
+    {
+        return (int64_t)va_arg(*args, ptrdiff_t);
+    }
+    return isSigned ? (int64_t)va_arg(*args, int) : (int64_t)va_arg(*args, unsigned int);
+}
+
+static int formatIntegerArg(char* out, int outLength, const char* specString, const FormatSpec* const spec, int64_t value)
+{
+    const char* modifier = spec->lengthModifier;
+    if(strcmp(modifier, "l") == 0)
+    {
+        return snprintf(out, (unsigned)outLength, specString, (long)value);
+    }
+    if(strcmp(modifier, "ll") == 0 || strcmp(modifier, "q") == 0)
+    {
+        return snprintf(out, (unsigned)outLength, specString, (long long)value);
+    }
+    if(strcmp(modifier, "j") == 0)
+    {
+        return snprintf(out, (unsigned)outLength, specString, (intmax_t)value);
+    }
+    if(strcmp(modifier, "z") == 0)
+    {
+        return snprintf(out, (unsigned)outLength, specString, (size_t)value);
+    }
+    if(strcmp(modifier, "t") == 0)
+    {
+        return snprintf(out, (unsigned)outLength, specString, (ptrdiff_t)value);
+    }
+    return snprintf(out, (unsigned)outLength, specString, (int)value);
+}
+
+static inline uint64_t imageOffset(const void* const pointer)
+{
+    return (uint64_t)((uintptr_t)pointer - g_imageBase);
+}
+
+static inline const char* imagePointer(const uint64_t offset)
+{
+    return (const char*)(g_imageBase + (uintptr_t)offset);
+}
+
+static inline bool isInImageText(const void* const pointer)
+{
+    return (uintptr_t)pointer >= g_imageBase && (uintptr_t)pointer < g_imageTextEnd;
+}
+
+/** Record a log call as a structured entry.
+ *
+ * @return The entry length, or -1 if it has to be formatted right away.
+ */
+static int captureStructuredEntry(uint8_t* const entry, const int maxLength,
+                                  const char* level, const char* file, int line, const char* function,
+                                  const char* fmt, va_list args)
+{
+    unlikely_if(!isInImageText(level) || !isInImageText(file) || !isInImageText(function) || !isInImageText(fmt))
+    {
+        return -1;
+    }
+
+    StructuredEntryHeader header =
+    {
+        .level = imageOffset(level),
+        .file = imageOffset(file),
+        .function = imageOffset(function),
+        .fmt = imageOffset(fmt),
+        .line = (uint32_t)line,
+        .reserved = 0,
+    };
+    memcpy(entry, &header, sizeof(header));
+    int length = sizeof(header);
+
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    FormatSpec spec;
+    for(const char* percent = strchr(fmt, '%'); percent != NULL; percent = strchr(spec.end, '%'))
+    {
+        parseFormatSpec(percent, &spec);
+        if(spec.type == FormatArgNone)
+        {
+            continue;
+        }
+        unlikely_if(spec.type == FormatArgUnsupported || spec.end - percent >= kMaxFormatSpecLength ||
+                    length + (int)sizeof(uint64_t) > maxLength)
+        {
+            length = -1;
+            break;
+        }
+
+        uint64_t value = 0;
+        switch(spec.type)
+        {
+            case FormatArgSigned:
+            case FormatArgUnsigned:
+                value = (uint64_t)readIntegerArg(&spec, &argsCopy);
+                break;
+            case FormatArgDouble:
+            {
+                double doubleValue = strcmp(spec.lengthModifier, "L") == 0 ? (double)va_arg(argsCopy, long double) : va_arg(argsCopy, double);
+                memcpy(&value, &doubleValue, sizeof(value));
+                break;
+            }
+            case FormatArgPointer:
+                value = (uint64_t)(uintptr_t)va_arg(argsCopy, void*);
+                break;
+            case FormatArgString:
+            {
+                const char* string = va_arg(argsCopy, const char*);
+                uint32_t stringLength = kNullStringLength;
+                if(string != NULL)
+                {
+                    stringLength = (uint32_t)(spec.precision < 0 ? strlen(string) : strnlen(string, (size_t)spec.precision));
+                }
+                memcpy(entry + length, &stringLength, sizeof(stringLength));
+                length += sizeof(stringLength);
+                if(string != NULL)
+                {
+                    unlikely_if(length + (int)stringLength > maxLength)
+                    {
+                        length = -1;
+                        break;
+                    }
+                    memcpy(entry + length, string, stringLength);
+                    length += (int)stringLength;
+                }
+                continue;
+            }
+            default:
+                break;
+        }
+        unlikely_if(length < 0)
+        {
+            break;
+        }
+        memcpy(entry + length, &value, sizeof(value));
+        length += sizeof(value);
+    }
+    va_end(argsCopy);
+    return length;
+}
+
+/** Format a structured entry as a log line (with newline). This is async-safe.
+ *
+ * @param isSameBuild If false, the entry's string offsets are meaningless.
+ *
+ * @return The formatted length.
+ */
+static int formatStructuredEntry(const uint8_t* const entry, const int entryLength, const bool isSameBuild,
+                                 char* const out, const int outLength)
 {
-    if(g_fd >= 0)
+    const int maxLength = outLength - 1;
+    StructuredEntryHeader header;
+    unlikely_if(!isSameBuild || g_imageBase == 0 || entryLength < (int)sizeof(header))
+    {
+        return snprintf(out, (unsigned)outLength, "(structured log entry from another build)\n");
+    }
+    memcpy(&header, entry, sizeof(header));
+
+    int length = snprintf(out, (unsigned)outLength, "%s: %s (%u): %s: ",
+                          imagePointer(header.level), imagePointer(header.file), header.line, imagePointer(header.function));
+    length = length < maxLength ? length : maxLength;
+    const uint8_t* arg = entry + sizeof(header);
+    const uint8_t* const argsEnd = entry + entryLength;
+    const char* pos = imagePointer(header.fmt);
+    FormatSpec spec;
+    char specString[kMaxFormatSpecLength];
+    char stringValue[GIOMonitorCrashLOGGER_CBufferSize];
+
+    while(*pos != '\0' && length < maxLength)
     {
-        int bytesToWrite = (int)strlen(str);
-        const char* pos = str;
-        while(bytesToWrite > 0)
+        const char* percent = strchr(pos, '%');
+        int literalLength = (int)(percent == NULL ? strlen(pos) : (size_t)(percent - pos));
+        literalLength = literalLength < maxLength - length ? literalLength : maxLength - length;
+        memcpy(out + length, pos, (size_t)literalLength);
+        length += literalLength;
+        if(percent == NULL || length >= maxLength)
+        {
+            break;
+        }
+
+        parseFormatSpec(percent, &spec);
+        pos = spec.end;
+        if(spec.type == FormatArgNone)
+        {
+            out[length++] = '%';
+            continue;
+        }
+        int specLength = (int)(spec.end - percent);
+        unlikely_if(spec.type == FormatArgUnsupported || specLength >= kMaxFormatSpecLength || arg + sizeof(uint32_t) > argsEnd)
+        {
+            break;
+        }
+        memcpy(specString, percent, (size_t)specLength);
+        specString[specLength] = '\0';
+
+        int formattedLength = 0;
+        char* const formatted = out + length;
+        const int available = outLength - length;
+        if(spec.type == FormatArgString)
+        {
+            uint32_t stringLength;
+            memcpy(&stringLength, arg, sizeof(stringLength));
+            arg += sizeof(stringLength);
+            if(stringLength == kNullStringLength)
+            {
+                formattedLength = snprintf(formatted, (unsigned)available, specString, "(null)");
+            }
+            else
+            {
+                unlikely_if(arg + stringLength > argsEnd)
+                {
+                    break;
+                }
+                uint32_t copyLength = stringLength < sizeof(stringValue) - 1 ? stringLength : (uint32_t)sizeof(stringValue) - 1;
+                memcpy(stringValue, arg, copyLength);
+                stringValue[copyLength] = '\0';
+                arg += stringLength;
+                formattedLength = snprintf(formatted, (unsigned)available, specString, stringValue);
+            }
+            length += formattedLength < available ? formattedLength : available - 1;
+            continue;
+        }
+
+        uint64_t value;
+        unlikely_if(arg + sizeof(value) > argsEnd)
+        {
+            break;
+        }
+        memcpy(&value, arg, sizeof(value));
+        arg += sizeof(value);
+        switch(spec.type)
         {
-            int bytesWritten = (int)write(g_fd, pos, (unsigned)bytesToWrite);
-            unlikely_if(bytesWritten == -1)
+            case FormatArgDouble:
             {
+                double doubleValue;
+                memcpy(&doubleValue, &value, sizeof(doubleValue));
+                if(strcmp(spec.lengthModifier, "L") == 0)
+                {
+                    formattedLength = snprintf(formatted, (unsigned)available, specString, (long double)doubleValue);
+                }
+                else
+                {
+                    formattedLength = snprintf(formatted, (unsigned)available, specString, doubleValue);
+                }
                 break;
             }
-            bytesToWrite -= bytesWritten;
-            pos += bytesWritten;
+            case FormatArgPointer:
+                formattedLength = snprintf(formatted, (unsigned)available, specString, (void*)(uintptr_t)value);
+                break;
+            default:
+                formattedLength = formatIntegerArg(formatted, available, specString, &spec, (int64_t)value);
+                break;
         }
+        length += formattedLength < available ? formattedLength : available - 1;
     }
-    write(STDOUT_FILENO, str, strlen(str));
+
+    length = length < maxLength ? length : maxLength;
+    out[length++] = '\n';
+    return length;
+}
+
+
+// ===========================================================================
+#pragma mark - Ring Buffer -
+// ===========================================================================
+
+/* In ring buffer mode, log entries are appended to a memory mapped file
+ * without any system calls, and a background thread copies them out to the
+ * log file and stdout. Any number of threads can append at once: each one
+ * reserves space by moving reservedPosition forward with a compare and swap,
+ * writes the record's header with its length, copies its entry in, then marks
+ * the record as committed.
+ *
+ * Each record is a 32-bit header (payload length | kRingRecordReserved, plus
+ * kRingRecordStructured for structured entries, and kRingRecordCommitted once
+ * the payload is in) followed by the payload, padded to 4 bytes. Positions
+ * only ever increase; the offset into the ring is position % capacity.
+ * Flushed records are zeroed so that a stale header is never mistaken for a
+ * live one.
+ *
+ * Since every reserved record has its length, a producer that stalls (or is
+ * suspended) before committing only holds back flushedPosition. Committed
+ * records after it are still written out, and marked kRingRecordFlushed so
+ * they aren't written twice. Only the few instructions between the compare
+ * and swap and the header store can stop the drain.
+ *
+ * Since the ring lives in a file, entries that were never flushed (because
+ * the process died) are recovered the next time the ring is opened. Records
+ * that were never committed are written out as incomplete entries.
+ * Structured entries are only decoded if the ring was written by the same
+ * build (imageMarker, derived from the image UUID, matches).
+ *
+ * The flush thread is a reserved thread, so that the crash handler never
+ * suspends it while it holds the ring lock.
+ */
+
+#define kRingBufferMagic 0x4752424d
+#define kRingRecordCommitted 0x80000000u
+#define kRingRecordStructured 0x40000000u
+#define kRingRecordReserved 0x20000000u
+#define kRingRecordFlushed 0x10000000u
+#define kRingRecordLengthMask 0x0fffffffu
+#define kRingBufferFlushIntervalUSec 200000
+#define kRingFlushWaitMilliseconds 100
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t capacity;
+    uint64_t reservedPosition;
+    uint64_t flushedPosition;
+    uint64_t imageMarker;
+} RingBufferHeader;
+
+static RingBufferHeader* volatile g_ring = NULL;
+static uint8_t* g_ringData;
+static uint32_t g_droppedEntryCount;
+static uint64_t g_imageMarker;
+
+/** The thread draining the ring, or 0. The drain buffers belong to it. */
+static GIOMonitorCrashThread g_ringFlushOwner;
+
+static char g_drainBuffer[GIOMonitorCrashLOGGER_CBufferSize];
+static int g_drainBufferLength;
+static uint8_t g_drainStructuredEntry[GIOMonitorCrashLOGGER_CBufferSize];
+static char g_drainFormattedEntry[GIOMonitorCrashLOGGER_CBufferSize];
+
+/** Find the image base (for structured entries) and a marker identifying
+ * this build (for recovering them).
+ */
+static void initImageInfo(void)
+{
+    Dl_info info;
+    if(g_imageBase != 0 || dladdr((const void*)initImageInfo, &info) == 0 || info.dli_fbase == NULL)
+    {
+        return;
+    }
+    g_imageBase = (uintptr_t)info.dli_fbase;
+    GIOMonitorCrashBinaryImage image;
+    const uint32_t imageIndex = info.dli_fname == NULL ? UINT32_MAX : gioMonitorCrashDynamicLinker_imageNamed(info.dli_fname, true);
+    if(imageIndex != UINT32_MAX && gioMonitorCrashDynamicLinker_getBinaryImage((int)imageIndex, &image) &&
+       image.address == g_imageBase)
+    {
+        g_imageTextEnd = g_imageBase + (uintptr_t)image.size;
+    }
+    const uint8_t* uuid = info.dli_fname == NULL ? NULL : gioMonitorCrashDynamicLinker_imageUUID(info.dli_fname, true);
+    if(uuid != NULL)
+    {
+        uint64_t high;
+        uint64_t low;
+        memcpy(&high, uuid, sizeof(high));
+        memcpy(&low, uuid + sizeof(high), sizeof(low));
+        g_imageMarker = high ^ low;
+    }
+    else
+    {
+        // No UUID to go by, so structured entries can't be trusted across launches.
+        g_imageMarker = (uint64_t)g_imageBase;
+    }
+}
+
+static inline uint64_t ringRecordSize(uint32_t payloadLength)
+{
+    return sizeof(uint32_t) + (((uint64_t)payloadLength + 3) & ~(uint64_t)3);
+}
+
+static void copyIntoRing(RingBufferHeader* ring, uint64_t position, const void* src, uint32_t length)
+{
+    uint32_t offset = (uint32_t)(position % ring->capacity);
+    uint32_t firstLength = ring->capacity - offset < length ? ring->capacity - offset : length;
+    memcpy(g_ringData + offset, src, firstLength);
+    memcpy(g_ringData, (const uint8_t*)src + firstLength, length - firstLength);
+}
+
+static void copyFromRing(RingBufferHeader* ring, uint64_t position, void* dst, uint32_t length)
+{
+    uint32_t offset = (uint32_t)(position % ring->capacity);
+    uint32_t firstLength = ring->capacity - offset < length ? ring->capacity - offset : length;
+    memcpy(dst, g_ringData + offset, firstLength);
+    memcpy((uint8_t*)dst + firstLength, g_ringData, length - firstLength);
+}
+
+static void zeroRing(RingBufferHeader* ring, uint64_t position, uint64_t length)
+{
+    uint32_t offset = (uint32_t)(position % ring->capacity);
+    uint64_t firstLength = ring->capacity - offset < length ? ring->capacity - offset : length;
+    memset(g_ringData + offset, 0, (size_t)firstLength);
+    memset(g_ringData, 0, (size_t)(length - firstLength));
+}
+
+/** Append an entry to the ring buffer. This is async-safe.
+ *
+ * @param flags 0, or kRingRecordStructured if the payload is a structured entry.
+ *
+ * @return false if the entry must be written directly instead.
+ */
+static bool appendToRing(RingBufferHeader* ring, const void* const payload, const int length, const uint32_t flags)
+{
+    const uint64_t recordSize = ringRecordSize((uint32_t)length);
+    unlikely_if(recordSize > ring->capacity / 2)
+    {
+        return false;
+    }
+
+    uint64_t position = __atomic_load_n(&ring->reservedPosition, __ATOMIC_RELAXED);
+    do
+    {
+        uint64_t flushedPosition = __atomic_load_n(&ring->flushedPosition, __ATOMIC_ACQUIRE);
+        unlikely_if(position + recordSize - flushedPosition > ring->capacity)
+        {
+            // The flush thread is falling behind. Drop the entry rather than block.
+            __atomic_add_fetch(&g_droppedEntryCount, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    while(!__atomic_compare_exchange_n(&ring->reservedPosition, &position, position + recordSize,
+                                       true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    uint32_t* header = (uint32_t*)(g_ringData + position % ring->capacity);
+    __atomic_store_n(header, (uint32_t)length | flags | kRingRecordReserved, __ATOMIC_RELEASE);
+    copyIntoRing(ring, position + sizeof(uint32_t), payload, (uint32_t)length);
+    __atomic_store_n(header, (uint32_t)length | flags | kRingRecordReserved | kRingRecordCommitted, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool tryLockRing(void)
+{
+    GIOMonitorCrashThread expected = 0;
+    return __atomic_compare_exchange_n(&g_ringFlushOwner, &expected, gioMonitorCrashThread_self(),
+                                       false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void unlockRing(void)
+{
+    __atomic_store_n(&g_ringFlushOwner, 0, __ATOMIC_RELEASE);
+}
+
+/** Add to the drain buffer, writing it out whenever it fills up.
+ * Call with the ring lock held.
+ */
+static void drainOutput(const void* const data, uint32_t length)
+{
+    const uint8_t* src = data;
+    while(length > 0)
+    {
+        unlikely_if(g_drainBufferLength == (int)sizeof(g_drainBuffer))
+        {
+            writeToLogSinks(g_drainBuffer, g_drainBufferLength);
+            g_drainBufferLength = 0;
+        }
+        uint32_t chunkLength = (uint32_t)sizeof(g_drainBuffer) - (uint32_t)g_drainBufferLength;
+        chunkLength = chunkLength < length ? chunkLength : length;
+        memcpy(g_drainBuffer + g_drainBufferLength, src, chunkLength);
+        g_drainBufferLength += (int)chunkLength;
+        src += chunkLength;
+        length -= chunkLength;
+    }
+}
+
+static void drainOutputFromRing(RingBufferHeader* ring, uint64_t position, uint32_t length)
+{
+    while(length > 0)
+    {
+        uint32_t offset = (uint32_t)(position % ring->capacity);
+        uint32_t chunkLength = ring->capacity - offset < length ? ring->capacity - offset : length;
+        drainOutput(g_ringData + offset, chunkLength);
+        position += chunkLength;
+        length -= chunkLength;
+    }
+}
+
+static void drainOutputUnsigned(uint32_t value)
+{
+    char digits[10];
+    int digitCount = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - digitCount++] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    while(value > 0);
+    drainOutput(digits + sizeof(digits) - digitCount, (uint32_t)digitCount);
+}
+
+static void drainOutputString(const char* const str)
+{
+    drainOutput(str, (uint32_t)strlen(str));
+}
+
+/** Write out all committed entries, oldest first. Call with the ring lock
+ * held, since the buffers it uses belong to the lock owner.
+ * This is async-safe.
+ *
+ * @param isRecovering If true, the ring was left by a dead process, so
+ *                     records that were never committed never will be.
+ *
+ * @return The number of ring buffer bytes freed.
+ */
+static uint64_t drainRing(RingBufferHeader* ring, const bool isRecovering)
+{
+    const bool isSameBuild = ring->imageMarker == g_imageMarker;
+    const uint64_t startPosition = __atomic_load_n(&ring->flushedPosition, __ATOMIC_ACQUIRE);
+    uint64_t flushedPosition = startPosition;
+    uint64_t position = startPosition;
+    const uint64_t endPosition = __atomic_load_n(&ring->reservedPosition, __ATOMIC_ACQUIRE);
+
+    while(position < endPosition)
+    {
+        uint32_t* headerPtr = (uint32_t*)(g_ringData + position % ring->capacity);
+        uint32_t header = __atomic_load_n(headerPtr, __ATOMIC_ACQUIRE);
+        unlikely_if(header == 0)
+        {
+            // Reserved, but its length isn't known yet.
+            break;
+        }
+        const uint32_t length = header & kRingRecordLengthMask;
+        const uint64_t recordSize = ringRecordSize(length);
+        const uint64_t payloadPosition = position + sizeof(uint32_t);
+
+        unlikely_if((header & kRingRecordCommitted) == 0)
+        {
+            if(!isRecovering)
+            {
+                // Still being written. It holds back flushedPosition until it's done.
+                position += recordSize;
+                continue;
+            }
+            drainOutputString("GIOMonitorCrashLogger: (incomplete log entry)\n");
+        }
+        else if((header & kRingRecordFlushed) == 0)
+        {
+            if(header & kRingRecordStructured)
+            {
+                uint32_t entryLength = length < sizeof(g_drainStructuredEntry) ? length : (uint32_t)sizeof(g_drainStructuredEntry);
+                copyFromRing(ring, payloadPosition, g_drainStructuredEntry, entryLength);
+                int formattedLength = formatStructuredEntry(g_drainStructuredEntry, (int)entryLength, isSameBuild,
+                                                            g_drainFormattedEntry, sizeof(g_drainFormattedEntry));
+                drainOutput(g_drainFormattedEntry, (uint32_t)formattedLength);
+            }
+            else
+            {
+                drainOutputFromRing(ring, payloadPosition, length);
+            }
+            if(position != flushedPosition)
+            {
+                // Can't be freed until the records before it are.
+                __atomic_store_n(headerPtr, header | kRingRecordFlushed, __ATOMIC_RELAXED);
+            }
+        }
+
+        if(position == flushedPosition)
+        {
+            zeroRing(ring, position, recordSize);
+            flushedPosition = position + recordSize;
+            __atomic_store_n(&ring->flushedPosition, flushedPosition, __ATOMIC_RELEASE);
+        }
+        position += recordSize;
+    }
+
+    uint32_t droppedCount = __atomic_exchange_n(&g_droppedEntryCount, 0, __ATOMIC_RELAXED);
+    unlikely_if(droppedCount > 0)
+    {
+        drainOutputString("GIOMonitorCrashLogger: Dropped ");
+        drainOutputUnsigned(droppedCount);
+        drainOutputString(" log entries\n");
+    }
+    if(g_drainBufferLength > 0)
+    {
+        writeToLogSinks(g_drainBuffer, g_drainBufferLength);
+        g_drainBufferLength = 0;
+    }
+    return flushedPosition - startPosition;
+}
+
+static void* ringFlushThread(__unused void* userData)
+{
+    useconds_t interval = kRingBufferFlushIntervalUSec;
+    for(;;)
+    {
+        usleep(interval);
+        RingBufferHeader* ring = g_ring;
+        if(ring != NULL && tryLockRing())
+        {
+            uint64_t drainedBytes = drainRing(ring, false);
+            unlockRing();
+            // Come back sooner while the ring is filling up quickly.
+            interval = drainedBytes > ring->capacity / 8 ? kRingBufferFlushIntervalUSec / 20 : kRingBufferFlushIntervalUSec;
+        }
+    }
+    return NULL;
+}
+
+bool gioMonitorCrashLog_setRingBuffer(const char* filename, int capacity)
+{
+    static bool isFlushThreadStarted = false;
+    if(g_ring != NULL)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Ring buffer already set\n");
+        return false;
+    }
+    if(filename == NULL || capacity < 4096)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Invalid ring buffer capacity %d\n", capacity);
+        return false;
+    }
+    capacity &= ~3;
+    initImageInfo();
+
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    unlikely_if(fd < 0)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Could not open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    const off_t fileSize = (off_t)(sizeof(RingBufferHeader) + (unsigned)capacity);
+    struct stat st;
+    bool isExistingRing = fstat(fd, &st) == 0 && st.st_size == fileSize;
+    unlikely_if(!isExistingRing && ftruncate(fd, fileSize) != 0)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Could not resize %s: %s\n", filename, strerror(errno));
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL, (size_t)fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    unlikely_if(mapping == MAP_FAILED)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Could not map %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    RingBufferHeader* ring = mapping;
+    g_ringData = (uint8_t*)mapping + sizeof(RingBufferHeader);
+    if(isExistingRing && ring->magic == kRingBufferMagic && ring->capacity == (uint32_t)capacity &&
+       ring->flushedPosition <= ring->reservedPosition)
+    {
+        // Recover entries the previous session didn't get to flush.
+        if(ring->flushedPosition < ring->reservedPosition)
+        {
+            writeFmtToLog("GIOMonitorCrashLogger: Unflushed log entries from the previous session:\n");
+            if(tryLockRing())
+            {
+                drainRing(ring, true);
+                unlockRing();
+            }
+        }
+    }
+    else
+    {
+        memset(mapping, 0, (size_t)fileSize);
+        ring->magic = kRingBufferMagic;
+        ring->capacity = (uint32_t)capacity;
+    }
+    // Anything left (a reservation whose header was never written) is discarded.
+    ring->reservedPosition = ring->flushedPosition = 0;
+    ring->imageMarker = g_imageMarker;
+    memset(g_ringData, 0, (size_t)capacity);
+
+    g_ring = ring;
+    if(!isFlushThreadStarted)
+    {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        isFlushThreadStarted = pthread_create(&thread, &attr, ringFlushThread, NULL) == 0;
+        pthread_attr_destroy(&attr);
+        if(isFlushThreadStarted)
+        {
+            gioMonitorCrashMachineContext_addReservedThread((GIOMonitorCrashThread)pthread_mach_thread_np(thread));
+        }
+    }
+    return true;
+}
+
+void gioMonitorCrashLog_setDeferredFormatting(bool isEnabled)
+{
+    initImageInfo();
+    g_isDeferredFormatting = isEnabled && g_imageTextEnd != 0;
+}
+
+void gioMonitorCrashLog_flushRingBuffer(void)
+{
+    RingBufferHeader* ring = g_ring;
+    if(ring == NULL)
+    {
+        return;
+    }
+    unlikely_if(__atomic_load_n(&g_ringFlushOwner, __ATOMIC_ACQUIRE) == gioMonitorCrashThread_self())
+    {
+        // Crashed while draining. The ring can't be trusted now.
+        return;
+    }
+    // The flush thread is reserved, so it's never suspended holding the lock.
+    // It will be done soon. Waiting is bounded in case it couldn't be reserved.
+    for(int waited = 0; !tryLockRing(); waited++)
+    {
+        unlikely_if(waited >= kRingFlushWaitMilliseconds)
+        {
+            return;
+        }
+        usleep(1000);
+    }
+    drainRing(ring, false);
+    unlockRing();
+}
+
+
+// ===========================================================================
+#pragma mark - Buffered Log -
+// ===========================================================================
+
+static void writeToLogWithLength(const char* const str, const int length)
+{
+    RingBufferHeader* ring = g_ring;
+    likely_if(ring != NULL && appendToRing(ring, str, length, 0))
+    {
+        return;
+    }
+    writeToLogSinks(str, length);
+}
+
+static void writeToLog(const char* const str)
+{
+    writeToLogWithLength(str, (int)strlen(str));
 }
 
 static inline void writeFmtArgsToLog(const char* fmt, va_list args)
@@ -134,6 +1157,37 @@ static inline void writeFmtArgsToLog(const char* fmt, va_list args)
     }
 }
 
+static void writeEntryToLog(const char* level, const char* file, int line, const char* function, const char* fmt, va_list args)
+{
+    RingBufferHeader* ring = g_ring;
+    if(g_isDeferredFormatting && ring != NULL)
+    {
+        uint8_t entry[GIOMonitorCrashLOGGER_CBufferSize];
+        int entryLength = captureStructuredEntry(entry, sizeof(entry), level, file, line, function, fmt, args);
+        likely_if(entryLength > 0 && appendToRing(ring, entry, entryLength, kRingRecordStructured))
+        {
+            return;
+        }
+    }
+
+    char buffer[GIOMonitorCrashLOGGER_CBufferSize];
+    const int maxLength = (int)sizeof(buffer) - 1;
+    int length = snprintf(buffer, sizeof(buffer), "%s: %s (%u): %s: ", level, file, line, function);
+    length = length < maxLength ? length : maxLength;
+    unlikely_if(fmt == NULL)
+    {
+        length += snprintf(buffer + length, (unsigned)(maxLength + 1 - length), "(null)");
+    }
+    else
+    {
+        length += vsnprintf(buffer + length, (unsigned)(maxLength + 1 - length), fmt, args);
+    }
+    // Always end with a newline, even if the message was truncated.
+    length = length < maxLength ? length : maxLength;
+    buffer[length++] = '\n';
+    writeToLogWithLength(buffer, length);
+}
+
 static inline void flushLog(void)
 {
     // Nothing to do.
@@ -170,10 +1224,73 @@ bool gioMonitorCrashLog_setLogFilename(const char* filename, bool overwrite)
         }
     }
 
+    g_circularLogCapacity = 0;
     setLogFD(fd);
     return true;
 }
 
+bool gioMonitorCrashLog_setCircularLogFilename(const char* filename, int capacity)
+{
+    if(filename == NULL || capacity < 1024)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Invalid circular log capacity %d\n", capacity);
+        return false;
+    }
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    unlikely_if(fd < 0)
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Could not open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    CircularLogHeader header = {.magic = kCircularLogMagic, .capacity = (uint32_t)capacity, .head = 0};
+    const size_t fileSize = sizeof(header) + (unsigned)capacity;
+    unlikely_if(ftruncate(fd, (off_t)fileSize) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+    {
+        writeFmtToLog("GIOMonitorCrashLogger: Could not initialize %s: %s\n", filename, strerror(errno));
+        close(fd);
+        return false;
+    }
+    char* buffer = malloc(fileSize);
+    unlikely_if(buffer == NULL)
+    {
+        close(fd);
+        return false;
+    }
+
+    if(filename != g_logFilename)
+    {
+        strncpy(g_logFilename, filename, sizeof(g_logFilename));
+    }
+    g_circularLogCapacity = 0;
+    setLogFD(fd);
+    char* oldBuffer = g_circularLogBuffer;
+    g_circularLogBuffer = buffer;
+    free(oldBuffer);
+    g_circularLogHead = 0;
+    g_circularLogCapacity = capacity;
+    return true;
+}
+
+const char* gioMonitorCrashLog_getLogTail(int* length)
+{
+    const int fd = g_fd;
+    const int capacity = g_circularLogCapacity;
+    char* const buffer = g_circularLogBuffer;
+    if(capacity <= 0 || buffer == NULL || fd < 0)
+    {
+        return NULL;
+    }
+    int bytesRead = (int)pread(fd, buffer, sizeof(CircularLogHeader) + (unsigned)capacity, 0);
+    int tailLength = gioMonitorCrashLog_unrollCircularLog(buffer, bytesRead);
+    if(tailLength < 0)
+    {
+        return NULL;
+    }
+    *length = tailLength;
+    return buffer;
+}
+
 #else // if GIOMonitorCrashLogger_CBufferSize <= 0
 
 static FILE* g_file = NULL;
@@ -213,11 +1330,32 @@ static inline void writeFmtArgsToLog(const char* fmt, va_list args)
     }
 }
 
+static void writeEntryToLog(const char* level, const char* file, int line, const char* function, const char* fmt, va_list args)
+{
+    writeFmtToLog("%s: %s (%u): %s: ", level, file, line, function);
+    writeFmtArgsToLog(fmt, args);
+    writeToLog("\n");
+}
+
 static inline void flushLog(void)
 {
     fflush(g_file);
 }
 
+bool gioMonitorCrashLog_setRingBuffer(__unused const char* filename, __unused int capacity)
+{
+    writeToLog("GIOMonitorCrashLogger: Ring buffer requires GIOMonitorCrashLOGGER_CBufferSize > 0\n");
+    return false;
+}
+
+void gioMonitorCrashLog_flushRingBuffer(void)
+{
+}
+
+void gioMonitorCrashLog_setDeferredFormatting(__unused bool isEnabled)
+{
+}
+
 bool gioMonitorCrashLog_setLogFilename(const char* filename, bool overwrite)
 {
     static FILE* file = NULL;
@@ -245,10 +1383,26 @@ bool gioMonitorCrashLog_setLogFilename(const char* filename, bool overwrite)
     return true;
 }
 
+bool gioMonitorCrashLog_setCircularLogFilename(const char* filename, __unused int capacity)
+{
+    writeToLog("GIOMonitorCrashLogger: Circular log requires GIOMonitorCrashLOGGER_CBufferSize > 0\n");
+    gioMonitorCrashLog_setLogFilename(filename, true);
+    return false;
+}
+
+const char* gioMonitorCrashLog_getLogTail(__unused int* length)
+{
+    return NULL;
+}
+
 #endif
 
 bool gioMonitorCrashLog_clearLogFile()
 {
+    if(g_circularLogCapacity > 0)
+    {
+        return gioMonitorCrashLog_setCircularLogFilename(g_logFilename, g_circularLogCapacity);
+    }
     return gioMonitorCrashLog_setLogFilename(g_logFilename, true);
 }
 
@@ -273,12 +1427,10 @@ void i_gioMonitorCrashLog_logC(const char* const level,
                   const char* const function,
                   const char* const fmt, ...)
 {
-    writeFmtToLog("%s: %s (%u): %s: ", level, lastPathEntry(file), line, function);
     va_list args;
     va_start(args,fmt);
-    writeFmtArgsToLog(fmt, args);
+    writeEntryToLog(level, lastPathEntry(file), line, function, fmt, args);
     va_end(args);
-    writeToLog("\n");
     flushLog();
 }
 
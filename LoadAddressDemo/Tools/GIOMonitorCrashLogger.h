@@ -258,9 +258,68 @@ void i_gioMonitorCrashLog_logCBasic(const char* fmt, ...);
  */
 bool gioMonitorCrashLog_setLogFilename(const char* filename, bool overwrite);
 
+/** Log to a fixed-size circular file instead. Once full, the oldest data is
+ * overwritten, so the file never grows. The file is cleared.
+ *
+ * @param filename The file to write to.
+ *
+ * @param capacity The number of bytes of log data to keep (at least 1024).
+ *
+ * @return true if the circular log file is in use.
+ */
+bool gioMonitorCrashLog_setCircularLogFilename(const char* filename, int capacity);
+
+/** Get the contents of the circular log file, oldest first, starting at a
+ * line boundary. Reads the file with a single pread into a buffer allocated
+ * when the file was set. This is async-safe.
+ *
+ * @param length Place to store the length of the contents.
+ *
+ * @return The contents (not null terminated), or NULL if not using a circular log file.
+ */
+const char* gioMonitorCrashLog_getLogTail(int* length);
+
+/** Convert the raw contents of a circular log file into plain log text in place.
+ * This is async-safe.
+ *
+ * @param data The file contents.
+ *
+ * @param length The length of the file contents.
+ *
+ * @return The length of the log text, or -1 if data isn't a circular log file.
+ */
+int gioMonitorCrashLog_unrollCircularLog(char* data, int length);
+
 /** Clear the log file. */
 bool gioMonitorCrashLog_clearLogFile(void);
 
+/** Buffer log entries in a memory mapped ring buffer file instead of writing
+ * them out immediately. A background thread copies them to the log file and
+ * stdout. Entries the process never got to flush are recovered into the log
+ * file the next time the ring buffer is opened.
+ *
+ * @param filename The ring buffer file.
+ *
+ * @param capacity The size of the ring buffer, in bytes (at least 4096).
+ *
+ * @return true if the ring buffer is in use.
+ */
+bool gioMonitorCrashLog_setRingBuffer(const char* filename, int capacity);
+
+/** Write out everything in the ring buffer right away. This is async-safe,
+ * and meant to be called while handling a crash. If the flush thread is
+ * writing entries out, this waits briefly for it to finish.
+ */
+void gioMonitorCrashLog_flushRingBuffer(void);
+
+/** Record log entries as a format string plus raw arguments, and leave the
+ * formatting to whoever writes the ring buffer out. Only applies while a ring
+ * buffer is in use; entries with unsupported arguments are formatted right away.
+ *
+ * @param isEnabled If true, defer formatting.
+ */
+void gioMonitorCrashLog_setDeferredFormatting(bool isEnabled);
+
 /** Tests if the logger would print at the specified level.
  *
  * @param LEVEL The level to test for. One of:
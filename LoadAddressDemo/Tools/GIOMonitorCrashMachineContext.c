@@ -26,12 +26,15 @@
 
 #include "GIOMonitorCrashMachineContext_Apple.h"
 #include "GIOMonitorCrashMachineContext.h"
+#include "GIOMonitorCrashArena.h"
 #include "GIOMonitorCrashSystemCapabilities.h"
 #include "GIOMonitorCrashCPU.h"
 #include "GIOMonitorCrashCPU_Apple.h"
 #include "GIOMonitorCrashStackCursor_MachineContext.h"
 
 #include <mach/mach.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 //#define GIOMonitorCrashLogger_LocalLevel TRACE
 #include "GIOMonitorCrashLogger.h"
@@ -44,58 +47,181 @@
     typedef ucontext_t SignalUserContext;
 #endif
 
-static GIOMonitorCrashThread g_reservedThreads[10];
-static int g_reservedThreadsMaxIndex = sizeof(g_reservedThreads) / sizeof(g_reservedThreads[0]) - 1;
-static int g_reservedThreadsCount = 0;
-
+/** Reserved threads are kept in an open addressing hash set, keyed by thread.
+ * 0 (MACH_PORT_NULL) marks an empty slot. The set is kept at most 5/8 full.
+ */
+#define kReservedThreadsCapacity 16
+#define kReservedThreadsMaxCount 10
 
+static GIOMonitorCrashThread g_reservedThreads[kReservedThreadsCapacity];
+static int g_reservedThreadsCount = 0;
 
-static inline bool isStackOverflow(const GIOMonitorCrashMachineContext* const context)
+/** All threads of the task, enumerated once when the environment is suspended
+ * and reused until it is resumed.
+ */
+typedef struct
 {
+    thread_act_array_t threads;
+    mach_msg_type_number_t threadCount;
+    bool isValid;
+} EnvironmentSnapshot;
+
+static EnvironmentSnapshot g_environment;
+
+/** The thread that has the environment suspended, or 0. g_environment and
+ * g_suspendDepth belong to it. Suspending again on that thread only nests,
+ * and the threads are resumed when the outermost suspend is balanced.
+ */
+static GIOMonitorCrashThread g_environmentOwner = 0;
+static int g_suspendDepth = 0;
+
+/** Thread list storage for crashed contexts filled without the crash arena.
+ * Replaced once by reserveThreadStorage(), before any monitor is enabled, and
+ * never freed, so a handler can't see it go away. It is shared, so only one
+ * thread at a time may fill a crashed context without the arena. The monitors
+ * only do so with the environment suspended.
+ */
+static thread_t g_defaultThreads[100];
+static thread_t* g_threads = g_defaultThreads;
+static int g_threadCapacity = sizeof(g_defaultThreads) / sizeof(g_defaultThreads[0]);
+static int g_maxThreadCount = sizeof(g_defaultThreads) / sizeof(g_defaultThreads[0]);
+
+static inline bool isReservedThread(GIOMonitorCrashThread thread);
+
+
+/** Walk the stack to check for stack overflow. If the calling thread holds
+ * the crash arena, the frames are kept there so that later stack cursors on
+ * this context don't have to walk it again. They are never kept on the stack
+ * being walked, which may be the one overflowing.
+ */
+static inline bool isStackOverflow(GIOMonitorCrashMachineContext* const context)
+{
+    context->stackFrameCount = 0;
+    context->stackFrames = gioMonitorCrashArena_allocate(sizeof(*context->stackFrames) * GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD);
     GIOMonitorCrashStackCursor stackCursor;
     gioMonitorCrashStackCursor_initWithMachineContext(&stackCursor, GIOMonitorCrashSC_STACK_OVERFLOW_THRESHOLD, context);
+    int frameCount = 0;
     while(stackCursor.advanceCursor(&stackCursor))
     {
+        if(context->stackFrames != NULL)
+        {
+            context->stackFrames[frameCount++] = stackCursor.stackEntry.address;
+        }
     }
+    context->stackFrameCount = frameCount;
     return stackCursor.state.hasGivenUp;
 }
 
-static inline bool getThreadList(GIOMonitorCrashMachineContext* context)
+static inline bool takeSnapshot(EnvironmentSnapshot* snapshot)
 {
-    const task_t thisTask = mach_task_self();
-    GIOMonitorCrashLOG_DEBUG("Getting thread list");
     kern_return_t kr;
-    thread_act_array_t threads;
-    mach_msg_type_number_t actualThreadCount;
-
-    if((kr = task_threads(thisTask, &threads, &actualThreadCount)) != KERN_SUCCESS)
+    if((kr = task_threads(mach_task_self(), &snapshot->threads, &snapshot->threadCount)) != KERN_SUCCESS)
     {
         GIOMonitorCrashLOG_ERROR("task_threads: %s", mach_error_string(kr));
+        snapshot->isValid = false;
         return false;
     }
-    GIOMonitorCrashLOG_TRACE("Got %d threads", context->threadCount);
-    int threadCount = (int)actualThreadCount;
-    int maxThreadCount = sizeof(context->allThreads) / sizeof(context->allThreads[0]);
-    if(threadCount > maxThreadCount)
+    GIOMonitorCrashLOG_TRACE("Got %d threads", snapshot->threadCount);
+    snapshot->isValid = true;
+    return true;
+}
+
+static inline void releaseSnapshot(EnvironmentSnapshot* snapshot)
+{
+    if(!snapshot->isValid)
+    {
+        return;
+    }
+    const task_t thisTask = mach_task_self();
+    for(mach_msg_type_number_t i = 0; i < snapshot->threadCount; i++)
     {
-        GIOMonitorCrashLOG_ERROR("Thread count %d is higher than maximum of %d", threadCount, maxThreadCount);
-        threadCount = maxThreadCount;
+        mach_port_deallocate(thisTask, snapshot->threads[i]);
     }
+    vm_deallocate(thisTask, (vm_address_t)snapshot->threads, sizeof(thread_t) * snapshot->threadCount);
+    snapshot->isValid = false;
+}
+
+static inline bool getThreadList(GIOMonitorCrashMachineContext* context)
+{
+    GIOMonitorCrashLOG_DEBUG("Getting thread list");
+    EnvironmentSnapshot localSnapshot = {0};
+    EnvironmentSnapshot* snapshot = &g_environment;
+    if(__atomic_load_n(&g_environmentOwner, __ATOMIC_ACQUIRE) != gioMonitorCrashThread_self() || !snapshot->isValid)
+    {
+        snapshot = &localSnapshot;
+        if(!takeSnapshot(snapshot))
+        {
+            return false;
+        }
+    }
+
+    thread_act_array_t threads = snapshot->threads;
+    int threadCount = (int)snapshot->threadCount;
+    int maxThreadCount = g_maxThreadCount;
+    context->allThreads = gioMonitorCrashArena_allocate(sizeof(*context->allThreads) * maxThreadCount);
+    if(context->allThreads == NULL)
+    {
+        maxThreadCount = __atomic_load_n(&g_threadCapacity, __ATOMIC_ACQUIRE);
+        context->allThreads = g_threads;
+    }
+    // The reporter's own threads keep running while the others are suspended,
+    // so their stacks can't be walked. Leave them out, unless one crashed.
+    int count = 0;
     for(int i = 0; i < threadCount; i++)
     {
-        context->allThreads[i] = threads[i];
+        if(threads[i] != context->thisThread && isReservedThread((GIOMonitorCrashThread)threads[i]))
+        {
+            continue;
+        }
+        if(count >= maxThreadCount)
+        {
+            GIOMonitorCrashLOG_ERROR("Thread count %d is higher than maximum of %d", threadCount, maxThreadCount);
+            break;
+        }
+        context->allThreads[count++] = threads[i];
     }
-    context->threadCount = threadCount;
+    context->threadCount = count;
 
-    for(mach_msg_type_number_t i = 0; i < actualThreadCount; i++)
+    releaseSnapshot(&localSnapshot);
+
+    return true;
+}
+
+void gioMonitorCrashMachineContext_setMaxThreadCount(int maxThreadCount)
+{
+    if(maxThreadCount <= 0)
     {
-        mach_port_deallocate(thisTask, context->allThreads[i]);
+        GIOMonitorCrashLOG_ERROR("Invalid max thread count %d", maxThreadCount);
+        return;
     }
-    vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * actualThreadCount);
+    g_maxThreadCount = maxThreadCount;
+}
 
+bool gioMonitorCrashMachineContext_reserveThreadStorage()
+{
+    int maxThreadCount = g_maxThreadCount;
+    if(maxThreadCount <= g_threadCapacity)
+    {
+        return true;
+    }
+    thread_t* threads = malloc(sizeof(*threads) * (unsigned)maxThreadCount);
+    if(threads == NULL)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not allocate storage for %d threads", maxThreadCount);
+        return false;
+    }
+    // The old storage is never freed. Publish the pointer before the larger
+    // capacity, so that a reader never pairs the capacity with smaller storage.
+    __atomic_store_n(&g_threads, threads, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_threadCapacity, maxThreadCount, __ATOMIC_RELEASE);
     return true;
 }
 
+int gioMonitorCrashMachineContext_getMaxThreadCount()
+{
+    return g_maxThreadCount;
+}
+
 int gioMonitorCrashMachineContext_contextSize()
 {
     return sizeof(GIOMonitorCrashMachineContext);
@@ -133,6 +259,7 @@ bool gioMonitorCrashMachineContext_getContextForSignal(void* signalUserContext,
     _STRUCT_MCONTEXT* sourceContext = ((SignalUserContext*)signalUserContext)->UC_MCONTEXT;
     memcpy(&destinationContext->machineContext, sourceContext, sizeof(destinationContext->machineContext));
     destinationContext->thisThread = (thread_t)gioMonitorCrashThread_self();
+    destinationContext->isCurrentThread = true;
     destinationContext->isCrashedContext = true;
     destinationContext->isSignalContext = true;
     destinationContext->isStackOverflow = isStackOverflow(destinationContext);
@@ -141,51 +268,81 @@ bool gioMonitorCrashMachineContext_getContextForSignal(void* signalUserContext,
     return true;
 }
 
-void gioMonitorCrashMachineContext_addReservedThread(GIOMonitorCrashThread thread)
+static inline int reservedThreadSlot(GIOMonitorCrashThread thread)
 {
-    int nextIndex = g_reservedThreadsCount;
-    if(nextIndex > g_reservedThreadsMaxIndex)
-    {
-        GIOMonitorCrashLOG_ERROR("Too many reserved threads (%d). Max is %d", nextIndex, g_reservedThreadsMaxIndex);
-        return;
-    }
-    g_reservedThreads[g_reservedThreadsCount++] = thread;
+    return (int)(((uint32_t)thread * 2654435761u) & (kReservedThreadsCapacity - 1));
 }
 
-#if GIOMonitorCrashCRASH_HAS_THREADS_API
-static inline bool isThreadInList(thread_t thread, GIOMonitorCrashThread* list, int listCount)
+static inline bool isReservedThread(GIOMonitorCrashThread thread)
 {
-    for(int i = 0; i < listCount; i++)
+    for(int i = reservedThreadSlot(thread); g_reservedThreads[i] != 0; i = (i + 1) & (kReservedThreadsCapacity - 1))
     {
-        if(list[i] == (GIOMonitorCrashThread)thread)
+        if(g_reservedThreads[i] == thread)
         {
             return true;
         }
     }
     return false;
 }
-#endif
 
-void gioMonitorCrashMachineContext_suspendEnvironment()
+void gioMonitorCrashMachineContext_addReservedThread(GIOMonitorCrashThread thread)
+{
+    if(thread == 0 || isReservedThread(thread))
+    {
+        return;
+    }
+    if(g_reservedThreadsCount >= kReservedThreadsMaxCount)
+    {
+        GIOMonitorCrashLOG_ERROR("Too many reserved threads (%d). Max is %d", g_reservedThreadsCount, kReservedThreadsMaxCount);
+        return;
+    }
+    int slot = reservedThreadSlot(thread);
+    while(g_reservedThreads[slot] != 0)
+    {
+        slot = (slot + 1) & (kReservedThreadsCapacity - 1);
+    }
+    g_reservedThreads[slot] = thread;
+    g_reservedThreadsCount++;
+}
+
+bool gioMonitorCrashMachineContext_suspendEnvironment(int maxWaitMilliseconds)
 {
 #if GIOMonitorCrashCRASH_HAS_THREADS_API
     GIOMonitorCrashLOG_DEBUG("Suspending environment.");
     kern_return_t kr;
-    const task_t thisTask = mach_task_self();
     const thread_t thisThread = (thread_t)gioMonitorCrashThread_self();
-    thread_act_array_t threads;
-    mach_msg_type_number_t numThreads;
 
-    if((kr = task_threads(thisTask, &threads, &numThreads)) != KERN_SUCCESS)
+    if(__atomic_load_n(&g_environmentOwner, __ATOMIC_ACQUIRE) == (GIOMonitorCrashThread)thisThread)
     {
-        GIOMonitorCrashLOG_ERROR("task_threads: %s", mach_error_string(kr));
-        return;
+        GIOMonitorCrashLOG_DEBUG("Environment already suspended.");
+        g_suspendDepth++;
+        return true;
+    }
+    GIOMonitorCrashThread expected = 0;
+    for(int waited = 0;
+        !__atomic_compare_exchange_n(&g_environmentOwner, &expected, (GIOMonitorCrashThread)thisThread,
+                                     false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        waited++)
+    {
+        if(waited >= maxWaitMilliseconds)
+        {
+            GIOMonitorCrashLOG_ERROR("Environment is held by thread %08x. Not suspending.", expected);
+            return false;
+        }
+        expected = 0;
+        usleep(1000);
     }
+    if(!takeSnapshot(&g_environment))
+    {
+        __atomic_store_n(&g_environmentOwner, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+    g_suspendDepth = 1;
 
-    for(mach_msg_type_number_t i = 0; i < numThreads; i++)
+    for(mach_msg_type_number_t i = 0; i < g_environment.threadCount; i++)
     {
-        thread_t thread = threads[i];
-        if(thread != thisThread && !isThreadInList(thread, g_reservedThreads, g_reservedThreadsCount))
+        thread_t thread = g_environment.threads[i];
+        if(thread != thisThread && !isReservedThread((GIOMonitorCrashThread)thread))
         {
             if((kr = thread_suspend(thread)) != KERN_SUCCESS)
             {
@@ -195,13 +352,10 @@ void gioMonitorCrashMachineContext_suspendEnvironment()
         }
     }
 
-    for(mach_msg_type_number_t i = 0; i < numThreads; i++)
-    {
-        mach_port_deallocate(thisTask, threads[i]);
-    }
-    vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * numThreads);
-
     GIOMonitorCrashLOG_DEBUG("Suspend complete.");
+    return true;
+#else
+    return false;
 #endif
 }
 
@@ -210,21 +364,24 @@ void gioMonitorCrashMachineContext_resumeEnvironment()
 #if GIOMonitorCrashCRASH_HAS_THREADS_API
     GIOMonitorCrashLOG_DEBUG("Resuming environment.");
     kern_return_t kr;
-    const task_t thisTask = mach_task_self();
     const thread_t thisThread = (thread_t)gioMonitorCrashThread_self();
-    thread_act_array_t threads;
-    mach_msg_type_number_t numThreads;
 
-    if((kr = task_threads(thisTask, &threads, &numThreads)) != KERN_SUCCESS)
+    if(__atomic_load_n(&g_environmentOwner, __ATOMIC_ACQUIRE) != (GIOMonitorCrashThread)thisThread)
     {
-        GIOMonitorCrashLOG_ERROR("task_threads: %s", mach_error_string(kr));
+        GIOMonitorCrashLOG_ERROR("Environment was not suspended by this thread.");
+        return;
+    }
+    if(--g_suspendDepth > 0)
+    {
+        GIOMonitorCrashLOG_DEBUG("Environment still suspended by an outer caller.");
         return;
     }
 
-    for(mach_msg_type_number_t i = 0; i < numThreads; i++)
+    // Resume the same threads that were suspended, and only those.
+    for(mach_msg_type_number_t i = 0; g_environment.isValid && i < g_environment.threadCount; i++)
     {
-        thread_t thread = threads[i];
-        if(thread != thisThread && !isThreadInList(thread, g_reservedThreads, g_reservedThreadsCount))
+        thread_t thread = g_environment.threads[i];
+        if(thread != thisThread && !isReservedThread((GIOMonitorCrashThread)thread))
         {
             if((kr = thread_resume(thread)) != KERN_SUCCESS)
             {
@@ -234,16 +391,20 @@ void gioMonitorCrashMachineContext_resumeEnvironment()
         }
     }
 
-    for(mach_msg_type_number_t i = 0; i < numThreads; i++)
-    {
-        mach_port_deallocate(thisTask, threads[i]);
-    }
-    vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * numThreads);
+    releaseSnapshot(&g_environment);
+    __atomic_store_n(&g_environmentOwner, 0, __ATOMIC_RELEASE);
 
     GIOMonitorCrashLOG_DEBUG("Resume complete.");
 #endif
 }
 
+int gioMonitorCrashMachineContext_getStackFrames(const GIOMonitorCrashMachineContext* const context, const uintptr_t** frames, bool* isComplete)
+{
+    *frames = context->stackFrames;
+    *isComplete = !context->isStackOverflow;
+    return context->stackFrameCount;
+}
+
 int gioMonitorCrashMachineContext_getThreadCount(const GIOMonitorCrashMachineContext* const context)
 {
     return context->threadCount;
@@ -289,6 +450,11 @@ bool gioMonitorCrashMachineContext_canHaveCPUState(const GIOMonitorCrashMachineC
     return !isContextForCurrentThread(context) || isSignalContext(context);
 }
 
+bool gioMonitorCrashMachineContext_isCurrentThread(const GIOMonitorCrashMachineContext* const context)
+{
+    return isContextForCurrentThread(context);
+}
+
 bool gioMonitorCrashMachineContext_hasValidExceptionRegisters(const GIOMonitorCrashMachineContext* const context)
 {
     return gioMonitorCrashMachineContext_canHaveCPUState(context) && gioMonitorCrashMachineContext_isCrashedContext(context);
@@ -34,12 +34,32 @@ extern "C" {
 
 #include "GIOMonitorCrashThread.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+/** How long to wait for another thread to resume the environment, in
+ * milliseconds. Signal handlers wait much less, since the thread that holds
+ * the environment may never resume it.
+ */
+#define GIOMonitorCrashMC_SUSPEND_WAIT_MILLISECONDS 2000
+#define GIOMonitorCrashMC_SIGNAL_SUSPEND_WAIT_MILLISECONDS 5
 
 /** Suspend the runtime environment.
+ * The threads are enumerated once here, and that list is reused for crashed
+ * contexts and for resuming until the environment is resumed.
+ *
+ * Calls nest on the same thread, and each that succeeds must be balanced by a
+ * call to resumeEnvironment() on that thread. Another thread calling this
+ * waits for the environment to be resumed, and fails if that takes too long.
+ *
+ * @param maxWaitMilliseconds How long to wait for another thread to resume the environment.
+ *
+ * @return true if the other threads are suspended. If false, they are still
+ *         running and resumeEnvironment() must not be called.
  */
-void gioMonitorCrashMachineContext_suspendEnvironment(void);
+bool gioMonitorCrashMachineContext_suspendEnvironment(int maxWaitMilliseconds);
 
-/** Resume the runtime environment.
+/** Resume the runtime environment, once every suspend on this thread is
+ * balanced. Only the threads that were suspended are resumed.
  */
 void gioMonitorCrashMachineContext_resumeEnvironment(void);
 
@@ -59,6 +79,27 @@ void gioMonitorCrashMachineContext_resumeEnvironment(void);
 
 struct GIOMonitorCrashMachineContext;
 
+/** Set the maximum number of threads a crashed context can hold.
+ * Threads beyond this are left out of the report. Contexts filled without
+ * the crash arena are also limited to the storage reserved by
+ * reserveThreadStorage().
+ *
+ * @param maxThreadCount The maximum number of threads.
+ */
+void gioMonitorCrashMachineContext_setMaxThreadCount(int maxThreadCount);
+
+/** Allocate thread list storage for the maximum thread count, for crashed
+ * contexts filled without the crash arena. Call it once, before enabling any
+ * monitor. Storage is never freed, so calling it again leaks the old storage.
+ *
+ * @return false if the storage couldn't be allocated.
+ */
+bool gioMonitorCrashMachineContext_reserveThreadStorage(void);
+
+/** Get the maximum number of threads a crashed context can hold.
+ */
+int gioMonitorCrashMachineContext_getMaxThreadCount(void);
+
 /** Get the internal size of a machine context.
  */
 int gioMonitorCrashMachineContext_contextSize(void);
@@ -91,7 +132,20 @@ bool gioMonitorCrashMachineContext_getContextForSignal(void* signalUserContext,
  */
 GIOMonitorCrashThread gioMonitorCrashMachineContext_getThreadFromContext(const struct GIOMonitorCrashMachineContext* const context);
 
-/** Get the number of threads stored in a machine context.
+/** Get the stack frames captured when a crashed context was filled in.
+ * They are only captured if the filling thread held the crash arena, and
+ * stay valid until it releases it.
+ *
+ * @param context The machine context.
+ * @param frames Receives the captured instruction addresses, innermost first.
+ * @param isComplete Receives true if the captured frames cover the whole stack.
+ *
+ * @return The number of captured frames, or 0 if the stack wasn't walked.
+ */
+int gioMonitorCrashMachineContext_getStackFrames(const struct GIOMonitorCrashMachineContext* const context, const uintptr_t** frames, bool* isComplete);
+
+/** Get the number of threads stored in a machine context. Reserved threads
+ * other than the context's own are left out, since they aren't suspended.
  *
  * @param context The machine context.
  *
@@ -125,11 +179,18 @@ bool gioMonitorCrashMachineContext_isCrashedContext(const struct GIOMonitorCrash
  */
 bool gioMonitorCrashMachineContext_canHaveCPUState(const struct GIOMonitorCrashMachineContext* const context);
 
+/** Check if this context was filled in on its own thread. For a crashed
+ * context, this tells whether the crash was captured on the crashed thread,
+ * whichever thread the report is written on later.
+ */
+bool gioMonitorCrashMachineContext_isCurrentThread(const struct GIOMonitorCrashMachineContext* const context);
+
 /** Check if this context has valid exception registers.
  */
 bool gioMonitorCrashMachineContext_hasValidExceptionRegisters(const struct GIOMonitorCrashMachineContext* const context);
 
-/** Add a thread to the reserved threads list.
+/** Add a thread to the reserved threads list. Reserved threads are left
+ * running when the environment is suspended, and left out of thread lists.
  *
  * @param thread The thread to add to the list.
  */
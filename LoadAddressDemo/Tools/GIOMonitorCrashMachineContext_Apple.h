@@ -32,8 +32,11 @@
 extern "C" {
 #endif
 
+#include "GIOMonitorCrashStackCursor.h"
+
 #include <mach/mach_types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/ucontext.h>
 
 #ifdef __arm64__
@@ -45,13 +48,20 @@ extern "C" {
 typedef struct GIOMonitorCrashMachineContext
 {
     thread_t thisThread;
-    thread_t allThreads[100];
+    thread_t* allThreads;
     int threadCount;
     bool isCrashedContext;
     bool isCurrentThread;
     bool isStackOverflow;
     bool isSignalContext;
     STRUCT_MCONTEXT_L machineContext;
+
+    /** Stack frames captured while checking for stack overflow, innermost
+     * first. Allocated from the crash arena, so only crashed contexts made
+     * while holding it have them.
+     */
+    uintptr_t* stackFrames;
+    int stackFrameCount;
 } GIOMonitorCrashMachineContext;
 
 
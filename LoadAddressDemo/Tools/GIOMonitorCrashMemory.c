@@ -33,8 +33,57 @@
 #include <mach/mach.h>
 
 
+/** Readable memory regions, sorted by address, with adjacent regions merged.
+ * While a snapshot is active, reads outside these regions fail without
+ * asking the kernel.
+ */
+#define kMaxReadableRegions 4096
+
+typedef struct
+{
+    uintptr_t start;
+    uintptr_t end;
+} ReadableRegion;
+
+static ReadableRegion g_readableRegions[kMaxReadableRegions];
+static int g_readableRegionCount = 0;
+static volatile bool g_hasRegionSnapshot = false;
+
+/** Get how many bytes starting at an address lie in a single readable region.
+ */
+static inline int readableBytesInRegion(const void* const memory, const int byteCount)
+{
+    const uintptr_t address = (uintptr_t)memory;
+    int low = 0;
+    int high = g_readableRegionCount - 1;
+    while(low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        const ReadableRegion* region = &g_readableRegions[mid];
+        if(address < region->start)
+        {
+            high = mid - 1;
+        }
+        else if(address >= region->end)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            uintptr_t available = region->end - address;
+            return available < (uintptr_t)byteCount ? (int)available : byteCount;
+        }
+    }
+    return 0;
+}
+
 static inline int copySafely(const void* restrict const src, void* restrict const dst, const int byteCount)
 {
+    if(g_hasRegionSnapshot && readableBytesInRegion(src, byteCount) < byteCount)
+    {
+        return 0;
+    }
+
     vm_size_t bytesCopied = 0;
     kern_return_t result = vm_read_overwrite(mach_task_self(),
                                              (vm_address_t)src,
@@ -57,6 +106,16 @@ static inline int copyMaxPossible(const void* restrict const src, void* restrict
 
     int bytesCopied = 0;
 
+    if(g_hasRegionSnapshot)
+    {
+        int readableCount = readableBytesInRegion(src, byteCount);
+        pSrcMax = pSrcEnd = (uint8_t*)src + readableCount;
+        if(readableCount == 0)
+        {
+            return 0;
+        }
+    }
+
     // Short-circuit if no memory is readable
     if(copySafely(src, dst, 1) != 1)
     {
@@ -142,6 +201,64 @@ int gioMonitorCrashMem_copyMaxPossible(const void* restrict const src, void* res
     return copyMaxPossible(src, dst, byteCount);
 }
 
+bool gioMonitorCrashMem_snapshotReadableRegions(void)
+{
+    g_hasRegionSnapshot = false;
+
+    const task_t thisTask = mach_task_self();
+    vm_address_t address = 0;
+    vm_size_t size = 0;
+    int regionCount = 0;
+
+    for(;;)
+    {
+        vm_region_basic_info_data_64_t info;
+        mach_msg_type_number_t infoCount = VM_REGION_BASIC_INFO_COUNT_64;
+        mach_port_t objectName = MACH_PORT_NULL;
+        kern_return_t kr = vm_region_64(thisTask, &address, &size, VM_REGION_BASIC_INFO_64, (vm_region_info_t)&info, &infoCount, &objectName);
+        if(kr != KERN_SUCCESS)
+        {
+            break;
+        }
+
+        if(info.protection & VM_PROT_READ)
+        {
+            if(regionCount > 0 && g_readableRegions[regionCount - 1].end == address)
+            {
+                g_readableRegions[regionCount - 1].end = address + size;
+            }
+            else
+            {
+                if(regionCount >= kMaxReadableRegions)
+                {
+                    GIOMonitorCrashLOG_ERROR("More than %d readable memory regions. Not using the region map.", kMaxReadableRegions);
+                    return false;
+                }
+                g_readableRegions[regionCount].start = address;
+                g_readableRegions[regionCount].end = address + size;
+                regionCount++;
+            }
+        }
+
+        if(address + size <= address)
+        {
+            break;
+        }
+        address += size;
+    }
+
+    GIOMonitorCrashLOG_DEBUG("Found %d readable memory regions.", regionCount);
+    g_readableRegionCount = regionCount;
+    g_hasRegionSnapshot = regionCount > 0;
+    return g_hasRegionSnapshot;
+}
+
+void gioMonitorCrashMem_clearReadableRegions(void)
+{
+    g_hasRegionSnapshot = false;
+    g_readableRegionCount = 0;
+}
+
 bool gioMonitorCrashMem_copySafely(const void* restrict const src, void* restrict const dst, const int byteCount)
 {
     return copySafely(src, dst, byteCount);
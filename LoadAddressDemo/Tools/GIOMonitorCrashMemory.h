@@ -38,8 +38,23 @@ extern "C" {
 
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
+/** Take a snapshot of the task's readable memory regions.
+ * Until the snapshot is cleared, any read outside those regions fails right
+ * away, without a kernel call. Reads inside them are still done safely.
+ * This is async-safe, but should only be used while other threads are
+ * suspended, since it doesn't see regions mapped after it is taken.
+ *
+ * @return true if a snapshot was taken.
+ */
+bool gioMonitorCrashMem_snapshotReadableRegions(void);
+
+/** Stop using the readable memory region snapshot.
+ */
+void gioMonitorCrashMem_clearReadableRegions(void);
+
 /** Test if the specified memory is safe to read from.
  *
  * @param memory A pointer to the memory to test.
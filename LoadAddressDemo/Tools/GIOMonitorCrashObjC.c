@@ -82,7 +82,6 @@ typedef struct
     bool isMutable;
     bool (*isValidObject)(const void* object);
     int (*description)(const void* object, char* buffer, int bufferLength);
-    const void* class;
 } ClassData;
 
 
@@ -147,6 +146,23 @@ static ClassData g_taggedClassData[] =
 };
 static int g_taggedClassDataCount = sizeof(g_taggedClassData) / sizeof(*g_taggedClassData);
 
+/** Hash index of g_classData by name. Each slot holds an index + 1, or 0 if empty.
+ * g_classData has no duplicate names, and the index is at least twice its size.
+ */
+#define kClassDataIndexSize 64
+static uint8_t g_classDataIndex[kClassDataIndexSize];
+static uint32_t g_classDataHashes[sizeof(g_classData) / sizeof(*g_classData)];
+static volatile bool g_classDataIndexBuilt = false;
+
+/** Class data already looked up, by class pointer. */
+#define kClassDataCacheSize 256
+#define kClassDataCacheMaxProbes 8
+static struct
+{
+    const void* class;
+    ClassData* data;
+} g_classDataCache[kClassDataCacheSize];
+
 static const char* g_blockBaseClassName = "NSBlock";
 
 
@@ -362,6 +378,57 @@ static CFAbsoluteTime extractTaggedNSDate(const void* const object)
     return value;
 }
 
+/** Build the name index of g_classData. This is async-safe, and only does
+ * anything the first time.
+ */
+static void buildClassDataIndex(void)
+{
+    unlikely_if(!g_classDataIndexBuilt)
+    {
+        const uint32_t mask = kClassDataIndexSize - 1;
+        for(int i = 0; g_classData[i].name != NULL; i++)
+        {
+            uint32_t hash = gioMonitorCrashString_hash(g_classData[i].name);
+            uint32_t slot = hash & mask;
+            while(g_classDataIndex[slot] != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+            g_classDataHashes[i] = hash;
+            g_classDataIndex[slot] = (uint8_t)(i + 1);
+        }
+        g_classDataIndexBuilt = true;
+    }
+}
+
+/** Get the class data for a class name.
+ *
+ * @param className The class name.
+ *
+ * @return The class data, or the catch-all entry if the name isn't known.
+ */
+static ClassData* getClassDataNamed(const char* className)
+{
+    static ClassData* const unknownClassData = &g_classData[sizeof(g_classData) / sizeof(*g_classData) - 1];
+    unlikely_if(className == NULL)
+    {
+        return unknownClassData;
+    }
+
+    buildClassDataIndex();
+    const uint32_t mask = kClassDataIndexSize - 1;
+    const uint32_t hash = gioMonitorCrashString_hash(className);
+    for(uint32_t slot = hash & mask; g_classDataIndex[slot] != 0; slot = (slot + 1) & mask)
+    {
+        int index = g_classDataIndex[slot] - 1;
+        if(g_classDataHashes[index] == hash && strcmp(className, g_classData[index].name) == 0)
+        {
+            return &g_classData[index];
+        }
+    }
+    return unknownClassData;
+}
+
 /** Get any special class metadata we have about the specified class.
  * It will return a generic metadata object if the type is not recognized.
  *
@@ -370,7 +437,8 @@ static CFAbsoluteTime extractTaggedNSDate(const void* const object)
  * and then compare against them later. However, comparing strings is
  * slow, so I've reached a compromise. Since I'm omly using this at
  * crash time, I can assume that the Objective-C environment is frozen.
- * As such, I can keep a cache of discovered classes. If, however, this
+ * As such, I can keep a cache of discovered classes, keyed by class pointer,
+ * and only look up names (by hash) on a cache miss. If, however, this
  * library is used outside of a frozen environment, caching will be
  * unreliable.
  *
@@ -380,23 +448,23 @@ static CFAbsoluteTime extractTaggedNSDate(const void* const object)
  */
 static ClassData* getClassData(const void* class)
 {
-    const char* className = getClassName(class);
-    for(ClassData* data = g_classData;; data++)
+    const uint32_t mask = kClassDataCacheSize - 1;
+    uint32_t slot = (uint32_t)(((uintptr_t)class >> 3) * 2654435761u) & mask;
+    for(int probes = 0; probes < kClassDataCacheMaxProbes; probes++, slot = (slot + 1) & mask)
     {
-        unlikely_if(data->name == NULL)
+        likely_if(g_classDataCache[slot].class == class)
         {
-            return data;
-        }
-        unlikely_if(class == data->class)
-        {
-            return data;
+            return g_classDataCache[slot].data;
         }
-        unlikely_if(data->class == NULL && strcmp(className, data->name) == 0)
+        if(g_classDataCache[slot].class == NULL)
         {
-            data->class = class;
+            ClassData* data = getClassDataNamed(getClassName(class));
+            g_classDataCache[slot].data = data;
+            g_classDataCache[slot].class = class;
             return data;
         }
     }
+    return getClassDataNamed(getClassName(class));
 }
 
 static inline const ClassData* getClassDataFromObject(const void* object)
@@ -0,0 +1,57 @@
+//
+//  GIOMonitorCrashSignalInfo.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Information about the signals that are considered fatal.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashSignalInfo_h
+#define HDR_GIOMonitorCrashSignalInfo_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** Get the name of a signal.
+ *
+ * @param signal The signal.
+ *
+ * @return The signal's name or NULL if not found.
+ */
+const char* gioMonitorCrashSignal_signalName(int signal);
+
+/** Get the name of a signal's subcode.
+ *
+ * @param signal The signal.
+ *
+ * @param code The signal's code.
+ *
+ * @return The code's name or NULL if not found.
+ */
+const char* gioMonitorCrashSignal_signalCodeName(int signal, int code);
+
+/** Get a list of fatal signals.
+ *
+ * @return A list of fatal signals.
+ */
+const int* gioMonitorCrashSignal_fatalSignals(void);
+
+/** Get the size of the fatal signals list.
+ *
+ * @return The size of the fatal signals list.
+ */
+int gioMonitorCrashSignal_numFatalSignals(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashSignalInfo_h
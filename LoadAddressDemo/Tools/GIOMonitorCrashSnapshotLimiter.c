@@ -0,0 +1,267 @@
+//
+//  GIOMonitorCrashSnapshotLimiter.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashSnapshotLimiter.h"
+#include "GIOMonitorCrashString.h"
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/** How many exception names get a bucket of their own. Names seen after that
+ * share the overflow bucket. */
+#define kMaxBuckets 32
+
+#define kMaxNameLength 64
+
+
+typedef struct
+{
+    /** Hash of the name, or 0 if the bucket is unused. Set after the name,
+     * so that a reader seeing it can trust the name.
+     */
+    uint32_t hash;
+
+    char name[kMaxNameLength];
+
+    /** Snapshots that can be taken right now. */
+    double tokens;
+
+    /** Monotonic time the tokens were last topped up. */
+    uint64_t refillTime;
+
+    int rateLimitedCount;
+    int sampledOutCount;
+
+    /** The counts last handed out by peekSuppressedCounts, to be taken off
+     * once the report they went into is known to be kept.
+     */
+    int peekedRateLimitedCount;
+    int peekedSampledOutCount;
+} GIOMonitorCrash_SnapshotBucket;
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double g_rateLimit = 0;
+static int g_burstLimit = 5;
+static double g_sampleRate = 1.0;
+
+static GIOMonitorCrash_SnapshotBucket g_buckets[kMaxBuckets];
+static GIOMonitorCrash_SnapshotBucket g_overflowBucket;
+
+
+// ============================================================================
+#pragma mark - Utility -
+// ============================================================================
+
+static uint64_t getMonotonicTimeNanoseconds(void)
+{
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0)
+    {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+static void initBucket(GIOMonitorCrash_SnapshotBucket* const bucket, const char* const name, const uint32_t hash)
+{
+    strncpy(bucket->name, name, sizeof(bucket->name) - 1);
+    bucket->name[sizeof(bucket->name) - 1] = '\0';
+    bucket->tokens = g_burstLimit;
+    bucket->refillTime = getMonotonicTimeNanoseconds();
+    __atomic_store_n(&bucket->hash, hash, __ATOMIC_RELEASE);
+}
+
+/** Find the bucket for a name, claiming a free one if needed.
+ * Call with g_mutex held.
+ */
+static GIOMonitorCrash_SnapshotBucket* getBucket(const char* const name)
+{
+    uint32_t hash = gioMonitorCrashString_hash(name);
+    if(hash == 0)
+    {
+        hash = 1;
+    }
+    for(int i = 0; i < kMaxBuckets; i++)
+    {
+        GIOMonitorCrash_SnapshotBucket* const bucket = &g_buckets[(hash + (uint32_t)i) % kMaxBuckets];
+        if(bucket->hash == 0)
+        {
+            initBucket(bucket, name, hash);
+            return bucket;
+        }
+        if(bucket->hash == hash && strncmp(bucket->name, name, sizeof(bucket->name) - 1) == 0)
+        {
+            return bucket;
+        }
+    }
+    if(g_overflowBucket.hash == 0)
+    {
+        GIOMonitorCrashLOG_INFO("More than %d exception names reported. The rest share one budget.", kMaxBuckets);
+        initBucket(&g_overflowBucket, "other", 1);
+    }
+    return &g_overflowBucket;
+}
+
+/** Top up a bucket's tokens for the time passed since the last top up. */
+static void refillBucket(GIOMonitorCrash_SnapshotBucket* const bucket)
+{
+    uint64_t now = getMonotonicTimeNanoseconds();
+    bucket->tokens += (double)(now - bucket->refillTime) / 1000000000.0 * g_rateLimit;
+    if(bucket->tokens > g_burstLimit)
+    {
+        bucket->tokens = g_burstLimit;
+    }
+    bucket->refillTime = now;
+}
+
+static bool isSampledOut(void)
+{
+    return g_sampleRate < 1.0 && (double)arc4random() / UINT32_MAX >= g_sampleRate;
+}
+
+static void peekSuppressedCounts(GIOMonitorCrash_SnapshotBucket* const bucket,
+                                 const GIOMonitorCrashSnapshotLimiter_SuppressedCallback callback,
+                                 void* const userData)
+{
+    if(__atomic_load_n(&bucket->hash, __ATOMIC_ACQUIRE) == 0)
+    {
+        return;
+    }
+    int rateLimitedCount = __atomic_load_n(&bucket->rateLimitedCount, __ATOMIC_RELAXED);
+    int sampledOutCount = __atomic_load_n(&bucket->sampledOutCount, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket->peekedRateLimitedCount, rateLimitedCount, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket->peekedSampledOutCount, sampledOutCount, __ATOMIC_RELAXED);
+    if(rateLimitedCount > 0 || sampledOutCount > 0)
+    {
+        callback(bucket->name, rateLimitedCount, sampledOutCount, userData);
+    }
+}
+
+/** Take off the counts last peeked. Snapshots suppressed since then stay. */
+static void commitSuppressedCounts(GIOMonitorCrash_SnapshotBucket* const bucket)
+{
+    int rateLimitedCount = __atomic_exchange_n(&bucket->peekedRateLimitedCount, 0, __ATOMIC_RELAXED);
+    int sampledOutCount = __atomic_exchange_n(&bucket->peekedSampledOutCount, 0, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&bucket->rateLimitedCount, rateLimitedCount, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&bucket->sampledOutCount, sampledOutCount, __ATOMIC_RELAXED);
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+void gioMonitorCrashSnapshotLimiter_setRateLimit(double rateLimit)
+{
+    pthread_mutex_lock(&g_mutex);
+    g_rateLimit = rateLimit < 0 ? 0 : rateLimit;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void gioMonitorCrashSnapshotLimiter_setBurstLimit(int burstLimit)
+{
+    pthread_mutex_lock(&g_mutex);
+    g_burstLimit = burstLimit < 1 ? 1 : burstLimit;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void gioMonitorCrashSnapshotLimiter_setSampleRate(double sampleRate)
+{
+    pthread_mutex_lock(&g_mutex);
+    g_sampleRate = sampleRate < 0 ? 0 : sampleRate;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+bool gioMonitorCrashSnapshotLimiter_shouldCapture(const char* name)
+{
+    if(name == NULL)
+    {
+        name = "unknown";
+    }
+
+    pthread_mutex_lock(&g_mutex);
+    if(g_rateLimit <= 0 && g_sampleRate >= 1.0)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return true;
+    }
+
+    bool shouldCapture = true;
+    GIOMonitorCrash_SnapshotBucket* const bucket = getBucket(name);
+    if(isSampledOut())
+    {
+        __atomic_fetch_add(&bucket->sampledOutCount, 1, __ATOMIC_RELAXED);
+        shouldCapture = false;
+    }
+    else if(g_rateLimit > 0)
+    {
+        refillBucket(bucket);
+        if(bucket->tokens < 1.0)
+        {
+            __atomic_fetch_add(&bucket->rateLimitedCount, 1, __ATOMIC_RELAXED);
+            shouldCapture = false;
+        }
+        else
+        {
+            bucket->tokens -= 1.0;
+        }
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    if(!shouldCapture)
+    {
+        GIOMonitorCrashLOG_DEBUG("Suppressed snapshot of %s", name);
+    }
+    return shouldCapture;
+}
+
+void gioMonitorCrashSnapshotLimiter_peekSuppressedCounts(GIOMonitorCrashSnapshotLimiter_SuppressedCallback callback,
+                                                         void* userData)
+{
+    for(int i = 0; i < kMaxBuckets; i++)
+    {
+        peekSuppressedCounts(&g_buckets[i], callback, userData);
+    }
+    peekSuppressedCounts(&g_overflowBucket, callback, userData);
+}
+
+void gioMonitorCrashSnapshotLimiter_commitSuppressedCounts(void)
+{
+    for(int i = 0; i < kMaxBuckets; i++)
+    {
+        commitSuppressedCounts(&g_buckets[i]);
+    }
+    commitSuppressedCounts(&g_overflowBucket);
+}
+
+void gioMonitorCrashSnapshotLimiter_addSuppressedCounts(const char* name, int rateLimitedCount, int sampledOutCount)
+{
+    if(name == NULL || (rateLimitedCount <= 0 && sampledOutCount <= 0))
+    {
+        return;
+    }
+    pthread_mutex_lock(&g_mutex);
+    GIOMonitorCrash_SnapshotBucket* const bucket = getBucket(name);
+    __atomic_fetch_add(&bucket->rateLimitedCount, rateLimitedCount < 0 ? 0 : rateLimitedCount, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bucket->sampledOutCount, sampledOutCount < 0 ? 0 : sampledOutCount, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_mutex);
+}
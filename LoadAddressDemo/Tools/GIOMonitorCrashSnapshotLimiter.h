@@ -0,0 +1,108 @@
+//
+//  GIOMonitorCrashSnapshotLimiter.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* Limits how often user reported snapshots are taken.
+ * Every snapshot suspends all threads and writes a full report, so a caller
+ * reporting the same exception in a loop can stall the app. Each exception
+ * name gets its own token bucket, and snapshots can also be sampled. Counts of
+ * the snapshots that were suppressed are kept per name until a report that
+ * has them is kept. A report that is coalesced away leaves them for the next.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashSnapshotLimiter_h
+#define HDR_GIOMonitorCrashSnapshotLimiter_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+
+
+/** Called for each exception name that had snapshots suppressed.
+ *
+ * @param name The exception name.
+ *
+ * @param rateLimitedCount Snapshots suppressed because the name's budget was used up.
+ *
+ * @param sampledOutCount Snapshots suppressed by sampling.
+ *
+ * @param userData The user data passed to peekSuppressedCounts.
+ */
+typedef void (*GIOMonitorCrashSnapshotLimiter_SuppressedCallback)(const char* name,
+                                                                  int rateLimitedCount,
+                                                                  int sampledOutCount,
+                                                                  void* userData);
+
+
+/** Set how many snapshots per second each exception name may take on average.
+ *
+ * @param rateLimit Snapshots per second (0 = no limit).
+ */
+void gioMonitorCrashSnapshotLimiter_setRateLimit(double rateLimit);
+
+/** Set how many snapshots of an exception name may be taken in a burst
+ * before the rate limit applies.
+ *
+ * @param burstLimit The bucket size (minimum 1).
+ */
+void gioMonitorCrashSnapshotLimiter_setBurstLimit(int burstLimit);
+
+/** Set the fraction of snapshots to take. Sampling applies before the rate
+ * limit, so sampled out snapshots don't use up the budget.
+ *
+ * @param sampleRate 0.0 to 1.0 (1.0 = take all).
+ */
+void gioMonitorCrashSnapshotLimiter_setSampleRate(double sampleRate);
+
+/** Check if a user reported snapshot should be taken, and count it as
+ * suppressed if not. This locks, so never call it from a crash handler.
+ *
+ * @param name The exception name. NULL is counted as "unknown".
+ *
+ * @return true if the snapshot should be taken.
+ */
+bool gioMonitorCrashSnapshotLimiter_shouldCapture(const char* name);
+
+/** Call callback for each exception name with suppressed snapshots. The
+ * counts stay until commitSuppressedCounts is called. This is async-safe.
+ *
+ * @param callback The function to call.
+ *
+ * @param userData Passed to callback.
+ */
+void gioMonitorCrashSnapshotLimiter_peekSuppressedCounts(GIOMonitorCrashSnapshotLimiter_SuppressedCallback callback,
+                                                         void* userData);
+
+/** Take the counts handed out by the last peekSuppressedCounts off the
+ * counts kept. Call it once the report they were written to is kept.
+ * This is async-safe.
+ */
+void gioMonitorCrashSnapshotLimiter_commitSuppressedCounts(void);
+
+/** Add to the suppressed snapshot counts of an exception name, such as those
+ * recorded by an earlier launch. This locks, so never call it from a crash
+ * handler.
+ *
+ * @param name The exception name.
+ *
+ * @param rateLimitedCount Snapshots suppressed because the name's budget was used up.
+ *
+ * @param sampledOutCount Snapshots suppressed by sampling.
+ */
+void gioMonitorCrashSnapshotLimiter_addSuppressedCounts(const char* name, int rateLimitedCount, int sampledOutCount);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashSnapshotLimiter_h
@@ -57,6 +57,8 @@ typedef struct
     uintptr_t instructionAddress;
     uintptr_t linkRegister;
     bool isPastFramePointer;
+    const uintptr_t* capturedFrames;
+    int capturedFrameCount;
 } MachineContextCursor;
 
 static bool advanceCursor(GIOMonitorCrashStackCursor *cursor)
@@ -70,6 +72,16 @@ static bool advanceCursor(GIOMonitorCrashStackCursor *cursor)
         return false;
     }
 
+    if(context->capturedFrames != NULL)
+    {
+        if(cursor->state.currentDepth >= context->capturedFrameCount)
+        {
+            return false;
+        }
+        nextAddress = context->capturedFrames[cursor->state.currentDepth];
+        goto successfulExit;
+    }
+
     if(context->instructionAddress == 0)
     {
         context->instructionAddress = gioMonitorCrashCpu_instructionAddress(context->machineContext);
@@ -137,4 +149,17 @@ void gioMonitorCrashStackCursor_initWithMachineContext(GIOMonitorCrashStackCurso
     context->machineContext = machineContext;
     context->maxStackDepth = maxStackDepth;
     context->instructionAddress = cursor->stackEntry.address;
+    context->capturedFrames = NULL;
+    context->capturedFrameCount = 0;
+
+    // Replay the frames captured by the stack overflow check if they cover
+    // everything this cursor would walk.
+    const uintptr_t* frames = NULL;
+    bool isComplete = false;
+    int frameCount = gioMonitorCrashMachineContext_getStackFrames(machineContext, &frames, &isComplete);
+    if(frameCount > 0 && (isComplete || maxStackDepth <= frameCount))
+    {
+        context->capturedFrames = frames;
+        context->capturedFrameCount = frameCount;
+    }
 }
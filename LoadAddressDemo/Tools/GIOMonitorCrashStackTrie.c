@@ -0,0 +1,132 @@
+//
+//  GIOMonitorCrashStackTrie.c
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+#include "GIOMonitorCrashStackTrie.h"
+
+#include <stdlib.h>
+
+//#define GIOMonitorCrashLogger_LocalLevel TRACE
+#include "GIOMonitorCrashLogger.h"
+
+
+static inline int findChild(const GIOMonitorCrashStackTrie* const trie, int parent, uintptr_t address)
+{
+    int node = parent < 0 ? trie->firstRoot : trie->nodes[parent].firstChild;
+    while(node >= 0)
+    {
+        if(trie->nodes[node].address == address)
+        {
+            return node;
+        }
+        node = trie->nodes[node].nextSibling;
+    }
+    return -1;
+}
+
+static inline int addChild(GIOMonitorCrashStackTrie* trie, int parent, uintptr_t address)
+{
+    int node = trie->nodeCount++;
+    GIOMonitorCrashStackTrieNode* entry = &trie->nodes[node];
+    entry->address = address;
+    entry->parent = parent;
+    entry->firstChild = -1;
+    entry->refCount = 0;
+    entry->sharedIndex = -1;
+    if(parent < 0)
+    {
+        entry->nextSibling = trie->firstRoot;
+        trie->firstRoot = node;
+    }
+    else
+    {
+        entry->nextSibling = trie->nodes[parent].firstChild;
+        trie->nodes[parent].firstChild = node;
+    }
+    return node;
+}
+
+bool gioMonitorCrashStackTrie_create(GIOMonitorCrashStackTrie* trie, int maxNodes)
+{
+    trie->nodes = malloc(sizeof(*trie->nodes) * (unsigned)maxNodes);
+    if(trie->nodes == NULL)
+    {
+        GIOMonitorCrashLOG_ERROR("Could not allocate %d stack trie nodes", maxNodes);
+        trie->nodeCapacity = 0;
+        return false;
+    }
+    trie->nodeCapacity = maxNodes;
+    gioMonitorCrashStackTrie_reset(trie);
+    return true;
+}
+
+void gioMonitorCrashStackTrie_destroy(GIOMonitorCrashStackTrie* trie)
+{
+    if(trie->nodes != NULL)
+    {
+        free(trie->nodes);
+    }
+    trie->nodes = NULL;
+    trie->nodeCapacity = 0;
+    trie->nodeCount = 0;
+    trie->firstRoot = -1;
+}
+
+void gioMonitorCrashStackTrie_reset(GIOMonitorCrashStackTrie* trie)
+{
+    trie->nodeCount = 0;
+    trie->firstRoot = -1;
+}
+
+int gioMonitorCrashStackTrie_addBacktrace(GIOMonitorCrashStackTrie* trie, const uintptr_t* backtrace, int length)
+{
+    if(length <= 0)
+    {
+        return -1;
+    }
+
+    // Follow the frames that are already in the trie.
+    int node = -1;
+    int index = length - 1;
+    for(; index >= 0; index--)
+    {
+        int child = findChild(trie, node, backtrace[index]);
+        if(child < 0)
+        {
+            break;
+        }
+        node = child;
+    }
+
+    if(trie->nodeCount + index + 1 > trie->nodeCapacity)
+    {
+        GIOMonitorCrashLOG_DEBUG("Stack trie is full (%d nodes)", trie->nodeCount);
+        return -1;
+    }
+    for(; index >= 0; index--)
+    {
+        node = addChild(trie, node, backtrace[index]);
+    }
+
+    for(int current = node; current >= 0; current = trie->nodes[current].parent)
+    {
+        trie->nodes[current].refCount++;
+    }
+    return node;
+}
+
+int gioMonitorCrashStackTrie_indexSharedNodes(GIOMonitorCrashStackTrie* trie)
+{
+    int sharedCount = 0;
+    for(int i = 0; i < trie->nodeCount; i++)
+    {
+        GIOMonitorCrashStackTrieNode* entry = &trie->nodes[i];
+        entry->sharedIndex = entry->refCount > 1 ? sharedCount++ : -1;
+    }
+    return sharedCount;
+}
@@ -0,0 +1,109 @@
+//
+//  GIOMonitorCrashStackTrie.h
+//  LoadAddressDemo
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+
+/* A trie of stack suffixes.
+ * Backtraces are inserted outermost frame first, so threads that end in the
+ * same frames (start, main, _pthread_start...) share the same nodes.
+ */
+
+
+#ifndef HDR_GIOMonitorCrashStackTrie_h
+#define HDR_GIOMonitorCrashStackTrie_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct
+{
+    /** The instruction address of this frame. */
+    uintptr_t address;
+
+    /** The next frame towards the outermost frame (the caller), or -1. */
+    int parent;
+
+    /** First frame called from this one, or -1. */
+    int firstChild;
+
+    /** Next frame with the same parent, or -1. */
+    int nextSibling;
+
+    /** Number of backtraces passing through this frame. */
+    int refCount;
+
+    /** Index in the shared frames table, or -1 if this frame is not shared. */
+    int sharedIndex;
+} GIOMonitorCrashStackTrieNode;
+
+typedef struct
+{
+    GIOMonitorCrashStackTrieNode* nodes;
+    int nodeCapacity;
+    int nodeCount;
+    int firstRoot;
+} GIOMonitorCrashStackTrie;
+
+
+/** Allocate storage for a trie.
+ * This allocates memory, so call it outside of the crash handler.
+ *
+ * @param trie The trie to initialize.
+ *
+ * @param maxNodes The maximum number of frames the trie can hold.
+ *
+ * @return true if successful.
+ */
+bool gioMonitorCrashStackTrie_create(GIOMonitorCrashStackTrie* trie, int maxNodes);
+
+/** Free the storage of a trie.
+ *
+ * @param trie The trie to destroy.
+ */
+void gioMonitorCrashStackTrie_destroy(GIOMonitorCrashStackTrie* trie);
+
+/** Remove all frames from a trie without releasing its storage.
+ * This is async-safe.
+ *
+ * @param trie The trie to reset.
+ */
+void gioMonitorCrashStackTrie_reset(GIOMonitorCrashStackTrie* trie);
+
+/** Add a backtrace to the trie.
+ * This is async-safe. If the trie doesn't have room for the whole backtrace,
+ * nothing is added.
+ *
+ * @param trie The trie.
+ *
+ * @param backtrace The backtrace, innermost frame first.
+ *
+ * @param length The number of frames in the backtrace.
+ *
+ * @return The node of the innermost frame, or -1 if the backtrace couldn't be added.
+ */
+int gioMonitorCrashStackTrie_addBacktrace(GIOMonitorCrashStackTrie* trie, const uintptr_t* backtrace, int length);
+
+/** Number all frames that are part of more than one backtrace, in node order.
+ *
+ * @param trie The trie.
+ *
+ * @return The number of shared frames.
+ */
+int gioMonitorCrashStackTrie_indexSharedNodes(GIOMonitorCrashStackTrie* trie);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_GIOMonitorCrashStackTrie_h
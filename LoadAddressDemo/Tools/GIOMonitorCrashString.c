@@ -59,6 +59,25 @@ static const int g_continuationByteCount[0x40] =
     3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 0, 0,
 };
 
+/* Word-at-a-time byte test: nonzero if any byte in the word is less than n
+ * (n <= 0x80). It never misses a match, and only reports false matches in
+ * words that also have a real one.
+ */
+#define kBytesInWord ((uint64_t)0x0101010101010101ULL)
+#define kHighBitsInWord ((uint64_t)0x8080808080808080ULL)
+#define wordHasByteLessThan(w, n) (((w) - kBytesInWord * (n)) & ~(w) & kHighBitsInWord)
+
+/** Check if a word holds only printable ASCII (0x20-0x7f).
+ * Such a word has no terminator, no control characters and no multibyte
+ * sequences, so it can be skipped whole.
+ */
+static inline bool isPrintableASCIIWord(const unsigned char* ptr)
+{
+    uint64_t word;
+    memcpy(&word, ptr, sizeof(word));
+    return ((word & kHighBitsInWord) | wordHasByteLessThan(word, 0x20)) == 0;
+}
+
 bool gioMonitorCrashString_isNullTerminatedUTF8String(const void* memory,
                                         int minLength,
                                         int maxLength)
@@ -66,36 +85,47 @@ bool gioMonitorCrashString_isNullTerminatedUTF8String(const void* memory,
     const unsigned char* ptr = memory;
     const unsigned char* const end = ptr + maxLength;
 
-    for(; ptr < end; ptr++)
+    while(ptr < end)
     {
-        unsigned char ch = *ptr;
-        unlikely_if(ch == 0)
+        likely_if(end - ptr >= (int)sizeof(uint64_t) && isPrintableASCIIWord(ptr))
         {
-            return (ptr - (const unsigned char*)memory) >= minLength;
+            ptr += sizeof(uint64_t);
+            continue;
         }
-        unlikely_if(ch & 0x80)
+
+        // Check the next word's worth of bytes one at a time.
+        const unsigned char* const chunkEnd = end - ptr > (int)sizeof(uint64_t) ? ptr + sizeof(uint64_t) : end;
+        for(; ptr < chunkEnd; ptr++)
         {
-            unlikely_if((ch & 0xc0) != 0xc0)
+            unsigned char ch = *ptr;
+            unlikely_if(ch == 0)
             {
-                return false;
-            }
-            int continuationBytes = g_continuationByteCount[ch & 0x3f];
-            unlikely_if(continuationBytes == 0 || ptr + continuationBytes >= end)
-            {
-                return false;
+                return (ptr - (const unsigned char*)memory) >= minLength;
             }
-            for(int i = 0; i < continuationBytes; i++)
+            unlikely_if(ch & 0x80)
             {
-                ptr++;
-                unlikely_if((*ptr & 0xc0) != 0x80)
+                unlikely_if((ch & 0xc0) != 0xc0)
+                {
+                    return false;
+                }
+                int continuationBytes = g_continuationByteCount[ch & 0x3f];
+                unlikely_if(continuationBytes == 0 || ptr + continuationBytes >= end)
                 {
                     return false;
                 }
+                for(int i = 0; i < continuationBytes; i++)
+                {
+                    ptr++;
+                    unlikely_if((*ptr & 0xc0) != 0x80)
+                    {
+                        return false;
+                    }
+                }
+            }
+            else unlikely_if(ch < 0x20 && !g_printableControlChars[ch])
+            {
+                return false;
             }
-        }
-        else unlikely_if(ch < 0x20 && !g_printableControlChars[ch])
-        {
-            return false;
         }
     }
     return false;
@@ -175,3 +205,14 @@ bool gioMonitorCrashString_extractHexValue(const char* string, int stringLength,
     }
     return false;
 }
+
+uint32_t gioMonitorCrashString_hash(const char* string)
+{
+    uint32_t hash = 2166136261u;
+    for(const unsigned char* ptr = (const unsigned char*)string; *ptr != 0; ptr++)
+    {
+        hash ^= *ptr;
+        hash *= 16777619u;
+    }
+    return hash;
+}
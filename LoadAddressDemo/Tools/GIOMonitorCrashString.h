@@ -58,6 +58,14 @@ bool gioMonitorCrashString_isNullTerminatedUTF8String(const void* memory, int mi
  */
 bool gioMonitorCrashString_extractHexValue(const char* string, int stringLength, uint64_t* result);
 
+/** Hash a null terminated string (32-bit FNV-1a). This is async-safe.
+ *
+ * @param string The string to hash.
+ *
+ * @return The hash value.
+ */
+uint32_t gioMonitorCrashString_hash(const char* string);
+
 
 #ifdef __cplusplus
 }
@@ -34,6 +34,30 @@ extern "C" {
 #include "GIOMonitorCrashStackCursor.h"
 #include <stdbool.h>
 
+/** Remove any pointer tagging from an instruction address
+ * On armv7 the least significant bit of the pointer distinguishes
+ * between thumb mode (2-byte instructions) and normal mode (4-byte instructions).
+ * On arm64 all instructions are 4-bytes wide so the two least significant
+ * bytes should always be 0.
+ * On x86_64 and i386, instructions are variable length so all bits are
+ * signficant.
+ */
+#if defined(__arm__)
+#define DETAG_INSTRUCTION_ADDRESS(A) ((A) & ~(1UL))
+#elif defined(__arm64__)
+#define DETAG_INSTRUCTION_ADDRESS(A) ((A) & ~(3UL))
+#else
+#define DETAG_INSTRUCTION_ADDRESS(A) (A)
+#endif
+
+/** Step backwards by one instruction.
+ * The backtrace of an objective-C program is expected to contain return
+ * addresses not call instructions, as that is what can easily be read from
+ * the stack. This is not a problem except for a few cases where the return
+ * address is inside a different symbol than the call address.
+ */
+#define CALL_INSTRUCTION_FROM_RETURN_ADDRESS(A) (DETAG_INSTRUCTION_ADDRESS((A)) - 1)
+
 /** Symbolicate a stack cursor.
  *
  * @param cursor The cursor to symbolicate.
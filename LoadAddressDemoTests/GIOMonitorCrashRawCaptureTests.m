@@ -0,0 +1,152 @@
+//
+//  GIOMonitorCrashRawCaptureTests.m
+//  LoadAddressDemoTests
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "GIOMonitorCrashRawCapture.h"
+#import "GIOMonitorCrashMachineContext.h"
+#import "GIOMonitorCrashStackCursor_Backtrace.h"
+#import "GIOMonitorCrashThread.h"
+
+#include <signal.h>
+#include <stdlib.h>
+
+/* Captures are read back on the next launch from whatever the crash handler
+ * left on disk, so reading must cope with any prefix of a capture and with
+ * garbage.
+ */
+
+#define kBacktraceLength 4
+
+static const uintptr_t g_backtrace[kBacktraceLength] = {0x1000, 0x2004, 0x3008, 0x400c};
+
+@interface GIOMonitorCrashRawCaptureTests : XCTestCase
+
+@property(nonatomic,copy) NSString* directory;
+@property(nonatomic,copy) NSString* capturePath;
+
+@end
+
+@implementation GIOMonitorCrashRawCaptureTests
+
+- (void)setUp {
+    NSString* name = [NSString stringWithFormat:@"GIOMonitorCrashRawCaptureTests-%@", [NSUUID UUID].UUIDString];
+    self.directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+    self.capturePath = [self.directory stringByAppendingPathComponent:@"capture.dat"];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.directory error:nil];
+}
+
+/** Write a capture of the current thread, with a known backtrace. */
+- (void)writeCapture {
+    GIOMonitorCrashMC_NEW_CONTEXT(machineContext);
+    gioMonitorCrashMachineContext_getContextForThread(gioMonitorCrashThread_self(), machineContext, false);
+    GIOMonitorCrashStackCursor cursor;
+    gioMonitorCrashStackCursor_initWithBacktrace(&cursor, g_backtrace, kBacktraceLength, 0);
+
+    GIOMonitorCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    context.crashType = GIOMonitorCrashMonitorTypeSignal;
+    context.eventID = "E5D1B1A4-0C0B-4D8A-9A55-0F0E7C1B2A3D";
+    context.crashReason = "Test crash";
+    context.faultAddress = 0xdeadbeef;
+    context.signal.signum = SIGSEGV;
+    context.threadsNotSuspended = true;
+    context.offendingMachineContext = machineContext;
+    context.stackCursor = &cursor;
+
+    XCTAssertTrue(gioMonitorCrashRawCapture_write(&context, "{\"key\":\"value\"}", self.capturePath.fileSystemRepresentation));
+}
+
+- (NSString*)writeData:(NSData*)data named:(NSString*)name {
+    NSString* path = [self.directory stringByAppendingPathComponent:name];
+    XCTAssertTrue([data writeToFile:path atomically:NO]);
+    return path;
+}
+
+- (void)testRoundTrip {
+    [self writeCapture];
+
+    GIOMonitorCrashRawCapture capture;
+    XCTAssertTrue(gioMonitorCrashRawCapture_read(self.capturePath.fileSystemRepresentation, &capture));
+    XCTAssertFalse(capture.isTruncated);
+    XCTAssertEqual(capture.context.crashType, GIOMonitorCrashMonitorTypeSignal);
+    XCTAssertEqualObjects(@(capture.context.eventID), @"E5D1B1A4-0C0B-4D8A-9A55-0F0E7C1B2A3D");
+    XCTAssertEqualObjects(@(capture.context.crashReason), @"Test crash");
+    XCTAssertEqual(capture.context.faultAddress, (uintptr_t)0xdeadbeef);
+    XCTAssertEqual(capture.context.signal.signum, SIGSEGV);
+    XCTAssertTrue(capture.context.threadsNotSuspended);
+    XCTAssertFalse(capture.context.registersAreValid);
+    XCTAssertEqualObjects(@(capture.userInfoJSON), @"{\"key\":\"value\"}");
+    XCTAssertGreaterThan(capture.imageCount, 0);
+
+    XCTAssertEqual(capture.threadCount, 1);
+    const GIOMonitorCrashRawThread* thread = &capture.threads[0];
+    XCTAssertEqual(thread->backtraceLength, kBacktraceLength);
+    for(int i = 0; i < kBacktraceLength && i < thread->backtraceLength; i++) {
+        XCTAssertEqual(thread->backtrace[i], g_backtrace[i]);
+    }
+    gioMonitorCrashRawCapture_free(&capture);
+}
+
+- (void)testTruncatedCaptures {
+    [self writeCapture];
+    NSData* data = [NSData dataWithContentsOfFile:self.capturePath];
+    XCTAssertGreaterThan(data.length, 64u);
+
+    // Odd steps, so that most cuts land inside a record rather than between two.
+    for(NSUInteger length = 0; length < data.length; length += 61) {
+        NSString* path = [self writeData:[data subdataWithRange:NSMakeRange(0, length)] named:@"truncated.dat"];
+        GIOMonitorCrashRawCapture capture;
+        if(gioMonitorCrashRawCapture_read(path.fileSystemRepresentation, &capture)) {
+            XCTAssertTrue(capture.isTruncated, @"length %lu", (unsigned long)length);
+            XCTAssertEqual(capture.context.crashType, GIOMonitorCrashMonitorTypeSignal);
+            XCTAssertLessThanOrEqual(capture.threadCount, 1);
+            gioMonitorCrashRawCapture_free(&capture);
+        }
+    }
+}
+
+- (void)testCaptureCutMidRecord {
+    [self writeCapture];
+    NSData* data = [NSData dataWithContentsOfFile:self.capturePath];
+
+    // The end record is a lone 8 byte header, so this cuts it in half.
+    NSString* path = [self writeData:[data subdataWithRange:NSMakeRange(0, data.length - 4)] named:@"truncated.dat"];
+    GIOMonitorCrashRawCapture capture;
+    XCTAssertTrue(gioMonitorCrashRawCapture_read(path.fileSystemRepresentation, &capture));
+    XCTAssertTrue(capture.isTruncated);
+    XCTAssertEqual(capture.threadCount, 1);
+    XCTAssertGreaterThan(capture.imageCount, 0);
+    gioMonitorCrashRawCapture_free(&capture);
+}
+
+- (void)testCorruptCaptures {
+    [self writeCapture];
+    NSData* data = [NSData dataWithContentsOfFile:self.capturePath];
+
+    // Flip bytes throughout the capture. Reading may fail, but must not crash.
+    srand(4321);
+    for(int run = 0; run < 200; run++) {
+        NSMutableData* corrupt = [data mutableCopy];
+        uint8_t* bytes = corrupt.mutableBytes;
+        for(int i = 0; i < 8; i++) {
+            bytes[(NSUInteger)rand() % corrupt.length] = (uint8_t)rand();
+        }
+        NSString* path = [self writeData:corrupt named:@"corrupt.dat"];
+        GIOMonitorCrashRawCapture capture;
+        if(gioMonitorCrashRawCapture_read(path.fileSystemRepresentation, &capture)) {
+            gioMonitorCrashRawCapture_free(&capture);
+        }
+    }
+}
+
+@end
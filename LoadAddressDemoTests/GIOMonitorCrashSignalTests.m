@@ -0,0 +1,120 @@
+//
+//  GIOMonitorCrashSignalTests.m
+//  LoadAddressDemoTests
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import <TargetConditionals.h>
+
+#import "GIOMonitorCrashC.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Each test forks, and the child installs the crash reporter and crashes with
+ * a signal so that the signal handler writes a report. Nothing is installed in
+ * the test process itself. Processes can only be forked in the simulator, so
+ * the tests only exist there.
+ */
+
+#define kTestAppName "GIOMonitorCrashSignalTests"
+
+@interface GIOMonitorCrashSignalTests : XCTestCase
+
+@property(nonatomic,copy) NSString* installPath;
+
+@end
+
+@implementation GIOMonitorCrashSignalTests
+
+- (void)setUp {
+    NSString* name = [NSString stringWithFormat:@"GIOMonitorCrashSignalTests-%@", [NSUUID UUID].UUIDString];
+    self.installPath = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:self.installPath error:nil];
+}
+
+#if TARGET_OS_SIMULATOR
+
+/** Crash a child process with a signal.
+ *
+ * @param sigNum The signal to raise in the child.
+ *
+ * @param useCrashHandlerThread If true, the child writes its report on the crash handler thread.
+ *
+ * @return The child's wait status.
+ */
+- (int)crashChildWithSignal:(int)sigNum useCrashHandlerThread:(bool)useCrashHandlerThread {
+    const char* installPath = self.installPath.fileSystemRepresentation;
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        // The child's first and only install, into a path of its own so that
+        // other reports are neither coalesced with nor pruned by its report.
+        gioMonitorCrash_setMonitoring(GIOMonitorCrashMonitorTypeSignal);
+        gioMonitorCrash_setUseCrashHandlerThread(useCrashHandlerThread);
+        gioMonitorCrash_install(kTestAppName, installPath);
+        raise(sigNum);
+        _exit(0);
+    }
+    XCTAssertGreaterThan(pid, 0);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+- (NSArray*)reportNames {
+    NSString* reportsPath = [self.installPath stringByAppendingPathComponent:@"Reports"];
+    NSArray* names = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:reportsPath error:nil];
+    NSPredicate* isReport = [NSPredicate predicateWithFormat:@"SELF BEGINSWITH %@ AND SELF ENDSWITH '.json'",
+                             @kTestAppName "-report-"];
+    return [names filteredArrayUsingPredicate:isReport];
+}
+
+- (void)assertReportWrittenForSignal:(int)sigNum useCrashHandlerThread:(bool)useCrashHandlerThread {
+    int status = [self crashChildWithSignal:sigNum useCrashHandlerThread:useCrashHandlerThread];
+
+    // The handler re-raises the signal once the report is written.
+    XCTAssertTrue(WIFSIGNALED(status));
+    XCTAssertEqual(WTERMSIG(status), sigNum);
+    XCTAssertEqual([self reportNames].count, 1u);
+}
+
+- (void)testSIGSEGVWritesReport {
+    [self assertReportWrittenForSignal:SIGSEGV useCrashHandlerThread:false];
+}
+
+- (void)testSIGABRTWritesReport {
+    [self assertReportWrittenForSignal:SIGABRT useCrashHandlerThread:false];
+}
+
+- (void)testSIGSEGVWritesReportOnHandlerThread {
+    [self assertReportWrittenForSignal:SIGSEGV useCrashHandlerThread:true];
+}
+
+- (void)testSIGABRTWritesReportOnHandlerThread {
+    [self assertReportWrittenForSignal:SIGABRT useCrashHandlerThread:true];
+}
+
+- (void)testSIGSEGVPerformance {
+    [self measureBlock:^{
+        [self crashChildWithSignal:SIGSEGV useCrashHandlerThread:false];
+    }];
+}
+
+- (void)testSIGSEGVOnHandlerThreadPerformance {
+    [self measureBlock:^{
+        [self crashChildWithSignal:SIGSEGV useCrashHandlerThread:true];
+    }];
+}
+
+#endif
+
+@end
@@ -0,0 +1,209 @@
+//
+//  GIOMonitorCrashStringTests.m
+//  LoadAddressDemoTests
+//
+//  Created by GrowingIO on 2026/10/18.
+//  Copyright © 2026 GrowingIO. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "GIOMonitorCrashString.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kMaxInputLength 64
+#define kMaxStartOffset 8
+
+static const int g_printableControlChars[0x20] =
+{
+    // Only tab, CR, and LF are considered printable
+    // 1  2  3  4  5  6  7  8  9  a  b  c  d  e  f
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const int g_continuationByteCount[0x40] =
+{
+    // 1  2  3  4  5  6  7  8  9  a  b  c  d  e  f
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 0, 0,
+};
+
+/** The byte at a time check that the word at a time one replaced, kept as the
+ * reference it must agree with.
+ */
+static bool isNullTerminatedUTF8StringByteLoop(const void* memory, int minLength, int maxLength)
+{
+    const unsigned char* ptr = memory;
+    const unsigned char* const end = ptr + maxLength;
+
+    for(; ptr < end; ptr++)
+    {
+        unsigned char ch = *ptr;
+        if(ch == 0)
+        {
+            return (ptr - (const unsigned char*)memory) >= minLength;
+        }
+        if(ch & 0x80)
+        {
+            if((ch & 0xc0) != 0xc0)
+            {
+                return false;
+            }
+            int continuationBytes = g_continuationByteCount[ch & 0x3f];
+            if(continuationBytes == 0 || ptr + continuationBytes >= end)
+            {
+                return false;
+            }
+            for(int i = 0; i < continuationBytes; i++)
+            {
+                ptr++;
+                if((*ptr & 0xc0) != 0x80)
+                {
+                    return false;
+                }
+            }
+        }
+        else if(ch < 0x20 && !g_printableControlChars[ch])
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+typedef struct
+{
+    const char* name;
+    const char* bytes;
+    int length;
+} TestInput;
+
+#define INPUT(NAME, BYTES) {NAME, BYTES, (int)sizeof(BYTES) - 1}
+
+static const TestInput g_inputs[] =
+{
+    INPUT("empty", "\0"),
+    INPUT("short ASCII", "abc\0"),
+    INPUT("word of ASCII", "abcdefgh\0"),
+    INPUT("long ASCII", "The quick brown fox jumps over the lazy dog, twice over.\0"),
+    INPUT("ASCII with tab and newlines", "line one\tcol\r\nline two\n\0"),
+    INPUT("control character", "abcdefg\x01hijklmn\0"),
+    INPUT("DEL", "abcdefghijk\x7fmnop\0"),
+    INPUT("two byte sequence", "caf\xc3\xa9 au lait\0"),
+    INPUT("three byte sequence", "price \xe2\x82\xac 10 and more text\0"),
+    INPUT("four byte sequence", "emoji \xf0\x9f\x98\x80 in the middle of text\0"),
+    INPUT("sequence across a word", "abcdefg\xe2\x82\xac\0"),
+    INPUT("truncated two byte sequence", "abcdefgh\xc3\0"),
+    INPUT("truncated three byte sequence", "abcdefgh\xe2\x82\0"),
+    INPUT("truncated four byte sequence", "abc\xf0\x9f\x98\0"),
+    INPUT("bad continuation byte", "abcdefgh\xe2\x41\x82 more\0"),
+    INPUT("lone continuation byte", "abcdefgh\x80 more text\0"),
+    INPUT("overlong slash", "abcd\xc0\xaf more text\0"),
+    INPUT("overlong NUL", "abcdefgh\xc0\x80 text\0"),
+    INPUT("overlong three byte", "abcd\xe0\x80\xaf more text\0"),
+    INPUT("five byte lead", "abcd\xf8\x88\x80\x80\x80 text\0"),
+    INPUT("invalid lead bytes", "abcd\xfe\xff more text\0"),
+    INPUT("no terminator", "abcdefghijklmnopqrstuvwxyz0123456789"),
+    INPUT("NUL in the middle", "abcdefghij\0klmnopqrstuvwxyz\0"),
+};
+
+@interface GIOMonitorCrashStringTests : XCTestCase
+
+@end
+
+@implementation GIOMonitorCrashStringTests
+
+/** Check the word at a time and byte at a time checks agree on an input, at
+ * every start offset within a word and at every length limit up to and past
+ * the input's own length.
+ */
+- (void)assertEquivalentForBytes:(const char*)bytes length:(int)length name:(NSString*)name {
+    // Aligned, so that adding the start offset gives every alignment.
+    uint64_t storage[(kMaxStartOffset + kMaxInputLength) / sizeof(uint64_t) + 1];
+    XCTAssertLessThanOrEqual(length, kMaxInputLength);
+
+    for(int offset = 0; offset < kMaxStartOffset; offset++) {
+        char* buffer = (char*)storage + offset;
+        memset(storage, 0x41, sizeof(storage));
+        memcpy(buffer, bytes, (size_t)length);
+        for(int maxLength = 0; maxLength <= length + 1; maxLength++) {
+            for(int minLength = 0; minLength <= 2; minLength++) {
+                bool expected = isNullTerminatedUTF8StringByteLoop(buffer, minLength, maxLength);
+                bool actual = gioMonitorCrashString_isNullTerminatedUTF8String(buffer, minLength, maxLength);
+                XCTAssertEqual(actual, expected, @"%@: offset %d, minLength %d, maxLength %d",
+                               name, offset, minLength, maxLength);
+            }
+        }
+    }
+}
+
+- (void)testUTF8CheckMatchesByteLoop {
+    for(size_t i = 0; i < sizeof(g_inputs) / sizeof(g_inputs[0]); i++) {
+        [self assertEquivalentForBytes:g_inputs[i].bytes
+                                length:g_inputs[i].length
+                                  name:@(g_inputs[i].name)];
+    }
+}
+
+- (void)testUTF8CheckMatchesByteLoopOnGarbage {
+    // Bytes drawn mostly from the ranges the checks treat differently.
+    static const unsigned char interesting[] = {
+        0x00, 0x01, 0x09, 0x0a, 0x1f, 0x20, 0x41, 0x7f,
+        0x80, 0xaf, 0xbf, 0xc0, 0xc3, 0xdf, 0xe2, 0xef,
+        0xf0, 0xf7, 0xf8, 0xfc, 0xfe, 0xff,
+    };
+    srand(1234);
+    char bytes[kMaxInputLength];
+    for(int run = 0; run < 500; run++) {
+        int length = 1 + rand() % kMaxInputLength;
+        for(int i = 0; i < length; i++) {
+            bytes[i] = rand() % 2 == 0
+                ? (char)(0x20 + rand() % 0x5f)
+                : (char)interesting[rand() % sizeof(interesting)];
+        }
+        [self assertEquivalentForBytes:bytes length:length name:[NSString stringWithFormat:@"garbage run %d", run]];
+    }
+}
+
+- (void)testUTF8CheckPerformance {
+    // Mostly valid strings, as found when introspecting memory, with some garbage.
+    enum { kBufferCount = 64, kBufferSize = 256 };
+    static char buffers[kBufferCount][kBufferSize];
+    srand(5678);
+    for(int i = 0; i < kBufferCount; i++) {
+        if(i % 4 == 3) {
+            for(int j = 0; j < kBufferSize; j++) {
+                buffers[i][j] = (char)rand();
+            }
+        } else {
+            const TestInput* input = &g_inputs[i % (sizeof(g_inputs) / sizeof(g_inputs[0]))];
+            int used = 0;
+            while(used + input->length < kBufferSize - 1) {
+                memcpy(buffers[i] + used, input->bytes, (size_t)input->length);
+                used += input->length;
+                // Join the copies, so that the string runs to the end of the buffer.
+                if(used > 0 && buffers[i][used - 1] == '\0') {
+                    buffers[i][used - 1] = ' ';
+                }
+            }
+            buffers[i][used] = '\0';
+        }
+    }
+
+    [self measureBlock:^{
+        int validCount = 0;
+        for(int run = 0; run < 2000; run++) {
+            for(int i = 0; i < kBufferCount; i++) {
+                validCount += gioMonitorCrashString_isNullTerminatedUTF8String(buffers[i], 1, kBufferSize);
+            }
+        }
+        XCTAssertGreaterThan(validCount, 0);
+    }];
+}
+
+@end
@@ -0,0 +1,329 @@
+import os
+import re
+import sys
+import json
+import getopt
+import struct
+import hashlib
+
+from report_converter import expand_report
+
+STATE_VERSION = 1
+
+# Frames of the crashed thread that make up an issue's exact fingerprint.
+FINGERPRINT_FRAMES = 5
+
+# Frames of the crashed thread that are used for similarity.
+SIMILARITY_FRAMES = 32
+SHINGLE_SIZE = 2
+
+# MinHash signature length, split into LSH bands of BAND_ROWS rows each.
+NUM_HASHES = 64
+BAND_ROWS = 4
+
+DEFAULT_THRESHOLD = 0.5
+
+MERSENNE_PRIME = (1 << 61) - 1
+MAX_HASH = (1 << 32) - 1
+
+SYSTEM_IMAGE_PREFIXES = ("/System/", "/usr/lib/", "/Developer/", "/private/preboot/")
+
+OFFSET_PATTERN = re.compile(r"\s*\+\s*(0x[0-9a-fA-F]+|\d+)$")
+ADDRESS_PATTERN = re.compile(r"0x[0-9a-fA-F]+")
+
+def make_permutations():
+
+    # Fixed seeds, so signatures stay comparable between runs.
+    permutations = []
+    seed = hashlib.sha256(b"crash_grouper").digest()
+    for index in range(NUM_HASHES):
+        seed = hashlib.sha256(seed + struct.pack("<I", index)).digest()
+        a, b = struct.unpack_from("<QQ", seed)
+        permutations.append(((a % (MERSENNE_PRIME - 1)) + 1, b % MERSENNE_PRIME))
+    return permutations
+
+PERMUTATIONS = make_permutations()
+
+def token_hash(token):
+
+    return struct.unpack("<I", hashlib.blake2b(token.encode("utf-8"), digest_size=4).digest())[0]
+
+def minhash(tokens):
+
+    signature = [MAX_HASH] * NUM_HASHES
+    for value in set(token_hash(token) for token in tokens):
+        for index, (a, b) in enumerate(PERMUTATIONS):
+            hashed = ((a * value + b) % MERSENNE_PRIME) & MAX_HASH
+            if hashed < signature[index]:
+                signature[index] = hashed
+    return signature
+
+def similarity(signature, other):
+
+    return sum(1 for a, b in zip(signature, other) if a == b) / float(NUM_HASHES)
+
+def band_keys(signature):
+
+    for start in range(0, NUM_HASHES, BAND_ROWS):
+        yield "{}:{}".format(start, ",".join(str(value) for value in signature[start:start + BAND_ROWS]))
+
+def unwrap_report(report):
+
+    if "report" in report and isinstance(report["report"], dict) and "crash" in report["report"]:
+        return report["report"]
+    return report
+
+def exception_key(error):
+
+    error_type = error.get("type", "unknown")
+    for section in ("nsexception", "cpp_exception", "user_reported"):
+        name = (error.get(section) or {}).get("name")
+        if name:
+            return "{}:{}".format(error_type, name)
+    signal = error.get("signal") or {}
+    if signal.get("name"):
+        return "{}:{}".format(error_type, signal["name"])
+    mach = error.get("mach") or {}
+    if mach.get("exception_name"):
+        return "{}:{}".format(error_type, mach["exception_name"])
+    return error_type
+
+def crashed_thread(crash):
+
+    threads = crash.get("threads", [])
+    for thread in threads:
+        if thread.get("crashed"):
+            return thread
+    return threads[0] if threads else None
+
+def system_image_names(report):
+
+    names = set()
+    for image in report.get("binary_images", []):
+        path = image.get("name") or ""
+        if path.startswith(SYSTEM_IMAGE_PREFIXES):
+            names.add(os.path.basename(path))
+    return names
+
+def normalize_frame(frame):
+
+    symbol = frame.get("symbol_name")
+    if symbol:
+        symbol = OFFSET_PATTERN.sub("", symbol)
+        return ADDRESS_PATTERN.sub("0x?", symbol)
+    return "{}`?".format(frame.get("object_name", "???"))
+
+def collapse_recursion(frames):
+
+    # Drop immediate repeats of runs of up to 4 frames: a;b;a;b;c -> a;b;c.
+    collapsed = []
+    for frame in frames:
+        collapsed.append(frame)
+        for length in range(1, 5):
+            if len(collapsed) >= 2 * length and collapsed[-length:] == collapsed[-2 * length:-length]:
+                del collapsed[-length:]
+                break
+    return collapsed
+
+def normalized_frames(report, thread):
+
+    contents = (thread.get("backtrace") or {}).get("contents", [])
+    system_images = system_image_names(report)
+    app_frames = [frame for frame in contents if frame.get("object_name") not in system_images]
+    if not app_frames:
+        # A crash entirely inside system code is still grouped by its frames.
+        app_frames = contents
+    return collapse_recursion([normalize_frame(frame) for frame in app_frames[:SIMILARITY_FRAMES * 2]])[:SIMILARITY_FRAMES]
+
+def analyze_report(report):
+
+    report = unwrap_report(report)
+    expand_report(report)
+    crash = report.get("crash")
+    if not isinstance(crash, dict):
+        return None
+    thread = crashed_thread(crash)
+    if thread is None:
+        return None
+
+    key = exception_key(crash.get("error") or {})
+    frames = normalized_frames(report, thread)
+    fingerprint = hashlib.sha1("\n".join([key] + frames[:FINGERPRINT_FRAMES]).encode("utf-8")).hexdigest()[:16]
+
+    tokens = [key]
+    for index in range(max(1, len(frames) - SHINGLE_SIZE + 1)):
+        tokens.append(";".join(frames[index:index + SHINGLE_SIZE]))
+
+    info = report.get("report") or {}
+    return {
+        "id": info.get("id"),
+        "timestamp": info.get("timestamp", 0),
+        "exception": key,
+        "title": "{} in {}".format(key, frames[0] if frames else "???"),
+        "fingerprint": fingerprint,
+        "signature": minhash(tokens),
+    }
+
+class IssueIndex(object):
+
+    def __init__(self, threshold):
+        self.threshold = threshold
+        self.issues = []
+        self.seen_reports = set()
+        self.by_fingerprint = {}
+        self.bands = {}
+
+    def load(self, path):
+
+        with open(path, "r") as state_file:
+            state = json.load(state_file)
+        if state.get("version") != STATE_VERSION:
+            raise ValueError("unsupported state version {}".format(state.get("version")))
+        self.seen_reports = set(state.get("seen_reports", []))
+        for issue in state.get("issues", []):
+            self.add_issue(issue)
+
+    def save(self, path):
+
+        state = {
+            "version": STATE_VERSION,
+            "issues": self.issues,
+            "seen_reports": sorted(self.seen_reports),
+        }
+        temp_path = path + ".tmp"
+        with open(temp_path, "w") as state_file:
+            json.dump(state, state_file)
+        os.rename(temp_path, path)
+
+    def add_issue(self, issue):
+
+        self.issues.append(issue)
+        for fingerprint in issue["fingerprints"]:
+            self.by_fingerprint[fingerprint] = issue
+        for key in band_keys(issue["signature"]):
+            self.bands.setdefault(key, []).append(issue)
+
+    def find_similar(self, analysis):
+
+        best = None
+        best_similarity = self.threshold
+        checked = set()
+        for key in band_keys(analysis["signature"]):
+            for issue in self.bands.get(key, []):
+                if issue["id"] in checked or issue["exception"] != analysis["exception"]:
+                    continue
+                checked.add(issue["id"])
+                score = similarity(issue["signature"], analysis["signature"])
+                if score >= best_similarity:
+                    best = issue
+                    best_similarity = score
+        return best
+
+    def add(self, analysis, path):
+
+        report_id = analysis["id"] or os.path.abspath(path)
+        if report_id in self.seen_reports:
+            return None
+        self.seen_reports.add(report_id)
+
+        issue = self.by_fingerprint.get(analysis["fingerprint"])
+        if issue is None:
+            issue = self.find_similar(analysis)
+            if issue is not None:
+                issue["fingerprints"].append(analysis["fingerprint"])
+                self.by_fingerprint[analysis["fingerprint"]] = issue
+        if issue is None:
+            issue = {
+                "id": len(self.issues) + 1,
+                "title": analysis["title"],
+                "exception": analysis["exception"],
+                "fingerprints": [analysis["fingerprint"]],
+                "signature": analysis["signature"],
+                "count": 0,
+                "first_seen": analysis["timestamp"],
+                "last_seen": analysis["timestamp"],
+                "sample_reports": [],
+            }
+            self.add_issue(issue)
+
+        issue["count"] += 1
+        issue["first_seen"] = min(issue["first_seen"], analysis["timestamp"])
+        issue["last_seen"] = max(issue["last_seen"], analysis["timestamp"])
+        if len(issue["sample_reports"]) < 5:
+            issue["sample_reports"].append(path)
+        return issue
+
+def report_paths(paths):
+
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.endswith(".json"):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+def group(input_paths, state_path, output_path, threshold):
+
+    index = IssueIndex(threshold)
+    if state_path is not None and os.path.isfile(state_path):
+        index.load(state_path)
+
+    for path in report_paths(input_paths):
+        try:
+            with open(path, "r") as input_file:
+                report = json.load(input_file)
+        except (IOError, OSError, ValueError) as error:
+            sys.stderr.write("Skipping {}: {}\n".format(path, error))
+            continue
+        analysis = analyze_report(report) if isinstance(report, dict) else None
+        if analysis is not None:
+            index.add(analysis, path)
+
+    if state_path is not None:
+        index.save(state_path)
+
+    issues = sorted(index.issues, key=lambda issue: -issue["count"])
+    if output_path is not None:
+        summary = [dict((key, value) for key, value in issue.items() if key != "signature") for issue in issues]
+        with open(output_path, "w") as output_file:
+            json.dump(summary, output_file, indent=2)
+    else:
+        for issue in issues:
+            print("#{:<6} {:>8}  {}".format(issue["id"], issue["count"], issue["title"]))
+
+def main(argv):
+    help_desc = 'crash_grouper.py -i <report.json|reports dir> [-i ...] [-s <state.json>] [-o <issues.json>] [-t <similarity threshold>]'
+
+    input_paths = []
+    state_path = None
+    output_path = None
+    threshold = DEFAULT_THRESHOLD
+
+    try:
+        opts, args = getopt.getopt(argv,"hi:s:o:t:",["input=","state=","output=","threshold="])
+    except getopt.GetoptError:
+        print(help_desc)
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt == '-h':
+            print(help_desc)
+            sys.exit()
+        elif opt in ("-i", "--input"):
+            input_paths.append(arg)
+        elif opt in ("-s", "--state"):
+            state_path = arg
+        elif opt in ("-o", "--output"):
+            output_path = arg
+        elif opt in ("-t", "--threshold"):
+            threshold = float(arg)
+
+    if not input_paths or not all(os.path.exists(path) for path in input_paths):
+        print(help_desc)
+        sys.exit(2)
+
+    group(input_paths, state_path, output_path, threshold)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -0,0 +1,395 @@
+import os
+import sys
+import json
+import getopt
+import heapq
+import struct
+import bisect
+import tempfile
+
+from report_converter import expand_report
+
+# Stacks are aggregated in memory until there are this many distinct ones,
+# then spilled to a sorted temporary file. The files are merged at the end.
+DEFAULT_MAX_STACKS = 200000
+
+MH_MAGIC = 0xfeedface
+MH_MAGIC_64 = 0xfeedfacf
+FAT_MAGIC = 0xcafebabe
+FAT_MAGIC_64 = 0xcafebabf
+
+LC_SEGMENT = 0x1
+LC_SYMTAB = 0x2
+LC_SEGMENT_64 = 0x19
+LC_UUID = 0x1b
+
+N_STAB = 0xe0
+N_TYPE = 0x0e
+N_SECT = 0x0e
+
+class MachOSlice(object):
+
+    def __init__(self, path, offset, is_64, cpu_type, text_vmaddr, symtab, uuid):
+        self.path = path
+        self.offset = offset
+        self.is_64 = is_64
+        self.cpu_type = cpu_type
+        self.text_vmaddr = text_vmaddr
+        self.symtab = symtab
+        self.uuid = uuid
+        self.addresses = None
+        self.names = None
+
+    def load_symbols(self):
+
+        self.addresses = []
+        self.names = []
+        if self.symtab is None:
+            return
+        symoff, nsyms, stroff, strsize = self.symtab
+        entry_format = "<IBBHQ" if self.is_64 else "<IBBHI"
+        entry_size = struct.calcsize(entry_format)
+        symbols = []
+        with open(self.path, "rb") as binary:
+            binary.seek(self.offset + stroff)
+            strings = binary.read(strsize)
+            binary.seek(self.offset + symoff)
+            table = binary.read(nsyms * entry_size)
+        for strx, n_type, n_sect, n_desc, value in struct.iter_unpack(entry_format, table):
+            if n_type & N_STAB or (n_type & N_TYPE) != N_SECT or value == 0:
+                continue
+            end = strings.find(b"\0", strx)
+            name = strings[strx:end].decode("utf-8", "replace")
+            if name.startswith("_"):
+                name = name[1:]
+            symbols.append((value, name))
+        symbols.sort()
+        for value, name in symbols:
+            self.addresses.append(value)
+            self.names.append(name)
+
+    def symbol_for(self, vmaddr):
+
+        if self.addresses is None:
+            self.load_symbols()
+        index = bisect.bisect_right(self.addresses, vmaddr) - 1
+        if index < 0:
+            return None
+        return self.names[index]
+
+def parse_macho_slice(binary, path, offset):
+
+    binary.seek(offset)
+    magic, = struct.unpack("<I", binary.read(4))
+    if magic not in (MH_MAGIC, MH_MAGIC_64):
+        return None
+    is_64 = magic == MH_MAGIC_64
+    binary.seek(offset)
+    header = binary.read(32 if is_64 else 28)
+    _, cpu_type, _, _, ncmds, sizeofcmds, _ = struct.unpack("<IiiIIII", header[:28])
+    commands = binary.read(sizeofcmds)
+
+    text_vmaddr = 0
+    symtab = None
+    uuid = None
+    position = 0
+    for _ in range(ncmds):
+        cmd, cmdsize = struct.unpack_from("<II", commands, position)
+        if cmd in (LC_SEGMENT, LC_SEGMENT_64):
+            segname = commands[position + 8:position + 24].rstrip(b"\0")
+            if segname == b"__TEXT":
+                if cmd == LC_SEGMENT_64:
+                    text_vmaddr, = struct.unpack_from("<Q", commands, position + 24)
+                else:
+                    text_vmaddr, = struct.unpack_from("<I", commands, position + 24)
+        elif cmd == LC_SYMTAB:
+            symtab = struct.unpack_from("<IIII", commands, position + 8)
+        elif cmd == LC_UUID:
+            uuid = commands[position + 8:position + 24].hex().upper()
+        if cmdsize == 0:
+            break
+        position += cmdsize
+
+    if uuid is None:
+        return None
+    return MachOSlice(path, offset, is_64, cpu_type, text_vmaddr, symtab, uuid)
+
+def parse_macho(path):
+
+    slices = []
+    try:
+        with open(path, "rb") as binary:
+            start = binary.read(8)
+            if len(start) < 8:
+                return slices
+            fat_magic, nfat_arch = struct.unpack(">II", start)
+            if fat_magic in (FAT_MAGIC, FAT_MAGIC_64):
+                arch_format = ">iiQQII" if fat_magic == FAT_MAGIC_64 else ">iiIII"
+                arch_size = struct.calcsize(arch_format)
+                archs = binary.read(nfat_arch * arch_size)
+                for index in range(nfat_arch):
+                    arch = struct.unpack_from(arch_format, archs, index * arch_size)
+                    macho_slice = parse_macho_slice(binary, path, arch[2])
+                    if macho_slice is not None:
+                        slices.append(macho_slice)
+            else:
+                macho_slice = parse_macho_slice(binary, path, 0)
+                if macho_slice is not None:
+                    slices.append(macho_slice)
+    except (IOError, OSError, struct.error):
+        pass
+    return slices
+
+def index_binaries(paths):
+
+    binaries = {}
+    for path in paths:
+        if os.path.isdir(path):
+            files = (os.path.join(root, name) for root, _, names in os.walk(path) for name in names)
+        else:
+            files = [path]
+        for file_path in files:
+            for macho_slice in parse_macho(file_path):
+                binaries[macho_slice.uuid] = macho_slice
+    return binaries
+
+class ImageMap(object):
+
+    def __init__(self, report, binaries):
+        images = []
+        for image in report.get("binary_images", []):
+            address = image.get("image_addr")
+            if address is None:
+                continue
+            uuid = (image.get("uuid") or "").replace("-", "").upper()
+            images.append((address, image.get("image_size", 0), image, binaries.get(uuid)))
+        images.sort(key=lambda entry: entry[0])
+        self.starts = [entry[0] for entry in images]
+        self.images = images
+
+    def lookup(self, address):
+
+        index = bisect.bisect_right(self.starts, address) - 1
+        if index < 0:
+            return None
+        start, size, image, macho_slice = self.images[index]
+        if address >= start + size:
+            return None
+        return start, image, macho_slice
+
+class Symbolicator(object):
+
+    def __init__(self, binaries):
+        self.binaries = binaries
+        self.frame_ids = {}
+        self.frame_names = []
+
+    def intern(self, name):
+
+        name = name.replace(";", ":")
+        frame_id = self.frame_ids.get(name)
+        if frame_id is None:
+            frame_id = len(self.frame_names)
+            self.frame_ids[name] = frame_id
+            self.frame_names.append(name)
+        return frame_id
+
+    def frame_name(self, image_map, frame, is_return_address):
+
+        address = frame.get("instruction_addr", 0)
+        lookup_address = address - 1 if is_return_address and address > 0 else address
+        found = image_map.lookup(lookup_address)
+        if found is None:
+            if frame.get("symbol_name"):
+                return "{}`{}".format(frame.get("object_name", "???"), frame["symbol_name"])
+            return hex(address)
+        start, image, macho_slice = found
+        image_name = os.path.basename(image.get("name") or frame.get("object_name") or "???")
+        symbol = None
+        if macho_slice is not None:
+            symbol = macho_slice.symbol_for(lookup_address - start + macho_slice.text_vmaddr)
+        if symbol is None:
+            symbol = frame.get("symbol_name")
+        if symbol is None:
+            return "{}`{}".format(image_name, hex(address - start))
+        return "{}`{}".format(image_name, symbol)
+
+    def stack(self, image_map, frames):
+
+        # Backtraces are innermost first; folded stacks are outermost first.
+        ids = []
+        for index in range(len(frames) - 1, -1, -1):
+            ids.append(self.intern(self.frame_name(image_map, frames[index], index > 0)))
+        return tuple(ids)
+
+class StackAggregator(object):
+
+    def __init__(self, symbolicator, max_stacks):
+        self.symbolicator = symbolicator
+        self.max_stacks = max_stacks
+        self.counts = {}
+        self.spills = []
+
+    def add(self, stack, count):
+
+        if not stack or count <= 0:
+            return
+        self.counts[stack] = self.counts.get(stack, 0) + count
+        if len(self.counts) >= self.max_stacks:
+            self.spill()
+
+    def folded_lines(self):
+
+        names = self.symbolicator.frame_names
+        lines = [(";".join(names[frame_id] for frame_id in stack), count) for stack, count in self.counts.items()]
+        lines.sort()
+        return lines
+
+    def spill(self):
+
+        spill_file = tempfile.TemporaryFile(mode="w+")
+        for folded, count in self.folded_lines():
+            spill_file.write("{}\t{}\n".format(folded, count))
+        spill_file.seek(0)
+        self.spills.append(spill_file)
+        self.counts = {}
+
+    def write(self, output):
+
+        if not self.spills:
+            for folded, count in self.folded_lines():
+                output.write("{} {}\n".format(folded, count))
+            return
+
+        if self.counts:
+            self.spill()
+        def read_spill(spill_file):
+            for line in spill_file:
+                folded, count = line.rstrip("\n").rsplit("\t", 1)
+                yield folded, int(count)
+        current = None
+        total = 0
+        for folded, count in heapq.merge(*[read_spill(spill_file) for spill_file in self.spills]):
+            if folded != current:
+                if current is not None:
+                    output.write("{} {}\n".format(current, total))
+                current = folded
+                total = 0
+            total += count
+        if current is not None:
+            output.write("{} {}\n".format(current, total))
+        for spill_file in self.spills:
+            spill_file.close()
+        self.spills = []
+
+def thread_root(thread):
+
+    if thread.get("dispatch_queue"):
+        return "queue:" + thread["dispatch_queue"]
+    if thread.get("name"):
+        return "thread:" + thread["name"]
+    return "thread:#{}".format(thread.get("index", "?"))
+
+def add_report(report, symbolicator, aggregator, per_thread):
+
+    if "report" in report and isinstance(report["report"], dict) and "crash" in report["report"]:
+        report = report["report"]
+    expand_report(report)
+    image_map = ImageMap(report, symbolicator.binaries)
+
+    crash = report.get("crash")
+    if isinstance(crash, dict):
+        for thread in crash.get("threads", []):
+            frames = (thread.get("backtrace") or {}).get("contents", [])
+            stack = symbolicator.stack(image_map, frames)
+            if per_thread:
+                stack = (symbolicator.intern(thread_root(thread)),) + stack
+            aggregator.add(stack, 1)
+
+    # CPU profiles hold a call tree with inclusive counts; emit each node's
+    # own samples.
+    profile = report.get("cpu_profile")
+    if isinstance(profile, dict):
+        nodes = profile.get("nodes", [])
+        self_counts = [node.get("count", 0) for node in nodes]
+        for node in nodes:
+            parent = node.get("parent", -1)
+            if parent >= 0:
+                self_counts[parent] -= node.get("count", 0)
+        root = (symbolicator.intern("cpu_profile"),) if per_thread else ()
+        paths = []
+        for index, node in enumerate(nodes):
+            parent = node.get("parent", -1)
+            frame_id = symbolicator.intern(symbolicator.frame_name(image_map, node, True))
+            paths.append((paths[parent] if parent >= 0 else root) + (frame_id,))
+            aggregator.add(paths[index], self_counts[index])
+
+def report_paths(paths):
+
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.endswith(".json"):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+def export(input_paths, binary_paths, output_path, per_thread, max_stacks):
+
+    symbolicator = Symbolicator(index_binaries(binary_paths))
+    aggregator = StackAggregator(symbolicator, max_stacks)
+
+    for path in report_paths(input_paths):
+        try:
+            with open(path, "r") as input_file:
+                report = json.load(input_file)
+        except (IOError, OSError, ValueError) as error:
+            sys.stderr.write("Skipping {}: {}\n".format(path, error))
+            continue
+        if isinstance(report, dict):
+            add_report(report, symbolicator, aggregator, per_thread)
+
+    if output_path is None:
+        aggregator.write(sys.stdout)
+    else:
+        with open(output_path, "w") as output_file:
+            aggregator.write(output_file)
+
+def main(argv):
+    help_desc = 'flamegraph_exporter.py -i <report.json|reports dir> [-i ...] [-b <binary|dSYM dir> ...] [-o <output.folded>] [-t] [-m <max stacks in memory>]'
+
+    input_paths = []
+    binary_paths = []
+    output_path = None
+    per_thread = False
+    max_stacks = DEFAULT_MAX_STACKS
+
+    try:
+        opts, args = getopt.getopt(argv,"hi:b:o:tm:",["input=","binary=","output=","per-thread","max-stacks="])
+    except getopt.GetoptError:
+        print(help_desc)
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt == '-h':
+            print(help_desc)
+            sys.exit()
+        elif opt in ("-i", "--input"):
+            input_paths.append(arg)
+        elif opt in ("-b", "--binary"):
+            binary_paths.append(arg)
+        elif opt in ("-o", "--output"):
+            output_path = arg
+        elif opt in ("-t", "--per-thread"):
+            per_thread = True
+        elif opt in ("-m", "--max-stacks"):
+            max_stacks = max(1, int(arg))
+
+    if not input_paths or not all(os.path.exists(path) for path in input_paths):
+        print(help_desc)
+        sys.exit(2)
+
+    export(input_paths, binary_paths, output_path, per_thread, max_stacks)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
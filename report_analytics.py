@@ -0,0 +1,413 @@
+import os
+import re
+import sys
+import json
+import time
+import zlib
+import array
+import getopt
+import struct
+import collections
+
+from report_converter import expand_report
+
+# A store is a sequence of row groups, one per ingest run. Each row group is
+#   "GCRG" | uint32 header length | JSON header | column blobs
+# The header holds the row count and, per column, its type, blob offset and
+# length, and min/max, so queries can skip whole row groups and only read the
+# columns they use. String columns are dictionary encoded: the blob holds the
+# distinct values followed by one int32 code per row (-1 = missing).
+
+ROW_GROUP_MAGIC = b"GCRG"
+
+INT = "int"
+STRING = "string"
+
+def report_info(report):
+    return report.get("report") or {}
+
+def system_info(report):
+    return report.get("system") or {}
+
+def error_info(report):
+    return (report.get("crash") or {}).get("error") or {}
+
+def crashed_frame(report):
+
+    threads = (report.get("crash") or {}).get("threads", [])
+    for thread in threads:
+        if thread.get("crashed"):
+            contents = (thread.get("backtrace") or {}).get("contents", [])
+            return contents[0] if contents else {}
+    return {}
+
+def crashed_image(report):
+
+    frame = crashed_frame(report)
+    address = frame.get("instruction_addr")
+    if address is None:
+        return {}
+    for image in report.get("binary_images", []):
+        start = image.get("image_addr", 0)
+        if start <= address < start + image.get("image_size", 0):
+            return image
+    return {}
+
+def exception_name(report):
+
+    error = error_info(report)
+    for section in ("nsexception", "cpp_exception", "user_reported", "signal"):
+        name = (error.get(section) or {}).get("name")
+        if name:
+            return name
+    return None
+
+COLUMNS = [
+    ("report_id", STRING, lambda report: report_info(report).get("id")),
+    ("timestamp", INT, lambda report: report_info(report).get("timestamp")),
+    ("report_type", STRING, lambda report: report_info(report).get("type")),
+    ("system_name", STRING, lambda report: system_info(report).get("system_name")),
+    ("os_version", STRING, lambda report: system_info(report).get("system_version")),
+    ("os_build", STRING, lambda report: system_info(report).get("os_version")),
+    ("machine", STRING, lambda report: system_info(report).get("machine")),
+    ("app_version", STRING, lambda report: system_info(report).get("CFBundleShortVersionString")),
+    ("app_build", STRING, lambda report: system_info(report).get("CFBundleVersion")),
+    ("app_uuid", STRING, lambda report: system_info(report).get("app_uuid")),
+    ("error_type", STRING, lambda report: error_info(report).get("type")),
+    ("exception_name", STRING, exception_name),
+    ("reason", STRING, lambda report: error_info(report).get("reason")),
+    ("fingerprint", STRING, lambda report: (report.get("crash") or {}).get("fingerprint")),
+    ("crashed_image", STRING, lambda report: os.path.basename(crashed_image(report).get("name") or "") or None),
+    ("crashed_image_uuid", STRING, lambda report: crashed_image(report).get("uuid")),
+    ("crashed_symbol", STRING, lambda report: crashed_frame(report).get("symbol_name")),
+    ("thread_count", INT, lambda report: len((report.get("crash") or {}).get("threads", []))),
+    ("image_count", INT, lambda report: len(report.get("binary_images", []))),
+]
+
+COLUMN_TYPES = dict((name, column_type) for name, column_type, _ in COLUMNS)
+
+MISSING_INT = -(1 << 63)
+
+def encode_column(column_type, values):
+
+    if column_type == INT:
+        data = array.array("q", [MISSING_INT if value is None else int(value) for value in values])
+        present = [value for value in values if value is not None]
+        if sys.byteorder != "little":
+            data.byteswap()
+        blob = data.tobytes()
+    else:
+        dictionary = {}
+        codes = array.array("i")
+        for value in values:
+            if value is None:
+                codes.append(-1)
+            else:
+                codes.append(dictionary.setdefault(str(value), len(dictionary)))
+        if sys.byteorder != "little":
+            codes.byteswap()
+        present = list(dictionary)
+        encoded = json.dumps(present).encode("utf-8")
+        blob = struct.pack("<I", len(encoded)) + encoded + codes.tobytes()
+    column = {"type": column_type}
+    if present:
+        column["min"] = min(present)
+        column["max"] = max(present)
+    return column, zlib.compress(blob)
+
+def decode_column(column_type, blob):
+
+    blob = zlib.decompress(blob)
+    if column_type == INT:
+        data = array.array("q")
+        data.frombytes(blob)
+        if sys.byteorder != "little":
+            data.byteswap()
+        return None, data
+    length, = struct.unpack_from("<I", blob)
+    dictionary = json.loads(blob[4:4 + length].decode("utf-8"))
+    codes = array.array("i")
+    codes.frombytes(blob[4 + length:])
+    if sys.byteorder != "little":
+        codes.byteswap()
+    return dictionary, codes
+
+def write_row_group(store, rows):
+
+    header = {"row_count": len(rows), "columns": {}}
+    blobs = []
+    offset = 0
+    for index, (name, column_type, _) in enumerate(COLUMNS):
+        column, blob = encode_column(column_type, [row[index] for row in rows])
+        column["offset"] = offset
+        column["length"] = len(blob)
+        header["columns"][name] = column
+        blobs.append(blob)
+        offset += len(blob)
+    encoded = json.dumps(header).encode("utf-8")
+    store.write(ROW_GROUP_MAGIC + struct.pack("<I", len(encoded)) + encoded)
+    for blob in blobs:
+        store.write(blob)
+
+def read_row_groups(store):
+
+    # Yields (header, offset of its first column blob).
+    while True:
+        start = store.read(8)
+        if len(start) < 8:
+            return
+        if start[:4] != ROW_GROUP_MAGIC:
+            raise ValueError("corrupt store at offset {}".format(store.tell() - 8))
+        length, = struct.unpack("<I", start[4:])
+        header = json.loads(store.read(length).decode("utf-8"))
+        data_offset = store.tell()
+        yield header, data_offset
+        store.seek(data_offset + sum(column["length"] for column in header["columns"].values()))
+
+def read_column(store, header, data_offset, name):
+
+    column = header["columns"][name]
+    store.seek(data_offset + column["offset"])
+    return decode_column(column["type"], store.read(column["length"]))
+
+def stored_report_ids(store_path):
+
+    ids = set()
+    if not os.path.isfile(store_path):
+        return ids
+    with open(store_path, "rb") as store:
+        for header, data_offset in read_row_groups(store):
+            position = store.tell()
+            dictionary, codes = read_column(store, header, data_offset, "report_id")
+            ids.update(dictionary)
+            store.seek(position)
+    return ids
+
+def report_paths(paths):
+
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.endswith(".json"):
+                    yield os.path.join(path, name)
+        else:
+            yield path
+
+def ingest(store_path, input_paths, row_group_size):
+
+    known_ids = stored_report_ids(store_path)
+    rows = []
+    count = 0
+    with open(store_path, "ab") as store:
+        for path in report_paths(input_paths):
+            try:
+                with open(path, "r") as input_file:
+                    report = json.load(input_file)
+            except (IOError, OSError, ValueError) as error:
+                sys.stderr.write("Skipping {}: {}\n".format(path, error))
+                continue
+            if not isinstance(report, dict):
+                continue
+            if "report" in report and isinstance(report["report"], dict) and "crash" in report["report"]:
+                report = report["report"]
+            expand_report(report)
+            report_id = report_info(report).get("id")
+            if report_id is not None and report_id in known_ids:
+                continue
+            known_ids.add(report_id)
+            rows.append([extract(report) for _, _, extract in COLUMNS])
+            if len(rows) >= row_group_size:
+                write_row_group(store, rows)
+                count += len(rows)
+                rows = []
+        if rows:
+            write_row_group(store, rows)
+            count += len(rows)
+    print("Ingested {} reports".format(count))
+
+# Filters
+
+FILTER_PATTERN = re.compile(r"^\s*(\w+)\s*(>=|<=|!=|=|<|>|~)\s*(.*?)\s*$")
+RELATIVE_TIME_PATTERN = re.compile(r"^now(?:-(\d+)([smhdw]))?$")
+TIME_UNITS = {"s": 1, "m": 60, "h": 3600, "d": 86400, "w": 604800}
+
+COMPARATORS = {
+    "=": lambda a, b: a == b,
+    "!=": lambda a, b: a != b,
+    "<": lambda a, b: a < b,
+    "<=": lambda a, b: a <= b,
+    ">": lambda a, b: a > b,
+    ">=": lambda a, b: a >= b,
+    "~": lambda a, b: b in a,
+}
+
+def parse_filter(text):
+
+    match = FILTER_PATTERN.match(text)
+    if match is None:
+        raise ValueError("bad filter: {}".format(text))
+    name, op, value = match.groups()
+    if name not in COLUMN_TYPES:
+        raise ValueError("unknown column: {}".format(name))
+    if COLUMN_TYPES[name] == INT:
+        relative = RELATIVE_TIME_PATTERN.match(value)
+        if relative is not None:
+            amount, unit = relative.groups()
+            value = int(time.time()) - (int(amount) * TIME_UNITS[unit] if amount else 0)
+        else:
+            value = int(value)
+        if op == "~":
+            raise ValueError("~ only applies to string columns")
+    return name, op, value
+
+def may_match(column, op, value):
+
+    # Row group pruning with the column's min/max.
+    if "min" not in column:
+        return op == "!="
+    low, high = column["min"], column["max"]
+    if op == "=":
+        return low <= value <= high
+    if op == "<":
+        return low < value
+    if op == "<=":
+        return low <= value
+    if op == ">":
+        return high > value
+    if op == ">=":
+        return high >= value
+    return True
+
+def filter_mask(dictionary, values, op, value):
+
+    compare = COMPARATORS[op]
+    if dictionary is None:
+        return [v != MISSING_INT and compare(v, value) for v in values]
+    # Evaluate the predicate once per distinct string, then on the codes.
+    matching = set(code for code, entry in enumerate(dictionary) if compare(entry, value))
+    if len(matching) == 1:
+        target = next(iter(matching))
+        return [code == target for code in values]
+    return [code in matching for code in values]
+
+def query(store_path, filters, group_by, select, limit):
+
+    needed = set(name for name, _, _ in filters) | set(group_by) | set(select)
+    for name in needed:
+        if name not in COLUMN_TYPES:
+            raise ValueError("unknown column: {}".format(name))
+
+    counts = collections.Counter()
+    printed = 0
+    scanned = 0
+    skipped = 0
+    with open(store_path, "rb") as store:
+        for header, data_offset in read_row_groups(store):
+            position = store.tell()
+            if not all(may_match(header["columns"][name], op, value) for name, op, value in filters):
+                skipped += 1
+                continue
+            scanned += 1
+
+            columns = {}
+            for name in needed:
+                columns[name] = read_column(store, header, data_offset, name)
+            store.seek(position)
+
+            selected = None
+            for name, op, value in filters:
+                dictionary, values = columns[name]
+                mask = filter_mask(dictionary, values, op, value)
+                selected = mask if selected is None else [a and b for a, b in zip(selected, mask)]
+            rows = range(header["row_count"]) if selected is None else [row for row, keep in enumerate(selected) if keep]
+
+            def decoded(name):
+                dictionary, values = columns[name]
+                if dictionary is None:
+                    return [None if value == MISSING_INT else value for value in values]
+                return [None if code < 0 else dictionary[code] for code in values]
+
+            if select:
+                decoded_columns = [decoded(name) for name in select]
+                for row in rows:
+                    if limit is not None and printed >= limit:
+                        break
+                    print("\t".join(str(column[row]) for column in decoded_columns))
+                    printed += 1
+            else:
+                decoded_columns = [decoded(name) for name in group_by]
+                counts.update(tuple(column[row] for column in decoded_columns) for row in rows)
+
+    if not select:
+        for key, count in counts.most_common(limit):
+            print("\t".join([str(count)] + [str(value) for value in key]))
+    sys.stderr.write("Scanned {} row groups, skipped {}\n".format(scanned, skipped))
+
+def main(argv):
+    help_desc = '''report_analytics.py ingest -d <store.gcol> -i <report.json|reports dir> [-i ...] [-r <rows per group>]
+report_analytics.py query -d <store.gcol> [-w <column op value> ...] [-g <column,...>] [-s <column,...>] [-l <limit>]
+    ops: = != < <= > >= ~ (substring). Int values may be relative times: now-7d, now-24h
+report_analytics.py columns'''
+
+    if not argv or argv[0] not in ("ingest", "query", "columns"):
+        print(help_desc)
+        sys.exit(2)
+    command = argv[0]
+
+    store_path = None
+    input_paths = []
+    row_group_size = 10000
+    filters = []
+    group_by = []
+    select = []
+    limit = None
+
+    try:
+        opts, args = getopt.getopt(argv[1:],"hd:i:r:w:g:s:l:",["store=","input=","rows=","where=","group-by=","select=","limit="])
+    except getopt.GetoptError:
+        print(help_desc)
+        sys.exit(2)
+
+    try:
+        for opt, arg in opts:
+            if opt == '-h':
+                print(help_desc)
+                sys.exit()
+            elif opt in ("-d", "--store"):
+                store_path = arg
+            elif opt in ("-i", "--input"):
+                input_paths.append(arg)
+            elif opt in ("-r", "--rows"):
+                row_group_size = max(1, int(arg))
+            elif opt in ("-w", "--where"):
+                filters.append(parse_filter(arg))
+            elif opt in ("-g", "--group-by"):
+                group_by = [name.strip() for name in arg.split(",") if name.strip()]
+            elif opt in ("-s", "--select"):
+                select = [name.strip() for name in arg.split(",") if name.strip()]
+            elif opt in ("-l", "--limit"):
+                limit = int(arg)
+    except ValueError as error:
+        print(error)
+        sys.exit(2)
+
+    if command == "columns":
+        for name, column_type, _ in COLUMNS:
+            print("{}\t{}".format(name, column_type))
+    elif command == "ingest":
+        if store_path is None or not input_paths:
+            print(help_desc)
+            sys.exit(2)
+        ingest(store_path, input_paths, row_group_size)
+    else:
+        if store_path is None or not os.path.isfile(store_path):
+            print(help_desc)
+            sys.exit(2)
+        try:
+            query(store_path, filters, group_by, select, limit)
+        except ValueError as error:
+            print(error)
+            sys.exit(2)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -0,0 +1,85 @@
+import os
+import sys
+import json
+import getopt
+
+SHARED_FRAMES_KEY = "shared_frames"
+SHARED_SUFFIX_KEY = "shared_suffix"
+CALLER_KEY = "caller"
+
+def shared_suffix(shared_frames, index):
+
+    frames = []
+    while index is not None:
+        frame = dict(shared_frames[index])
+        index = frame.pop(CALLER_KEY, None)
+        frames.append(frame)
+    return frames
+
+def expand_crash(crash):
+
+    shared_frames = crash.pop(SHARED_FRAMES_KEY, None)
+    if shared_frames is None:
+        return
+
+    for thread in crash.get("threads", []):
+        backtrace = thread.get("backtrace")
+        if backtrace is None or SHARED_SUFFIX_KEY not in backtrace:
+            continue
+        index = backtrace.pop(SHARED_SUFFIX_KEY)
+        backtrace["contents"] = backtrace.get("contents", []) + shared_suffix(shared_frames, index)
+
+def expand_report(report):
+
+    if isinstance(report, dict):
+        if SHARED_FRAMES_KEY in report:
+            expand_crash(report)
+        for value in report.values():
+            expand_report(value)
+    elif isinstance(report, list):
+        for value in report:
+            expand_report(value)
+
+def convert_file(input_path, output_path):
+
+    with open(input_path, "r") as input_file:
+        report = json.load(input_file)
+
+    expand_report(report)
+
+    if output_path is None:
+        json.dump(report, sys.stdout, indent=2)
+        print("")
+    else:
+        with open(output_path, "w") as output_file:
+            json.dump(report, output_file, indent=2)
+
+def main(argv):
+    help_desc = 'report_converter.py -i <report.json> [-o <output.json>]'
+
+    input_path = None
+    output_path = None
+
+    try:
+        opts, args = getopt.getopt(argv,"hi:o:",["input=","output="])
+    except getopt.GetoptError:
+        print(help_desc)
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt == '-h':
+            print(help_desc)
+            sys.exit()
+        elif opt in ("-i", "--input"):
+            input_path = arg
+        elif opt in ("-o", "--output"):
+            output_path = arg
+
+    if input_path is None or not os.path.isfile(input_path):
+        print(help_desc)
+        sys.exit(2)
+
+    convert_file(input_path, output_path)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])